@@ -0,0 +1,38 @@
+#ifndef CEF_APP_BASE64_H_
+#define CEF_APP_BASE64_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Standard (RFC 4648, padded) base64 codec writing into caller-provided
+// buffers. Uses AVX2 or SSE4.1 when the CPU supports them (selected at
+// runtime) and NEON on ARM64, with a scalar fallback for everything else and
+// for the tail of each buffer.
+
+// Exact encoded size of |size| bytes
+inline size_t Base64EncodedSize(size_t size) {
+  return (size + 2) / 3 * 4;
+}
+
+// Upper bound on the decoded size of |size| base64 characters
+inline size_t Base64DecodedMaxSize(size_t size) {
+  return (size + 3) / 4 * 3;
+}
+
+// Encode |size| bytes into |output|, which must hold Base64EncodedSize(size)
+// characters. No terminator is written. Returns the number of characters.
+size_t Base64Encode(const void* input, size_t size, char* output);
+
+// Convenience wrapper returning a std::string
+std::string Base64Encode(const void* input, size_t size);
+
+// Decode into |output|, which must hold at least Base64DecodedMaxSize(size)
+// bytes. Returns false on malformed input.
+bool Base64Decode(const char* input, size_t size, uint8_t* output,
+                  size_t* output_size);
+
+// Name of the implementation selected for this CPU, for logging
+const char* Base64ImplementationName();
+
+#endif  // CEF_APP_BASE64_H_
@@ -0,0 +1,60 @@
+#ifndef CEF_APP_BUFFER_POOL_H_
+#define CEF_APP_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Allocator whose value-less construct() default-initializes, so growing a
+// vector of bytes leaves the new bytes uninitialized instead of zeroing them
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+  template <typename U>
+  struct rebind {
+    using other = DefaultInitAllocator<U>;
+  };
+
+  DefaultInitAllocator() = default;
+  template <typename U>
+  DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept {}
+
+  template <typename U>
+  void construct(U* p) {
+    ::new (static_cast<void*>(p)) U;
+  }
+  template <typename U, typename... Args>
+  void construct(U* p, Args&&... args) {
+    ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+  }
+};
+
+// Byte buffer for data that is written right after it is sized: frames
+// decoded from base64, copied pixels, compressed output
+using ByteBuffer = std::vector<uint8_t, DefaultInitAllocator<uint8_t>>;
+
+// Thread-safe pool of byte buffers that keep their capacity between uses.
+//
+// Screencast frames are a few hundred KB each and arrive many times per
+// second; recycling the buffers avoids a large allocation per frame.
+class BufferPool {
+ public:
+  explicit BufferPool(size_t max_pooled);
+
+  // Returns a buffer resized to |size|. Its contents are unspecified; new
+  // bytes are not zeroed.
+  ByteBuffer Acquire(size_t size);
+
+  // Give a buffer back. Dropped if the pool is already full.
+  void Release(ByteBuffer buffer);
+
+ private:
+  std::mutex lock_;
+  std::vector<ByteBuffer> buffers_;
+  size_t max_pooled_;
+};
+
+#endif  // CEF_APP_BUFFER_POOL_H_
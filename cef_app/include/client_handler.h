@@ -2,13 +2,25 @@
 #define CEF_APP_CLIENT_HANDLER_H_
 
 #include "include/cef_client.h"
+#include "include/cef_command_line.h"
 #include "include/cef_devtools_message_observer.h"
 #include "include/cef_registration.h"
+#include "frame_bus.h"
+#include "frame_index.h"
+#include "message_registry.h"
 #include "oauth_server.h"
-
+#include "recording_writer.h"
+#include "replay_buffer.h"
+#include "screencast_controller.h"
+#include "screencast_recorder.h"
+#include "slide_detector.h"
+#include "thumbnail_service.h"
+
+#include <chrono>
+#include <ctime>
 #include <list>
 #include <memory>
-#include <fstream>
+#include <vector>
 
 // Client handler for browser-level callbacks
 class ClientHandler : public CefClient,
@@ -16,6 +28,7 @@ class ClientHandler : public CefClient,
                       public CefFocusHandler,
                       public CefLifeSpanHandler,
                       public CefLoadHandler,
+                      public CefRenderHandler,
                       public CefRequestHandler,
                       public CefResourceRequestHandler,
                       public CefDevToolsMessageObserver {
@@ -30,6 +43,10 @@ class ClientHandler : public CefClient,
   // Provide access to the single global instance
   static ClientHandler* GetInstance();
 
+  // True if the content browser should render off-screen (Linux only). CEF
+  // must then be initialized with windowless rendering enabled.
+  static bool UseOffScreenRendering(CefRefPtr<CefCommandLine> command_line);
+
   // CefClient methods
   virtual CefRefPtr<CefDisplayHandler> GetDisplayHandler() override {
     return this;
@@ -41,6 +58,9 @@ class ClientHandler : public CefClient,
     return this;
   }
   virtual CefRefPtr<CefLoadHandler> GetLoadHandler() override { return this; }
+  virtual CefRefPtr<CefRenderHandler> GetRenderHandler() override {
+    return osr_enabled_ ? this : nullptr;
+  }
   virtual CefRefPtr<CefRequestHandler> GetRequestHandler() override {
     return this;
   }
@@ -82,6 +102,10 @@ class ClientHandler : public CefClient,
   // CefDisplayHandler methods
   virtual void OnTitleChange(CefRefPtr<CefBrowser> browser,
                              const CefString& title) override;
+  virtual bool OnCursorChange(CefRefPtr<CefBrowser> browser,
+                              CefCursorHandle cursor,
+                              cef_cursor_type_t type,
+                              const CefCursorInfo& custom_cursor_info) override;
 
   // CefFocusHandler methods
   virtual void OnGotFocus(CefRefPtr<CefBrowser> browser) override;
@@ -106,12 +130,26 @@ class ClientHandler : public CefClient,
                              bool* no_javascript_access) override;
 
   // CefLoadHandler methods
+  virtual void OnLoadEnd(CefRefPtr<CefBrowser> browser,
+                         CefRefPtr<CefFrame> frame,
+                         int httpStatusCode) override;
   virtual void OnLoadError(CefRefPtr<CefBrowser> browser,
                            CefRefPtr<CefFrame> frame,
                            ErrorCode errorCode,
                            const CefString& errorText,
                            const CefString& failedUrl) override;
 
+  // CefRenderHandler methods (off-screen content browser only)
+  virtual void GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rect) override;
+  virtual void OnPopupShow(CefRefPtr<CefBrowser> browser, bool show) override;
+  virtual void OnPopupSize(CefRefPtr<CefBrowser> browser, const CefRect& rect) override;
+  virtual void OnPaint(CefRefPtr<CefBrowser> browser,
+                       PaintElementType type,
+                       const RectList& dirtyRects,
+                       const void* buffer,
+                       int width,
+                       int height) override;
+
   // CefRequestHandler methods
   virtual bool OnBeforeBrowse(CefRefPtr<CefBrowser> browser,
                               CefRefPtr<CefFrame> frame,
@@ -146,6 +184,10 @@ class ClientHandler : public CefClient,
     return nullptr;
   }
 
+  // Push |payload| to the UI's handler for |topic| (rebrazeAuth.subscribe).
+  // Topics and payloads are listed in frontend/src/utils/cefBridge.ts.
+  void PublishEvent(const std::string& topic, CefRefPtr<CefDictionaryValue> payload);
+
   // Meeting view browser management (dual-browser architecture)
   void CreateMeetingView(const std::string& url, int x, int y, int width, int height);
   void ShowMeetingView();
@@ -171,6 +213,33 @@ class ClientHandler : public CefClient,
   void NavigateContentBrowser(const std::string& url);
 
  private:
+  // Process messages from the renderers, dispatched by name through
+  // GetMessageTable() once their arguments match the schema
+  using MessageTable = MessageRegistry<void (ClientHandler::*)(CefRefPtr<CefBrowser> browser,
+                                                               CefRefPtr<CefProcessMessage> message)>;
+  static const MessageTable& GetMessageTable();
+  void HandleOpenSystemBrowser(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleNavigateToMeeting(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleJoinMeeting(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleLeaveMeeting(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleUpdateMeetingBounds(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleGetMeetingPageInfo(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleGetMeetingParticipants(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleParticipantsChanged(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleStartRecording(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleStopRecording(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleRecordingCropChanged(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleSetReplayBuffer(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleSaveReplay(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleStartSlideDetection(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleStopSlideDetection(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleGetRecordingPreviews(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleSearchFrames(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleScreencastFrameConsumed(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleOpenRecordingSession(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleAppendRecordingChunk(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+  void HandleFinalizeRecordingSession(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+
   // Platform-specific implementation
   void PlatformTitleChange(CefRefPtr<CefBrowser> browser,
                            const CefString& title);
@@ -189,9 +258,120 @@ class ClientHandler : public CefClient,
   void PlatformHideMeetingView(CefRefPtr<CefBrowser> browser);
   void PlatformCloseMeetingView(CefRefPtr<CefBrowser> browser);
 
+  // Platform-specific presentation of the off-screen content browser: a
+  // native child window at the meeting bounds that shows the painted pixels
+  // and forwards mouse and keyboard input to the browser
+  bool PlatformCreateOsrWindow(int x, int y, int width, int height);
+  void PlatformPaintOsrWindow(const void* buffer, int width, int height,
+                              const RectList& dirty_rects, int offset_x, int offset_y);
+  void PlatformSetOsrCursor(CefCursorHandle cursor);
+  void PlatformDestroyOsrWindow();
+
   // Open URL in system browser
   void OpenSystemBrowser(const std::string& url);
 
+  // Tell the UI browser that a recording file is complete
+  void NotifyRecordingSaved(const std::string& meeting_id,
+                            const std::string& recording_path);
+
+  // Finish the streaming recording session; the UI is notified once the
+  // file is on disk
+  void CloseRecordingSession();
+
+  // Repair recordings interrupted by a crash in an earlier run. Runs on a
+  // file thread; only recordings opened before |launch_time| are touched.
+  void RecoverInterruptedRecordings(std::time_t launch_time);
+
+  // Make a finished streaming recording seekable, then notify the UI. Runs
+  // on a file thread.
+  void FinishRecording(const std::string& meeting_id,
+                       const std::string& recording_path);
+
+  // Write the instant replay buffer to |recording_path|, then notify the UI.
+  // Runs on a file thread.
+  void SaveReplay(std::shared_ptr<ReplayBuffer> replay_buffer,
+                  const std::string& meeting_id,
+                  const std::string& recording_path);
+
+  // End native or renderer-mode screencast recording: drop the recording
+  // subscriptions, stop crop tracking and let the native recorder finish
+  // its file in the background
+  void StopRecording();
+
+  // Finish slide detection in the background; the analyzer thread may
+  // still be working on a frame
+  void StopSlideDetection();
+
+  // Report the viewport rect of the first element matching |selector| in
+  // the content browser as "recording_crop_changed" while it moves or
+  // resizes; the native recorder keeps only that region
+  void StartCropTracking(const std::string& selector);
+  void StopCropTracking();
+
+  // Inject the participant agent into the content browser's page. It
+  // opens the participant list once, watches it with a MutationObserver and
+  // reports who joined and left as "participants_changed".
+  void StartParticipantAgent();
+
+  // Forget the roster, publishing everyone in it as having left
+  void ResetParticipants();
+
+  // Hash new recordings into the visual search index in the background
+  void UpdateFrameIndex();
+
+  // Look up recordings showing a frame like |jpeg| and answer request
+  // |request_id| with the matches. Runs on a file thread.
+  void SearchFrames(std::shared_ptr<FrameIndex> frame_index,
+                    std::vector<uint8_t> jpeg,
+                    int max_results,
+                    int request_id);
+
+  // Make (or look up) the poster, scrub sprite and VTT of a recording in the
+  // background, then answer request |request_id| with them, or publish them
+  // as a "recordingPreviews" event if |request_id| is 0
+  void GenerateRecordingPreviews(const std::string& recording_path, int request_id);
+  void SendRecordingPreviews(const std::string& recording_path, int request_id,
+                             CefRefPtr<CefDictionaryValue> previews);
+
+  // Settle the promise of request |request_id| from the UI renderer: resolved
+  // with |result|, or rejected with |error|
+  void SendRequestResult(int request_id, CefRefPtr<CefValue> result);
+  void SendRequestError(int request_id, const std::string& error);
+
+  // Where requests are answered and events go: the UI browser, or the first
+  // browser on platforms without one
+  CefRefPtr<CefBrowser> GetMessageTarget();
+
+  // Capture the content browser while a recording, the replay buffer or
+  // slide detection needs frames
+  void StartScreencastCapture();
+  void StopScreencastCaptureIfUnused();
+
+  // Off-screen mode: repaint the open popup (e.g. a <select> list) over the
+  // view, and lower the paint rate while the recorder falls behind
+  void PaintOsrPopup();
+  bool IsRecordingPaints() const {
+    return osr_enabled_ && screencast_recorder_ && screencast_recorder_->IsRecording();
+  }
+  void OnOffScreenFrameConsumed(bool dropped);
+  void SetOsrFrameRate(int frame_rate);
+
+  // Screencast capture with backpressure. Frames are acked through the
+  // controller, which also picks the capture settings.
+  void StartScreencast();
+  void AckScreencastFrame(int session_id);
+  void OnScreencastFrameConsumed(bool dropped);
+  void OnScreencastFrameReleased(int generation, bool dropped);
+  void UpdateScreencast(int generation);
+
+  // Frame bus subscriptions of the recorder or, in renderer mode, the UI
+  // preview. The preview has at most one frame with the UI renderer and one
+  // waiting; newer frames replace the waiting one.
+  void SubscribeRecordingFrames();
+  void UnsubscribeFrames(int& subscription);
+  void SendFrameToUI(const FrameRef& frame);
+  void OnUIFrameConsumed();
+
   // True if the application is using the Views framework
   const bool use_views_;
 
@@ -216,17 +396,68 @@ class ClientHandler : public CefClient,
   // Store content browser's title for meeting info
   std::string content_browser_title_;
 
+  // Participants of the meeting in the content browser, in joining order;
+  // kept up to date by the participant agent
+  std::vector<std::string> participants_;
+
   // Track last meeting bounds to avoid redundant updates
   int last_meeting_x_ = 0;
   int last_meeting_y_ = 0;
   int last_meeting_width_ = 0;
   int last_meeting_height_ = 0;
 
-  // Recording file
-  std::ofstream recording_file_;
-  std::string current_recording_path_;
+  // Off-screen rendering of the content browser (see UseOffScreenRendering).
+  // Paints go to |osr_window_| and, while recording natively, straight to
+  // the recorder as BGRA; the DevTools screencast is not involved.
+  bool osr_enabled_ = false;
+  int osr_max_frame_rate_ = 30;
+  int osr_frame_rate_ = 30;
+  std::chrono::steady_clock::time_point osr_frame_rate_changed_;
+  CefWindowHandle osr_window_ = kNullWindowHandle;
+  CefRect osr_popup_rect_;
+  std::vector<uint8_t> osr_popup_pixels_;  // Last popup paint, BGRA
+
+  // Streaming recording session (renderer-mode chunks); the writer runs its
+  // own I/O thread
+  std::unique_ptr<RecordingWriter> recording_writer_;
+  std::string recording_meeting_id_;
+  uint32_t recording_next_sequence_;
+  std::chrono::steady_clock::time_point recording_started_;
+  int64_t recording_committed_ms_ = 0;  // End of the last committed segment
+  bool recovery_started_ = false;
   std::string current_meeting_id_;
 
+  // Screencast frames, decoded once and shared by the consumers below.
+  // Subscription ids are 0 while unsubscribed.
+  FrameBus frame_bus_;
+  int recorder_subscription_ = 0;
+  int ui_subscription_ = 0;
+  int slides_subscription_ = 0;
+
+  // Native screencast recorder (used when recording in "native" mode)
+  std::unique_ptr<ScreencastRecorder> screencast_recorder_;
+
+  // Always-on capture of the last few minutes (see ReplayBuffer); shared
+  // with an in-progress save. Not on the frame bus: frames are decoded
+  // straight into its arena.
+  std::shared_ptr<ReplayBuffer> replay_buffer_;
+  bool recording_screencast_ = false;  // start_recording is active
+  bool crop_tracking_ = false;         // The content browser reports a crop rect
+
+  // Keyframe extraction for meeting summaries
+  std::unique_ptr<SlideDetector> slide_detector_;
+
+  // Visual search over the recordings directory; created with the UI browser
+  std::shared_ptr<FrameIndex> frame_index_;
+
+  // Recording previews; created with the UI browser
+  std::unique_ptr<ThumbnailService> thumbnail_service_;
+
+  // Adaptive screencast settings and deferred frame acks
+  ScreencastController screencast_controller_;
+  bool screencast_active_ = false;
+  int screencast_generation_ = 0;  // Invalidates pending UpdateScreencast tasks
+
   // DevTools observer registration
   CefRefPtr<CefRegistration> devtools_registration_;
   int next_devtools_id_ = 1;
@@ -0,0 +1,10 @@
+#ifndef CEF_APP_CPU_FEATURES_H_
+#define CEF_APP_CPU_FEATURES_H_
+
+// Runtime CPU feature checks for SIMD kernels that are compiled with
+// per-function target attributes and selected when first used. Both return
+// false on non-x86 builds.
+bool CpuHasSse41();
+bool CpuHasAvx2();
+
+#endif  // CEF_APP_CPU_FEATURES_H_
@@ -0,0 +1,90 @@
+#ifndef CEF_APP_EBML_H_
+#define CEF_APP_EBML_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// EBML element IDs and serialization helpers shared by the Matroska/WebM
+// writer and remuxer.
+namespace ebml {
+
+// Element IDs (IDs already include their length marker bits)
+const uint32_t kEbml = 0x1A45DFA3;
+const uint32_t kEbmlVersion = 0x4286;
+const uint32_t kEbmlReadVersion = 0x42F7;
+const uint32_t kEbmlMaxIdLength = 0x42F2;
+const uint32_t kEbmlMaxSizeLength = 0x42F3;
+const uint32_t kDocType = 0x4282;
+const uint32_t kDocTypeVersion = 0x4287;
+const uint32_t kDocTypeReadVersion = 0x4285;
+const uint32_t kSegment = 0x18538067;
+const uint32_t kSeekHead = 0x114D9B74;
+const uint32_t kSeek = 0x4DBB;
+const uint32_t kSeekId = 0x53AB;
+const uint32_t kSeekPosition = 0x53AC;
+const uint32_t kVoid = 0xEC;
+const uint32_t kInfo = 0x1549A966;
+const uint32_t kTimestampScale = 0x2AD7B1;
+const uint32_t kDuration = 0x4489;
+const uint32_t kMuxingApp = 0x4D80;
+const uint32_t kWritingApp = 0x5741;
+const uint32_t kTracks = 0x1654AE6B;
+const uint32_t kTrackEntry = 0xAE;
+const uint32_t kTrackNumber = 0xD7;
+const uint32_t kTrackUid = 0x73C5;
+const uint32_t kTrackType = 0x83;
+const uint32_t kFlagLacing = 0x9C;
+const uint32_t kCodecId = 0x86;
+const uint32_t kVideo = 0xE0;
+const uint32_t kPixelWidth = 0xB0;
+const uint32_t kPixelHeight = 0xBA;
+const uint32_t kCluster = 0x1F43B675;
+const uint32_t kClusterTimestamp = 0xE7;
+const uint32_t kSimpleBlock = 0xA3;
+const uint32_t kBlockGroup = 0xA0;
+const uint32_t kBlock = 0xA1;
+const uint32_t kReferenceBlock = 0xFB;
+const uint32_t kCues = 0x1C53BB6B;
+const uint32_t kCuePoint = 0xBB;
+const uint32_t kCueTime = 0xB3;
+const uint32_t kCueTrackPositions = 0xB7;
+const uint32_t kCueTrack = 0xF7;
+const uint32_t kCueClusterPosition = 0xF1;
+const uint32_t kChapters = 0x1043A770;
+const uint32_t kAttachments = 0x1941A469;
+const uint32_t kTags = 0x1254C367;
+
+// Unknown-size marker for an 8-byte EBML size field
+const uint64_t kUnknownSize = 0x00FFFFFFFFFFFFFFULL;
+
+void AppendId(std::string& out, uint32_t id);
+
+// Append |size| as an EBML variable-length integer using the shortest form
+void AppendSize(std::string& out, uint64_t size);
+
+// Append |size| as a fixed 8-byte EBML size so it can be patched later
+void AppendFixedSize(std::string& out, uint64_t size);
+
+void AppendUInt(std::string& out, uint32_t id, uint64_t value);
+void AppendFloat(std::string& out, uint32_t id, double value);
+void AppendString(std::string& out, uint32_t id, const std::string& value);
+void AppendMaster(std::string& out, uint32_t id, const std::string& payload);
+
+// Append a Void element occupying exactly |total| bytes (|total| >= 2)
+void AppendVoid(std::string& out, size_t total);
+
+// Big-endian IEEE double as stored in a float element's payload
+void EncodeFloat(double value, char bytes[8]);
+
+// Parse the variable-length integer at |data|. Returns its length in bytes,
+// or 0 if |size| is too short or the first byte is invalid. With
+// |keep_marker| the length marker bit is kept, as it is for element IDs.
+int ReadVarInt(const uint8_t* data, size_t size, bool keep_marker, uint64_t& value);
+
+// True if |value| (read without the marker) is the reserved unknown size
+bool IsUnknownSize(uint64_t value, int length);
+
+}  // namespace ebml
+
+#endif  // CEF_APP_EBML_H_
@@ -0,0 +1,179 @@
+#ifndef CEF_APP_FRAME_BUS_H_
+#define CEF_APP_FRAME_BUS_H_
+
+#include "buffer_pool.h"
+#include "jpeg_dc_decoder.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fan-out of screencast frames to the consumers in the browser process.
+//
+// A frame is base64-decoded once into an immutable, reference-counted
+// ScreencastFrame that every subscriber shares: the live preview, the
+// recorder and the slide detector hold references instead of copies, and
+// the JPEG buffer is recycled once the last one is gone. (The replay ring
+// is not a subscriber; it decodes frames straight into its own arena.)
+// Pictures derived from the JPEG are decoded by the first consumer that
+// asks for them and shared from then on.
+//
+// Each subscriber declares how often it wants frames and what happens to
+// frames it cannot take yet (DropPolicy). A frame no subscriber wants is
+// never decoded, so a rate-limited subscriber costs nothing for the frames
+// it skips.
+class ScreencastFrame {
+ public:
+  // Runs once the last reference is gone, on the thread that dropped it.
+  // |dropped| is set if a consumer discarded the frame unprocessed.
+  using ReleaseCallback = std::function<void(bool dropped)>;
+
+  ~ScreencastFrame();
+
+  ScreencastFrame(const ScreencastFrame&) = delete;
+  ScreencastFrame& operator=(const ScreencastFrame&) = delete;
+
+  // Screencast timestamp in seconds
+  double GetTimestamp() const { return timestamp_; }
+
+  const uint8_t* GetJpeg() const { return jpeg_.data(); }
+  size_t GetJpegSize() const { return jpeg_.size(); }
+
+  // The 1/8-scale luma image (DecodeJpegDcLuma), or nullptr if the JPEG
+  // cannot be decoded that way. Decoded on the first call. Thread safe.
+  const LumaImage* GetDcLuma() const;
+
+  // A consumer discarded the frame, e.g. in favour of a newer one
+  void MarkDropped() const { dropped_ = true; }
+
+ private:
+  friend class FrameBus;
+
+  ScreencastFrame(ByteBuffer jpeg, double timestamp,
+                  std::shared_ptr<BufferPool> pool, ReleaseCallback on_release);
+
+  ByteBuffer jpeg_;  // Back to |pool_| on destruction
+  const double timestamp_;
+  const std::shared_ptr<BufferPool> pool_;
+  const ReleaseCallback on_release_;
+
+  mutable std::once_flag dc_luma_once_;
+  mutable std::unique_ptr<LumaImage> dc_luma_;
+  mutable std::atomic<bool> dropped_;
+};
+
+using FrameRef = std::shared_ptr<const ScreencastFrame>;
+
+class FrameBus {
+ public:
+  // What happens to a frame that arrives while the subscriber has
+  // |max_in_flight| frames out
+  enum class DropPolicy {
+    kLatestOnly,  // One frame waits; a newer one replaces it
+    kDropOldest,  // Up to |max_queued| wait; the oldest makes room
+    kDropNewest,  // Up to |max_queued| wait; further frames are skipped
+  };
+
+  struct Options {
+    // Frames closer together than this (by screencast timestamp) are
+    // skipped; 0 takes every frame
+    double max_fps = 0.0;
+    DropPolicy drop_policy = DropPolicy::kLatestOnly;
+    // Frames handed to the callback and not yet Done(). 0 means no limit,
+    // for subscribers that queue the frames themselves; they never need to
+    // call Done().
+    size_t max_in_flight = 0;
+    size_t max_queued = 1;
+  };
+
+  // Receives a frame. Runs on the thread calling Publish(), or Done() for
+  // frames that had to wait, outside the bus lock; must not block.
+  using Callback = std::function<void(const FrameRef& frame)>;
+
+  struct Stats {
+    std::string name;
+    uint64_t delivered;
+    uint64_t dropped;
+  };
+
+  explicit FrameBus(size_t pooled_buffers);
+
+  // Returns the subscription id, never 0
+  int Subscribe(const std::string& name, const Options& options, Callback callback);
+
+  // Frames waiting for the subscriber are dropped. Waits for calls of the
+  // callback running on other threads, so it is not running and not called
+  // again once this returns; it may be called from the callback itself.
+  void Unsubscribe(int id);
+
+  // Subscriber |id| has finished with its oldest frame in flight; hands it
+  // the next waiting frame, if any
+  void Done(int id);
+
+  // Forget the frames |id| has in flight or waiting, e.g. because it went
+  // away without calling Done()
+  void Reset(int id);
+
+  bool HasSubscribers();
+
+  // True if a frame with this screencast timestamp would be taken by any
+  // subscriber; the publisher skips decoding it otherwise
+  bool WantsFrame(double timestamp);
+
+  // A buffer for the JPEG passed to Publish(); recycled with the frame
+  ByteBuffer AcquireBuffer(size_t size) { return pool_->Acquire(size); }
+
+  // Hand |jpeg| to the subscribers that want it. Returns false, without
+  // calling |on_release|, if none took it.
+  bool Publish(ByteBuffer jpeg, double timestamp,
+               ScreencastFrame::ReleaseCallback on_release);
+
+  std::vector<Stats> GetStats();
+
+ private:
+  struct Subscriber {
+    int id;
+    std::string name;
+    Options options;
+    Callback callback;
+    double last_timestamp = -1.0;  // Last frame taken
+    std::deque<FrameRef> in_flight;  // Only tracked with |max_in_flight| set
+    std::deque<FrameRef> queued;
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+  };
+
+  // A callback call in progress outside the lock
+  struct Delivery {
+    int id;
+    std::thread::id thread;
+  };
+
+  // Lock held
+  Subscriber* Find(int id);
+  bool Accepts(const Subscriber& subscriber, double timestamp) const;
+  bool IsDeliveringElsewhere(int id) const;
+
+  // Call |callback| for a delivery registered under the lock, then
+  // unregister it
+  void Deliver(int id, const Callback& callback, const FrameRef& frame);
+
+  // Shared with the frames, which may outlive the bus
+  std::shared_ptr<BufferPool> pool_;
+
+  std::mutex lock_;
+  std::condition_variable delivery_done_;
+  std::vector<Subscriber> subscribers_;
+  std::vector<Delivery> deliveries_;
+  int next_id_;
+};
+
+#endif  // CEF_APP_FRAME_BUS_H_
@@ -0,0 +1,35 @@
+#ifndef CEF_APP_FRAME_CROP_H_
+#define CEF_APP_FRAME_CROP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Region of interest of native recordings, e.g. the shared screen of a
+// meeting without the call UI around it.
+
+// Part of a screencast frame to keep, in fractions of the frame size so
+// that it does not depend on the screencast scale
+struct CropRect {
+  double x = 0.0;
+  double y = 0.0;
+  double width = 1.0;
+  double height = 1.0;
+
+  bool IsFull() const { return x <= 0.0 && y <= 0.0 && width >= 1.0 && height >= 1.0; }
+
+  // Pixel bounds of the rect in a |frame_width| x |frame_height| frame,
+  // widened so the origin is on a multiple of |align_x| / |align_y|.
+  // Returns false if they would cover the whole frame or nothing.
+  bool GetBounds(int frame_width, int frame_height, int align_x, int align_y, int& left,
+                 int& top, int& width, int& height) const;
+};
+
+// Crop a baseline JPEG in the DCT domain, as jpegtran -crop: the kept
+// blocks are copied without re-quantization, so the pixels do not change,
+// and the origin moves out to the MCU grid (8 or 16 pixels). Costs a
+// Huffman decode and encode. Returns false if |rect| keeps the whole frame
+// or the JPEG is not supported; |out| is then left alone.
+bool CropJpeg(const uint8_t* jpeg, size_t size, const CropRect& rect, std::vector<uint8_t>& out);
+
+#endif  // CEF_APP_FRAME_CROP_H_
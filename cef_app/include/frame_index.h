@@ -0,0 +1,82 @@
+#ifndef CEF_APP_FRAME_INDEX_H_
+#define CEF_APP_FRAME_INDEX_H_
+
+#include "jpeg_dc_decoder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Visual search over the recordings directory.
+//
+// Frames sampled from MJPEG recordings (one every couple of seconds, minus
+// repeats of a static screen) and the keyframes of every slides directory
+// are reduced to 64-bit difference hashes. The hashes live in memory as one
+// flat array, so a query is a single pass of XOR + popcount (AVX2, NEON or
+// scalar) over all of them, and are saved to "frame_index.bin" in the
+// recordings directory.
+//
+// VP8/VP9 and MediaRecorder recordings are not indexed; there is no decoder
+// for them in the browser process.
+
+// dHash of |image|: 9x8 box-filtered brightness, one bit per horizontal
+// neighbour comparison
+uint64_t ComputeDifferenceHash(const LumaImage& image);
+
+// Hamming distance of |query| to each of |count| hashes
+void ComputeHammingDistances(const uint64_t* hashes, size_t count, uint64_t query,
+                             uint8_t* distances);
+
+struct FrameMatch {
+  std::string path;   // Recording file or slides directory
+  int64_t offset_ms;  // Position of the best matching frame
+  int distance;       // Differing hash bits, 0..64
+};
+
+class FrameIndex {
+ public:
+  explicit FrameIndex(const std::string& directory);
+
+  // Read the saved index, if any
+  bool Load();
+
+  // Hash recordings added or changed since the last update, forget deleted
+  // ones and save the index. Blocking and I/O heavy; run on a background
+  // thread. Searches may run concurrently.
+  void Update();
+
+  // Best match per recording, closest first. Matches further than
+  // |max_distance| bits are left out.
+  std::vector<FrameMatch> Search(uint64_t hash, size_t max_results, int max_distance);
+
+  size_t GetHashCount();
+
+ private:
+  struct Source {
+    std::string name;  // Relative to the directory
+    uint64_t size;
+    int64_t modified;
+    uint32_t first;  // Range in |hashes_| / |offsets_|
+    uint32_t count;
+  };
+
+  // A source hashed by Update() outside the lock
+  struct HashedSource {
+    Source source;
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> offsets;
+  };
+
+  bool Save();
+
+  std::string directory_;
+
+  std::mutex lock_;
+  std::vector<Source> sources_;
+  std::vector<uint64_t> hashes_;
+  std::vector<uint32_t> offsets_;  // Milliseconds into the source
+};
+
+#endif  // CEF_APP_FRAME_INDEX_H_
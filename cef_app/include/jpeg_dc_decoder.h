@@ -0,0 +1,75 @@
+#ifndef CEF_APP_JPEG_DC_DECODER_H_
+#define CEF_APP_JPEG_DC_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 1/8-scale decoding of baseline JPEGs.
+//
+// Every 8x8 block is reduced to its DC coefficient, i.e. the block's mean,
+// so no IDCT is done and a 1920x1080 screencast frame becomes a 240x135
+// picture. The Huffman data still has to be walked, but AC coefficients are
+// skipped without being stored. Enough for scene analysis and thumbnails;
+// not for full-size display.
+//
+// The same parser can also hand out the quantized coefficients themselves,
+// for lossless transcoding in the DCT domain.
+
+// 8-bit grayscale picture. Rows are |stride| bytes apart; the buffer is
+// zero-padded to a multiple of 16 columns and 8 rows so block kernels can
+// run over the edges.
+struct LumaImage {
+  int width = 0;
+  int height = 0;
+  int stride = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// 8-bit RGB picture, 3 bytes per pixel, rows tightly packed
+struct RgbImage {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// Decode the luma DC image of |jpeg| into |image|, reusing its buffer.
+// Returns false for progressive, arithmetic-coded or damaged files.
+bool DecodeJpegDcLuma(const uint8_t* jpeg, size_t size, LumaImage& image);
+
+// Same with the chroma DC images too, converted to RGB: a 1/8-scale,
+// box-filtered color thumbnail. Non-interleaved color files come out gray.
+bool DecodeJpegDcColor(const uint8_t* jpeg, size_t size, RgbImage& image);
+
+// Quantized DCT coefficients of a whole picture, as stored in the file.
+// Re-encoding them with the same quantization tables (EncodeJpegCoefficients)
+// gives back the same pixels.
+struct JpegCoefficients {
+  struct Plane {
+    int h = 1;  // Sampling factors
+    int v = 1;
+    int quant_table = 0;
+    int blocks_x = 0;  // Padded to whole MCUs
+    int blocks_y = 0;
+    std::vector<int16_t> blocks;  // 64 coefficients per block, zig-zag order
+
+    int16_t* block(int x, int y) {
+      return blocks.data() + (static_cast<size_t>(y) * blocks_x + x) * 64;
+    }
+    const int16_t* block(int x, int y) const {
+      return blocks.data() + (static_cast<size_t>(y) * blocks_x + x) * 64;
+    }
+  };
+
+  int width = 0;
+  int height = 0;
+  int component_count = 0;  // 1 (gray) or 3 (YCbCr)
+  Plane planes[3];
+  uint16_t quant[4][64] = {};  // Zig-zag order
+};
+
+// Decode all coefficients of |jpeg| into |image|, reusing its buffers.
+// Only interleaved 3-component and single-component files are supported.
+bool DecodeJpegCoefficients(const uint8_t* jpeg, size_t size, JpegCoefficients& image);
+
+#endif  // CEF_APP_JPEG_DC_DECODER_H_
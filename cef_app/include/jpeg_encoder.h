@@ -0,0 +1,21 @@
+#ifndef CEF_APP_JPEG_ENCODER_H_
+#define CEF_APP_JPEG_ENCODER_H_
+
+#include "jpeg_dc_decoder.h"
+
+#include <cstdint>
+#include <vector>
+
+// Baseline JPEG encoder for the small pictures generated in the browser
+// process (recording thumbnails and scrub sprites): 4:2:0, standard Annex K
+// tables, float AAN DCT. Not tuned for large frames.
+
+// Encode |image| at |quality| (1..100, as in libjpeg) into |out|
+bool EncodeJpeg(const RgbImage& image, int quality, std::vector<uint8_t>& out);
+
+// Entropy-code already quantized coefficients with their own quantization
+// tables and sampling, and the Annex K Huffman tables. No DCT is involved,
+// so the result decodes to the same pixels as the file they came from.
+bool EncodeJpegCoefficients(const JpegCoefficients& image, std::vector<uint8_t>& out);
+
+#endif  // CEF_APP_JPEG_ENCODER_H_
@@ -0,0 +1,64 @@
+#ifndef CEF_APP_MATROSKA_READER_H_
+#define CEF_APP_MATROSKA_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class TileDecoder;
+
+// Sequential reader for the frames of JPEG-based Matroska files, i.e. native
+// MJPEG and "tiles" recordings and instant replays written by MatroskaWriter.
+//
+// The file is streamed element by element and only the payloads of the
+// frames the caller asks for are read; everything else is skipped with a
+// seek, so sampling a long recording touches little of it. Tile records all
+// have to be read, but frames are only rebuilt when asked for.
+class MatroskaReader {
+ public:
+  // Receives a JPEG frame at |timestamp_ms| from the start of the file;
+  // returns the earliest timestamp of the next frame wanted, or INT64_MAX
+  // to stop reading
+  using FrameCallback =
+      std::function<int64_t(const uint8_t* jpeg, size_t size, int64_t timestamp_ms)>;
+
+  MatroskaReader();
+  ~MatroskaReader();
+
+  // Read the frames of the first V_MJPEG or tiles track of |path|. Returns
+  // false if the file is not Matroska or has no such track; a truncated
+  // file returns true after its last complete frame.
+  bool Read(const std::string& path, const FrameCallback& callback);
+
+  // Segment duration from the Info element, 0 if unknown (e.g. a recording
+  // interrupted by a crash). Valid from the first frame callback on.
+  int64_t GetDurationMs() const { return duration_ms_; }
+
+ private:
+  bool ReadVarInt(bool keep_marker, uint64_t& value, int& length);
+  bool ReadHeader(uint32_t& id, uint64_t& size, bool& unknown);
+  bool ReadPayload(uint64_t size);
+  void ParseInfo();
+  bool FindVideoTrack();
+  bool ParseBlockHeader(const uint8_t* data, size_t size, int64_t& timestamp_ms,
+                        size_t& header_size);
+  void HandleBlockInMemory(const uint8_t* data, uint64_t size, const FrameCallback& callback);
+  bool HandleSimpleBlock(uint64_t size, const FrameCallback& callback);
+  void HandleFrame(const uint8_t* data, size_t size, int64_t timestamp_ms,
+                   const FrameCallback& callback);
+
+  std::ifstream file_;
+  std::vector<uint8_t> buffer_;
+  uint64_t track_number_ = 0;
+  uint64_t timestamp_scale_ = 1000000;  // Nanoseconds per tick
+  uint64_t cluster_timestamp_ = 0;      // Ticks
+  int64_t next_timestamp_ms_ = 0;
+  int64_t duration_ms_ = 0;
+  std::unique_ptr<TileDecoder> tile_decoder_;  // For tiles tracks only
+};
+
+#endif  // CEF_APP_MATROSKA_READER_H_
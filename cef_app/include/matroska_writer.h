@@ -0,0 +1,78 @@
+#ifndef CEF_APP_MATROSKA_WRITER_H_
+#define CEF_APP_MATROSKA_WRITER_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Minimal single-track Matroska/WebM muxer.
+//
+// Frames are appended as SimpleBlocks inside clusters of bounded duration.
+// Keyframes start new clusters, and every cluster that starts with a
+// keyframe gets a cue point, so the finished file carries a seek index
+// (Cues) that only points at decodable data, a Duration and a SeekHead. The Segment is written with an unknown
+// size until Close() patches it, which keeps a file truncated by a crash
+// readable up to the last complete block.
+class MatroskaWriter {
+ public:
+  MatroskaWriter();
+  ~MatroskaWriter();
+
+  // Open |path| and write the EBML header, Info and Tracks elements.
+  // |doc_type| is "matroska" or "webm", |codec_id| e.g. "V_MJPEG" or "V_VP8".
+  bool Open(const std::string& path,
+            const std::string& doc_type,
+            const std::string& codec_id,
+            int width,
+            int height);
+
+  // Append one frame. |timestamp_ms| is relative to the start of the
+  // recording and must not decrease.
+  bool WriteFrame(const uint8_t* data,
+                  size_t size,
+                  int64_t timestamp_ms,
+                  bool keyframe);
+
+  // Write Cues, patch Duration, SeekHead and Segment size, and close the
+  // file. Returns false if any write since Open() failed.
+  bool Close();
+
+  bool IsOpen() const { return file_.is_open(); }
+  int64_t GetDurationMs() const { return last_timestamp_ms_; }
+  uint64_t GetFrameCount() const { return frame_count_; }
+  uint64_t GetBytesWritten() const { return bytes_written_; }
+
+ private:
+  struct CuePoint {
+    int64_t time_ms;
+    uint64_t cluster_position;  // Relative to the Segment data start
+  };
+
+  void StartCluster(int64_t timestamp_ms, bool keyframe);
+  void FinishCluster();
+  bool WriteBytes(const void* data, size_t size);
+  void PatchSize(uint64_t size_position, uint64_t size);
+
+  std::ofstream file_;
+  uint64_t bytes_written_;
+
+  uint64_t segment_size_position_;
+  uint64_t segment_data_start_;
+  uint64_t seek_head_position_;
+  uint64_t duration_position_;
+  uint64_t info_position_;
+  uint64_t tracks_position_;
+
+  bool cluster_open_;
+  uint64_t cluster_position_;
+  uint64_t cluster_size_position_;
+  int64_t cluster_timestamp_ms_;
+  bool cluster_keyframe_;  // The open cluster starts with a keyframe
+
+  int64_t last_timestamp_ms_;
+  uint64_t frame_count_;
+  std::vector<CuePoint> cues_;
+};
+
+#endif  // CEF_APP_MATROSKA_WRITER_H_
@@ -30,6 +30,11 @@ class RenderProcessHandler : public CefRenderProcessHandler {
                                CefRefPtr<CefFrame> frame,
                                CefRefPtr<CefV8Context> context) override;
 
+  // Called when a context is released; drops JS callbacks registered in it
+  virtual void OnContextReleased(CefRefPtr<CefBrowser> browser,
+                                 CefRefPtr<CefFrame> frame,
+                                 CefRefPtr<CefV8Context> context) override;
+
   // Called to handle process messages
   virtual bool OnProcessMessageReceived(
       CefRefPtr<CefBrowser> browser,
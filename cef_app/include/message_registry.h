@@ -0,0 +1,126 @@
+#ifndef CEF_APP_MESSAGE_REGISTRY_H_
+#define CEF_APP_MESSAGE_REGISTRY_H_
+
+#include "include/cef_values.h"
+#include "include/cef_v8.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Name-keyed dispatch tables for the browser <-> renderer bridge.
+//
+// Process messages and rebrazeAuth functions are registered in static tables
+// of {name, schema, handler}. Lookup hashes the name once (FNV-1a) into a
+// table in which every registered name has a slot of its own, then confirms
+// it with a single string compare, so dispatch costs the same however many
+// messages there are. The hash seed that makes the table collision-free is
+// searched once, when the table is built.
+//
+// A schema lists the expected argument types, one letter per argument;
+// arguments after a '|' are optional and may also be null (or undefined in
+// V8). Arguments are checked against it once, before the handler runs, so
+// handlers read them without further checks.
+//
+// Process message arguments (CefListValue):
+//   s string  i int  d double or int  b bool  B binary  D dictionary  L list
+//   * any
+// V8 function arguments:
+//   s string  i int  u uint  n number  b bool  o object  A array
+//   a ArrayBuffer  f function or null  * any
+// A process message that carries shared memory has no argument list; its
+// handler validates the shared header instead.
+
+constexpr uint32_t HashMessageName(std::string_view name, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;
+  for (char c : name) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// True if |args| matches |schema|. A null list (shared memory) matches.
+bool MatchesSchema(const char* schema, CefRefPtr<CefListValue> args);
+bool MatchesSchema(const char* schema, const CefV8ValueList& args);
+
+// True if |schema| only uses the letters above; |v8| picks the alphabet
+bool IsValidSchema(const char* schema, bool v8);
+
+// Logs and aborts; a broken table is a programming error
+void ReportBrokenMessageTable(const char* name, const char* reason);
+
+template <typename Handler>
+class MessageRegistry {
+ public:
+  struct Entry {
+    const char* name;
+    const char* schema;
+    Handler handler;
+  };
+
+  // |entries| must outlive the registry; normally a static table
+  template <size_t N>
+  MessageRegistry(const Entry (&entries)[N], bool v8) {
+    Build(entries, N, v8);
+  }
+
+  // The entry registered as |name|, or nullptr
+  const Entry* Find(std::string_view name) const {
+    const Entry* entry = slots_[HashMessageName(name, seed_) & mask_];
+    return entry && name == entry->name ? entry : nullptr;
+  }
+
+  // Every registered entry, in table order
+  const Entry* begin() const { return entries_; }
+  const Entry* end() const { return entries_ + count_; }
+
+ private:
+  void Build(const Entry* entries, size_t count, bool v8) {
+    entries_ = entries;
+    count_ = count;
+    for (size_t i = 0; i < count; i++) {
+      if (!IsValidSchema(entries[i].schema, v8)) {
+        ReportBrokenMessageTable(entries[i].name, "invalid schema");
+      }
+      for (size_t j = 0; j < i; j++) {
+        if (std::string_view(entries[i].name) == entries[j].name) {
+          ReportBrokenMessageTable(entries[i].name, "registered twice");
+        }
+      }
+    }
+
+    // Try seeds until every name has a slot of its own, doubling the table
+    // every so often
+    size_t size = 4;
+    while (size < count * 2) {
+      size <<= 1;
+    }
+    for (uint32_t seed = 0;; seed++) {
+      if (seed > 0 && seed % 64 == 0) {
+        size <<= 1;
+      }
+      slots_.assign(size, nullptr);
+      mask_ = static_cast<uint32_t>(size - 1);
+      seed_ = seed;
+      bool collision = false;
+      for (size_t i = 0; i < count && !collision; i++) {
+        const Entry*& slot = slots_[HashMessageName(entries[i].name, seed_) & mask_];
+        collision = slot != nullptr;
+        slot = &entries[i];
+      }
+      if (!collision) {
+        return;
+      }
+    }
+  }
+
+  const Entry* entries_ = nullptr;
+  size_t count_ = 0;
+  std::vector<const Entry*> slots_;
+  uint32_t seed_ = 0;
+  uint32_t mask_ = 0;
+};
+
+#endif  // CEF_APP_MESSAGE_REGISTRY_H_
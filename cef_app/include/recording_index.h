@@ -0,0 +1,90 @@
+#ifndef CEF_APP_RECORDING_INDEX_H_
+#define CEF_APP_RECORDING_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Crash-safe segment index kept next to a recording while it is written.
+//
+// A recording is one continuous .webm stream. Every few seconds the writer
+// commits the bytes appended since the previous commit as a segment: the data
+// file is synced first, then a RecordingSegmentEntry is appended to
+// "<recording>.index" and the index is synced. An entry therefore only ever
+// describes bytes that are already durable.
+//
+// A cleanly closed recording deletes its index. An index found at startup
+// belongs to a recording that was interrupted; recovery reads the entries,
+// verifies the newest segment and truncates the data file after the last
+// good segment. MediaRecorder writes WebM with an unknown segment size and
+// no cues, so the committed prefix is itself a playable file.
+
+const uint32_t kRecordingIndexMagic = 0x58494252;  // "RBIX"
+const uint32_t kRecordingIndexVersion = 1;
+
+struct RecordingIndexHeader {
+  uint32_t magic;
+  uint32_t version;
+  int64_t created_at;    // Unix time the recording was opened
+  char meeting_id[64];   // NUL-terminated
+};
+
+struct RecordingSegmentEntry {
+  uint32_t segment;      // 0-based, increases by one per entry
+  uint32_t crc32;        // Of the segment bytes in the data file
+  int64_t start_ms;      // Time range relative to the start of the recording
+  int64_t end_ms;
+  uint64_t offset;       // Byte range in the data file
+  uint64_t size;
+  uint32_t entry_crc32;  // Of all the fields above; detects torn appends
+  uint32_t reserved;
+};
+
+// Returns <recording_path>.index
+std::string GetRecordingIndexPath(const std::string& recording_path);
+
+// Standard CRC-32 (IEEE 802.3). Pass 0 to start a new checksum.
+uint32_t UpdateCrc32(uint32_t crc, const void* data, size_t size);
+
+// Append-only writer for one index file. Not thread safe; the recording
+// writer drives it from its own thread.
+class RecordingIndex {
+ public:
+  RecordingIndex();
+  ~RecordingIndex();
+
+  // Create (truncate) the index for |recording_path| and sync its header
+  bool Create(const std::string& recording_path, const std::string& meeting_id);
+
+  // Append |entry| (entry_crc32 is filled in) and sync the index
+  bool Append(RecordingSegmentEntry entry);
+
+  // Close the index. With |remove| the file is deleted, which marks the
+  // recording as complete.
+  void Close(bool remove);
+
+  bool IsOpen() const { return fd_ >= 0; }
+
+ private:
+  int fd_;
+  std::string path_;
+};
+
+struct RecoveredRecording {
+  std::string meeting_id;
+  std::string path;
+  uint32_t segments;
+  uint64_t size;
+  int64_t duration_ms;
+};
+
+// Recover every interrupted recording in |directory| whose index was created
+// before |created_before|. The work per recording is one pass over its index
+// plus a checksum of the newest segment, independent of the recording length.
+// Recordings without a single committed segment are deleted.
+std::vector<RecoveredRecording> RecoverRecordings(const std::string& directory,
+                                                  std::time_t created_before);
+
+#endif  // CEF_APP_RECORDING_INDEX_H_
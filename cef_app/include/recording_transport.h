@@ -0,0 +1,30 @@
+#ifndef CEF_APP_RECORDING_TRANSPORT_H_
+#define CEF_APP_RECORDING_TRANSPORT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Wire format for streaming recording sessions.
+//
+// The UI opens a session ("open_recording_session", meeting id at index 0),
+// appends each MediaRecorder chunk as it is produced and finally closes it
+// ("finalize_recording_session", number of chunks sent at index 0).
+//
+// Each "append_recording_chunk" message carries one chunk. Large chunks
+// travel in shared memory (CefSharedProcessMessageBuilder): the region starts
+// with a RecordingChunkHeader followed by the raw bytes. Small chunks use a
+// regular message with the bytes as a CefBinaryValue at index 0 and the
+// sequence number as an int at index 1. No base64 is involved.
+
+// Chunks at or above this size are sent through shared memory
+const size_t kRecordingSharedMemoryThreshold = 64 * 1024;
+
+const uint32_t kRecordingChunkMagic = 0x52435243;  // "RCRC"
+
+struct RecordingChunkHeader {
+  uint32_t magic;
+  uint32_t sequence;  // 0-based, increases by one per chunk in a session
+  uint64_t size;      // Payload bytes following the header
+};
+
+#endif  // CEF_APP_RECORDING_TRANSPORT_H_
@@ -0,0 +1,108 @@
+#ifndef CEF_APP_RECORDING_WRITER_H_
+#define CEF_APP_RECORDING_WRITER_H_
+
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Asynchronous append-only file writer for recordings.
+//
+// The owning thread (the CEF UI thread) only pushes operation pointers into a
+// lock-free SPSC queue. A dedicated writer thread drains the queue and writes
+// with io_uring on Linux, falling back to pwrite() when io_uring is not
+// available. Disk stalls therefore never block window management or IPC.
+//
+// Bytes are made durable in segments (see recording_index.h): CommitSegment()
+// syncs everything written so far and records it in the sidecar index, so an
+// interrupted recording can be recovered up to its last commit.
+class RecordingWriter {
+ public:
+  // Bytes to be written. Implementations keep the underlying storage (for
+  // example a shared memory region) alive until the writer destroys them.
+  class Buffer {
+   public:
+    virtual ~Buffer() {}
+    virtual const void* data() const = 0;
+    virtual size_t size() const = 0;
+  };
+
+  // Called on the writer thread after the file has been closed
+  using CloseCallback =
+      std::function<void(const std::string& path, bool success)>;
+
+  struct Stats {
+    size_t queue_depth;         // Operations queued or in flight
+    uint64_t bytes_written;
+    uint64_t writes_completed;
+    uint64_t last_latency_us;   // Enqueue to completion, most recent write
+    uint64_t max_latency_us;
+    uint64_t total_latency_us;  // Sum over writes_completed
+    bool using_io_uring;
+  };
+
+  RecordingWriter();
+  ~RecordingWriter();
+
+  // The following must all be called from the same (producer) thread.
+
+  // Open (truncate) |path| and create its segment index. Subsequent writes
+  // are appended to it.
+  void Open(const std::string& path, const std::string& meeting_id);
+
+  // Append |buffer| to the open file. Ownership passes to the writer.
+  void Write(std::unique_ptr<Buffer> buffer);
+
+  // Sync the bytes appended since the previous commit and record them as a
+  // segment covering [start_ms, end_ms] of the recording.
+  void CommitSegment(int64_t start_ms, int64_t end_ms);
+
+  // Flush pending writes, fsync and close the file, then run |callback|.
+  // A successful close removes the segment index.
+  void Close(CloseCallback callback);
+
+  bool IsOpen() const { return is_open_; }
+  const std::string& GetPath() const { return path_; }
+
+  // Safe from any thread
+  Stats GetStats() const;
+
+ private:
+  struct Operation;
+  class Backend;
+  class PwriteBackend;
+  class IoUringBackend;
+
+  void Enqueue(Operation* op);
+  void WriterThread();
+
+  // Producer-side state
+  bool is_open_;
+  std::string path_;
+
+  SpscQueue<Operation*> queue_;
+
+  // Used only to park the writer thread while the queue is empty
+  std::mutex wake_lock_;
+  std::condition_variable wake_cv_;
+  std::atomic<bool> writer_waiting_;
+  std::atomic<bool> shutdown_;
+
+  std::thread writer_thread_;
+
+  std::atomic<size_t> in_flight_;
+  std::atomic<uint64_t> bytes_written_;
+  std::atomic<uint64_t> writes_completed_;
+  std::atomic<uint64_t> last_latency_us_;
+  std::atomic<uint64_t> max_latency_us_;
+  std::atomic<uint64_t> total_latency_us_;
+  std::atomic<bool> using_io_uring_;
+};
+
+#endif  // CEF_APP_RECORDING_WRITER_H_
@@ -0,0 +1,77 @@
+#ifndef CEF_APP_REPLAY_BUFFER_H_
+#define CEF_APP_REPLAY_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Fixed-memory ring of the most recent screencast JPEGs ("instant replay").
+//
+// All memory is allocated up front: one byte arena for the frame data and a
+// fixed table of frame entries. A frame is decoded straight into the arena
+// with BeginFrame()/CommitFrame(), overwriting the oldest frames, so inserts
+// never allocate or copy. Frames also expire once they are older than the
+// configured duration.
+//
+// The producer (the CEF UI thread) and Save() may run concurrently; Save()
+// copies one frame at a time under the lock and skips frames that were
+// overwritten before it got to them.
+class ReplayBuffer {
+ public:
+  struct Stats {
+    uint64_t frames;
+    uint64_t bytes;
+    int64_t duration_ms;
+  };
+
+  // |budget_bytes| bounds the arena and the frame table together
+  ReplayBuffer(size_t budget_bytes, int64_t max_duration_ms);
+
+  // Space for a frame of up to |max_size| bytes, valid until CommitFrame()
+  // or the next BeginFrame(). Returns nullptr for frames larger than a
+  // quarter of the arena. Producer thread only.
+  uint8_t* BeginFrame(size_t max_size);
+
+  // Publish the frame written at the last BeginFrame() pointer.
+  // |timestamp| is the screencast timestamp in seconds.
+  void CommitFrame(size_t size, double timestamp);
+
+  // Drop all frames
+  void Clear();
+
+  // Write the buffered frames to an MJPEG Matroska file. Blocking; call
+  // from a background thread.
+  bool Save(const std::string& path, Stats* stats);
+
+  size_t GetBudget() const { return budget_; }
+  int64_t GetMaxDurationMs() const { return max_duration_ms_; }
+  Stats GetStats();
+
+ private:
+  struct Entry {
+    uint64_t offset;  // Position in the arena stream; wraps at capacity_
+    size_t size;
+    int64_t timestamp_ms;
+  };
+
+  Entry& EntryAt(uint64_t sequence) { return entries_[sequence % entries_.size()]; }
+  void EvictBefore(uint64_t offset);
+
+  const size_t budget_;
+  const size_t capacity_;  // Arena bytes; the rest of the budget is entries_
+  const int64_t max_duration_ms_;
+  std::unique_ptr<uint8_t[]> arena_;
+
+  std::mutex lock_;
+  std::vector<Entry> entries_;
+  uint64_t first_sequence_;  // Oldest live frame
+  uint64_t next_sequence_;   // One past the newest frame
+  uint64_t write_offset_;    // End of the newest frame
+  uint64_t reserved_offset_; // Start of the frame being written
+  uint64_t bytes_;           // Data held by live frames
+};
+
+#endif  // CEF_APP_REPLAY_BUFFER_H_
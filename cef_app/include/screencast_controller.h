@@ -0,0 +1,76 @@
+#ifndef CEF_APP_SCREENCAST_CONTROLLER_H_
+#define CEF_APP_SCREENCAST_CONTROLLER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Adapts Page.startScreencast parameters to how fast frames are consumed.
+//
+// Frames are acknowledged (Page.screencastFrameAck) right away only while
+// few frames are waiting on the consumer; beyond that the ack is deferred
+// until the consumer has finished a frame. Chromium stops capturing while
+// acks are outstanding, so a slow consumer throttles the capture instead of
+// frames being dropped further down the pipeline.
+//
+// Once a second Update() looks at the backlog, the share of frames the
+// consumer dropped, the receive-to-consumed latency and the process CPU
+// load, and moves along a ladder of quality, resolution cap and
+// everyNthFrame settings, with hysteresis.
+//
+// All methods must be called on the same thread (the CEF UI thread).
+class ScreencastController {
+ public:
+  struct Settings {
+    int quality;  // JPEG quality, 0-100
+    int max_width;  // 0 for no cap
+    int max_height;
+    int every_nth_frame;
+  };
+
+  ScreencastController();
+
+  // Forget all frames and return to the highest quality level
+  void Reset();
+
+  const Settings& GetSettings() const;
+  size_t GetLevel() const { return level_; }
+
+  // A frame with DevTools session id |session_id| was handed to the
+  // consumer. Returns true if it should be acknowledged now; otherwise the
+  // ack is held back until a frame is consumed.
+  bool OnFrameReceived(int session_id);
+
+  // The consumer finished with an outstanding frame, or discarded it
+  // (|dropped|) in favour of a newer one. Returns a deferred session id to
+  // acknowledge now, or -1.
+  int OnFrameConsumed(bool dropped);
+
+  // Re-evaluate the settings. Returns true if GetSettings() changed and the
+  // screencast should be restarted with them. Acks that have been held for
+  // too long (the consumer went away) are appended to |stalled_acks|.
+  bool Update(std::vector<int>& stalled_acks);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  std::deque<Clock::time_point> in_flight_;  // Receive time per frame
+  std::deque<int> deferred_acks_;
+  Clock::time_point last_consumed_;
+
+  // Statistics for the current Update() window
+  Clock::time_point window_start_;
+  double window_cpu_seconds_;
+  size_t window_frames_;
+  size_t window_deferred_;
+  size_t window_dropped_;
+  double window_latency_ms_;
+  size_t window_consumed_;
+
+  size_t level_;
+  int pressured_windows_;
+  int calm_windows_;
+};
+
+#endif  // CEF_APP_SCREENCAST_CONTROLLER_H_
@@ -0,0 +1,24 @@
+#ifndef CEF_APP_SCREENCAST_FRAME_PARSER_H_
+#define CEF_APP_SCREENCAST_FRAME_PARSER_H_
+
+#include <cstddef>
+
+// Fields of a Page.screencastFrame event, pointing into the original params
+// buffer. Valid only as long as that buffer is.
+struct ScreencastFrameView {
+  const char* data;  // Base64 JPEG, without quotes
+  size_t data_size;
+  int session_id;
+  bool has_session_id;
+  double timestamp;  // metadata.timestamp, seconds
+  bool has_timestamp;
+};
+
+// Scan Page.screencastFrame |params| JSON for "data", "sessionId" and
+// "metadata.timestamp" without building a DOM or copying the payload.
+// Returns false if the JSON is malformed or "data" contains escapes; callers
+// can fall back to CefParseJSON in that case.
+bool ParseScreencastFrame(const void* params, size_t size,
+                          ScreencastFrameView& frame);
+
+#endif  // CEF_APP_SCREENCAST_FRAME_PARSER_H_
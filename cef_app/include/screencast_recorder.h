@@ -0,0 +1,126 @@
+#ifndef CEF_APP_SCREENCAST_RECORDER_H_
+#define CEF_APP_SCREENCAST_RECORDER_H_
+
+#include "buffer_pool.h"
+#include "frame_bus.h"
+#include "frame_crop.h"
+#include "video_encoder.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Browser-process recorder for DevTools screencast frames.
+//
+// JPEG frames come from the frame bus and are muxed into a Matroska file on
+// a dedicated writer thread, keeping the per-frame timestamps reported by
+// the screencast. The queue holds references to the shared frames, which
+// are released once written or dropped. Nothing is sent to the UI renderer,
+// so the canvas + MediaRecorder round trip is skipped entirely.
+//
+// By default the JPEGs are stored as MJPEG. With a VP8/VP9 config (libvpx
+// builds only) a small worker pool decodes frames to I420 in parallel and
+// the writer thread feeds them in order to a multithreaded libvpx encoder.
+// The "tiles" codec keeps only the 64x64 tiles that changed since the
+// previous frame (TileEncoder); MatroskaReader turns them back into JPEGs.
+// With a crop rect set, only that region of interest is stored.
+//
+// An off-screen content browser hands over raw BGRA paints instead
+// (AddRawFrame). VP8/VP9 convert them straight to I420; MJPEG and tiles
+// compress them to JPEG once, in the same worker pool.
+class ScreencastRecorder {
+ public:
+  // Called on the writer thread once the file has been finalized
+  using FinishedCallback =
+      std::function<void(const std::string& path, bool success)>;
+
+  // Called once per queued raw frame after it has been written or dropped,
+  // usually on the writer thread. Used for off-screen backpressure;
+  // screencast frames report through their release instead.
+  using FrameConsumedCallback = std::function<void(bool dropped)>;
+
+  ScreencastRecorder();
+  ~ScreencastRecorder();
+
+  // Must be set while not recording
+  void SetFrameConsumedCallback(FrameConsumedCallback callback) {
+    frame_consumed_callback_ = callback;
+  }
+
+  // Start writing to |path|. Fails if a recording is already in progress.
+  // A codec that is not available in this build falls back to MJPEG.
+  bool Start(const std::string& path,
+             const VideoEncoderConfig& config = VideoEncoderConfig());
+
+  // Queue a screencast frame. May be called from any thread.
+  void AddFrame(const FrameRef& jpeg);
+
+  // Queue a BGRA picture with |stride| bytes per row. The pixels are copied,
+  // so the buffer may be reused once this returns. May be called from any
+  // thread.
+  void AddRawFrame(const void* bgra, int width, int height, int stride, double timestamp);
+
+  // Keep only |rect| of the frames queued from now on; a full rect turns
+  // cropping off. Reset by Start(). May be called from any thread.
+  void SetCrop(const CropRect& rect);
+
+  // Drain queued frames, finalize the file and invoke |callback|.
+  void Stop(FinishedCallback callback);
+
+  bool IsRecording() const { return recording_; }
+  const std::string& GetPath() const { return path_; }
+  VideoCodec GetCodec() const { return config_.codec; }
+
+  // Counters
+  size_t GetQueueDepth();
+  uint64_t GetFramesWritten() const { return frames_written_; }
+  uint64_t GetFramesDropped() const { return frames_dropped_; }
+
+ private:
+  struct Frame {
+    FrameRef jpeg;              // Screencast frames
+    ByteBuffer data;            // Raw frames: BGRA pixels
+    double timestamp;
+    CropRect crop;
+    int width = 0;  // Raw frames only, tightly packed rows
+    int height = 0;
+  };
+
+  // A frame on its way through the decode pool
+  struct EncodeJob;
+
+  void QueueFrame(Frame frame);
+  void WriterThread();
+
+  std::string path_;
+  VideoEncoderConfig config_;
+  std::atomic<bool> recording_;
+
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::deque<Frame> queue_;
+  CropRect crop_;
+  bool stop_requested_;
+  FinishedCallback finished_callback_;
+  FrameConsumedCallback frame_consumed_callback_;
+
+  std::thread writer_thread_;
+
+  BufferPool frame_pool_;
+  BufferPool image_pool_;
+
+  // Signals decode completion to the writer thread
+  std::mutex decode_lock_;
+  std::condition_variable decode_cv_;
+
+  std::atomic<uint64_t> frames_written_;
+  std::atomic<uint64_t> frames_dropped_;
+};
+
+#endif  // CEF_APP_SCREENCAST_RECORDER_H_
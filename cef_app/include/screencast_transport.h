@@ -0,0 +1,27 @@
+#ifndef CEF_APP_SCREENCAST_TRANSPORT_H_
+#define CEF_APP_SCREENCAST_TRANSPORT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Wire format for "screencast_frame" process messages (browser -> UI).
+//
+// Frames carry the decoded JPEG bytes. Large frames travel in shared memory
+// (CefSharedProcessMessageBuilder): the region starts with a
+// ScreencastFrameHeader followed by the JPEG. Small frames use a regular
+// message with the JPEG as a CefBinaryValue at index 0 and the timestamp as
+// a double at index 1.
+
+// Frames at or above this size are sent through shared memory
+const size_t kScreencastSharedMemoryThreshold = 64 * 1024;
+
+const uint32_t kScreencastFrameMagic = 0x53434652;  // "SCFR"
+
+struct ScreencastFrameHeader {
+  uint32_t magic;
+  uint32_t reserved;
+  double timestamp;  // Screencast metadata timestamp, seconds
+  uint64_t size;     // JPEG bytes following the header
+};
+
+#endif  // CEF_APP_SCREENCAST_TRANSPORT_H_
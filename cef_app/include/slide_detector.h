@@ -0,0 +1,92 @@
+#ifndef CEF_APP_SLIDE_DETECTOR_H_
+#define CEF_APP_SLIDE_DETECTOR_H_
+
+#include "frame_bus.h"
+#include "jpeg_dc_decoder.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Picks the distinct "slides" out of a meeting's screencast.
+//
+// Frames are analyzed on one background thread at a reduced rate, which the
+// frame bus subscription enforces (Options::interval_ms). Each is decoded
+// to its 1/8-scale luma image (ScreencastFrame::GetDcLuma) and split into
+// tiles of 8x8 blocks, i.e. 64x64 screen pixels, whose differences are
+// summed with SSE2/NEON. Tiles that changed during the last few analyzed
+// frames are treated as in motion (webcams, cursor, transitions) and
+// ignored; once enough of the settled tiles differ from the last keyframe
+// the frame becomes a new keyframe.
+//
+// Keyframes are saved as the original JPEGs in a per-meeting directory,
+// together with a "slides.jsonl" sidecar holding one line per keyframe.
+class SlideDetector {
+ public:
+  struct Options {
+    // Share of all tiles that must have settled on new content
+    double change_threshold = 0.10;
+    // Mean absolute luma difference at which a tile counts as changed
+    int tile_threshold = 6;
+    // Analyze at most this often; slides do not change faster
+    int interval_ms = 200;
+  };
+
+  SlideDetector();
+  ~SlideDetector();
+
+  // Start writing keyframes into |directory|, which is created
+  bool Start(const std::string& directory, const Options& options);
+
+  // Analyze the frames still queued, then close the sidecar
+  void Stop();
+
+  bool IsRunning() const { return running_; }
+  const std::string& GetDirectory() const { return directory_; }
+
+  // Hand over a frame. Replaces a frame still waiting for the analyzer, so
+  // a slow machine analyzes fewer frames instead of falling behind.
+  void AddFrame(const FrameRef& frame);
+
+  uint64_t GetKeyframeCount() const { return keyframe_count_; }
+
+ private:
+  void AnalyzerThread();
+
+  // Compare |current_| with the previous frame and the last keyframe;
+  // returns the share of tiles that settled on new content, or -1 if the
+  // picture size changed
+  double Analyze();
+  void SaveKeyframe(const std::vector<uint8_t>& jpeg, double timestamp, double score);
+
+  std::string directory_;
+  Options options_;
+  bool running_;
+
+  std::mutex lock_;
+  std::condition_variable cv_;
+  FrameRef pending_frame_;
+  bool stop_requested_;
+
+  std::thread analyzer_thread_;
+
+  // Analyzer thread state
+  LumaImage current_;
+  LumaImage previous_;
+  LumaImage keyframe_;
+  std::vector<uint32_t> motion_sad_;    // Per tile, vs. previous frame
+  std::vector<uint32_t> keyframe_sad_;  // Per tile, vs. last keyframe
+  std::vector<uint8_t> quiet_frames_;   // Per tile, analyzed frames without motion
+  bool has_keyframe_;
+  bool settled_;  // No tile moved during the last few analyzed frames
+  double first_timestamp_;
+  std::atomic<uint64_t> keyframe_count_;
+  std::ofstream sidecar_;
+};
+
+#endif  // CEF_APP_SLIDE_DETECTOR_H_
@@ -0,0 +1,59 @@
+#ifndef CEF_APP_THUMBNAIL_SERVICE_H_
+#define CEF_APP_THUMBNAIL_SERVICE_H_
+
+#include "worker_pool.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Preview images for the recordings viewer, generated in the background.
+//
+// For "<name>.mkv" three files are written next to the recording:
+//   <name>.poster.jpg  - one frame a few seconds in
+//   <name>.sprite.jpg  - up to 100 evenly spaced frames tiled in a grid
+//   <name>.sprite.vtt  - WebVTT cues mapping time ranges to sprite tiles
+//                        ("<name>.sprite.jpg#xywh=x,y,w,h")
+// The VTT is written last and records the size and modification time of the
+// recording it was made from; previews are regenerated when those change.
+//
+// Frames come from the 1/8-scale DC decode of the MJPEG frames, so a long
+// recording costs a seek per tile plus a Huffman walk, no full decode. The
+// work runs on a small pool of background-priority threads.
+class ThumbnailService {
+ public:
+  struct Previews {
+    std::string poster_path;
+    std::string sprite_path;
+    std::string index_path;
+    int tile_count = 0;  // 0 if the recording has no decodable frames
+  };
+
+  // Called on a worker thread
+  using Callback =
+      std::function<void(const std::string& recording_path, const Previews& previews)>;
+
+  explicit ThumbnailService(size_t threads);
+
+  // Abandons queued recordings without running their callbacks
+  ~ThumbnailService();
+
+  // Make or look up the previews of |recording_path|. Requests for a
+  // recording that is already queued share its result.
+  void Generate(const std::string& recording_path, Callback callback);
+
+ private:
+  void Run(const std::string& recording_path);
+
+  std::atomic<bool> shutting_down_;
+  std::mutex lock_;
+  std::map<std::string, std::vector<Callback>> pending_;
+
+  // Last, so the workers stop before the members above are destroyed
+  WorkerPool pool_;
+};
+
+#endif  // CEF_APP_THUMBNAIL_SERVICE_H_
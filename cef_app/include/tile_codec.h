@@ -0,0 +1,85 @@
+#ifndef CEF_APP_TILE_CODEC_H_
+#define CEF_APP_TILE_CODEC_H_
+
+#include "jpeg_dc_decoder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Damage-tile compression of screencast frames ("tiles" recordings).
+//
+// Meeting pages are mostly static, yet every screencast frame is a full
+// JPEG. Frames are compared with the previous one in 64x64 tiles and only
+// the tiles that changed are stored. The comparison and the storage are done
+// on the quantized DCT coefficients, so nothing is re-compressed: a replayed
+// frame decodes to exactly the pixels of the captured one.
+//
+// A stream is a sequence of records:
+//   keyframe - the screencast JPEG as is; every 10 s, after a size or
+//              quality change, and when most of the picture changed
+//   delta    - "RBT1", a big-endian 16-bit tile count and as many tile
+//              indices (row-major over the frame), then a JPEG "atlas" with
+//              those tiles side by side, up to 32 per row. A frame without
+//              changes is the 6-byte header alone.
+// Deltas rely on every record since the last keyframe.
+
+// Matroska CodecID of tile streams
+extern const char kTileCodecId[];
+
+// Records frames as keyframes and deltas. Not thread safe.
+class TileEncoder {
+ public:
+  // Turn |jpeg| into the next record. Returns true if the frame is a
+  // keyframe, to be stored as |jpeg| itself; otherwise |delta| gets the
+  // record to store.
+  bool Encode(const uint8_t* jpeg, size_t size, int64_t timestamp_ms,
+              std::vector<uint8_t>& delta);
+
+  // Counters
+  uint64_t GetKeyframes() const { return keyframes_; }
+  uint64_t GetDeltas() const { return deltas_; }
+  uint64_t GetChangedTiles() const { return changed_tiles_; }
+
+ private:
+  bool EncodeDelta(std::vector<uint8_t>& delta);
+
+  JpegCoefficients previous_;
+  JpegCoefficients current_;
+  JpegCoefficients atlas_;
+  std::vector<uint16_t> changed_;
+  bool has_reference_ = false;
+  int64_t keyframe_timestamp_ms_ = 0;
+
+  uint64_t keyframes_ = 0;
+  uint64_t deltas_ = 0;
+  uint64_t changed_tiles_ = 0;
+};
+
+// Rebuilds full frames from records. Not thread safe.
+class TileDecoder {
+ public:
+  // True if |record| is a keyframe
+  static bool IsKeyframe(const uint8_t* record, size_t size);
+
+  // Apply the next record. Fails for damaged records and for deltas
+  // without an intact keyframe and deltas before them.
+  bool Apply(const uint8_t* record, size_t size);
+
+  // The current frame as a JPEG, valid until the next Apply(). The JPEG is
+  // only re-encoded when asked for, so skipped frames cost a delta decode.
+  bool GetFrame(const uint8_t*& jpeg, size_t& size);
+
+ private:
+  bool ApplyDelta(const uint8_t* record, size_t size);
+
+  std::vector<uint8_t> keyframe_;
+  std::vector<uint8_t> frame_;  // |image_| encoded, or empty
+  JpegCoefficients image_;
+  JpegCoefficients atlas_;
+  bool has_keyframe_ = false;
+  bool decoded_ = false;   // |image_| holds |keyframe_|
+  bool modified_ = false;  // Tiles have been applied since
+};
+
+#endif  // CEF_APP_TILE_CODEC_H_
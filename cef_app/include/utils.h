@@ -6,4 +6,17 @@
 std::string GetExecutableDirectory();
 std::string GetDocumentsDirectory();
 
+// Returns <Documents>/Rebraze/Recordings, creating it if needed
+std::string GetRecordingsDirectory();
+
+// Create |path| (not its parents). Succeeds if it already exists.
+bool MakeDirectory(const std::string& path);
+
+// Returns a new recording path: <recordings dir>/meeting_<id>_<timestamp>.<ext>
+std::string MakeRecordingPath(const std::string& meeting_id,
+                              const std::string& extension);
+
+// CPU time (user + system) consumed by this process so far, in seconds
+double GetProcessCpuSeconds();
+
 #endif  // CEF_APP_UTILS_H_
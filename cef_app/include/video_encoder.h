@@ -0,0 +1,128 @@
+#ifndef CEF_APP_VIDEO_ENCODER_H_
+#define CEF_APP_VIDEO_ENCODER_H_
+
+#include "buffer_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// VP8/VP9 encoding of screencast frames for native recordings.
+//
+// libvpx and libturbojpeg are optional; they are only used when the app is
+// configured with -DREBRAZE_ENABLE_VPX=ON. Without them IsAvailable() is
+// false for VP8/VP9 and recordings stay MJPEG.
+
+enum VideoCodec {
+  VIDEO_CODEC_MJPEG,  // Screencast JPEGs stored as is, no encoder involved
+  VIDEO_CODEC_VP8,
+  VIDEO_CODEC_VP9,
+  VIDEO_CODEC_TILES,  // Changed 64x64 tiles of the JPEGs only, see tile_codec.h
+};
+
+// Speed/quality trade-off; maps to libvpx cpu-used and deadline
+enum VideoEncoderPreset {
+  VIDEO_PRESET_REALTIME,  // Lowest CPU, for several recordings at once
+  VIDEO_PRESET_BALANCED,
+  VIDEO_PRESET_QUALITY,
+};
+
+struct VideoEncoderConfig {
+  VideoCodec codec = VIDEO_CODEC_MJPEG;
+  VideoEncoderPreset preset = VIDEO_PRESET_BALANCED;
+  int bitrate_kbps = 2000;
+  // Encoder threads (libvpx row/tile multithreading); 0 picks a share of
+  // the cores so that one meeting cannot take over the machine
+  int threads = 0;
+};
+
+// Parse "mjpeg" / "vp8" / "vp9" / "tiles" and "realtime" / "balanced" / "quality".
+// Unknown names leave |config| unchanged and return false.
+bool ParseVideoCodec(const std::string& name, VideoCodec& codec);
+bool ParseVideoEncoderPreset(const std::string& name, VideoEncoderPreset& preset);
+
+const char* GetVideoCodecName(VideoCodec codec);
+
+// Matroska CodecID, e.g. "V_VP8"
+const char* GetVideoCodecId(VideoCodec codec);
+
+// True for the codecs that go through VideoEncoder
+bool IsVideoCodecEncoded(VideoCodec codec);
+
+// Encoder and decoder threads used for |config|
+int GetVideoEncoderThreads(const VideoEncoderConfig& config);
+
+// Planar 4:2:0 picture. Chroma planes are half the (even-rounded) size.
+struct I420Image {
+  int width = 0;
+  int height = 0;
+  int strides[3] = {0, 0, 0};
+  size_t offsets[3] = {0, 0, 0};
+  ByteBuffer data;
+
+  // Lay out the planes for |width| x |height| in |buffer|
+  void Allocate(int width, int height, ByteBuffer buffer);
+  static size_t GetBufferSize(int width, int height);
+
+  // Narrow the picture to a rectangle of itself without copying; the
+  // origin must be even
+  void Crop(int left, int top, int crop_width, int crop_height);
+
+  uint8_t* plane(int index) { return data.data() + offsets[index]; }
+  const uint8_t* plane(int index) const { return data.data() + offsets[index]; }
+};
+
+// Read the pixel size of a JPEG without decoding it
+bool GetJpegDimensions(const uint8_t* jpeg, size_t size, int& width, int& height);
+
+// Decode a screencast JPEG into |image|, which must already be allocated for
+// the JPEG's size. Thread safe; each thread keeps its own decoder.
+bool DecodeJpegToI420(const uint8_t* jpeg, size_t size, I420Image& image);
+
+// Convert BGRA pixels (off-screen rendering), |stride| bytes per row, into
+// |image|, which must already be allocated for the picture's size. Thread
+// safe; needs the same optional libraries as VP8/VP9.
+bool ConvertBgraToI420(const uint8_t* bgra, int stride, I420Image& image);
+
+// Compress BGRA pixels to a 4:2:0 JPEG at |quality| (1..100). Uses
+// TurboJPEG when available and the built-in encoder otherwise. Thread safe.
+bool EncodeBgraToJpeg(const uint8_t* bgra, int width, int height, int stride,
+                      int quality, ByteBuffer& out);
+
+class VideoEncoder {
+ public:
+  // One compressed frame. Called on the thread that calls Encode()/Flush().
+  using PacketCallback = std::function<void(const uint8_t* data,
+                                            size_t size,
+                                            int64_t timestamp_ms,
+                                            bool keyframe)>;
+
+  static bool IsAvailable(VideoCodec codec);
+
+  VideoEncoder();
+  ~VideoEncoder();
+
+  bool Open(const VideoEncoderConfig& config, int width, int height);
+
+  // Encode |image|; |timestamp_ms| must increase. A picture size different
+  // from the current one reconfigures the encoder, or opens it again if it
+  // cannot take the new size, and starts a keyframe.
+  bool Encode(const I420Image& image, int64_t timestamp_ms,
+              const PacketCallback& callback);
+
+  // Emit any frames still held by the encoder
+  bool Flush(const PacketCallback& callback);
+
+  void Close();
+
+  bool IsOpen() const { return state_ != nullptr; }
+
+ private:
+  struct State;
+  std::unique_ptr<State> state_;
+};
+
+#endif  // CEF_APP_VIDEO_ENCODER_H_
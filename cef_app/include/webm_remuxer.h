@@ -0,0 +1,31 @@
+#ifndef CEF_APP_WEBM_REMUXER_H_
+#define CEF_APP_WEBM_REMUXER_H_
+
+#include <cstdint>
+#include <string>
+
+// Makes a MediaRecorder WebM file seekable without re-encoding.
+//
+// MediaRecorder writes a live stream: the Segment and Clusters have unknown
+// sizes and there is no Duration, SeekHead or Cues, so a player has to scan
+// the whole file before it can seek. The remuxer streams the file once,
+// copying every block unchanged, into a new file with sized Clusters, a
+// Duration, a cue point per cluster that holds a keyframe and a SeekHead.
+// The original is replaced only after the new file is complete and synced.
+//
+// Input cut off in the middle of an element (a recovered recording, say) is
+// remuxed up to its last complete block.
+
+struct WebmRemuxStats {
+  uint64_t clusters;
+  uint64_t cue_points;
+  int64_t duration_ms;
+  uint64_t input_bytes;
+  uint64_t output_bytes;
+};
+
+// Blocking; call from a background thread. Returns false and leaves |path|
+// untouched if it is not a WebM/Matroska file this remuxer understands.
+bool RemuxWebmForSeeking(const std::string& path, WebmRemuxStats* stats);
+
+#endif  // CEF_APP_WEBM_REMUXER_H_
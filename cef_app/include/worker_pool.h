@@ -0,0 +1,48 @@
+#ifndef CEF_APP_WORKER_POOL_H_
+#define CEF_APP_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads running posted tasks in FIFO order.
+//
+// Used for CPU-heavy media work (frame decoding, encoding) that must stay off
+// the CEF UI thread and whose parallelism has to be bounded per recording.
+class WorkerPool {
+ public:
+  enum class Priority {
+    kNormal,
+    // Lowest OS scheduling (and, where supported, I/O) priority; for work
+    // nobody is waiting on, such as preview generation
+    kBackground,
+  };
+
+  // |name| is only used for logging
+  WorkerPool(size_t threads, const std::string& name, Priority priority = Priority::kNormal);
+
+  // Runs the tasks still queued, then joins the workers
+  ~WorkerPool();
+
+  void Post(std::function<void()> task);
+
+  size_t GetThreadCount() const { return threads_.size(); }
+
+ private:
+  void WorkerThread();
+
+  std::string name_;
+  Priority priority_;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  bool shutdown_;
+  std::vector<std::thread> threads_;
+};
+
+#endif  // CEF_APP_WORKER_POOL_H_
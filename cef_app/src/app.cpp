@@ -1,4 +1,5 @@
 #include "app.h"
+#include "base64.h"
 #include "client_handler.h"
 #include "message_handler.h"
 #include "oauth_server.h"
@@ -70,51 +71,6 @@ std::string ReadFileToString(const std::string& path) {
   return buffer.str();
 }
 
-// Helper function to encode to Base64
-static const char base64_chars[] =
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-std::string Base64Encode(const std::string& input) {
-  std::string ret;
-  int i = 0;
-  int j = 0;
-  unsigned char char_array_3[3];
-  unsigned char char_array_4[4];
-  size_t in_len = input.size();
-  const char* bytes_to_encode = input.c_str();
-
-  while (in_len--) {
-    char_array_3[i++] = *(bytes_to_encode++);
-    if (i == 3) {
-      char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-      char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-      char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-      char_array_4[3] = char_array_3[2] & 0x3f;
-
-      for (i = 0; i < 4; i++)
-        ret += base64_chars[char_array_4[i]];
-      i = 0;
-    }
-  }
-
-  if (i) {
-    for (j = i; j < 3; j++)
-      char_array_3[j] = '\0';
-
-    char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-    char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-    char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-
-    for (j = 0; j < i + 1; j++)
-      ret += base64_chars[char_array_4[j]];
-
-    while (i++ < 3)
-      ret += '=';
-  }
-
-  return ret;
-}
-
 namespace {
 
 // When using the Views framework this object provides the delegate
@@ -189,40 +145,13 @@ void App::OnContextInitialized() {
     CefPostTask(TID_UI, base::BindOnce([](const std::string& token) {
       std::cout << "[App] OAuth token received: " << token.substr(0, 20) << "..." << std::endl;
 
-      // Send token to browser process
+      // Push the token to the UI's "authToken" subscriber
       ClientHandler* handler = ClientHandler::GetInstance();
-      std::cout << "[App] ClientHandler instance: " << (handler ? "OK" : "NULL") << std::endl;
-
       if (handler) {
-        CefRefPtr<CefBrowser> browser = handler->GetBrowser();
-        std::cout << "[App] Browser: " << (browser ? "OK" : "NULL") << std::endl;
-
-        if (browser) {
-          std::cout << "[App] Browser ID: " << browser->GetIdentifier() << std::endl;
-
-          CefRefPtr<CefFrame> mainFrame = browser->GetMainFrame();
-          std::cout << "[App] Main frame: " << (mainFrame ? "OK" : "NULL") << std::endl;
-
-          if (mainFrame) {
-            std::cout << "[App] Frame URL: " << mainFrame->GetURL().ToString() << std::endl;
-
-            // Create process message
-            CefRefPtr<CefProcessMessage> message =
-                CefProcessMessage::Create("auth_token_received");
-
-            CefRefPtr<CefListValue> args = message->GetArgumentList();
-            args->SetString(0, token);
-
-            // Send to renderer process
-            std::cout << "[App] Sending auth_token_received message to renderer..." << std::endl;
-            mainFrame->SendProcessMessage(PID_RENDERER, message);
-            std::cout << "[App] ✓ Message sent to renderer!" << std::endl;
-          } else {
-            std::cerr << "[App] ERROR: Main frame is NULL!" << std::endl;
-          }
-        } else {
-          std::cerr << "[App] ERROR: Browser is NULL!" << std::endl;
-        }
+        CefRefPtr<CefDictionaryValue> payload = CefDictionaryValue::Create();
+        payload->SetString("token", token);
+        handler->PublishEvent("authToken", payload);
+        std::cout << "[App] ✓ Auth token published to UI" << std::endl;
       } else {
         std::cerr << "[App] ERROR: ClientHandler is NULL!" << std::endl;
       }
@@ -339,7 +268,7 @@ void App::OnContextInitialized() {
       std::string html_content = ReadFileToString(html_path);
 
       if (!html_content.empty()) {
-        ui_html = "data:text/html;base64," + Base64Encode(html_content);
+        ui_html = "data:text/html;base64," + Base64Encode(html_content.data(), html_content.size());
       }
     }
 
@@ -432,7 +361,7 @@ void App::OnContextInitialized() {
 </body>
 </html>
 )HTML";
-      ui_html = "data:text/html;base64," + Base64Encode(embedded_html);
+      ui_html = "data:text/html;base64," + Base64Encode(embedded_html.data(), embedded_html.size());
     }
 
     std::cout << "[App] Creating UI browser (shell)" << std::endl;
@@ -496,7 +425,8 @@ void App::OnContextInitialized() {
 void App::OnBeforeCommandLineProcessing(
     const CefString& process_type,
     CefRefPtr<CefCommandLine> command_line) {
-  // Enable features and settings
+  // Enable features and settings. Software compositing is also what lets an
+  // off-screen meeting view (--meeting-osr) paint into plain BGRA buffers.
   command_line->AppendSwitch("disable-gpu");
   command_line->AppendSwitch("disable-gpu-compositing");
 
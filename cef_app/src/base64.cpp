@@ -0,0 +1,469 @@
+#include "base64.h"
+#include "cpu_features.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BASE64_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define BASE64_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang need per-function target attributes to emit AVX2/SSE4.1
+// code without raising the baseline for the whole build. MSVC allows the
+// intrinsics anywhere.
+#if defined(BASE64_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BASE64_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define BASE64_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BASE64_TARGET_SSE41
+#define BASE64_TARGET_AVX2
+#endif
+
+namespace {
+
+const char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+const uint8_t kInvalid = 0xFF;
+
+struct DecodeTable {
+  uint8_t values[256];
+
+  DecodeTable() {
+    for (int i = 0; i < 256; i++) {
+      values[i] = kInvalid;
+    }
+    for (int i = 0; i < 64; i++) {
+      values[static_cast<uint8_t>(kAlphabet[i])] = static_cast<uint8_t>(i);
+    }
+  }
+};
+
+const DecodeTable kDecodeTable;
+
+// Vector kernels process whole blocks from the start of the buffer and
+// report how much input they consumed; the scalar code finishes the rest.
+// Encoders consume multiples of 3 bytes, decoders multiples of 4 characters.
+using EncodeBlocksFn = size_t (*)(const uint8_t* in, size_t size, char* out);
+using DecodeBlocksFn = bool (*)(const uint8_t* in, size_t size, uint8_t* out,
+                                size_t* consumed);
+
+size_t EncodeBlocksScalar(const uint8_t* in, size_t size, char* out) {
+  size_t i = 0;
+  for (; i + 3 <= size; i += 3) {
+    uint32_t triple = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+    out[0] = kAlphabet[(triple >> 18) & 0x3F];
+    out[1] = kAlphabet[(triple >> 12) & 0x3F];
+    out[2] = kAlphabet[(triple >> 6) & 0x3F];
+    out[3] = kAlphabet[triple & 0x3F];
+    out += 4;
+  }
+  return i;
+}
+
+bool DecodeBlocksScalar(const uint8_t* in, size_t size, uint8_t* out,
+                        size_t* consumed) {
+  const uint8_t* table = kDecodeTable.values;
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    uint32_t a = table[in[i]];
+    uint32_t b = table[in[i + 1]];
+    uint32_t c = table[in[i + 2]];
+    uint32_t d = table[in[i + 3]];
+    if ((a | b | c | d) & 0xC0) {  // kInvalid has the top bits set
+      return false;
+    }
+    uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+    out[0] = static_cast<uint8_t>(triple >> 16);
+    out[1] = static_cast<uint8_t>(triple >> 8);
+    out[2] = static_cast<uint8_t>(triple);
+    out += 3;
+  }
+  *consumed = i;
+  return true;
+}
+
+#if defined(BASE64_X86)
+
+// The x86 kernels follow Wojciech Mula and Daniel Lemire, "Faster Base64
+// Encoding and Decoding Using AVX2 Instructions" (2018).
+
+// 16 6-bit indices (one per byte) to their ASCII characters
+BASE64_TARGET_SSE41 inline __m128i EncodeLookupSse(__m128i indices) {
+  const __m128i shift_lut = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+      '/' - 63, 'A', 0, 0);
+  __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+  return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, result), indices);
+}
+
+// 12 input bytes (in the low 12 bytes of |in|) to 16 6-bit indices
+BASE64_TARGET_SSE41 inline __m128i EncodeSplitSse(__m128i in) {
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                         4, 5, 3, 4, 1, 2, 0, 1));
+  __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+BASE64_TARGET_SSE41 size_t EncodeBlocksSse41(const uint8_t* in, size_t size, char* out) {
+  size_t i = 0;
+  // Each step reads 16 bytes but only consumes 12
+  for (; i + 16 <= size; i += 12) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i chars = EncodeLookupSse(EncodeSplitSse(block));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), chars);
+    out += 16;
+  }
+  return i;
+}
+
+// 16 ASCII characters to 6-bit values; |valid| is cleared on bad input
+BASE64_TARGET_SSE41 inline __m128i DecodeLookupSse(__m128i in, bool* valid) {
+  const __m128i shift_lut = _mm_setr_epi8(
+      0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  // Bit n of mask_lut[low nibble] is set if high nibble n is valid
+  const __m128i mask_lut = _mm_setr_epi8(
+      static_cast<char>(0xA8),
+      static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+      static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+      static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+      static_cast<char>(0xF0), 0x54, 0x50, 0x50, 0x50, 0x54);
+  const __m128i bit_lut = _mm_setr_epi8(
+      0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, static_cast<char>(0x80),
+      0, 0, 0, 0, 0, 0, 0, 0);
+
+  __m128i high = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0F));
+  __m128i low = _mm_and_si128(in, _mm_set1_epi8(0x0F));
+
+  __m128i mask = _mm_shuffle_epi8(mask_lut, low);
+  __m128i bit = _mm_shuffle_epi8(bit_lut, high);
+  __m128i bad = _mm_cmpeq_epi8(_mm_and_si128(mask, bit), _mm_setzero_si128());
+  if (_mm_movemask_epi8(bad)) {
+    *valid = false;
+  }
+
+  __m128i shift = _mm_shuffle_epi8(shift_lut, high);
+  // '/' shares its high nibble with '+' but needs a different shift
+  __m128i is_slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+  shift = _mm_blendv_epi8(shift, _mm_set1_epi8(16), is_slash);
+  return _mm_add_epi8(in, shift);
+}
+
+// 16 6-bit values to 12 bytes, in the low 12 bytes of the result
+BASE64_TARGET_SSE41 inline __m128i DecodePackSse(__m128i values) {
+  __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+  return _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                                14, 13, 12, -1, -1, -1, -1));
+}
+
+BASE64_TARGET_SSE41 bool DecodeBlocksSse41(const uint8_t* in, size_t size, uint8_t* out,
+                                           size_t* consumed) {
+  size_t i = 0;
+  bool valid = true;
+  // Each step writes 16 bytes but only produces 12; leave room for that
+  for (; i + 24 <= size; i += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i values = DecodeLookupSse(block, &valid);
+    if (!valid) {
+      return false;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), DecodePackSse(values));
+    out += 12;
+  }
+  *consumed = i;
+  return true;
+}
+
+BASE64_TARGET_AVX2 size_t EncodeBlocksAvx2(const uint8_t* in, size_t size, char* out) {
+  const __m256i shuffle = _mm256_setr_epi8(
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  const __m256i shift_lut = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+      '/' - 63, 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+      '/' - 63, 'A', 0, 0);
+
+  size_t i = 0;
+  // Each step reads 12 bytes into each 128-bit lane (28 bytes total)
+  for (; i + 28 <= size; i += 24) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+    __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+    block = _mm256_shuffle_epi8(block, shuffle);
+    __m256i t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00));
+    __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    __m256i t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0));
+    __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    __m256i indices = _mm256_or_si256(t1, t3);
+
+    __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    result = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, result), indices);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), result);
+    out += 32;
+  }
+  return i;
+}
+
+BASE64_TARGET_AVX2 bool DecodeBlocksAvx2(const uint8_t* in, size_t size, uint8_t* out,
+                                         size_t* consumed) {
+  const __m256i shift_lut = _mm256_setr_epi8(
+      0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i mask_lut = _mm256_setr_epi8(
+      static_cast<char>(0xA8),
+      static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+      static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+      static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+      static_cast<char>(0xF0), 0x54, 0x50, 0x50, 0x50, 0x54,
+      static_cast<char>(0xA8),
+      static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+      static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+      static_cast<char>(0xF8), static_cast<char>(0xF8), static_cast<char>(0xF8),
+      static_cast<char>(0xF0), 0x54, 0x50, 0x50, 0x50, 0x54);
+  const __m256i bit_lut = _mm256_setr_epi8(
+      0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, static_cast<char>(0x80),
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, static_cast<char>(0x80),
+      0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i pack_shuffle = _mm256_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+  size_t i = 0;
+  // Each step writes 32 bytes but only produces 24; leave room for that
+  for (; i + 48 <= size; i += 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+
+    __m256i high = _mm256_and_si256(_mm256_srli_epi32(block, 4), _mm256_set1_epi8(0x0F));
+    __m256i low = _mm256_and_si256(block, _mm256_set1_epi8(0x0F));
+    __m256i mask = _mm256_shuffle_epi8(mask_lut, low);
+    __m256i bit = _mm256_shuffle_epi8(bit_lut, high);
+    __m256i bad = _mm256_cmpeq_epi8(_mm256_and_si256(mask, bit), _mm256_setzero_si256());
+    if (_mm256_movemask_epi8(bad)) {
+      return false;
+    }
+
+    __m256i shift = _mm256_shuffle_epi8(shift_lut, high);
+    __m256i is_slash = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('/'));
+    shift = _mm256_blendv_epi8(shift, _mm256_set1_epi8(16), is_slash);
+    __m256i values = _mm256_add_epi8(block, shift);
+
+    __m256i merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    merged = _mm256_shuffle_epi8(merged, pack_shuffle);
+    // Move the 12 bytes of the upper lane next to those of the lower lane
+    merged = _mm256_permutevar8x32_epi32(merged, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), merged);
+    out += 24;
+  }
+  *consumed = i;
+  return true;
+}
+
+#elif defined(BASE64_NEON)
+
+size_t EncodeBlocksNeon(const uint8_t* in, size_t size, char* out) {
+  uint8x16x4_t alphabet;
+  for (int i = 0; i < 4; i++) {
+    alphabet.val[i] = vld1q_u8(reinterpret_cast<const uint8_t*>(kAlphabet) + 16 * i);
+  }
+
+  size_t i = 0;
+  for (; i + 48 <= size; i += 48) {
+    // De-interleave so each register holds one byte of every triple
+    uint8x16x3_t bytes = vld3q_u8(in + i);
+    uint8x16x4_t indices;
+    indices.val[0] = vshrq_n_u8(bytes.val[0], 2);
+    indices.val[1] = vorrq_u8(vshrq_n_u8(bytes.val[1], 4),
+                              vandq_u8(vshlq_n_u8(bytes.val[0], 4), vdupq_n_u8(0x30)));
+    indices.val[2] = vorrq_u8(vshrq_n_u8(bytes.val[2], 6),
+                              vandq_u8(vshlq_n_u8(bytes.val[1], 2), vdupq_n_u8(0x3C)));
+    indices.val[3] = vandq_u8(bytes.val[2], vdupq_n_u8(0x3F));
+
+    uint8x16x4_t chars;
+    for (int j = 0; j < 4; j++) {
+      chars.val[j] = vqtbl4q_u8(alphabet, indices.val[j]);
+    }
+    vst4q_u8(reinterpret_cast<uint8_t*>(out), chars);
+    out += 64;
+  }
+  return i;
+}
+
+// Same nibble-based validation and translation as the x86 kernels
+inline uint8x16_t DecodeLookupNeon(uint8x16_t in, uint8x16_t* bad) {
+  static const uint8_t kShift[16] = {0, 0, 19, 4, 191, 191, 185, 185,
+                                     0, 0, 0, 0, 0, 0, 0, 0};
+  static const uint8_t kMask[16] = {0xA8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8,
+                                    0xF8, 0xF8, 0xF0, 0x54, 0x50, 0x50, 0x50, 0x54};
+  static const uint8_t kBit[16] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                                   0, 0, 0, 0, 0, 0, 0, 0};
+
+  uint8x16_t high = vshrq_n_u8(in, 4);
+  uint8x16_t low = vandq_u8(in, vdupq_n_u8(0x0F));
+  uint8x16_t mask = vqtbl1q_u8(vld1q_u8(kMask), low);
+  uint8x16_t bit = vqtbl1q_u8(vld1q_u8(kBit), high);
+  *bad = vorrq_u8(*bad, vceqq_u8(vandq_u8(mask, bit), vdupq_n_u8(0)));
+
+  uint8x16_t shift = vqtbl1q_u8(vld1q_u8(kShift), high);
+  uint8x16_t is_slash = vceqq_u8(in, vdupq_n_u8('/'));
+  shift = vbslq_u8(is_slash, vdupq_n_u8(16), shift);
+  return vaddq_u8(in, shift);
+}
+
+bool DecodeBlocksNeon(const uint8_t* in, size_t size, uint8_t* out,
+                      size_t* consumed) {
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    uint8x16x4_t chars = vld4q_u8(in + i);
+    uint8x16_t bad = vdupq_n_u8(0);
+    uint8x16_t a = DecodeLookupNeon(chars.val[0], &bad);
+    uint8x16_t b = DecodeLookupNeon(chars.val[1], &bad);
+    uint8x16_t c = DecodeLookupNeon(chars.val[2], &bad);
+    uint8x16_t d = DecodeLookupNeon(chars.val[3], &bad);
+    if (vmaxvq_u8(bad)) {
+      return false;
+    }
+
+    uint8x16x3_t bytes;
+    bytes.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+    bytes.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+    bytes.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+    vst3q_u8(out, bytes);
+    out += 48;
+  }
+  *consumed = i;
+  return true;
+}
+
+#endif
+
+struct Implementation {
+  EncodeBlocksFn encode;
+  DecodeBlocksFn decode;
+  const char* name;
+};
+
+Implementation SelectImplementation() {
+#if defined(BASE64_X86)
+  if (CpuHasAvx2()) {
+    return {EncodeBlocksAvx2, DecodeBlocksAvx2, "avx2"};
+  }
+  if (CpuHasSse41()) {
+    return {EncodeBlocksSse41, DecodeBlocksSse41, "sse4.1"};
+  }
+#elif defined(BASE64_NEON)
+  return {EncodeBlocksNeon, DecodeBlocksNeon, "neon"};
+#endif
+  return {EncodeBlocksScalar, DecodeBlocksScalar, "scalar"};
+}
+
+const Implementation& GetImplementation() {
+  static const Implementation implementation = SelectImplementation();
+  return implementation;
+}
+
+}  // namespace
+
+size_t Base64Encode(const void* input, size_t size, char* output) {
+  const uint8_t* in = static_cast<const uint8_t*>(input);
+  char* out = output;
+
+  size_t done = GetImplementation().encode(in, size, out);
+  out += done / 3 * 4;
+  size_t rest = EncodeBlocksScalar(in + done, size - done, out);
+  out += rest / 3 * 4;
+  done += rest;
+
+  // Final partial triple with padding
+  size_t remaining = size - done;
+  if (remaining > 0) {
+    uint32_t triple = in[done] << 16;
+    if (remaining > 1) {
+      triple |= in[done + 1] << 8;
+    }
+    out[0] = kAlphabet[(triple >> 18) & 0x3F];
+    out[1] = kAlphabet[(triple >> 12) & 0x3F];
+    out[2] = remaining > 1 ? kAlphabet[(triple >> 6) & 0x3F] : '=';
+    out[3] = '=';
+    out += 4;
+  }
+  return static_cast<size_t>(out - output);
+}
+
+std::string Base64Encode(const void* input, size_t size) {
+  std::string encoded(Base64EncodedSize(size), '\0');
+  if (!encoded.empty()) {
+    Base64Encode(input, size, &encoded[0]);
+  }
+  return encoded;
+}
+
+bool Base64Decode(const char* input, size_t size, uint8_t* output,
+                  size_t* output_size) {
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(input);
+  if (size % 4 != 0) {
+    return false;
+  }
+  if (size == 0) {
+    *output_size = 0;
+    return true;
+  }
+
+  // The last quantum may carry padding; the block decoders never see it
+  size_t full = size - 4;
+  uint8_t* out = output;
+
+  size_t done = 0;
+  if (!GetImplementation().decode(in, full, out, &done)) {
+    return false;
+  }
+  out += done / 4 * 3;
+  size_t rest = 0;
+  if (!DecodeBlocksScalar(in + done, full - done, out, &rest)) {
+    return false;
+  }
+  out += rest / 4 * 3;
+
+  const uint8_t* table = kDecodeTable.values;
+  const uint8_t* last = in + full;
+  size_t padding = last[3] == '=' ? (last[2] == '=' ? 2 : 1) : 0;
+  uint32_t a = table[last[0]];
+  uint32_t b = table[last[1]];
+  uint32_t c = padding >= 2 ? 0 : table[last[2]];
+  uint32_t d = padding >= 1 ? 0 : table[last[3]];
+  if ((a | b | c | d) & 0xC0) {
+    return false;
+  }
+  uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+  *out++ = static_cast<uint8_t>(triple >> 16);
+  if (padding < 2) {
+    *out++ = static_cast<uint8_t>(triple >> 8);
+  }
+  if (padding < 1) {
+    *out++ = static_cast<uint8_t>(triple);
+  }
+
+  *output_size = static_cast<size_t>(out - output);
+  return true;
+}
+
+const char* Base64ImplementationName() {
+  return GetImplementation().name;
+}
@@ -0,0 +1,23 @@
+#include "buffer_pool.h"
+
+BufferPool::BufferPool(size_t max_pooled) : max_pooled_(max_pooled) {}
+
+ByteBuffer BufferPool::Acquire(size_t size) {
+  ByteBuffer buffer;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!buffers_.empty()) {
+      buffer = std::move(buffers_.back());
+      buffers_.pop_back();
+    }
+  }
+  buffer.resize(size);
+  return buffer;
+}
+
+void BufferPool::Release(ByteBuffer buffer) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (buffers_.size() < max_pooled_) {
+    buffers_.push_back(std::move(buffer));
+  }
+}
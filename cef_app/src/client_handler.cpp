@@ -1,15 +1,33 @@
 #include "client_handler.h"
+#include "base64.h"
+#include "frame_index.h"
+#include "message_registry.h"
+#include "recording_index.h"
+#include "recording_transport.h"
+#include "recording_writer.h"
+#include "replay_buffer.h"
+#include "screencast_frame_parser.h"
+#include "screencast_transport.h"
+#include "slide_detector.h"
+#include "thumbnail_service.h"
 #include "utils.h"
+#include "video_encoder.h"
+#include "webm_remuxer.h"
 
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 #include <string>
 #include <cerrno>
+#include <cstdlib>
 #include <cstring>
+#include <thread>
 
 #include "include/base/cef_callback.h"
 #include "include/cef_app.h"
 #include "include/cef_parser.h"
+#include "include/cef_shared_memory_region.h"
+#include "include/cef_shared_process_message_builder.h"
 #include "include/views/cef_browser_view.h"
 #include "include/views/cef_window.h"
 #include "include/wrapper/cef_closure_task.h"
@@ -32,10 +50,107 @@ namespace {
 
 ClientHandler* g_instance = nullptr;
 
+// Streaming recordings are committed to their crash-recovery index in
+// segments of roughly this length
+const int64_t kRecordingSegmentMs = 5000;
+
+// Instant replay defaults; the UI may ask for a different length or size
+const int64_t kDefaultReplaySeconds = 120;
+const int kDefaultReplayMegabytes = 128;
+const int kMaxReplayMegabytes = 1024;
+const int kMaxReplaySeconds = 3600;
+
+// Decoded screencast frame buffers kept for reuse by the frame bus; enough
+// to cover a short stall of the slowest consumer
+const size_t kPooledScreencastFrames = 16;
+
+// Off-screen content browser: "--meeting-osr[=<fps>]"
+const char kOffScreenSwitch[] = "meeting-osr";
+const int kDefaultOsrFrameRate = 30;
+const int kMaxOsrFrameRate = 60;
+
+// Paint rate control while recording off-screen: step down once more than a
+// few frames wait for the recorder, step back up while it keeps up
+const int kMinOsrFrameRate = 5;
+const int kOsrFrameRateStep = 5;
+const size_t kMaxOsrQueuedFrames = 4;
+const int64_t kOsrFrameRateIntervalMs = 500;
+
+// Recording chunk bytes still owned by the process message they arrived in.
+// Holding the message (and region/binary) keeps the memory valid until the
+// writer thread has written it.
+class RecordingChunkBuffer : public RecordingWriter::Buffer {
+ public:
+  explicit RecordingChunkBuffer(CefRefPtr<CefProcessMessage> message)
+      : message_(message), data_(nullptr), size_(0) {}
+
+  void SetData(CefRefPtr<CefBaseRefCounted> owner, const void* data, size_t size) {
+    owner_ = owner;
+    data_ = data;
+    size_ = size;
+  }
+
+  const void* data() const override { return data_; }
+  size_t size() const override { return size_; }
+
+ private:
+  CefRefPtr<CefProcessMessage> message_;
+  CefRefPtr<CefBaseRefCounted> owner_;
+  const void* data_;
+  size_t size_;
+};
+
+// Fallback for Page.screencastFrame params the span scanner does not handle.
+// |data| receives the unescaped payload that |frame| points into.
+bool ParseScreencastFrameWithDom(const void* params, size_t params_size,
+                                 std::string& data, ScreencastFrameView& frame) {
+  CefRefPtr<CefValue> value = CefParseJSON(
+      CefString(static_cast<const char*>(params), params_size), JSON_PARSER_RFC);
+  if (!value || !value->IsValid() || value->GetType() != VTYPE_DICTIONARY) {
+    return false;
+  }
+
+  CefRefPtr<CefDictionaryValue> dict = value->GetDictionary();
+  data = dict->GetString("data");
+  frame.data = data.data();
+  frame.data_size = data.size();
+  frame.has_session_id = dict->HasKey("sessionId");
+  frame.session_id = frame.has_session_id ? dict->GetInt("sessionId") : 0;
+  CefRefPtr<CefDictionaryValue> metadata = dict->GetDictionary("metadata");
+  frame.has_timestamp = metadata && metadata->HasKey("timestamp");
+  frame.timestamp = frame.has_timestamp ? metadata->GetDouble("timestamp") : 0.0;
+  return true;
+}
+
+// A "screencast_frame" message for the UI renderer; large frames go through
+// shared memory. Returns nullptr if the memory cannot be allocated.
+CefRefPtr<CefProcessMessage> CreateScreencastFrameMessage(const ScreencastFrame& frame) {
+  size_t size = frame.GetJpegSize();
+
+  if (size >= kScreencastSharedMemoryThreshold) {
+    CefRefPtr<CefSharedProcessMessageBuilder> builder =
+        CefSharedProcessMessageBuilder::Create("screencast_frame",
+                                               sizeof(ScreencastFrameHeader) + size);
+    if (!builder || !builder->IsValid()) {
+      return nullptr;
+    }
+    uint8_t* memory = static_cast<uint8_t*>(builder->Memory());
+    ScreencastFrameHeader header = {kScreencastFrameMagic, 0, frame.GetTimestamp(), size};
+    memcpy(memory, &header, sizeof(header));
+    memcpy(memory + sizeof(header), frame.GetJpeg(), size);
+    return builder->Build();
+  }
+
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("screencast_frame");
+  message->GetArgumentList()->SetBinary(0, CefBinaryValue::Create(frame.GetJpeg(), size));
+  message->GetArgumentList()->SetDouble(1, frame.GetTimestamp());
+  return message;
+}
+
 // Returns a data: URI with the specified contents
 std::string GetDataURI(const std::string& data, const std::string& mime_type) {
   return "data:" + mime_type + ";base64," +
-         CefURIEncode(CefBase64Encode(data.data(), data.size()), false)
+         CefURIEncode(Base64Encode(data.data(), data.size()), false)
              .ToString();
 }
 
@@ -43,15 +158,37 @@ std::string GetDataURI(const std::string& data, const std::string& mime_type) {
 
 ClientHandler::ClientHandler(bool use_views)
     : use_views_(use_views), is_closing_(false), parent_window_(0),
-      last_meeting_x_(0), last_meeting_y_(0), last_meeting_width_(0), last_meeting_height_(0) {
+      last_meeting_x_(0), last_meeting_y_(0), last_meeting_width_(0), last_meeting_height_(0),
+      recording_next_sequence_(0), frame_bus_(kPooledScreencastFrames) {
   DCHECK(!g_instance);
   g_instance = this;
+
+  CefRefPtr<CefCommandLine> command_line = CefCommandLine::GetGlobalCommandLine();
+  osr_enabled_ = UseOffScreenRendering(command_line);
+  if (osr_enabled_) {
+    std::string frame_rate = command_line->GetSwitchValue(kOffScreenSwitch);
+    osr_max_frame_rate_ = frame_rate.empty() ? kDefaultOsrFrameRate
+                                             : std::min(kMaxOsrFrameRate,
+                                                        std::max(1, atoi(frame_rate.c_str())));
+    osr_frame_rate_ = osr_max_frame_rate_;
+    std::cout << "[Browser] Off-screen meeting view at up to " << osr_max_frame_rate_ << " fps"
+              << std::endl;
+  }
 }
 
 ClientHandler::~ClientHandler() {
   g_instance = nullptr;
 }
 
+// static
+bool ClientHandler::UseOffScreenRendering(CefRefPtr<CefCommandLine> command_line) {
+#if defined(OS_LINUX)
+  return command_line && command_line->HasSwitch(kOffScreenSwitch);
+#else
+  return false;
+#endif
+}
+
 // static
 ClientHandler* ClientHandler::GetInstance() {
   return g_instance;
@@ -64,7 +201,9 @@ void ClientHandler::OnGotFocus(CefRefPtr<CefBrowser> browser) {
   // When the UI browser gets focus (e.g. switching workspaces),
   // ensure the content browser (child window) is raised and visible.
   if (ui_browser_ && browser->IsSame(ui_browser_) && content_browser_) {
-    Window window = content_browser_->GetHost()->GetWindowHandle();
+    Window window = osr_window_ != kNullWindowHandle
+                        ? osr_window_
+                        : content_browser_->GetHost()->GetWindowHandle();
     Display* display = cef_get_xdisplay();
     if (window != kNullWindowHandle && display) {
       XRaiseWindow(display, window);
@@ -87,6 +226,29 @@ void ClientHandler::OnAfterCreated(CefRefPtr<CefBrowser> browser) {
     ui_browser_ = browser;
     std::cout << "[Browser] UI browser created with ID: " << browser->GetIdentifier() << std::endl;
 
+    // Salvage recordings left behind by a crash, off the UI thread
+    if (!recovery_started_) {
+      recovery_started_ = true;
+      CefPostTask(TID_FILE_USER_VISIBLE,
+                  base::BindOnce(&ClientHandler::RecoverInterruptedRecordings, this,
+                                 std::time(nullptr)));
+
+      // Catch up on recordings made since the index was last saved
+      frame_index_ = std::make_shared<FrameIndex>(GetRecordingsDirectory());
+      CefPostTask(TID_FILE_BACKGROUND,
+                  base::BindOnce(
+                      [](std::shared_ptr<FrameIndex> frame_index) {
+                        frame_index->Load();
+                        frame_index->Update();
+                      },
+                      frame_index_));
+
+      // One or two low-priority threads; previews are never urgent
+      size_t preview_threads =
+          std::max<size_t>(1, std::min<size_t>(2, std::thread::hardware_concurrency() / 4));
+      thumbnail_service_.reset(new ThumbnailService(preview_threads));
+    }
+
     // Add to browser list for lifecycle management
     browser_list_.push_back(browser);
 
@@ -124,6 +286,11 @@ void ClientHandler::OnAfterCreated(CefRefPtr<CefBrowser> browser) {
       // Add to browser list for lifecycle management
       browser_list_.push_back(browser);
 
+      if (replay_buffer_) {
+        replay_buffer_->Clear();
+        StartScreencastCapture();
+      }
+
 #if defined(OS_LINUX)
       // For true child windows (parent_window set), we don't need transient hints.
       // However, we might need to ensure the window is mapped.
@@ -239,6 +406,27 @@ void ClientHandler::OnBeforeClose(CefRefPtr<CefBrowser> browser) {
   if (content_browser_ && content_browser_->IsSame(browser)) {
     std::cout << "[Browser] Content browser closed - returning to dashboard" << std::endl;
     content_browser_ = nullptr;
+    ResetParticipants();
+
+    // A recording in progress ends with the meeting view; what was captured
+    // is still saved
+    StopRecording();
+    if (recording_writer_ && recording_writer_->IsOpen()) {
+      CloseRecordingSession();
+    }
+    if (recording_writer_) {
+      // Joining the writer thread waits for the close; not on the UI thread
+      CefPostTask(TID_FILE_USER_VISIBLE,
+                  base::BindOnce([](std::shared_ptr<RecordingWriter>) {},
+                                 std::shared_ptr<RecordingWriter>(std::move(recording_writer_))));
+    }
+    StopSlideDetection();
+    screencast_active_ = false;
+    screencast_generation_++;
+    frame_bus_.Reset(ui_subscription_);
+    devtools_registration_ = nullptr;
+    PlatformDestroyOsrWindow();
+    osr_popup_pixels_.clear();
 
     // Remove from the list of existing browsers
     BrowserList::iterator bit = browser_list_.begin();
@@ -269,6 +457,18 @@ void ClientHandler::OnBeforeClose(CefRefPtr<CefBrowser> browser) {
   }
 }
 
+void ClientHandler::OnLoadEnd(CefRefPtr<CefBrowser> browser,
+                              CefRefPtr<CefFrame> frame,
+                              int httpStatusCode) {
+  CEF_REQUIRE_UI_THREAD();
+
+  // A new meeting page starts with an empty roster and needs its own agent
+  if (content_browser_ && content_browser_->IsSame(browser) && frame->IsMain()) {
+    ResetParticipants();
+    StartParticipantAgent();
+  }
+}
+
 void ClientHandler::OnLoadError(CefRefPtr<CefBrowser> browser,
                                 CefRefPtr<CefFrame> frame,
                                 ErrorCode errorCode,
@@ -314,6 +514,11 @@ void ClientHandler::OnTitleChange(CefRefPtr<CefBrowser> browser,
   if (content_browser_ && browser->GetIdentifier() == content_browser_->GetIdentifier()) {
     content_browser_title_ = title.ToString();
     std::cout << "[Browser] Content browser title changed: " << content_browser_title_ << std::endl;
+
+    CefRefPtr<CefDictionaryValue> info = CefDictionaryValue::Create();
+    info->SetString("url", browser->GetMainFrame()->GetURL());
+    info->SetString("title", content_browser_title_);
+    PublishEvent("meetingPageInfo", info);
   }
 
   // Only update window title for content browser
@@ -336,6 +541,20 @@ void ClientHandler::OnTitleChange(CefRefPtr<CefBrowser> browser,
   }
 }
 
+bool ClientHandler::OnCursorChange(CefRefPtr<CefBrowser> browser,
+                                   CefCursorHandle cursor,
+                                   cef_cursor_type_t type,
+                                   const CefCursorInfo& custom_cursor_info) {
+  CEF_REQUIRE_UI_THREAD();
+
+  // Windowed browsers set their own cursor
+  if (osr_window_ == kNullWindowHandle || !content_browser_ || !browser->IsSame(content_browser_)) {
+    return false;
+  }
+  PlatformSetOsrCursor(cursor);
+  return true;
+}
+
 bool ClientHandler::OnBeforeBrowse(CefRefPtr<CefBrowser> browser,
                                    CefRefPtr<CefFrame> frame,
                                    CefRefPtr<CefRequest> request,
@@ -407,6 +626,36 @@ CefResourceRequestHandler::ReturnValue ClientHandler::OnBeforeResourceLoad(
   return RV_CONTINUE;
 }
 
+// static
+const ClientHandler::MessageTable& ClientHandler::GetMessageTable() {
+  // Argument schemas are described in message_registry.h
+  static const MessageTable::Entry kEntries[] = {
+      {"open_system_browser", "s", &ClientHandler::HandleOpenSystemBrowser},
+      {"navigate_to_meeting", "s", &ClientHandler::HandleNavigateToMeeting},
+      {"join_meeting", "siiii", &ClientHandler::HandleJoinMeeting},
+      {"leave_meeting", "", &ClientHandler::HandleLeaveMeeting},
+      {"update_meeting_bounds", "iiii", &ClientHandler::HandleUpdateMeetingBounds},
+      {"get_meeting_page_info", "i", &ClientHandler::HandleGetMeetingPageInfo},
+      {"get_meeting_participants", "i", &ClientHandler::HandleGetMeetingParticipants},
+      {"participants_changed", "LL", &ClientHandler::HandleParticipantsChanged},
+      {"start_recording", "s|sD", &ClientHandler::HandleStartRecording},
+      {"stop_recording", "", &ClientHandler::HandleStopRecording},
+      {"recording_crop_changed", "dddd", &ClientHandler::HandleRecordingCropChanged},
+      {"set_replay_buffer", "b|D", &ClientHandler::HandleSetReplayBuffer},
+      {"save_replay", "s", &ClientHandler::HandleSaveReplay},
+      {"start_slide_detection", "s|D", &ClientHandler::HandleStartSlideDetection},
+      {"stop_slide_detection", "", &ClientHandler::HandleStopSlideDetection},
+      {"get_recording_previews", "is", &ClientHandler::HandleGetRecordingPreviews},
+      {"search_frames", "iB|i", &ClientHandler::HandleSearchFrames},
+      {"screencast_frame_consumed", "", &ClientHandler::HandleScreencastFrameConsumed},
+      {"open_recording_session", "s", &ClientHandler::HandleOpenRecordingSession},
+      {"append_recording_chunk", "Bi", &ClientHandler::HandleAppendRecordingChunk},
+      {"finalize_recording_session", "i", &ClientHandler::HandleFinalizeRecordingSession},
+  };
+  static const MessageTable table(kEntries, false);
+  return table;
+}
+
 bool ClientHandler::OnProcessMessageReceived(
     CefRefPtr<CefBrowser> browser,
     CefRefPtr<CefFrame> frame,
@@ -414,396 +663,1253 @@ bool ClientHandler::OnProcessMessageReceived(
     CefRefPtr<CefProcessMessage> message) {
   CEF_REQUIRE_UI_THREAD();
 
-  const std::string& message_name = message->GetName();
-  std::cout << "[Browser] Process message received: " << message_name << std::endl;
-
-  if (message_name == "open_system_browser") {
-    // Get URL from message
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string url = args->GetString(0);
-
-    std::cout << "[Browser] Opening system browser with URL: " << url << std::endl;
-    OpenSystemBrowser(url);
+  const std::string message_name = message->GetName();
+  const MessageTable::Entry* entry = GetMessageTable().Find(message_name);
+  if (!entry) {
+    std::cerr << "[Browser] Unknown process message: " << message_name << std::endl;
+    return false;
+  }
+  if (!MatchesSchema(entry->schema, message->GetArgumentList())) {
+    std::cerr << "[Browser] Malformed process message: " << message_name << std::endl;
     return true;
   }
+  (this->*entry->handler)(browser, message);
+  return true;
+}
 
-  if (message_name == "navigate_to_meeting") {
-    // Get meeting URL from message
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string url = args->GetString(0);
+void ClientHandler::HandleOpenSystemBrowser(CefRefPtr<CefBrowser> browser,
+                                            CefRefPtr<CefProcessMessage> message) {
+  // Get URL from message
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  std::string url = args->GetString(0);
+
+  std::cout << "[Browser] Opening system browser with URL: " << url << std::endl;
+  OpenSystemBrowser(url);
+}
 
-    std::cout << "[Browser] Navigating to meeting URL: " << url << std::endl;
+void ClientHandler::HandleNavigateToMeeting(CefRefPtr<CefBrowser> browser,
+                                            CefRefPtr<CefProcessMessage> message) {
+  // Get meeting URL from message
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  std::string url = args->GetString(0);
 
-    // Navigate the current browser to the meeting URL
-    if (browser && browser->GetMainFrame()) {
-      browser->GetMainFrame()->LoadURL(url);
-      std::cout << "[Browser] Browser navigated to meeting URL" << std::endl;
-    }
-    return true;
+  std::cout << "[Browser] Navigating to meeting URL: " << url << std::endl;
+
+  // Navigate the current browser to the meeting URL
+  if (browser && browser->GetMainFrame()) {
+    browser->GetMainFrame()->LoadURL(url);
+    std::cout << "[Browser] Browser navigated to meeting URL" << std::endl;
   }
+}
 
-  if (message_name == "join_meeting") {
-    // Get meeting details from message
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string url = args->GetString(0);
-    int x = args->GetInt(1);
-    int y = args->GetInt(2);
-    int width = args->GetInt(3);
-    int height = args->GetInt(4);
+void ClientHandler::HandleJoinMeeting(CefRefPtr<CefBrowser> browser,
+                                      CefRefPtr<CefProcessMessage> message) {
+  // Get meeting details from message
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  std::string url = args->GetString(0);
+  int x = args->GetInt(1);
+  int y = args->GetInt(2);
+  int width = args->GetInt(3);
+  int height = args->GetInt(4);
 
-    std::cout << "[Browser] Join meeting request: " << url
-              << " at (" << x << ", " << y << ") size: " << width << "x" << height << std::endl;
+  std::cout << "[Browser] Join meeting request: " << url
+            << " at (" << x << ", " << y << ") size: " << width << "x" << height << std::endl;
 
-    CreateMeetingView(url, x, y, width, height);
-    return true;
-  }
+  CreateMeetingView(url, x, y, width, height);
+}
 
-  if (message_name == "leave_meeting") {
-    std::cout << "[Browser] Leave meeting request" << std::endl;
-    DestroyMeetingView();
-    return true;
-  }
+void ClientHandler::HandleLeaveMeeting(CefRefPtr<CefBrowser> browser,
+                                       CefRefPtr<CefProcessMessage> message) {
+  std::cout << "[Browser] Leave meeting request" << std::endl;
+  DestroyMeetingView();
+}
 
-  if (message_name == "update_meeting_bounds") {
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    int x = args->GetInt(0);
-    int y = args->GetInt(1);
-    int width = args->GetInt(2);
-    int height = args->GetInt(3);
+void ClientHandler::HandleUpdateMeetingBounds(CefRefPtr<CefBrowser> browser,
+                                              CefRefPtr<CefProcessMessage> message) {
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  int x = args->GetInt(0);
+  int y = args->GetInt(1);
+  int width = args->GetInt(2);
+  int height = args->GetInt(3);
 
-    std::cout << "[Browser] Update meeting bounds: (" << x << ", " << y
-              << ") size: " << width << "x" << height << std::endl;
+  std::cout << "[Browser] Update meeting bounds: (" << x << ", " << y
+            << ") size: " << width << "x" << height << std::endl;
 
-    UpdateMeetingViewBounds(x, y, width, height);
-    return true;
+  UpdateMeetingViewBounds(x, y, width, height);
+}
+
+void ClientHandler::HandleGetMeetingPageInfo(CefRefPtr<CefBrowser> browser,
+                                             CefRefPtr<CefProcessMessage> message) {
+  // [requestId]
+  std::string url = "";
+  std::string title = content_browser_title_;
+
+  if (content_browser_) {
+    url = content_browser_->GetMainFrame()->GetURL().ToString();
   }
 
-  if (message_name == "get_meeting_page_info") {
-    std::cout << "[Browser] Get meeting page info request" << std::endl;
+  CefRefPtr<CefDictionaryValue> info = CefDictionaryValue::Create();
+  info->SetString("url", url);
+  info->SetString("title", title);
+  CefRefPtr<CefValue> value = CefValue::Create();
+  value->SetDictionary(info);
+  SendRequestResult(message->GetArgumentList()->GetInt(0), value);
+}
 
-    std::string url = "";
-    std::string title = content_browser_title_;
+void ClientHandler::HandleGetMeetingParticipants(CefRefPtr<CefBrowser> browser,
+                                                 CefRefPtr<CefProcessMessage> message) {
+  // [requestId]; answered from the roster the participant agent keeps
+  CefRefPtr<CefListValue> names = CefListValue::Create();
+  for (size_t i = 0; i < participants_.size(); i++) {
+    names->SetString(i, participants_[i]);
+  }
+  CefRefPtr<CefValue> value = CefValue::Create();
+  value->SetList(names);
+  SendRequestResult(message->GetArgumentList()->GetInt(0), value);
+}
 
-    if (content_browser_) {
-      url = content_browser_->GetMainFrame()->GetURL().ToString();
+void ClientHandler::HandleParticipantsChanged(CefRefPtr<CefBrowser> browser,
+                                              CefRefPtr<CefProcessMessage> message) {
+  // [joined, left] from the participant agent. Names are not unique, so
+  // each entry adds or removes one occurrence.
+  if (!content_browser_ || !content_browser_->IsSame(browser)) {
+    return;
+  }
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  CefRefPtr<CefListValue> joined = args->GetList(0);
+  CefRefPtr<CefListValue> left = args->GetList(1);
+
+  for (size_t i = 0; i < left->GetSize(); i++) {
+    auto it = std::find(participants_.begin(), participants_.end(),
+                        left->GetString(i).ToString());
+    if (it != participants_.end()) {
+      participants_.erase(it);
     }
+  }
+  for (size_t i = 0; i < joined->GetSize(); i++) {
+    participants_.push_back(joined->GetString(i).ToString());
+  }
+  std::cout << "[Browser] Participants: +" << joined->GetSize() << " -" << left->GetSize()
+            << ", " << participants_.size() << " present" << std::endl;
+
+  CefRefPtr<CefDictionaryValue> payload = CefDictionaryValue::Create();
+  payload->SetList("joined", joined);
+  payload->SetList("left", left);
+  PublishEvent("participants", payload);
+}
 
-    std::cout << "[Browser] Meeting page info - URL: " << url << ", Title: " << title << std::endl;
-
-    // Send response back to UI browser
-    if (ui_browser_) {
-      CefRefPtr<CefProcessMessage> response = CefProcessMessage::Create("meeting_page_info_response");
-      CefRefPtr<CefListValue> args = response->GetArgumentList();
-      args->SetString(0, url);
-      args->SetString(1, title);
-      ui_browser_->GetMainFrame()->SendProcessMessage(PID_RENDERER, response);
-    } else if (!browser_list_.empty()) {
-      // Fallback for non-Windows platforms
-      CefRefPtr<CefProcessMessage> response = CefProcessMessage::Create("meeting_page_info_response");
-      CefRefPtr<CefListValue> args = response->GetArgumentList();
-      args->SetString(0, url);
-      args->SetString(1, title);
-      browser_list_.front()->GetMainFrame()->SendProcessMessage(PID_RENDERER, response);
+void ClientHandler::HandleStartRecording(CefRefPtr<CefBrowser> browser,
+                                         CefRefPtr<CefProcessMessage> message) {
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  std::string meeting_id = args->GetString(0);
+  current_meeting_id_ = meeting_id;
+
+  // Optional mode: "native" records frames in the browser process,
+  // "renderer" (default) forwards them to the UI for MediaRecorder.
+  std::string mode = "renderer";
+  if (args->GetSize() > 1 && args->GetType(1) == VTYPE_STRING) {
+    mode = args->GetString(1);
+  }
+
+  std::cout << "[Browser] Start recording request for meeting: " << meeting_id
+            << " (mode: " << mode << ", base64: " << Base64ImplementationName() << ")"
+            << std::endl;
+  if (content_browser_) {
+    if (mode == "native") {
+      if (!screencast_recorder_) {
+        screencast_recorder_.reset(new ScreencastRecorder());
+        screencast_recorder_->SetFrameConsumedCallback([this](bool dropped) {
+          // Off-screen paints are throttled by frame rate; screencast
+          // frames hold back their acks until the frame bus releases them
+          CefPostTask(TID_UI, base::BindOnce(&ClientHandler::OnOffScreenFrameConsumed, this,
+                                             dropped));
+        });
+      }
+      // Optional settings: {codec, bitrateKbps, preset, cropSelector}
+      VideoEncoderConfig encoder_config;
+      std::string crop_selector;
+      if (args->GetSize() > 2 && args->GetType(2) == VTYPE_DICTIONARY) {
+        CefRefPtr<CefDictionaryValue> options = args->GetDictionary(2);
+        if (options->HasKey("codec") &&
+            !ParseVideoCodec(options->GetString("codec"), encoder_config.codec)) {
+          std::cerr << "[Browser] Unknown recording codec: "
+                    << options->GetString("codec").ToString() << std::endl;
+        }
+        if (options->HasKey("preset")) {
+          ParseVideoEncoderPreset(options->GetString("preset"), encoder_config.preset);
+        }
+        if (options->HasKey("bitrateKbps")) {
+          encoder_config.bitrate_kbps = options->GetInt("bitrateKbps");
+        }
+        if (options->HasKey("cropSelector")) {
+          crop_selector = options->GetString("cropSelector");
+        }
+      }
+      bool encoded = IsVideoCodecEncoded(encoder_config.codec) &&
+                     VideoEncoder::IsAvailable(encoder_config.codec);
+      screencast_recorder_->Start(MakeRecordingPath(meeting_id, encoded ? "webm" : "mkv"),
+                                  encoder_config);
+      if (!crop_selector.empty()) {
+        StartCropTracking(crop_selector);
+      }
     }
 
-    return true;
+    recording_screencast_ = true;
+    if (IsRecordingPaints()) {
+      SetOsrFrameRate(osr_max_frame_rate_);
+    } else {
+      SubscribeRecordingFrames();
+      StartScreencastCapture();
+    }
   }
+}
 
-  if (message_name == "get_meeting_participants") {
-    std::cout << "[Browser] Get meeting participants request" << std::endl;
-
-    if (content_browser_) {
-      // Execute JavaScript in content browser to extract participants
-      // This JS opens the panel if needed, extracts names, then closes it
-      std::string js_code = R"(
-        (function() {
-          var participants = [];
-
-          // Function to extract participants from the DOM
-          function extractParticipants() {
-            var found = [];
-
-            // Method 1: Google Meet - aria-label on listitem
-            document.querySelectorAll('div[role="listitem"]').forEach(function(el) {
-              var name = el.getAttribute('aria-label');
-              if (name && name.trim()) {
-                found.push(name.trim());
-              }
-            });
-
-            // Method 2: Google Meet - span.zWGUib class (fallback)
-            if (found.length === 0) {
-              document.querySelectorAll('span.zWGUib').forEach(function(el) {
-                var name = el.textContent;
-                if (name && name.trim()) {
-                  found.push(name.trim());
-                }
-              });
-            }
+void ClientHandler::HandleStopRecording(CefRefPtr<CefBrowser> browser,
+                                        CefRefPtr<CefProcessMessage> message) {
+  std::cout << "[Browser] Stop recording request" << std::endl;
+  StopRecording();
+}
 
-            // Method 3: Zoom - participant list items
-            if (found.length === 0) {
-              document.querySelectorAll('.participants-item__display-name').forEach(function(el) {
-                var name = el.textContent;
-                if (name && name.trim()) {
-                  found.push(name.trim());
-                }
-              });
-            }
+void ClientHandler::StopRecording() {
+  CEF_REQUIRE_UI_THREAD();
 
-            return found;
-          }
+  recording_screencast_ = false;
+  UnsubscribeFrames(recorder_subscription_);
+  UnsubscribeFrames(ui_subscription_);
+  StopScreencastCaptureIfUnused();
+  StopCropTracking();
+
+  if (screencast_recorder_ && screencast_recorder_->IsRecording()) {
+    // The recorder finalizes on its writer thread; report back on the UI thread
+    std::string meeting_id = current_meeting_id_;
+    screencast_recorder_->Stop([this, meeting_id](const std::string& path, bool success) {
+      if (success) {
+        CefPostTask(TID_UI, base::BindOnce(&ClientHandler::NotifyRecordingSaved,
+                                           this, meeting_id, path));
+      }
+    });
+    current_meeting_id_.clear();
+  }
+  if (osr_enabled_) {
+    SetOsrFrameRate(osr_max_frame_rate_);
+  }
+}
 
-          // Function to find and click the people/participants button
-          function findPeopleButton() {
-            // Google Meet: Look for button with people icon
-            var buttons = document.querySelectorAll('button');
-            for (var i = 0; i < buttons.length; i++) {
-              var btn = buttons[i];
-              // Check aria-label
-              var label = btn.getAttribute('aria-label') || '';
-              if (label.toLowerCase().includes('people') ||
-                  label.toLowerCase().includes('participant') ||
-                  label.toLowerCase().includes('everyone')) {
-                return btn;
-              }
-              // Check for people icon inside button
-              var icon = btn.querySelector('i.google-symbols');
-              if (icon && icon.textContent && icon.textContent.trim() === 'people') {
-                return btn;
-              }
-            }
-            return null;
-          }
+void ClientHandler::HandleRecordingCropChanged(CefRefPtr<CefBrowser> browser,
+                                               CefRefPtr<CefProcessMessage> message) {
+  // From the tracker in the content browser: [x, y, width, height] as
+  // fractions of the viewport
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  if (!crop_tracking_ || !content_browser_ || !browser->IsSame(content_browser_) ||
+      !screencast_recorder_) {
+    return;
+  }
+  CropRect rect;
+  rect.x = std::min(1.0, std::max(0.0, args->GetDouble(0)));
+  rect.y = std::min(1.0, std::max(0.0, args->GetDouble(1)));
+  rect.width = std::min(1.0 - rect.x, std::max(0.0, args->GetDouble(2)));
+  rect.height = std::min(1.0 - rect.y, std::max(0.0, args->GetDouble(3)));
+  if (rect.width <= 0.0 || rect.height <= 0.0) {
+    rect = CropRect();
+  }
+  std::cout << "[Browser] Recording crop: " << rect.x << ", " << rect.y << " "
+            << rect.width << "x" << rect.height << std::endl;
+  screencast_recorder_->SetCrop(rect);
+}
 
-          // Try to extract participants directly first
-          participants = extractParticipants();
-
-          if (participants.length === 0) {
-            // Panel might not be open, try to open it
-            var peopleBtn = findPeopleButton();
-            if (peopleBtn) {
-              // Click to open panel
-              peopleBtn.click();
-
-              // Wait for panel to load, then extract and close
-              setTimeout(function() {
-                participants = extractParticipants();
-
-                // Close the panel by clicking the button again
-                setTimeout(function() {
-                  peopleBtn.click();
-                }, 100);
-
-                // Send results
-                if (window.rebrazeAuth && window.rebrazeAuth.sendParticipantList) {
-                  window.rebrazeAuth.sendParticipantList(JSON.stringify(participants));
-                }
-              }, 500);
-            } else {
-              // Couldn't find button, send empty
-              if (window.rebrazeAuth && window.rebrazeAuth.sendParticipantList) {
-                window.rebrazeAuth.sendParticipantList(JSON.stringify(participants));
-              }
-            }
-          } else {
-            // Already have participants, send them
-            if (window.rebrazeAuth && window.rebrazeAuth.sendParticipantList) {
-              window.rebrazeAuth.sendParticipantList(JSON.stringify(participants));
-            }
-          }
-        })();
-      )";
+void ClientHandler::HandleSetReplayBuffer(CefRefPtr<CefBrowser> browser,
+                                          CefRefPtr<CefProcessMessage> message) {
+  // Optional always-on capture: [enabled, {seconds, maxMegabytes}]
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  bool enabled = args->GetBool(0);
+  if (!enabled) {
+    if (replay_buffer_) {
+      std::cout << "[Browser] Instant replay disabled" << std::endl;
+      replay_buffer_ = nullptr;
+      StopScreencastCaptureIfUnused();
+    }
+    return;
+  }
 
-      content_browser_->GetMainFrame()->ExecuteJavaScript(js_code, "", 0);
-      std::cout << "[Browser] Executed participant extraction JS in content browser" << std::endl;
-    } else {
-      std::cout << "[Browser] No content browser to extract participants from" << std::endl;
-      // Send empty list
-      if (ui_browser_) {
-        CefRefPtr<CefProcessMessage> response = CefProcessMessage::Create("meeting_participants_response");
-        CefRefPtr<CefListValue> args = response->GetArgumentList();
-        args->SetString(0, "[]");
-        ui_browser_->GetMainFrame()->SendProcessMessage(PID_RENDERER, response);
-      }
+  int64_t seconds = kDefaultReplaySeconds;
+  int megabytes = kDefaultReplayMegabytes;
+  if (args->GetSize() > 1 && args->GetType(1) == VTYPE_DICTIONARY) {
+    CefRefPtr<CefDictionaryValue> options = args->GetDictionary(1);
+    if (options->HasKey("seconds")) {
+      seconds = std::min(std::max(1, options->GetInt("seconds")), kMaxReplaySeconds);
     }
+    if (options->HasKey("maxMegabytes")) {
+      megabytes = std::min(std::max(8, options->GetInt("maxMegabytes")), kMaxReplayMegabytes);
+    }
+  }
 
-    return true;
+  size_t budget = static_cast<size_t>(megabytes) << 20;
+  if (!replay_buffer_ || replay_buffer_->GetBudget() != budget ||
+      replay_buffer_->GetMaxDurationMs() != seconds * 1000) {
+    // A save still running keeps the old buffer alive until it is done
+    replay_buffer_ = std::make_shared<ReplayBuffer>(budget, seconds * 1000);
   }
+  std::cout << "[Browser] Instant replay enabled: " << seconds << "s, "
+            << megabytes << " MB" << std::endl;
+  StartScreencastCapture();
+}
 
-  if (message_name == "participant_list_extracted") {
-    // Received participant list from content browser, forward to UI browser
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string json_list = args->GetString(0).ToString();
-
-    std::cout << "[Browser] Participant list extracted: " << json_list << std::endl;
-
-    // Forward to UI browser
-    if (ui_browser_) {
-      CefRefPtr<CefProcessMessage> response = CefProcessMessage::Create("meeting_participants_response");
-      CefRefPtr<CefListValue> response_args = response->GetArgumentList();
-      response_args->SetString(0, json_list);
-      ui_browser_->GetMainFrame()->SendProcessMessage(PID_RENDERER, response);
-    } else if (!browser_list_.empty()) {
-      // Fallback for non-Windows platforms
-      CefRefPtr<CefProcessMessage> response = CefProcessMessage::Create("meeting_participants_response");
-      CefRefPtr<CefListValue> response_args = response->GetArgumentList();
-      response_args->SetString(0, json_list);
-      browser_list_.front()->GetMainFrame()->SendProcessMessage(PID_RENDERER, response);
+void ClientHandler::HandleSaveReplay(CefRefPtr<CefBrowser> browser,
+                                     CefRefPtr<CefProcessMessage> message) {
+  std::string meeting_id = message->GetArgumentList()->GetString(0);
+  if (!replay_buffer_) {
+    std::cerr << "[Browser] save_replay requested but instant replay is off" << std::endl;
+    return;
+  }
+  CefPostTask(TID_FILE_USER_VISIBLE,
+              base::BindOnce(&ClientHandler::SaveReplay, this, replay_buffer_, meeting_id,
+                             MakeRecordingPath(meeting_id + "_replay", "mkv")));
+}
+
+void ClientHandler::HandleStartSlideDetection(CefRefPtr<CefBrowser> browser,
+                                              CefRefPtr<CefProcessMessage> message) {
+  // [meetingId, {changeThreshold, intervalMs}]
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  std::string meeting_id = args->GetString(0);
+  SlideDetector::Options options;
+  if (args->GetSize() > 1 && args->GetType(1) == VTYPE_DICTIONARY) {
+    CefRefPtr<CefDictionaryValue> dict = args->GetDictionary(1);
+    if (dict->HasKey("changeThreshold")) {
+      options.change_threshold = dict->GetDouble("changeThreshold");
+    }
+    if (dict->HasKey("intervalMs")) {
+      options.interval_ms = std::max(50, dict->GetInt("intervalMs"));
     }
+  }
 
-    return true;
+  StopSlideDetection();
+  slide_detector_.reset(new SlideDetector());
+  if (!slide_detector_->Start(MakeRecordingPath(meeting_id, "slides"), options)) {
+    slide_detector_.reset();
+    return;
   }
+  // Only the frames the detector will analyze are decoded
+  FrameBus::Options slide_options;
+  slide_options.max_fps = 1000.0 / options.interval_ms;
+  SlideDetector* detector = slide_detector_.get();
+  slides_subscription_ = frame_bus_.Subscribe(
+      "Slides", slide_options, [detector](const FrameRef& frame) { detector->AddFrame(frame); });
+  StartScreencastCapture();
+}
 
-  if (message_name == "start_recording") {
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string meeting_id = args->GetString(0);
-    current_meeting_id_ = meeting_id;
+void ClientHandler::HandleStopSlideDetection(CefRefPtr<CefBrowser> browser,
+                                             CefRefPtr<CefProcessMessage> message) {
+  StopSlideDetection();
+  StopScreencastCaptureIfUnused();
+}
 
-    std::cout << "[Browser] Start recording request for meeting: " << meeting_id << std::endl;
-    if (content_browser_) {
-      devtools_registration_ = content_browser_->GetHost()->AddDevToolsMessageObserver(this);
+void ClientHandler::HandleGetRecordingPreviews(CefRefPtr<CefBrowser> browser,
+                                               CefRefPtr<CefProcessMessage> message) {
+  // [requestId, recordingPath]; only files directly in the recordings directory
+  int request_id = message->GetArgumentList()->GetInt(0);
+  std::string recording_path = message->GetArgumentList()->GetString(1);
+  std::string directory = GetRecordingsDirectory() + "/";
+  if (recording_path.compare(0, directory.size(), directory) != 0 ||
+      recording_path.find_first_of("/\\", directory.size()) != std::string::npos) {
+    std::cerr << "[Browser] get_recording_previews: not a recording: " << recording_path
+              << std::endl;
+    SendRequestError(request_id, "Not a recording");
+    return;
+  }
+  GenerateRecordingPreviews(recording_path, request_id);
+}
 
-      CefRefPtr<CefDictionaryValue> params = CefDictionaryValue::Create();
-      params->SetString("format", "jpeg");
-      params->SetInt("quality", 80);
-      // params->SetInt("everyNthFrame", 1);
+void ClientHandler::HandleSearchFrames(CefRefPtr<CefBrowser> browser,
+                                       CefRefPtr<CefProcessMessage> message) {
+  // [requestId, jpeg: binary, maxResults]
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  int request_id = args->GetInt(0);
+  CefRefPtr<CefBinaryValue> binary = args->GetBinary(1);
+  if (!frame_index_) {
+    CefRefPtr<CefValue> value = CefValue::Create();
+    value->SetList(CefListValue::Create());
+    SendRequestResult(request_id, value);
+    return;
+  }
+  std::vector<uint8_t> jpeg(binary->GetSize());
+  binary->GetData(jpeg.data(), jpeg.size(), 0);
+  int max_results = args->GetType(2) == VTYPE_INT ? std::max(1, args->GetInt(2)) : 10;
+  CefPostTask(TID_FILE_USER_VISIBLE,
+              base::BindOnce(&ClientHandler::SearchFrames, this, frame_index_,
+                             std::move(jpeg), max_results, request_id));
+}
 
-      content_browser_->GetHost()->ExecuteDevToolsMethod(0, "Page.startScreencast", params);
-    }
-    return true;
+void ClientHandler::HandleScreencastFrameConsumed(CefRefPtr<CefBrowser> browser,
+                                                  CefRefPtr<CefProcessMessage> message) {
+  // The UI has drawn a frame forwarded in "renderer" mode
+  OnUIFrameConsumed();
+}
+
+void ClientHandler::HandleOpenRecordingSession(CefRefPtr<CefBrowser> browser,
+                                               CefRefPtr<CefProcessMessage> message) {
+  std::string meeting_id = message->GetArgumentList()->GetString(0);
+  if (recording_writer_ && recording_writer_->IsOpen()) {
+    std::cerr << "[Browser] Recording session for meeting " << recording_meeting_id_
+              << " was not finalized; closing it" << std::endl;
+    CloseRecordingSession();
   }
 
-  if (message_name == "stop_recording") {
-    std::cout << "[Browser] Stop recording request" << std::endl;
-    if (content_browser_) {
-      content_browser_->GetHost()->ExecuteDevToolsMethod(0, "Page.stopScreencast", nullptr);
+  // The writer thread does all file I/O; only pointers are queued here
+  if (!recording_writer_) {
+    recording_writer_.reset(new RecordingWriter());
+  }
 
-      // Remove observer by resetting the registration
-      devtools_registration_ = nullptr;
-    }
-    return true;
+  std::string filename = MakeRecordingPath(meeting_id, "webm");
+  recording_writer_->Open(filename, meeting_id);
+  recording_meeting_id_ = meeting_id;
+  recording_next_sequence_ = 0;
+  recording_started_ = std::chrono::steady_clock::now();
+  recording_committed_ms_ = 0;
+  std::cout << "[Browser] Streaming recording to: " << filename << std::endl;
+}
+
+void ClientHandler::HandleAppendRecordingChunk(CefRefPtr<CefBrowser> browser,
+                                               CefRefPtr<CefProcessMessage> message) {
+  if (!recording_writer_ || !recording_writer_->IsOpen()) {
+    std::cerr << "[Browser] Recording chunk received without an open session" << std::endl;
+    return;
   }
 
-  if (message_name == "save_recording_chunk") {
+  // Locate the raw chunk bytes without copying them
+  std::unique_ptr<RecordingChunkBuffer> chunk(new RecordingChunkBuffer(message));
+  uint32_t sequence = 0;
+
+  CefRefPtr<CefSharedMemoryRegion> region = message->GetSharedMemoryRegion();
+  if (region && region->IsValid()) {
+    RecordingChunkHeader header;
+    if (region->Size() < sizeof(header)) {
+      return;
+    }
+    memcpy(&header, region->Memory(), sizeof(header));
+    if (header.magic != kRecordingChunkMagic ||
+        header.size > region->Size() - sizeof(header)) {
+      std::cerr << "[Browser] Malformed recording chunk" << std::endl;
+      return;
+    }
+    chunk->SetData(region, static_cast<const char*>(region->Memory()) + sizeof(header),
+                   static_cast<size_t>(header.size));
+    sequence = header.sequence;
+  } else {
     CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string data_base64 = args->GetString(0);
-    bool is_last = args->GetBool(1);
-
-    if (!recording_file_.is_open()) {
-      // Create recordings directory
-      std::string docs_dir = GetDocumentsDirectory();
-      std::cout << "[Browser] Documents directory: " << docs_dir << std::endl;
-      
-      std::string recordings_dir;
-
-      #ifdef _WIN32
-        std::string app_dir = docs_dir + "\\Rebraze";
-        recordings_dir = app_dir + "\\Recordings";
-        if (_mkdir(app_dir.c_str()) != 0 && errno != EEXIST) {
-             std::cerr << "[Browser] Failed to create app dir: " << app_dir << " Error: " << strerror(errno) << std::endl;
-        }
-        if (_mkdir(recordings_dir.c_str()) != 0 && errno != EEXIST) {
-             std::cerr << "[Browser] Failed to create recordings dir: " << recordings_dir << " Error: " << strerror(errno) << std::endl;
-        }
-      #else
-        std::string app_dir = docs_dir + "/Rebraze";
-        recordings_dir = app_dir + "/Recordings";
-        if (mkdir(app_dir.c_str(), 0755) != 0 && errno != EEXIST) {
-            std::cerr << "[Browser] Failed to create app dir: " << app_dir << " Error: " << strerror(errno) << std::endl;
-        }
-        if (mkdir(recordings_dir.c_str(), 0755) != 0 && errno != EEXIST) {
-            std::cerr << "[Browser] Failed to create recordings dir: " << recordings_dir << " Error: " << strerror(errno) << std::endl;
-        }
-      #endif
+    CefRefPtr<CefBinaryValue> binary = args->GetBinary(0);
+    if (binary) {
+      chunk->SetData(binary, binary->GetRawData(), binary->GetSize());
+    }
+    sequence = static_cast<uint32_t>(args->GetInt(1));
+  }
+
+  // Process messages arrive in order, so anything else is a renderer bug.
+  // Skip replays; a gap is logged but the following chunks are still kept.
+  if (sequence < recording_next_sequence_) {
+    std::cerr << "[Browser] Dropping duplicate recording chunk " << sequence << std::endl;
+    return;
+  }
+  if (sequence > recording_next_sequence_) {
+    std::cerr << "[Browser] Recording chunks " << recording_next_sequence_ << "-"
+              << (sequence - 1) << " are missing" << std::endl;
+  }
+  recording_next_sequence_ = sequence + 1;
+
+  recording_writer_->Write(std::move(chunk));
+
+  // Segment boundaries fall between chunks
+  int64_t elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - recording_started_).count();
+  if (elapsed_ms - recording_committed_ms_ >= kRecordingSegmentMs) {
+    recording_writer_->CommitSegment(recording_committed_ms_, elapsed_ms);
+    recording_committed_ms_ = elapsed_ms;
+  }
+}
 
-      // Generate filename with meeting ID and timestamp
-      std::time_t t = std::time(nullptr);
-      char timestamp[50];
-      std::strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", std::localtime(&t));
+void ClientHandler::HandleFinalizeRecordingSession(CefRefPtr<CefBrowser> browser,
+                                                   CefRefPtr<CefProcessMessage> message) {
+  if (!recording_writer_ || !recording_writer_->IsOpen()) {
+    return;
+  }
+
+  uint32_t chunk_count = static_cast<uint32_t>(message->GetArgumentList()->GetInt(0));
+  if (chunk_count != recording_next_sequence_) {
+    std::cerr << "[Browser] Recording finalized after " << recording_next_sequence_
+              << " of " << chunk_count << " chunks" << std::endl;
+  }
+  CloseRecordingSession();
+}
+
+bool ClientHandler::OnDevToolsMessage(CefRefPtr<CefBrowser> browser, const void* message, size_t message_size) {
+  return false; // Default handling
+}
+
+void ClientHandler::OnDevToolsMethodResult(CefRefPtr<CefBrowser> browser, int message_id, bool success, const void* result, size_t result_size) {
+  // Optional: handle result
+}
+
+void ClientHandler::OnDevToolsEvent(CefRefPtr<CefBrowser> browser, const CefString& method, const void* params, size_t params_size) {
+  if (method == "Page.screencastFrame") {
+    // Locate the fields in place; only unusual payloads go through the DOM
+    ScreencastFrameView frame;
+    std::string data;
+    if (!ParseScreencastFrame(params, params_size, frame) &&
+        !ParseScreencastFrameWithDom(params, params_size, data, frame)) {
+      return;
+    }
 
-      std::string filename = recordings_dir + "/meeting_" + current_meeting_id_ + "_" + timestamp + ".webm";
-      current_recording_path_ = filename;
+    double timestamp = frame.has_timestamp
+                           ? frame.timestamp
+                           : std::chrono::duration<double>(
+                                 std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // The replay ring takes every frame, decoded straight into its arena;
+    // the oldest frames make room. The decoded JPEG stays valid until the
+    // next BeginFrame() on this thread.
+    const uint8_t* decoded = nullptr;
+    size_t decoded_size = 0;
+    if (frame.data_size > 0 && replay_buffer_) {
+      uint8_t* jpeg = replay_buffer_->BeginFrame(Base64DecodedMaxSize(frame.data_size));
+      if (jpeg && Base64Decode(frame.data, frame.data_size, jpeg, &decoded_size)) {
+        replay_buffer_->CommitFrame(decoded_size, timestamp);
+        decoded = jpeg;
+      }
+    }
 
-      recording_file_.open(filename, std::ios::binary);
-      if (recording_file_.is_open()) {
-        std::cout << "[Browser] Started saving recording to: " << filename << std::endl;
+    // Decoded at most once: the frame bus gets its own copy of the replay
+    // bytes (the ring overwrites them later), or decodes the frame itself,
+    // and only if a subscriber takes it
+    bool consumed_later = false;
+    if (frame.data_size > 0 && frame_bus_.WantsFrame(timestamp)) {
+      ByteBuffer jpeg;
+      bool ok = true;
+      if (decoded) {
+        jpeg = frame_bus_.AcquireBuffer(decoded_size);
+        memcpy(jpeg.data(), decoded, decoded_size);
       } else {
-        std::cerr << "[Browser] Failed to open recording file: " << filename << " Error: " << strerror(errno) << std::endl;
+        jpeg = frame_bus_.AcquireBuffer(Base64DecodedMaxSize(frame.data_size));
+        size_t jpeg_size = 0;
+        ok = Base64Decode(frame.data, frame.data_size, jpeg.data(), &jpeg_size);
+        jpeg.resize(jpeg_size);
+      }
+      if (ok) {
+        int generation = screencast_generation_;
+        consumed_later = frame_bus_.Publish(std::move(jpeg), timestamp,
+                                            [this, generation](bool dropped) {
+          CefPostTask(TID_UI, base::BindOnce(&ClientHandler::OnScreencastFrameReleased, this,
+                                             generation, dropped));
+        });
       }
     }
 
-    if (recording_file_.is_open()) {
-      CefRefPtr<CefBinaryValue> data = CefBase64Decode(data_base64);
-      if (data) {
-        size_t size = data->GetSize();
-        char* buffer = new char[size];
-        data->GetData(buffer, size, 0);
-        recording_file_.write(buffer, size);
-        delete[] buffer;
+    if (frame.has_session_id) {
+      // Ack only once the consumers let go of the frame so Chromium throttles
+      // capture
+      if (!consumed_later || !screencast_active_ ||
+          screencast_controller_.OnFrameReceived(frame.session_id)) {
+        AckScreencastFrame(frame.session_id);
       }
     }
+  }
+}
+
+void ClientHandler::NotifyRecordingSaved(const std::string& meeting_id,
+                                         const std::string& recording_path) {
+  CEF_REQUIRE_UI_THREAD();
 
-    if (is_last) {
-      if (recording_file_.is_open()) {
-        recording_file_.close();
-        std::cout << "[Browser] Finished saving recording to: " << current_recording_path_ << std::endl;
-
-        // Send recording path back to UI browser
-        if (ui_browser_) {
-          CefRefPtr<CefProcessMessage> msg = CefProcessMessage::Create("recording_saved");
-          msg->GetArgumentList()->SetString(0, current_meeting_id_);
-          msg->GetArgumentList()->SetString(1, current_recording_path_);
-          ui_browser_->GetMainFrame()->SendProcessMessage(PID_RENDERER, msg);
+  std::cout << "[Browser] Recording saved: " << recording_path << std::endl;
+
+  CefRefPtr<CefDictionaryValue> payload = CefDictionaryValue::Create();
+  payload->SetString("meetingId", meeting_id);
+  payload->SetString("recordingPath", recording_path);
+  PublishEvent("recordingSaved", payload);
+
+  UpdateFrameIndex();
+  GenerateRecordingPreviews(recording_path, 0);
+}
+
+void ClientHandler::GenerateRecordingPreviews(const std::string& recording_path,
+                                              int request_id) {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (!thumbnail_service_) {
+    return;
+  }
+  thumbnail_service_->Generate(
+      recording_path,
+      [this, request_id](const std::string& path, const ThumbnailService::Previews& previews) {
+        // None for recordings without decodable frames (VP8/VP9, WebM)
+        CefRefPtr<CefDictionaryValue> dict;
+        if (previews.tile_count > 0) {
+          dict = CefDictionaryValue::Create();
+          dict->SetString("poster", previews.poster_path);
+          dict->SetString("sprite", previews.sprite_path);
+          dict->SetString("index", previews.index_path);
+          dict->SetInt("tileCount", previews.tile_count);
         }
+        CefPostTask(TID_UI, base::BindOnce(&ClientHandler::SendRecordingPreviews, this, path,
+                                           request_id, dict));
+      });
+}
 
-        // Clear recording state
-        current_recording_path_.clear();
-        current_meeting_id_.clear();
-      }
+void ClientHandler::SendRecordingPreviews(const std::string& recording_path,
+                                          int request_id,
+                                          CefRefPtr<CefDictionaryValue> previews) {
+  CEF_REQUIRE_UI_THREAD();
+
+  CefRefPtr<CefValue> value = CefValue::Create();  // null without previews
+  if (previews) {
+    value->SetDictionary(previews);
+  }
+
+  if (request_id != 0) {
+    SendRequestResult(request_id, value);
+  } else {
+    CefRefPtr<CefDictionaryValue> payload = CefDictionaryValue::Create();
+    payload->SetString("recordingPath", recording_path);
+    payload->SetValue("previews", value);
+    PublishEvent("recordingPreviews", payload);
+  }
+}
+
+void ClientHandler::CloseRecordingSession() {
+  // The writer flushes and closes on its own thread; report back on the UI thread
+  std::string meeting_id = recording_meeting_id_;
+  recording_writer_->Close([this, meeting_id](const std::string& path, bool success) {
+    if (success) {
+      CefPostTask(TID_FILE_USER_VISIBLE, base::BindOnce(&ClientHandler::FinishRecording,
+                                                        this, meeting_id, path));
+    } else {
+      std::cerr << "[Browser] Failed to save recording: " << path << std::endl;
     }
-    return true;
+  });
+  recording_meeting_id_.clear();
+  recording_next_sequence_ = 0;
+}
+
+void ClientHandler::RecoverInterruptedRecordings(std::time_t launch_time) {
+  std::vector<RecoveredRecording> recovered =
+      RecoverRecordings(GetRecordingsDirectory(), launch_time);
+  for (const RecoveredRecording& recording : recovered) {
+    FinishRecording(recording.meeting_id, recording.path);
   }
+}
 
-  return false;
+void ClientHandler::FinishRecording(const std::string& meeting_id,
+                                    const std::string& recording_path) {
+  // MediaRecorder output has no cues; without them the viewer has to read
+  // the whole file to seek. On failure the file is still playable as is.
+  RemuxWebmForSeeking(recording_path, nullptr);
+  CefPostTask(TID_UI, base::BindOnce(&ClientHandler::NotifyRecordingSaved, this,
+                                     meeting_id, recording_path));
 }
 
-bool ClientHandler::OnDevToolsMessage(CefRefPtr<CefBrowser> browser, const void* message, size_t message_size) {
-  return false; // Default handling
+void ClientHandler::SaveReplay(std::shared_ptr<ReplayBuffer> replay_buffer,
+                               const std::string& meeting_id,
+                               const std::string& recording_path) {
+  ReplayBuffer::Stats stats;
+  if (!replay_buffer->Save(recording_path, &stats)) {
+    std::cerr << "[Browser] Failed to save replay: " << recording_path << std::endl;
+    return;
+  }
+  std::cout << "[Browser] Saved replay of " << stats.frames << " frames ("
+            << stats.duration_ms << " ms)" << std::endl;
+  CefPostTask(TID_UI, base::BindOnce(&ClientHandler::NotifyRecordingSaved, this,
+                                     meeting_id, recording_path));
 }
 
-void ClientHandler::OnDevToolsMethodResult(CefRefPtr<CefBrowser> browser, int message_id, bool success, const void* result, size_t result_size) {
-  // Optional: handle result
+void ClientHandler::StopSlideDetection() {
+  UnsubscribeFrames(slides_subscription_);
+  if (slide_detector_) {
+    // Stop() joins the analyzer thread; keep that off the UI thread. The
+    // finished slides are indexed afterwards.
+    CefPostTask(TID_FILE_USER_VISIBLE,
+                base::BindOnce(
+                    [](std::unique_ptr<SlideDetector> detector,
+                       std::shared_ptr<FrameIndex> frame_index) {
+                      detector->Stop();
+                      if (frame_index) {
+                        CefPostTask(TID_FILE_BACKGROUND,
+                                    base::BindOnce(
+                                        [](std::shared_ptr<FrameIndex> frame_index) {
+                                          frame_index->Update();
+                                        },
+                                        frame_index));
+                      }
+                    },
+                    std::move(slide_detector_), frame_index_));
+  }
 }
 
-void ClientHandler::OnDevToolsEvent(CefRefPtr<CefBrowser> browser, const CefString& method, const void* params, size_t params_size) {
-  if (method == "Page.screencastFrame") {
-    CefRefPtr<CefValue> value = CefParseJSON(CefString(static_cast<const char*>(params), params_size), JSON_PARSER_RFC);
-    if (value && value->IsValid() && value->GetType() == VTYPE_DICTIONARY) {
-      CefRefPtr<CefDictionaryValue> dict = value->GetDictionary();
-      if (dict->HasKey("data")) {
-        std::string data = dict->GetString("data");
-        if (ui_browser_) {
-           CefRefPtr<CefProcessMessage> msg = CefProcessMessage::Create("screencast_frame");
-           msg->GetArgumentList()->SetString(0, data);
-           ui_browser_->GetMainFrame()->SendProcessMessage(PID_RENDERER, msg);
+void ClientHandler::StartCropTracking(const std::string& selector) {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (!content_browser_) {
+    return;
+  }
+  CefRefPtr<CefValue> value = CefValue::Create();
+  value->SetString(selector);
+  std::string selector_json = CefWriteJSON(value, JSON_WRITER_DEFAULT).ToString();
+
+  // Size changes come from a ResizeObserver; moves, and the element being
+  // replaced when the meeting layout changes, are caught by a slow poll.
+  // Only changed rects are reported, as fractions of the viewport.
+  std::string js_code = R"(
+    (function(selector) {
+      if (window.__rebrazeCropTracker) {
+        window.__rebrazeCropTracker.stop();
+      }
+      var observed = null;
+      var last = '';
+      var observer = new ResizeObserver(report);
+      function report() {
+        var element = document.querySelector(selector);
+        if (element !== observed) {
+          observer.disconnect();
+          observed = element;
+          if (element) {
+            observer.observe(element);
+          }
+        }
+        var rect = [0, 0, 1, 1];
+        if (element) {
+          var bounds = element.getBoundingClientRect();
+          var width = window.innerWidth;
+          var height = window.innerHeight;
+          if (bounds.width > 0 && bounds.height > 0 && width > 0 && height > 0) {
+            rect = [bounds.left / width, bounds.top / height,
+                    bounds.width / width, bounds.height / height];
+          }
+        }
+        var key = rect.join(',');
+        if (key !== last && window.rebrazeAuth && window.rebrazeAuth.reportRecordingCrop) {
+          last = key;
+          window.rebrazeAuth.reportRecordingCrop(rect[0], rect[1], rect[2], rect[3]);
         }
       }
-      
-      if (dict->HasKey("sessionId")) {
-         int sessionId = dict->GetInt("sessionId");
-         CefRefPtr<CefDictionaryValue> ackParams = CefDictionaryValue::Create();
-         ackParams->SetInt("sessionId", sessionId);
+      var poll = setInterval(report, 1000);
+      window.addEventListener('resize', report);
+      window.__rebrazeCropTracker = {
+        stop: function() {
+          clearInterval(poll);
+          window.removeEventListener('resize', report);
+          observer.disconnect();
+          window.__rebrazeCropTracker = null;
+        }
+      };
+      report();
+    })()" + selector_json + ");";
+
+  crop_tracking_ = true;
+  content_browser_->GetMainFrame()->ExecuteJavaScript(js_code, "", 0);
+  std::cout << "[Browser] Tracking recording crop element: " << selector << std::endl;
+}
+
+void ClientHandler::StopCropTracking() {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (!crop_tracking_) {
+    return;
+  }
+  crop_tracking_ = false;
+  if (content_browser_) {
+    content_browser_->GetMainFrame()->ExecuteJavaScript(
+        "if (window.__rebrazeCropTracker) { window.__rebrazeCropTracker.stop(); }", "", 0);
+  }
+}
 
-         browser->GetHost()->ExecuteDevToolsMethod(0, "Page.screencastFrameAck", ackParams);
+void ClientHandler::StartParticipantAgent() {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (!content_browser_) {
+    return;
+  }
+
+  // The agent opens the People panel once the meeting UI is up, then
+  // observes only the participant list container (Google Meet list, then
+  // Zoom) and reports the difference to its last read. A mutation defers
+  // the read by 300 ms; further mutations in that window join it. A slow
+  // poll finds the container again once it is detached, e.g. when the
+  // panel is closed. Without a container the roster is kept, unless the
+  // meeting UI itself is gone; an empty container means nobody is left.
+  std::string js_code = R"(
+    (function() {
+      if (window.__rebrazeParticipantAgent) {
+        return;
+      }
+      var kNameSelector =
+          'div[role="listitem"], span.zWGUib, .participants-item__display-name';
+      var roster = {};
+      var container = null;
+      var timer = null;
+      var opened = false;
+      function readNames() {
+        var found = [];
+        container.querySelectorAll('div[role="listitem"]').forEach(function(el) {
+          var name = el.getAttribute('aria-label');
+          if (name && name.trim()) {
+            found.push(name.trim());
+          }
+        });
+        if (found.length === 0) {
+          container.querySelectorAll('span.zWGUib').forEach(function(el) {
+            var name = el.textContent;
+            if (name && name.trim()) {
+              found.push(name.trim());
+            }
+          });
+        }
+        if (found.length === 0) {
+          container.querySelectorAll('.participants-item__display-name').forEach(function(el) {
+            var name = el.textContent;
+            if (name && name.trim()) {
+              found.push(name.trim());
+            }
+          });
+        }
+        return found;
+      }
+      function findPeopleButton() {
+        var buttons = document.querySelectorAll('button');
+        for (var i = 0; i < buttons.length; i++) {
+          var btn = buttons[i];
+          var label = (btn.getAttribute('aria-label') || '').toLowerCase();
+          if (label.includes('people') || label.includes('participant') ||
+              label.includes('everyone')) {
+            return btn;
+          }
+          var icon = btn.querySelector('i.google-symbols');
+          if (icon && icon.textContent && icon.textContent.trim() === 'people') {
+            return btn;
+          }
+        }
+        return null;
+      }
+      function findContainer() {
+        var item = document.querySelector(kNameSelector);
+        if (!item) {
+          return null;
+        }
+        return item.closest('[role="list"], ul') || item.parentElement;
+      }
+      function update(names) {
+        var counts = {};
+        names.forEach(function(name) {
+          counts[name] = (counts[name] || 0) + 1;
+        });
+        var joined = [];
+        var left = [];
+        Object.keys(counts).forEach(function(name) {
+          for (var i = roster[name] || 0; i < counts[name]; i++) {
+            joined.push(name);
+          }
+        });
+        Object.keys(roster).forEach(function(name) {
+          for (var i = counts[name] || 0; i < roster[name]; i++) {
+            left.push(name);
+          }
+        });
+        roster = counts;
+        if ((joined.length || left.length) && window.rebrazeAuth &&
+            window.rebrazeAuth.participantsChanged) {
+          window.rebrazeAuth.participantsChanged(joined, left);
+        }
+      }
+      function sync() {
+        timer = null;
+        if (container && container.isConnected) {
+          update(readNames());
+        }
+      }
+      function schedule() {
+        if (timer === null) {
+          timer = setTimeout(sync, 300);
+        }
+      }
+      var observer = new MutationObserver(schedule);
+      function attach() {
+        if (container && container.isConnected) {
+          return;
+        }
+        observer.disconnect();
+        container = findContainer();
+        if (container) {
+          observer.observe(container, {
+            childList: true,
+            subtree: true,
+            characterData: true,
+            attributes: true,
+            attributeFilter: ['aria-label']
+          });
+          sync();
+          return;
+        }
+        var button = findPeopleButton();
+        if (!button) {
+          update([]);
+        } else if (!opened) {
+          opened = true;
+          button.click();
+        }
       }
+      attach();
+      window.__rebrazeParticipantAgent = setInterval(attach, 1000);
+    })();
+  )";
+
+  content_browser_->GetMainFrame()->ExecuteJavaScript(js_code, "", 0);
+}
+
+void ClientHandler::ResetParticipants() {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (participants_.empty()) {
+    return;
+  }
+  CefRefPtr<CefListValue> left = CefListValue::Create();
+  for (size_t i = 0; i < participants_.size(); i++) {
+    left->SetString(i, participants_[i]);
+  }
+  participants_.clear();
+
+  CefRefPtr<CefDictionaryValue> payload = CefDictionaryValue::Create();
+  payload->SetList("joined", CefListValue::Create());
+  payload->SetList("left", left);
+  PublishEvent("participants", payload);
+}
+
+void ClientHandler::UpdateFrameIndex() {
+  CEF_REQUIRE_UI_THREAD();
+
+  // The background file thread runs one update at a time
+  if (frame_index_) {
+    CefPostTask(TID_FILE_BACKGROUND,
+                base::BindOnce([](std::shared_ptr<FrameIndex> frame_index) {
+                  frame_index->Update();
+                }, frame_index_));
+  }
+}
+
+void ClientHandler::SearchFrames(std::shared_ptr<FrameIndex> frame_index,
+                                 std::vector<uint8_t> jpeg,
+                                 int max_results,
+                                 int request_id) {
+  const int kMaxDistance = 20;  // Of 64 bits; further is a different picture
+
+  CefRefPtr<CefListValue> results = CefListValue::Create();
+  LumaImage image;
+  if (DecodeJpegDcLuma(jpeg.data(), jpeg.size(), image)) {
+    std::vector<FrameMatch> matches = frame_index->Search(
+        ComputeDifferenceHash(image), static_cast<size_t>(max_results), kMaxDistance);
+    for (size_t i = 0; i < matches.size(); i++) {
+      CefRefPtr<CefDictionaryValue> match = CefDictionaryValue::Create();
+      match->SetString("path", matches[i].path);
+      match->SetDouble("offsetMs", static_cast<double>(matches[i].offset_ms));
+      match->SetInt("distance", matches[i].distance);
+      results->SetDictionary(i, match);
     }
+  } else {
+    std::cerr << "[Browser] search_frames: not a baseline JPEG" << std::endl;
+  }
+
+  CefRefPtr<CefValue> value = CefValue::Create();
+  value->SetList(results);
+  CefPostTask(TID_UI, base::BindOnce(&ClientHandler::SendRequestResult, this, request_id, value));
+}
+
+void ClientHandler::SendRequestResult(int request_id, CefRefPtr<CefValue> result) {
+  CEF_REQUIRE_UI_THREAD();
+
+  CefRefPtr<CefBrowser> target = GetMessageTarget();
+  if (target) {
+    CefRefPtr<CefProcessMessage> msg = CefProcessMessage::Create("request_result");
+    msg->GetArgumentList()->SetInt(0, request_id);
+    msg->GetArgumentList()->SetValue(1, result);
+    target->GetMainFrame()->SendProcessMessage(PID_RENDERER, msg);
+  }
+}
+
+void ClientHandler::SendRequestError(int request_id, const std::string& error) {
+  CEF_REQUIRE_UI_THREAD();
+
+  CefRefPtr<CefBrowser> target = GetMessageTarget();
+  if (target) {
+    CefRefPtr<CefProcessMessage> msg = CefProcessMessage::Create("request_result");
+    msg->GetArgumentList()->SetInt(0, request_id);
+    msg->GetArgumentList()->SetNull(1);
+    msg->GetArgumentList()->SetString(2, error);
+    target->GetMainFrame()->SendProcessMessage(PID_RENDERER, msg);
+  }
+}
+
+void ClientHandler::PublishEvent(const std::string& topic,
+                                 CefRefPtr<CefDictionaryValue> payload) {
+  CEF_REQUIRE_UI_THREAD();
+
+  CefRefPtr<CefBrowser> target = GetMessageTarget();
+  if (target) {
+    CefRefPtr<CefProcessMessage> msg = CefProcessMessage::Create("event");
+    msg->GetArgumentList()->SetString(0, topic);
+    msg->GetArgumentList()->SetDictionary(1, payload);
+    target->GetMainFrame()->SendProcessMessage(PID_RENDERER, msg);
+  }
+}
+
+CefRefPtr<CefBrowser> ClientHandler::GetMessageTarget() {
+  return ui_browser_ ? ui_browser_ : GetBrowser();
+}
+
+void ClientHandler::StartScreencastCapture() {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (!content_browser_) {
+    return;
+  }
+  if (!devtools_registration_) {
+    devtools_registration_ = content_browser_->GetHost()->AddDevToolsMessageObserver(this);
+  }
+  StartScreencast();
+}
+
+void ClientHandler::StopScreencastCaptureIfUnused() {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (frame_bus_.HasSubscribers() || replay_buffer_ || !content_browser_) {
+    return;
+  }
+  content_browser_->GetHost()->ExecuteDevToolsMethod(0, "Page.stopScreencast", nullptr);
+  screencast_active_ = false;
+  screencast_generation_++;
+
+  // Remove observer by resetting the registration
+  devtools_registration_ = nullptr;
+}
+
+void ClientHandler::StartScreencast() {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (!screencast_active_) {
+    screencast_controller_.Reset();
+    screencast_active_ = true;
+    CefPostDelayedTask(TID_UI, base::BindOnce(&ClientHandler::UpdateScreencast, this,
+                                              ++screencast_generation_), 1000);
+  }
+
+  const ScreencastController::Settings& settings = screencast_controller_.GetSettings();
+  CefRefPtr<CefDictionaryValue> params = CefDictionaryValue::Create();
+  params->SetString("format", "jpeg");
+  params->SetInt("quality", settings.quality);
+  if (settings.max_width > 0) {
+    params->SetInt("maxWidth", settings.max_width);
+    params->SetInt("maxHeight", settings.max_height);
+  }
+  params->SetInt("everyNthFrame", settings.every_nth_frame);
+
+  // Calling startScreencast again while capturing just updates the settings
+  content_browser_->GetHost()->ExecuteDevToolsMethod(0, "Page.startScreencast", params);
+}
+
+void ClientHandler::AckScreencastFrame(int session_id) {
+  if (!content_browser_) {
+    return;
+  }
+  CefRefPtr<CefDictionaryValue> params = CefDictionaryValue::Create();
+  params->SetInt("sessionId", session_id);
+  content_browser_->GetHost()->ExecuteDevToolsMethod(0, "Page.screencastFrameAck", params);
+}
+
+void ClientHandler::OnScreencastFrameConsumed(bool dropped) {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (!screencast_active_) {
+    return;
+  }
+  int session_id = screencast_controller_.OnFrameConsumed(dropped);
+  if (session_id >= 0) {
+    AckScreencastFrame(session_id);
+  }
+}
+
+void ClientHandler::OnScreencastFrameReleased(int generation, bool dropped) {
+  CEF_REQUIRE_UI_THREAD();
+
+  // The controller has forgotten frames from before a restart
+  if (generation == screencast_generation_) {
+    OnScreencastFrameConsumed(dropped);
+  }
+}
+
+void ClientHandler::SubscribeRecordingFrames() {
+  CEF_REQUIRE_UI_THREAD();
+
+  UnsubscribeFrames(recorder_subscription_);
+  UnsubscribeFrames(ui_subscription_);
+  if (screencast_recorder_ && screencast_recorder_->IsRecording()) {
+    // Native recording: the recorder queues and drops frames itself
+    ScreencastRecorder* recorder = screencast_recorder_.get();
+    recorder_subscription_ = frame_bus_.Subscribe(
+        "Recorder", FrameBus::Options(), [recorder](const FrameRef& frame) {
+          recorder->AddFrame(frame);
+        });
+  } else if (ui_browser_) {
+    // Renderer mode: one frame is with the UI renderer and the newest waits
+    FrameBus::Options options;
+    options.drop_policy = FrameBus::DropPolicy::kLatestOnly;
+    options.max_in_flight = 1;
+    ui_subscription_ = frame_bus_.Subscribe("UI preview", options,
+                                            [this](const FrameRef& frame) { SendFrameToUI(frame); });
+  }
+}
+
+void ClientHandler::UnsubscribeFrames(int& subscription) {
+  if (subscription != 0) {
+    frame_bus_.Unsubscribe(subscription);
+    subscription = 0;
+  }
+}
+
+void ClientHandler::SendFrameToUI(const FrameRef& frame) {
+  CEF_REQUIRE_UI_THREAD();
+
+  CefRefPtr<CefProcessMessage> message =
+      ui_browser_ ? CreateScreencastFrameMessage(*frame) : nullptr;
+  if (!message) {
+    frame_bus_.Done(ui_subscription_);
+    return;
+  }
+  ui_browser_->GetMainFrame()->SendProcessMessage(PID_RENDERER, message);
+}
+
+void ClientHandler::OnUIFrameConsumed() {
+  CEF_REQUIRE_UI_THREAD();
+
+  frame_bus_.Done(ui_subscription_);
+}
+
+void ClientHandler::UpdateScreencast(int generation) {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (!screencast_active_ || generation != screencast_generation_ || !content_browser_) {
+    return;
+  }
+
+  std::vector<int> stalled_acks;
+  bool changed = screencast_controller_.Update(stalled_acks);
+  for (int session_id : stalled_acks) {
+    AckScreencastFrame(session_id);
+  }
+  if (!stalled_acks.empty()) {
+    // The UI never reported its frame (e.g. it reloaded); start over
+    frame_bus_.Reset(ui_subscription_);
   }
+  if (changed) {
+    StartScreencast();
+  }
+
+  CefPostDelayedTask(TID_UI, base::BindOnce(&ClientHandler::UpdateScreencast, this,
+                                            generation), 1000);
 }
 
 void ClientHandler::OnDevToolsAgentAttached(CefRefPtr<CefBrowser> browser) {}
 void ClientHandler::OnDevToolsAgentDetached(CefRefPtr<CefBrowser> browser) {}
 
+void ClientHandler::GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rect) {
+  CEF_REQUIRE_UI_THREAD();
+
+  // The view is never empty, even before the UI has laid out the meeting
+  rect = CefRect(0, 0, std::max(1, last_meeting_width_), std::max(1, last_meeting_height_));
+}
+
+void ClientHandler::OnPopupShow(CefRefPtr<CefBrowser> browser, bool show) {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (!show) {
+    // Repaint the view where the popup was
+    osr_popup_pixels_.clear();
+    osr_popup_rect_ = CefRect();
+    browser->GetHost()->Invalidate(PET_VIEW);
+  }
+}
+
+void ClientHandler::OnPopupSize(CefRefPtr<CefBrowser> browser, const CefRect& rect) {
+  CEF_REQUIRE_UI_THREAD();
+
+  osr_popup_rect_ = rect;
+}
+
+void ClientHandler::OnPaint(CefRefPtr<CefBrowser> browser,
+                            PaintElementType type,
+                            const RectList& dirtyRects,
+                            const void* buffer,
+                            int width,
+                            int height) {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (type == PET_POPUP) {
+    // Kept, since every view paint below the popup covers it again
+    const uint8_t* pixels = static_cast<const uint8_t*>(buffer);
+    osr_popup_pixels_.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+    osr_popup_rect_.width = width;
+    osr_popup_rect_.height = height;
+    PaintOsrPopup();
+    return;
+  }
+
+  PlatformPaintOsrWindow(buffer, width, height, dirtyRects, 0, 0);
+  PaintOsrPopup();
+
+  // The buffer is only valid during this call; the recorder takes a copy.
+  // Paints come at the windowless frame rate at most, and only on damage.
+  if (IsRecordingPaints() && recording_screencast_) {
+    double timestamp =
+        std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    screencast_recorder_->AddRawFrame(buffer, width, height, width * 4, timestamp);
+  }
+}
+
+void ClientHandler::PaintOsrPopup() {
+  if (osr_popup_pixels_.empty()) {
+    return;
+  }
+  RectList popup_rects(1, CefRect(0, 0, osr_popup_rect_.width, osr_popup_rect_.height));
+  PlatformPaintOsrWindow(osr_popup_pixels_.data(), osr_popup_rect_.width,
+                         osr_popup_rect_.height, popup_rects, osr_popup_rect_.x,
+                         osr_popup_rect_.y);
+}
+
+void ClientHandler::OnOffScreenFrameConsumed(bool dropped) {
+  CEF_REQUIRE_UI_THREAD();
+
+  if (!IsRecordingPaints()) {
+    return;
+  }
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now - osr_frame_rate_changed_ < std::chrono::milliseconds(kOsrFrameRateIntervalMs)) {
+    return;
+  }
+
+  // Paint less often while frames pile up in front of the recorder, and
+  // creep back up to the configured rate once it keeps up
+  size_t queued = screencast_recorder_->GetQueueDepth();
+  if (dropped || queued > kMaxOsrQueuedFrames) {
+    SetOsrFrameRate(std::max(kMinOsrFrameRate, osr_frame_rate_ * 3 / 4));
+  } else if (queued == 0) {
+    SetOsrFrameRate(std::min(osr_max_frame_rate_, osr_frame_rate_ + kOsrFrameRateStep));
+  }
+}
+
+void ClientHandler::SetOsrFrameRate(int frame_rate) {
+  if (frame_rate == osr_frame_rate_ || !content_browser_) {
+    return;
+  }
+  content_browser_->GetHost()->SetWindowlessFrameRate(frame_rate);
+  std::cout << "[Browser] Off-screen frame rate: " << osr_frame_rate_ << " -> " << frame_rate
+            << " fps" << std::endl;
+  osr_frame_rate_ = frame_rate;
+  osr_frame_rate_changed_ = std::chrono::steady_clock::now();
+}
+
 void ClientHandler::OpenSystemBrowser(const std::string& url) {
   std::cout << "[Browser] OpenSystemBrowser called for URL: " << url << std::endl;
   PlatformOpenURL(url);
@@ -829,6 +1935,11 @@ void ClientHandler::CreateMeetingView(const std::string& url, int x, int y, int
     last_meeting_y_ = y;
     last_meeting_width_ = width;
     last_meeting_height_ = height;
+
+    if (osr_window_ != kNullWindowHandle) {
+      content_browser_->GetHost()->WasHidden(false);
+      content_browser_->GetHost()->WasResized();
+    }
     
     return;
   }
@@ -888,6 +1999,14 @@ void ClientHandler::CreateMeetingView(const std::string& url, int x, int y, int
   // Browser settings for content view
   CefBrowserSettings browser_settings;
 
+  // Off-screen: the page is painted into a window of ours (OnPaint). With
+  // software compositing (disable-gpu) paints arrive as BGRA in memory.
+  if (osr_enabled_ && PlatformCreateOsrWindow(x, y, width, height)) {
+    window_info.SetAsWindowless(window_info.parent_window);
+    browser_settings.windowless_frame_rate = osr_max_frame_rate_;
+    osr_frame_rate_ = osr_max_frame_rate_;
+  }
+
   std::cout << "[Browser] Creating content browser with URL: " << url << std::endl;
 
   // Create the content browser
@@ -992,6 +2111,9 @@ void ClientHandler::ShowMeetingView() {
 
   std::cout << "[Browser] Showing content browser" << std::endl;
   PlatformShowMeetingView(content_browser_);
+  if (osr_window_ != kNullWindowHandle) {
+    content_browser_->GetHost()->WasHidden(false);
+  }
 }
 
 void ClientHandler::HideMeetingView() {
@@ -1004,6 +2126,9 @@ void ClientHandler::HideMeetingView() {
 
   std::cout << "[Browser] Hiding content browser" << std::endl;
   PlatformHideMeetingView(content_browser_);
+  if (osr_window_ != kNullWindowHandle) {
+    content_browser_->GetHost()->WasHidden(true);
+  }
 }
 
 void ClientHandler::DestroyMeetingView() {
@@ -1057,6 +2182,11 @@ void ClientHandler::UpdateMeetingViewBounds(int x, int y, int width, int height)
     last_meeting_y_ = y;
     last_meeting_width_ = width;
     last_meeting_height_ = height;
+
+    // Off-screen, the view size comes from GetViewRect()
+    if (osr_window_ != kNullWindowHandle) {
+      content_browser_->GetHost()->WasResized();
+    }
   }
 }
 
@@ -0,0 +1,49 @@
+#include "cpu_features.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_FEATURES_X86 1
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(CPU_FEATURES_X86)
+
+bool CpuHasSse41() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 19)) != 0;
+#else
+  return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+bool CpuHasAvx2() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  bool os_saves_ymm = (info[2] & (1 << 27)) != 0 &&  // OSXSAVE
+                      (_xgetbv(0) & 0x6) == 0x6;      // XMM and YMM state
+  if (!os_saves_ymm) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#else
+
+bool CpuHasSse41() {
+  return false;
+}
+
+bool CpuHasAvx2() {
+  return false;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#include "ebml.h"
+
+#include <cstring>
+
+namespace ebml {
+
+void AppendId(std::string& out, uint32_t id) {
+  if (id > 0xFFFFFF) out.push_back(static_cast<char>(id >> 24));
+  if (id > 0xFFFF) out.push_back(static_cast<char>(id >> 16));
+  if (id > 0xFF) out.push_back(static_cast<char>(id >> 8));
+  out.push_back(static_cast<char>(id));
+}
+
+void AppendSize(std::string& out, uint64_t size) {
+  int length = 1;
+  while (length < 8 && size >= (1ULL << (7 * length)) - 1) {
+    length++;
+  }
+  for (int i = length - 1; i >= 0; --i) {
+    uint8_t byte = static_cast<uint8_t>(size >> (8 * i));
+    if (i == length - 1) byte |= static_cast<uint8_t>(0x80 >> (length - 1));
+    out.push_back(static_cast<char>(byte));
+  }
+}
+
+void AppendFixedSize(std::string& out, uint64_t size) {
+  out.push_back(static_cast<char>(0x01));
+  for (int i = 6; i >= 0; --i) {
+    out.push_back(static_cast<char>(size >> (8 * i)));
+  }
+}
+
+void AppendUInt(std::string& out, uint32_t id, uint64_t value) {
+  int length = 1;
+  while (length < 8 && (value >> (8 * length)) != 0) {
+    length++;
+  }
+  AppendId(out, id);
+  AppendSize(out, length);
+  for (int i = length - 1; i >= 0; --i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void AppendFloat(std::string& out, uint32_t id, double value) {
+  char bytes[8];
+  EncodeFloat(value, bytes);
+  AppendId(out, id);
+  AppendSize(out, 8);
+  out.append(bytes, sizeof(bytes));
+}
+
+void AppendString(std::string& out, uint32_t id, const std::string& value) {
+  AppendId(out, id);
+  AppendSize(out, value.size());
+  out.append(value);
+}
+
+void AppendMaster(std::string& out, uint32_t id, const std::string& payload) {
+  AppendId(out, id);
+  AppendSize(out, payload.size());
+  out.append(payload);
+}
+
+void AppendVoid(std::string& out, size_t total) {
+  AppendId(out, kVoid);
+  if (total < 9) {
+    AppendSize(out, total - 2);
+    out.append(total - 2, '\0');
+  } else {
+    AppendFixedSize(out, total - 9);
+    out.append(total - 9, '\0');
+  }
+}
+
+void EncodeFloat(double value, char bytes[8]) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; ++i) {
+    bytes[i] = static_cast<char>(bits >> (8 * (7 - i)));
+  }
+}
+
+int ReadVarInt(const uint8_t* data, size_t size, bool keep_marker, uint64_t& value) {
+  if (size == 0 || data[0] == 0) {
+    return 0;
+  }
+  int length = 1;
+  while (!(data[0] & (0x80 >> (length - 1)))) {
+    length++;
+  }
+  if (static_cast<size_t>(length) > size) {
+    return 0;
+  }
+  value = keep_marker ? data[0] : data[0] & (0xFF >> length);
+  for (int i = 1; i < length; ++i) {
+    value = (value << 8) | data[i];
+  }
+  return length;
+}
+
+bool IsUnknownSize(uint64_t value, int length) {
+  return value == (1ULL << (7 * length)) - 1;
+}
+
+}  // namespace ebml
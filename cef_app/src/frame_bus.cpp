@@ -0,0 +1,233 @@
+#include "frame_bus.h"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+ScreencastFrame::ScreencastFrame(ByteBuffer jpeg, double timestamp,
+                                 std::shared_ptr<BufferPool> pool, ReleaseCallback on_release)
+    : jpeg_(std::move(jpeg)),
+      timestamp_(timestamp),
+      pool_(std::move(pool)),
+      on_release_(std::move(on_release)),
+      dropped_(false) {}
+
+ScreencastFrame::~ScreencastFrame() {
+  pool_->Release(std::move(jpeg_));
+  if (on_release_) {
+    on_release_(dropped_);
+  }
+}
+
+const LumaImage* ScreencastFrame::GetDcLuma() const {
+  std::call_once(dc_luma_once_, [this] {
+    std::unique_ptr<LumaImage> image(new LumaImage());
+    if (DecodeJpegDcLuma(jpeg_.data(), jpeg_.size(), *image)) {
+      dc_luma_ = std::move(image);
+    }
+  });
+  return dc_luma_.get();
+}
+
+FrameBus::FrameBus(size_t pooled_buffers)
+    : pool_(std::make_shared<BufferPool>(pooled_buffers)), next_id_(1) {}
+
+int FrameBus::Subscribe(const std::string& name, const Options& options, Callback callback) {
+  std::lock_guard<std::mutex> guard(lock_);
+  Subscriber subscriber;
+  subscriber.id = next_id_++;
+  subscriber.name = name;
+  subscriber.options = options;
+  subscriber.callback = std::move(callback);
+  subscribers_.push_back(std::move(subscriber));
+  return subscribers_.back().id;
+}
+
+void FrameBus::Unsubscribe(int id) {
+  // Frames are released outside the lock; their release callbacks may
+  // call back into the bus
+  std::deque<FrameRef> released;
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    auto it = std::find_if(subscribers_.begin(), subscribers_.end(),
+                           [id](const Subscriber& subscriber) { return subscriber.id == id; });
+    if (it == subscribers_.end()) {
+      return;
+    }
+    std::cout << "[FrameBus] " << it->name << ": " << it->delivered << " frames, "
+              << it->dropped << " dropped" << std::endl;
+    released.swap(it->in_flight);
+    for (FrameRef& frame : it->queued) {
+      frame->MarkDropped();
+      released.push_back(std::move(frame));
+    }
+    subscribers_.erase(it);
+
+    // No new delivery can start now; let the running ones finish
+    delivery_done_.wait(guard, [this, id] { return !IsDeliveringElsewhere(id); });
+  }
+}
+
+void FrameBus::Done(int id) {
+  FrameRef finished;
+  FrameRef next;
+  Callback callback;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    Subscriber* subscriber = Find(id);
+    if (!subscriber || subscriber->in_flight.empty()) {
+      return;
+    }
+    finished = std::move(subscriber->in_flight.front());
+    subscriber->in_flight.pop_front();
+    if (!subscriber->queued.empty()) {
+      next = std::move(subscriber->queued.front());
+      subscriber->queued.pop_front();
+      subscriber->in_flight.push_back(next);
+      subscriber->delivered++;
+      callback = subscriber->callback;
+      deliveries_.push_back(Delivery{id, std::this_thread::get_id()});
+    }
+  }
+  if (next) {
+    Deliver(id, callback, next);
+  }
+}
+
+void FrameBus::Reset(int id) {
+  std::deque<FrameRef> released;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    Subscriber* subscriber = Find(id);
+    if (!subscriber) {
+      return;
+    }
+    released.swap(subscriber->in_flight);
+    for (FrameRef& frame : subscriber->queued) {
+      frame->MarkDropped();
+      released.push_back(std::move(frame));
+    }
+    subscriber->queued.clear();
+  }
+}
+
+bool FrameBus::HasSubscribers() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return !subscribers_.empty();
+}
+
+bool FrameBus::WantsFrame(double timestamp) {
+  std::lock_guard<std::mutex> guard(lock_);
+  for (const Subscriber& subscriber : subscribers_) {
+    if (Accepts(subscriber, timestamp)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FrameBus::Publish(ByteBuffer jpeg, double timestamp,
+                       ScreencastFrame::ReleaseCallback on_release) {
+  FrameRef frame;
+  std::vector<std::pair<int, Callback>> deliveries;
+  std::vector<FrameRef> evicted;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (Subscriber& subscriber : subscribers_) {
+      if (!Accepts(subscriber, timestamp)) {
+        continue;
+      }
+      if (!frame) {
+        frame.reset(new ScreencastFrame(std::move(jpeg), timestamp, pool_,
+                                        std::move(on_release)));
+      }
+      subscriber.last_timestamp = timestamp;
+
+      const Options& options = subscriber.options;
+      if (options.max_in_flight == 0 || subscriber.in_flight.size() < options.max_in_flight) {
+        if (options.max_in_flight > 0) {
+          subscriber.in_flight.push_back(frame);
+        }
+        subscriber.delivered++;
+        deliveries.emplace_back(subscriber.id, subscriber.callback);
+        deliveries_.push_back(Delivery{subscriber.id, std::this_thread::get_id()});
+        continue;
+      }
+
+      // The subscriber is busy; the frame waits, or something is dropped
+      size_t max_queued = options.drop_policy == DropPolicy::kLatestOnly
+                              ? 1
+                              : std::max<size_t>(1, options.max_queued);
+      if (subscriber.queued.size() >= max_queued) {
+        subscriber.dropped++;
+        if (options.drop_policy == DropPolicy::kDropNewest) {
+          frame->MarkDropped();
+          continue;
+        }
+        subscriber.queued.front()->MarkDropped();
+        evicted.push_back(std::move(subscriber.queued.front()));
+        subscriber.queued.pop_front();
+      }
+      subscriber.queued.push_back(frame);
+    }
+  }
+
+  if (!frame) {
+    pool_->Release(std::move(jpeg));
+    return false;
+  }
+  for (const auto& delivery : deliveries) {
+    Deliver(delivery.first, delivery.second, frame);
+  }
+  return true;
+}
+
+std::vector<FrameBus::Stats> FrameBus::GetStats() {
+  std::lock_guard<std::mutex> guard(lock_);
+  std::vector<Stats> stats;
+  for (const Subscriber& subscriber : subscribers_) {
+    stats.push_back(Stats{subscriber.name, subscriber.delivered, subscriber.dropped});
+  }
+  return stats;
+}
+
+FrameBus::Subscriber* FrameBus::Find(int id) {
+  for (Subscriber& subscriber : subscribers_) {
+    if (subscriber.id == id) {
+      return &subscriber;
+    }
+  }
+  return nullptr;
+}
+
+bool FrameBus::IsDeliveringElsewhere(int id) const {
+  std::thread::id self = std::this_thread::get_id();
+  for (const Delivery& delivery : deliveries_) {
+    if (delivery.id == id && delivery.thread != self) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void FrameBus::Deliver(int id, const Callback& callback, const FrameRef& frame) {
+  callback(frame);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  std::thread::id self = std::this_thread::get_id();
+  for (auto it = deliveries_.begin(); it != deliveries_.end(); ++it) {
+    if (it->id == id && it->thread == self) {
+      deliveries_.erase(it);
+      break;
+    }
+  }
+  delivery_done_.notify_all();
+}
+
+bool FrameBus::Accepts(const Subscriber& subscriber, double timestamp) const {
+  // A timestamp going backwards means a new screencast session
+  double max_fps = subscriber.options.max_fps;
+  return max_fps <= 0.0 || subscriber.last_timestamp < 0.0 ||
+         timestamp < subscriber.last_timestamp ||
+         (timestamp - subscriber.last_timestamp) * max_fps >= 1.0;
+}
@@ -0,0 +1,73 @@
+#include "frame_crop.h"
+#include "jpeg_dc_decoder.h"
+#include "jpeg_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+bool CropRect::GetBounds(int frame_width, int frame_height, int align_x, int align_y, int& left,
+                         int& top, int& width, int& height) const {
+  if (IsFull() || frame_width <= 0 || frame_height <= 0) {
+    return false;
+  }
+  int right = std::min(frame_width, static_cast<int>(std::ceil((x + this->width) * frame_width)));
+  int bottom =
+      std::min(frame_height, static_cast<int>(std::ceil((y + this->height) * frame_height)));
+  left = std::max(0, static_cast<int>(std::floor(x * frame_width)));
+  top = std::max(0, static_cast<int>(std::floor(y * frame_height)));
+  left -= left % align_x;
+  top -= top % align_y;
+  width = right - left;
+  height = bottom - top;
+  return width > 0 && height > 0 && (width < frame_width || height < frame_height);
+}
+
+bool CropJpeg(const uint8_t* jpeg, size_t size, const CropRect& rect, std::vector<uint8_t>& out) {
+  if (rect.IsFull()) {
+    return false;
+  }
+  thread_local JpegCoefficients source;
+  thread_local JpegCoefficients cropped;
+  if (!DecodeJpegCoefficients(jpeg, size, source)) {
+    return false;
+  }
+
+  int h_max = 1;
+  int v_max = 1;
+  for (int c = 0; c < source.component_count; c++) {
+    h_max = std::max(h_max, source.planes[c].h);
+    v_max = std::max(v_max, source.planes[c].v);
+  }
+  int mcu_width = 8 * h_max;
+  int mcu_height = 8 * v_max;
+  int left, top, width, height;
+  if (!rect.GetBounds(source.width, source.height, mcu_width, mcu_height, left, top, width,
+                      height)) {
+    return false;
+  }
+
+  cropped.width = width;
+  cropped.height = height;
+  cropped.component_count = source.component_count;
+  memcpy(cropped.quant, source.quant, sizeof(cropped.quant));
+  int mcus_x = (width + mcu_width - 1) / mcu_width;
+  int mcus_y = (height + mcu_height - 1) / mcu_height;
+  for (int c = 0; c < source.component_count; c++) {
+    const JpegCoefficients::Plane& from = source.planes[c];
+    JpegCoefficients::Plane& to = cropped.planes[c];
+    to.h = from.h;
+    to.v = from.v;
+    to.quant_table = from.quant_table;
+    to.blocks_x = mcus_x * from.h;
+    to.blocks_y = mcus_y * from.v;
+    to.blocks.resize(static_cast<size_t>(to.blocks_x) * to.blocks_y * 64);
+    int first_x = left / mcu_width * from.h;
+    int first_y = top / mcu_height * from.v;
+    for (int y = 0; y < to.blocks_y; y++) {
+      memcpy(to.block(0, y), from.block(first_x, first_y + y),
+             static_cast<size_t>(to.blocks_x) * 64 * sizeof(int16_t));
+    }
+  }
+  return EncodeJpegCoefficients(cropped, out);
+}
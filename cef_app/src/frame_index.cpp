@@ -0,0 +1,448 @@
+#include "frame_index.h"
+#include "cpu_features.h"
+#include "matroska_reader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FRAME_INDEX_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define FRAME_INDEX_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(FRAME_INDEX_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FRAME_INDEX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FRAME_INDEX_TARGET_AVX2
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#endif
+
+namespace {
+
+const char kIndexFileName[] = "frame_index.bin";
+const uint32_t kIndexMagic = 0x58464252;  // "RBFX"
+const uint32_t kIndexVersion = 1;
+
+// Recordings are sampled at most this often
+const int64_t kSampleIntervalMs = 2000;
+
+// A sample this close to the previous one is the same screen; not stored
+const int kDuplicateDistance = 3;
+
+struct IndexFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t source_count;
+  uint32_t hash_count;
+};
+
+struct IndexFileSource {
+  uint32_t name_size;
+  uint32_t hash_count;
+  uint64_t size;
+  int64_t modified;
+};
+
+bool HasSuffix(const std::string& value, const char* suffix) {
+  size_t length = strlen(suffix);
+  return value.size() >= length &&
+         value.compare(value.size() - length, length, suffix) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Hamming distance kernels
+
+inline int PopCount64(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(value);
+#else
+  value = value - ((value >> 1) & 0x5555555555555555ULL);
+  value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+  value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return static_cast<int>((value * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+using HammingFn = size_t (*)(const uint64_t* hashes, size_t count, uint64_t query,
+                             uint8_t* distances);
+
+// Vector kernels handle whole blocks and report how many hashes they did
+size_t HammingBlocksScalar(const uint64_t*, size_t, uint64_t, uint8_t*) {
+  return 0;
+}
+
+#if defined(FRAME_INDEX_X86)
+
+// Nibble-table popcount (Mula et al.): PSHUFB looks up the bit count of each
+// half-byte, PSADBW sums the bytes of each 64-bit lane
+FRAME_INDEX_TARGET_AVX2 size_t HammingBlocksAvx2(const uint64_t* hashes, size_t count,
+                                                 uint64_t query, uint8_t* distances) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_nibbles = _mm256_set1_epi8(0x0F);
+  const __m256i queries = _mm256_set1_epi64x(static_cast<long long>(query));
+  // Gathers the low byte of each 64-bit lane into the first 4 bytes
+  const __m256i gather = _mm256_setr_epi8(0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          -1, -1, -1, 0, 8, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          -1, -1, -1, -1, -1, -1);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i bits = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashes + i)), queries);
+    __m256i low = _mm256_and_si256(bits, low_nibbles);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(bits, 4), low_nibbles);
+    __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low),
+                                     _mm256_shuffle_epi8(lookup, high));
+    __m256i sums = _mm256_shuffle_epi8(_mm256_sad_epu8(counts, _mm256_setzero_si256()), gather);
+    uint16_t first = static_cast<uint16_t>(_mm256_extract_epi16(sums, 0));
+    uint16_t second = static_cast<uint16_t>(_mm256_extract_epi16(sums, 8));
+    memcpy(distances + i, &first, 2);
+    memcpy(distances + i + 2, &second, 2);
+  }
+  return i;
+}
+
+#elif defined(FRAME_INDEX_NEON)
+
+size_t HammingBlocksNeon(const uint64_t* hashes, size_t count, uint64_t query,
+                         uint8_t* distances) {
+  const uint64x2_t queries = vdupq_n_u64(query);
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    uint8x16_t counts = vcntq_u8(vreinterpretq_u8_u64(veorq_u64(vld1q_u64(hashes + i), queries)));
+    uint64x2_t sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(counts)));
+    distances[i] = static_cast<uint8_t>(vgetq_lane_u64(sums, 0));
+    distances[i + 1] = static_cast<uint8_t>(vgetq_lane_u64(sums, 1));
+  }
+  return i;
+}
+
+#endif
+
+HammingFn SelectHammingKernel() {
+#if defined(FRAME_INDEX_X86)
+  if (CpuHasAvx2()) {
+    return HammingBlocksAvx2;
+  }
+#elif defined(FRAME_INDEX_NEON)
+  return HammingBlocksNeon;
+#endif
+  return HammingBlocksScalar;
+}
+
+// ---------------------------------------------------------------------------
+// Frame sources
+
+using FrameCallback = std::function<void(const uint8_t* jpeg, size_t size, int64_t offset_ms)>;
+
+// Keyframes listed in a SlideDetector sidecar: {"file":"slide_0001.jpg",
+// ...,"offsetMs":1234,...} per line
+void ReadSlides(const std::string& directory, const FrameCallback& callback) {
+  std::ifstream sidecar(directory + "/slides.jsonl");
+  std::string line;
+  std::vector<char> jpeg;
+  while (std::getline(sidecar, line)) {
+    size_t file_start = line.find("\"file\":\"");
+    size_t offset_start = line.find("\"offsetMs\":");
+    if (file_start == std::string::npos || offset_start == std::string::npos) {
+      continue;
+    }
+    file_start += 8;
+    size_t file_end = line.find('"', file_start);
+    if (file_end == std::string::npos) {
+      continue;
+    }
+    std::string name = line.substr(file_start, file_end - file_start);
+    int64_t offset_ms = std::strtoll(line.c_str() + offset_start + 11, nullptr, 10);
+
+    std::ifstream file(directory + "/" + name, std::ios::in | std::ios::binary);
+    jpeg.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (!jpeg.empty()) {
+      callback(reinterpret_cast<const uint8_t*>(jpeg.data()), jpeg.size(), offset_ms);
+    }
+  }
+}
+
+}  // namespace
+
+uint64_t ComputeDifferenceHash(const LumaImage& image) {
+  if (image.width <= 0 || image.height <= 0) {
+    return 0;
+  }
+
+  uint64_t hash = 0;
+  for (int row = 0; row < 8; row++) {
+    int y0 = row * image.height / 8;
+    int y1 = std::max(y0 + 1, (row + 1) * image.height / 8);
+    uint32_t means[9];
+    for (int column = 0; column < 9; column++) {
+      int x0 = column * image.width / 9;
+      int x1 = std::max(x0 + 1, (column + 1) * image.width / 9);
+      uint32_t sum = 0;
+      for (int y = y0; y < y1; y++) {
+        const uint8_t* pixels = image.pixels.data() + static_cast<size_t>(y) * image.stride;
+        for (int x = x0; x < x1; x++) {
+          sum += pixels[x];
+        }
+      }
+      means[column] = sum / ((y1 - y0) * (x1 - x0));
+    }
+    for (int column = 0; column < 8; column++) {
+      hash = (hash << 1) | (means[column] < means[column + 1] ? 1 : 0);
+    }
+  }
+  return hash;
+}
+
+void ComputeHammingDistances(const uint64_t* hashes, size_t count, uint64_t query,
+                             uint8_t* distances) {
+  static const HammingFn kernel = SelectHammingKernel();
+  size_t done = kernel(hashes, count, query, distances);
+  for (size_t i = done; i < count; i++) {
+    distances[i] = static_cast<uint8_t>(PopCount64(hashes[i] ^ query));
+  }
+}
+
+FrameIndex::FrameIndex(const std::string& directory) : directory_(directory) {}
+
+bool FrameIndex::Load() {
+  std::ifstream file(directory_ + "/" + kIndexFileName, std::ios::in | std::ios::binary);
+  IndexFileHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != kIndexMagic || header.version != kIndexVersion) {
+    return false;
+  }
+
+  std::vector<Source> sources;
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < header.source_count; i++) {
+    IndexFileSource entry;
+    if (!file.read(reinterpret_cast<char*>(&entry), sizeof(entry)) || entry.name_size > 4096) {
+      return false;
+    }
+    Source source;
+    source.name.resize(entry.name_size);
+    if (!file.read(&source.name[0], entry.name_size)) {
+      return false;
+    }
+    source.size = entry.size;
+    source.modified = entry.modified;
+    source.first = static_cast<uint32_t>(total);
+    source.count = entry.hash_count;
+    total += entry.hash_count;
+    sources.push_back(source);
+  }
+  if (total != header.hash_count) {
+    return false;
+  }
+
+  std::vector<uint64_t> hashes(header.hash_count);
+  std::vector<uint32_t> offsets(header.hash_count);
+  if (header.hash_count > 0 &&
+      (!file.read(reinterpret_cast<char*>(hashes.data()), hashes.size() * sizeof(uint64_t)) ||
+       !file.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(uint32_t)))) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  sources_.swap(sources);
+  hashes_.swap(hashes);
+  offsets_.swap(offsets);
+  std::cout << "[FrameIndex] Loaded " << hashes_.size() << " hashes of " << sources_.size()
+            << " recordings" << std::endl;
+  return true;
+}
+
+bool FrameIndex::Save() {
+  std::string path = directory_ + "/" + kIndexFileName;
+  std::string temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    IndexFileHeader header = {kIndexMagic, kIndexVersion, static_cast<uint32_t>(sources_.size()),
+                              static_cast<uint32_t>(hashes_.size())};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const Source& source : sources_) {
+      IndexFileSource entry = {static_cast<uint32_t>(source.name.size()), source.count,
+                               source.size, source.modified};
+      file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+      file.write(source.name.data(), source.name.size());
+    }
+    file.write(reinterpret_cast<const char*>(hashes_.data()), hashes_.size() * sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(offsets_.data()),
+               offsets_.size() * sizeof(uint32_t));
+    if (!file.flush()) {
+      std::remove(temp_path.c_str());
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+void FrameIndex::Update() {
+  std::unordered_map<std::string, Source> known;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (const Source& source : sources_) {
+      known[source.name] = source;
+    }
+  }
+
+  // Sources are identified by size and modification time; a slides
+  // directory by its sidecar
+  std::vector<Source> present;
+  std::error_code error;
+  std::filesystem::directory_iterator it(directory_, error);
+  for (; !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+    std::string name = it->path().filename().string();
+    std::filesystem::path identity;
+    if (HasSuffix(name, ".mkv") && it->is_regular_file(error)) {
+      identity = it->path();
+    } else if (HasSuffix(name, ".slides") && it->is_directory(error)) {
+      identity = it->path() / "slides.jsonl";
+    } else {
+      continue;
+    }
+    std::error_code stat_error;
+    Source source;
+    source.name = name;
+    source.size = std::filesystem::file_size(identity, stat_error);
+    source.modified = static_cast<int64_t>(
+        std::filesystem::last_write_time(identity, stat_error).time_since_epoch().count());
+    source.first = 0;
+    source.count = 0;
+    if (!stat_error) {
+      present.push_back(source);
+    }
+  }
+
+  std::vector<Source> unchanged;
+  std::vector<HashedSource> hashed;
+  LumaImage image;
+  for (const Source& source : present) {
+    auto found = known.find(source.name);
+    if (found != known.end() && found->second.size == source.size &&
+        found->second.modified == source.modified) {
+      unchanged.push_back(found->second);
+      continue;
+    }
+
+    HashedSource result;
+    result.source = source;
+    uint64_t previous = 0;
+    FrameCallback add_frame = [&](const uint8_t* jpeg, size_t size, int64_t offset_ms) {
+      if (!DecodeJpegDcLuma(jpeg, size, image)) {
+        return;
+      }
+      uint64_t hash = ComputeDifferenceHash(image);
+      if (!result.hashes.empty() && PopCount64(hash ^ previous) <= kDuplicateDistance) {
+        return;
+      }
+      previous = hash;
+      result.hashes.push_back(hash);
+      result.offsets.push_back(static_cast<uint32_t>(std::max<int64_t>(0, offset_ms)));
+    };
+
+    std::string path = directory_ + "/" + source.name;
+    if (HasSuffix(source.name, ".slides")) {
+      ReadSlides(path, add_frame);
+    } else {
+      // Files that are not MJPEG are remembered with no hashes so they are
+      // not parsed again
+      MatroskaReader reader;
+      reader.Read(path, [&](const uint8_t* jpeg, size_t size, int64_t timestamp_ms) {
+        add_frame(jpeg, size, timestamp_ms);
+        return timestamp_ms + kSampleIntervalMs;
+      });
+    }
+    hashed.push_back(std::move(result));
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  if (hashed.empty() && unchanged.size() == sources_.size()) {
+    return;  // Nothing added, changed or removed
+  }
+
+  std::vector<Source> sources;
+  std::vector<uint64_t> hashes;
+  std::vector<uint32_t> offsets;
+  for (Source source : unchanged) {
+    uint32_t first = static_cast<uint32_t>(hashes.size());
+    hashes.insert(hashes.end(), hashes_.begin() + source.first,
+                  hashes_.begin() + source.first + source.count);
+    offsets.insert(offsets.end(), offsets_.begin() + source.first,
+                   offsets_.begin() + source.first + source.count);
+    source.first = first;
+    sources.push_back(source);
+  }
+  for (HashedSource& result : hashed) {
+    result.source.first = static_cast<uint32_t>(hashes.size());
+    result.source.count = static_cast<uint32_t>(result.hashes.size());
+    hashes.insert(hashes.end(), result.hashes.begin(), result.hashes.end());
+    offsets.insert(offsets.end(), result.offsets.begin(), result.offsets.end());
+    sources.push_back(result.source);
+  }
+  sources_.swap(sources);
+  hashes_.swap(hashes);
+  offsets_.swap(offsets);
+
+  std::cout << "[FrameIndex] Indexed " << hashed.size() << " recordings; "
+            << hashes_.size() << " hashes of " << sources_.size() << " in total" << std::endl;
+  if (!Save()) {
+    std::cerr << "[FrameIndex] Failed to save " << kIndexFileName << std::endl;
+  }
+}
+
+std::vector<FrameMatch> FrameIndex::Search(uint64_t hash, size_t max_results,
+                                           int max_distance) {
+  thread_local std::vector<uint8_t> distances;
+  std::vector<FrameMatch> matches;
+
+  std::lock_guard<std::mutex> guard(lock_);
+  distances.resize(hashes_.size());
+  ComputeHammingDistances(hashes_.data(), hashes_.size(), hash, distances.data());
+
+  for (const Source& source : sources_) {
+    if (source.count == 0) {
+      continue;
+    }
+    const uint8_t* begin = distances.data() + source.first;
+    const uint8_t* best = std::min_element(begin, begin + source.count);
+    if (*best <= max_distance) {
+      matches.push_back({directory_ + "/" + source.name,
+                         offsets_[source.first + (best - begin)], *best});
+    }
+  }
+
+  std::sort(matches.begin(), matches.end(), [](const FrameMatch& a, const FrameMatch& b) {
+    return a.distance < b.distance;
+  });
+  if (matches.size() > max_results) {
+    matches.resize(max_results);
+  }
+  return matches;
+}
+
+size_t FrameIndex::GetHashCount() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return hashes_.size();
+}
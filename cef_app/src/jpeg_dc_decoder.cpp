@@ -0,0 +1,629 @@
+#include "jpeg_dc_decoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Codes up to this many bits are resolved with one table lookup
+const int kFastBits = 9;
+
+const uint8_t kNoMarker = 0;
+
+// Canonical Huffman table (ITU T.81 Annex C), decoded as in stb_image
+struct HuffmanTable {
+  bool defined = false;
+  uint8_t fast[1 << kFastBits];  // Symbol index, or 255 for longer codes
+  uint16_t codes[256];
+  uint8_t sizes[257];
+  uint8_t values[256];
+  uint32_t max_code[18];  // Per length, left-aligned to 16 bits
+  int delta[17];          // Symbol index minus code, per length
+};
+
+bool BuildHuffmanTable(const uint8_t counts[16], const uint8_t* values,
+                       HuffmanTable& table) {
+  int k = 0;
+  for (int i = 0; i < 16; i++) {
+    for (int j = 0; j < counts[i]; j++) {
+      table.sizes[k++] = static_cast<uint8_t>(i + 1);
+    }
+  }
+  table.sizes[k] = 0;
+
+  uint32_t code = 0;
+  k = 0;
+  for (int length = 1; length <= 16; length++) {
+    table.delta[length] = k - static_cast<int>(code);
+    if (table.sizes[k] == length) {
+      while (table.sizes[k] == length) {
+        table.codes[k++] = static_cast<uint16_t>(code++);
+      }
+      if (code - 1 >= (1u << length)) {
+        return false;  // More codes than fit in |length| bits
+      }
+    }
+    table.max_code[length] = code << (16 - length);
+    code <<= 1;
+  }
+  table.max_code[17] = 0xFFFFFFFF;
+
+  memset(table.fast, 255, sizeof(table.fast));
+  for (int i = 0; i < k; i++) {
+    int size = table.sizes[i];
+    if (size <= kFastBits) {
+      int first = table.codes[i] << (kFastBits - size);
+      int count = 1 << (kFastBits - size);
+      memset(table.fast + first, i, count);
+    }
+  }
+  memcpy(table.values, values, k);
+  table.defined = true;
+  return true;
+}
+
+struct Component {
+  int id = 0;
+  int h = 1;
+  int v = 1;
+  int quant_table = 0;
+  int dc_table = 0;
+  int ac_table = 0;
+  int dc_predictor = 0;
+};
+
+// Entropy-coded segment reader. Handles byte stuffing and stops at the
+// next marker, after which it feeds zero bits.
+class BitReader {
+ public:
+  BitReader(const uint8_t* data, size_t size)
+      : data_(data),
+        size_(size),
+        pos_(0),
+        buffer_(0),
+        bits_(0),
+        padding_bits_(0),
+        marker_(kNoMarker) {}
+
+  // True once more bits were consumed than the segment holds, i.e. the
+  // file is truncated or corrupt
+  bool overrun() const { return bits_ < padding_bits_; }
+
+  int DecodeHuffman(const HuffmanTable& table) {
+    if (bits_ < 16) {
+      Fill();
+    }
+    int fast = table.fast[buffer_ >> (32 - kFastBits)];
+    if (fast < 255) {
+      int size = table.sizes[fast];
+      if (size > bits_) {
+        return -1;
+      }
+      Consume(size);
+      return table.values[fast];
+    }
+
+    uint32_t top = buffer_ >> 16;
+    int length = kFastBits + 1;
+    while (top >= table.max_code[length]) {
+      length++;
+    }
+    if (length > 16 || length > bits_) {
+      return -1;
+    }
+    int index = static_cast<int>(buffer_ >> (32 - length)) + table.delta[length];
+    Consume(length);
+    return index >= 0 && index < 256 ? table.values[index] : -1;
+  }
+
+  // Read |count| (1..16) bits and sign-extend as a JPEG magnitude category
+  int ReceiveExtend(int count) {
+    if (bits_ < count) {
+      Fill();
+    }
+    int value = static_cast<int>(buffer_ >> (32 - count));
+    Consume(count);
+    if (value < (1 << (count - 1))) {
+      value -= (1 << count) - 1;
+    }
+    return value;
+  }
+
+  void Skip(int count) {
+    if (bits_ < count) {
+      Fill();
+    }
+    Consume(count);
+  }
+
+  // Drop the rest of the current byte and move past the next RSTn marker
+  bool Restart() {
+    if (overrun()) {
+      return false;
+    }
+    while (marker_ == kNoMarker && pos_ < size_) {
+      buffer_ = 0;
+      bits_ = 0;
+      Fill();
+    }
+    bool ok = marker_ >= 0xD0 && marker_ <= 0xD7;
+    buffer_ = 0;
+    bits_ = 0;
+    padding_bits_ = 0;
+    marker_ = kNoMarker;
+    return ok;
+  }
+
+ private:
+  void Consume(int count) {
+    buffer_ <<= count;
+    bits_ -= count;
+  }
+
+  void Fill() {
+    while (bits_ <= 24) {
+      uint32_t byte = 0;
+      if (marker_ == kNoMarker && pos_ < size_) {
+        byte = data_[pos_++];
+        if (byte == 0xFF) {
+          uint8_t next = pos_ < size_ ? data_[pos_++] : 0xD9;
+          while (next == 0xFF && pos_ < size_) {
+            next = data_[pos_++];
+          }
+          if (next != 0) {
+            marker_ = next;
+            byte = 0;
+            padding_bits_ += 8;
+          }
+        }
+      } else {
+        padding_bits_ += 8;
+      }
+      buffer_ |= byte << (24 - bits_);
+      bits_ += 8;
+    }
+  }
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
+  uint32_t buffer_;
+  int bits_;
+  int padding_bits_;  // Zero bits fed after the end of the segment
+  uint8_t marker_;
+};
+
+struct FrameHeader {
+  int width = 0;
+  int height = 0;
+  int restart_interval = 0;
+  int component_count = 0;
+  Component components[4];
+  int scan_components[4];
+  int scan_count = 0;
+  int dc_quant[4] = {1, 1, 1, 1};
+  uint16_t quant[4][64] = {};  // Zig-zag order
+  bool quant_defined[4] = {false, false, false, false};
+  HuffmanTable dc_tables[4];
+  HuffmanTable ac_tables[4];
+};
+
+// Parse the markers up to the first SOS. Returns the offset of the
+// entropy-coded data, or 0.
+size_t ParseHeaders(const uint8_t* data, size_t size, FrameHeader& header) {
+  if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return 0;
+  }
+
+  size_t pos = 2;
+  while (pos + 4 <= size) {
+    if (data[pos] != 0xFF) {
+      return 0;
+    }
+    uint8_t marker = data[pos + 1];
+    if (marker == 0xFF) {
+      pos++;
+      continue;
+    }
+    size_t length = (data[pos + 2] << 8) | data[pos + 3];
+    if (length < 2 || pos + 2 + length > size) {
+      return 0;
+    }
+    const uint8_t* segment = data + pos + 4;
+    size_t segment_size = length - 2;
+    pos += 2 + length;
+
+    if (marker == 0xDB) {  // DQT
+      size_t i = 0;
+      while (i < segment_size) {
+        int precision = segment[i] >> 4;
+        int id = segment[i] & 3;
+        size_t table_size = precision ? 128 : 64;
+        if (i + 1 + table_size > segment_size) {
+          return 0;
+        }
+        for (int k = 0; k < 64; k++) {
+          header.quant[id][k] = static_cast<uint16_t>(
+              precision ? (segment[i + 1 + 2 * k] << 8) | segment[i + 2 + 2 * k]
+                        : segment[i + 1 + k]);
+        }
+        header.quant_defined[id] = true;
+        header.dc_quant[id] = header.quant[id][0];
+        i += 1 + table_size;
+      }
+    } else if (marker == 0xC4) {  // DHT
+      size_t i = 0;
+      while (i + 17 <= segment_size) {
+        int table_class = segment[i] >> 4;
+        int id = segment[i] & 3;
+        const uint8_t* counts = segment + i + 1;
+        size_t total = 0;
+        for (int j = 0; j < 16; j++) {
+          total += counts[j];
+        }
+        if (total > 256 || table_class > 1 || i + 17 + total > segment_size) {
+          return 0;
+        }
+        HuffmanTable& table = table_class ? header.ac_tables[id] : header.dc_tables[id];
+        if (!BuildHuffmanTable(counts, segment + i + 17, table)) {
+          return 0;
+        }
+        i += 17 + total;
+      }
+    } else if (marker == 0xC0 || marker == 0xC1) {  // Baseline / extended Huffman
+      if (segment_size < 6 || segment[0] != 8) {
+        return 0;
+      }
+      header.height = (segment[1] << 8) | segment[2];
+      header.width = (segment[3] << 8) | segment[4];
+      header.component_count = segment[5];
+      if (header.width == 0 || header.height == 0 || header.component_count < 1 ||
+          header.component_count > 4 ||
+          segment_size < 6 + 3 * static_cast<size_t>(header.component_count)) {
+        return 0;
+      }
+      for (int c = 0; c < header.component_count; c++) {
+        Component& component = header.components[c];
+        component.id = segment[6 + 3 * c];
+        component.h = segment[7 + 3 * c] >> 4;
+        component.v = segment[7 + 3 * c] & 15;
+        component.quant_table = segment[8 + 3 * c] & 3;
+        if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4) {
+          return 0;
+        }
+      }
+    } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 &&
+               marker != 0xC8 && marker != 0xCC) {
+      return 0;  // Progressive, lossless or arithmetic coding
+    } else if (marker == 0xDD) {  // DRI
+      if (segment_size < 2) {
+        return 0;
+      }
+      header.restart_interval = (segment[0] << 8) | segment[1];
+    } else if (marker == 0xDA) {  // SOS
+      if (header.component_count == 0 || segment_size < 1) {
+        return 0;
+      }
+      header.scan_count = segment[0];
+      if (header.scan_count < 1 || header.scan_count > header.component_count ||
+          segment_size < 1 + 2 * static_cast<size_t>(header.scan_count)) {
+        return 0;
+      }
+      for (int s = 0; s < header.scan_count; s++) {
+        int id = segment[1 + 2 * s];
+        int index = -1;
+        for (int c = 0; c < header.component_count; c++) {
+          if (header.components[c].id == id) {
+            index = c;
+          }
+        }
+        if (index < 0) {
+          return 0;
+        }
+        header.components[index].dc_table = (segment[2 + 2 * s] >> 4) & 3;
+        header.components[index].ac_table = segment[2 + 2 * s] & 3;
+        header.scan_components[s] = index;
+      }
+      return pos;
+    } else if (marker == 0xD9) {
+      return 0;
+    }
+  }
+  return 0;
+}
+
+// Decode one block, updating the DC predictor of |component|. The AC
+// coefficients are skipped unless |coefficients| is given, which then gets
+// all 64 in zig-zag order.
+bool DecodeBlock(BitReader& reader, const FrameHeader& header, Component& component,
+                 int16_t* coefficients = nullptr) {
+  int category = reader.DecodeHuffman(header.dc_tables[component.dc_table]);
+  if (category < 0 || category > 15) {
+    return false;
+  }
+  if (category > 0) {
+    component.dc_predictor += reader.ReceiveExtend(category);
+  }
+  if (coefficients) {
+    memset(coefficients, 0, 64 * sizeof(int16_t));
+    coefficients[0] = static_cast<int16_t>(component.dc_predictor);
+  }
+
+  const HuffmanTable& ac = header.ac_tables[component.ac_table];
+  for (int k = 1; k < 64;) {
+    int symbol = reader.DecodeHuffman(ac);
+    if (symbol < 0) {
+      return false;
+    }
+    int run = symbol >> 4;
+    int bits = symbol & 15;
+    if (bits == 0) {
+      if (run != 15) {
+        break;  // End of block
+      }
+      k += 16;
+    } else if (coefficients) {
+      k += run;
+      if (k > 63) {
+        return false;
+      }
+      coefficients[k++] = static_cast<int16_t>(reader.ReceiveExtend(bits));
+    } else {
+      reader.Skip(bits);
+      k += run + 1;
+    }
+  }
+  return true;
+}
+
+// Parse the headers of |jpeg| into |header| and check that the tables its
+// first scan refers to are defined. Returns the offset of the scan data, or 0.
+size_t ParseFrame(const uint8_t* jpeg, size_t size, FrameHeader& header) {
+  header = FrameHeader();
+  size_t scan_start = ParseHeaders(jpeg, size, header);
+  if (scan_start == 0 || header.scan_components[0] != 0) {
+    return 0;
+  }
+  for (int s = 0; s < header.scan_count; s++) {
+    const Component& component = header.components[header.scan_components[s]];
+    if (!header.dc_tables[component.dc_table].defined ||
+        !header.ac_tables[component.ac_table].defined) {
+      return 0;
+    }
+  }
+  return scan_start;
+}
+
+// Decode the first scan, calling |store(component_index, block_x, block_y)|
+// after each block with the component's DC predictor updated and, if
+// |coefficients| is given, the block's coefficients in it. Of a
+// non-interleaved file only the luma scan is decoded.
+template <typename Store>
+bool DecodeScan(const uint8_t* jpeg, size_t size, size_t scan_start, FrameHeader& header,
+                int16_t* coefficients, Store store) {
+  int h_max = 1;
+  int v_max = 1;
+  for (int c = 0; c < header.component_count; c++) {
+    h_max = std::max(h_max, header.components[c].h);
+    v_max = std::max(v_max, header.components[c].v);
+  }
+  Component& luma = header.components[0];
+
+  BitReader reader(jpeg + scan_start, size - scan_start);
+  int restarts_left = header.restart_interval;
+
+  if (header.scan_count == 1) {
+    // Non-interleaved: one block per MCU. The chroma scans that may follow
+    // are not needed.
+    int blocks_x = (header.width * luma.h / h_max + 7) / 8;
+    int blocks_y = (header.height * luma.v / v_max + 7) / 8;
+    if (luma.h != h_max || luma.v != v_max) {
+      return false;
+    }
+    for (int y = 0; y < blocks_y; y++) {
+      for (int x = 0; x < blocks_x; x++) {
+        if (!DecodeBlock(reader, header, luma, coefficients) || reader.overrun()) {
+          return false;
+        }
+        store(0, x, y);
+        if (header.restart_interval && --restarts_left == 0) {
+          if ((y != blocks_y - 1 || x != blocks_x - 1) && !reader.Restart()) {
+            return false;
+          }
+          restarts_left = header.restart_interval;
+          luma.dc_predictor = 0;
+        }
+      }
+    }
+    return true;
+  }
+
+  if (header.scan_count != header.component_count) {
+    return false;
+  }
+  int mcus_x = (header.width + 8 * h_max - 1) / (8 * h_max);
+  int mcus_y = (header.height + 8 * v_max - 1) / (8 * v_max);
+  for (int mcu_y = 0; mcu_y < mcus_y; mcu_y++) {
+    for (int mcu_x = 0; mcu_x < mcus_x; mcu_x++) {
+      for (int s = 0; s < header.scan_count; s++) {
+        int index = header.scan_components[s];
+        Component& component = header.components[index];
+        for (int by = 0; by < component.v; by++) {
+          for (int bx = 0; bx < component.h; bx++) {
+            if (!DecodeBlock(reader, header, component, coefficients) || reader.overrun()) {
+              return false;
+            }
+            store(index, mcu_x * component.h + bx, mcu_y * component.v + by);
+          }
+        }
+      }
+
+      if (header.restart_interval && --restarts_left == 0) {
+        if (mcu_y != mcus_y - 1 || mcu_x != mcus_x - 1) {
+          if (!reader.Restart()) {
+            return false;
+          }
+        }
+        restarts_left = header.restart_interval;
+        for (int c = 0; c < header.component_count; c++) {
+          header.components[c].dc_predictor = 0;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// DC image of each component: |planes[0]| is luma; chroma planes are only
+// filled when given, for interleaved 3-component files, and left empty
+// (width 0) otherwise
+bool DecodeDcPlanes(const uint8_t* jpeg, size_t size, LumaImage* planes[3]) {
+  // Tables are large; keep them off the stack and reuse them per thread
+  thread_local FrameHeader header;
+  size_t scan_start = ParseFrame(jpeg, size, header);
+  if (scan_start == 0) {
+    return false;
+  }
+
+  int h_max = 1;
+  int v_max = 1;
+  for (int c = 0; c < header.component_count; c++) {
+    h_max = std::max(h_max, header.components[c].h);
+    v_max = std::max(v_max, header.components[c].v);
+  }
+
+  bool color = planes[1] && planes[2] && header.component_count == 3 &&
+               header.scan_count == 3;
+  int plane_count = color ? 3 : 1;
+  for (int c = 0; c < 3; c++) {
+    LumaImage* image = planes[c];
+    if (!image) {
+      continue;
+    }
+    if (c >= plane_count) {
+      image->width = 0;
+      image->height = 0;
+      image->stride = 0;
+      image->pixels.clear();
+      continue;
+    }
+    const Component& component = header.components[c];
+    image->width = ((header.width * component.h + h_max - 1) / h_max + 7) / 8;
+    image->height = ((header.height * component.v + v_max - 1) / v_max + 7) / 8;
+    image->stride = (image->width + 15) & ~15;
+    image->pixels.assign(static_cast<size_t>(image->stride) * ((image->height + 7) & ~7), 0);
+  }
+
+  // Dequantized DC / 8 is the block mean; JPEG samples are centered on 128
+  return DecodeScan(jpeg, size, scan_start, header, nullptr, [&](int index, int x, int y) {
+    if (index >= plane_count) {
+      return;
+    }
+    LumaImage& image = *planes[index];
+    const Component& component = header.components[index];
+    if (x < image.width && y < image.height) {
+      int value = 128 + component.dc_predictor * header.dc_quant[component.quant_table] / 8;
+      image.pixels[static_cast<size_t>(y) * image.stride + x] =
+          static_cast<uint8_t>(std::min(255, std::max(0, value)));
+    }
+  });
+}
+
+}  // namespace
+
+bool DecodeJpegDcLuma(const uint8_t* jpeg, size_t size, LumaImage& image) {
+  LumaImage* planes[3] = {&image, nullptr, nullptr};
+  return DecodeDcPlanes(jpeg, size, planes);
+}
+
+bool DecodeJpegDcColor(const uint8_t* jpeg, size_t size, RgbImage& image) {
+  thread_local LumaImage luma;
+  thread_local LumaImage cb;
+  thread_local LumaImage cr;
+  LumaImage* planes[3] = {&luma, &cb, &cr};
+  if (!DecodeDcPlanes(jpeg, size, planes)) {
+    return false;
+  }
+
+  image.width = luma.width;
+  image.height = luma.height;
+  image.pixels.resize(static_cast<size_t>(image.width) * image.height * 3);
+  uint8_t* out = image.pixels.data();
+  for (int y = 0; y < luma.height; y++) {
+    const uint8_t* y_row = luma.pixels.data() + static_cast<size_t>(y) * luma.stride;
+    int cy = cb.width ? y * cb.height / luma.height : 0;
+    const uint8_t* cb_row = cb.pixels.data() + static_cast<size_t>(cy) * cb.stride;
+    const uint8_t* cr_row = cr.pixels.data() + static_cast<size_t>(cy) * cr.stride;
+    for (int x = 0; x < luma.width; x++) {
+      // JFIF YCbCr -> RGB in 16.16 fixed point; grayscale files have no chroma
+      int value = y_row[x] << 16;
+      int red = value;
+      int green = value;
+      int blue = value;
+      if (cb.width) {
+        int cx = x * cb.width / luma.width;
+        int u = cb_row[cx] - 128;
+        int v = cr_row[cx] - 128;
+        red += 91881 * v;
+        green -= 22554 * u + 46802 * v;
+        blue += 116130 * u;
+      }
+      *out++ = static_cast<uint8_t>(std::min(255, std::max(0, (red + 32768) >> 16)));
+      *out++ = static_cast<uint8_t>(std::min(255, std::max(0, (green + 32768) >> 16)));
+      *out++ = static_cast<uint8_t>(std::min(255, std::max(0, (blue + 32768) >> 16)));
+    }
+  }
+  return true;
+}
+
+bool DecodeJpegCoefficients(const uint8_t* jpeg, size_t size, JpegCoefficients& image) {
+  thread_local FrameHeader header;
+  size_t scan_start = ParseFrame(jpeg, size, header);
+  if (scan_start == 0 || (header.component_count != 1 && header.component_count != 3) ||
+      header.scan_count != header.component_count) {
+    return false;
+  }
+
+  // A single-component scan is not interleaved and has no MCU padding
+  int h_max = 1;
+  int v_max = 1;
+  if (header.component_count == 3) {
+    for (int c = 0; c < 3; c++) {
+      h_max = std::max(h_max, header.components[c].h);
+      v_max = std::max(v_max, header.components[c].v);
+    }
+  }
+  int mcus_x = (header.width + 8 * h_max - 1) / (8 * h_max);
+  int mcus_y = (header.height + 8 * v_max - 1) / (8 * v_max);
+
+  image.width = header.width;
+  image.height = header.height;
+  image.component_count = header.component_count;
+  for (int t = 0; t < 4; t++) {
+    memcpy(image.quant[t], header.quant[t], sizeof(image.quant[t]));
+  }
+  for (int c = 0; c < header.component_count; c++) {
+    const Component& component = header.components[c];
+    JpegCoefficients::Plane& plane = image.planes[c];
+    if (!header.quant_defined[component.quant_table]) {
+      return false;
+    }
+    plane.h = header.component_count == 3 ? component.h : 1;
+    plane.v = header.component_count == 3 ? component.v : 1;
+    plane.quant_table = component.quant_table;
+    plane.blocks_x = mcus_x * plane.h;
+    plane.blocks_y = mcus_y * plane.v;
+    plane.blocks.resize(static_cast<size_t>(plane.blocks_x) * plane.blocks_y * 64);
+  }
+  if (header.component_count == 1) {
+    // Decode in MCU order regardless of the declared sampling
+    header.components[0].h = 1;
+    header.components[0].v = 1;
+  }
+
+  int16_t coefficients[64];
+  return DecodeScan(jpeg, size, scan_start, header, coefficients, [&](int index, int x, int y) {
+    JpegCoefficients::Plane& plane = image.planes[index];
+    memcpy(plane.block(x, y), coefficients, sizeof(coefficients));
+  });
+}
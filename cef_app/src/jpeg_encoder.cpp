@@ -0,0 +1,490 @@
+#include "jpeg_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Annex K.1 quantization tables, in zig-zag order
+const uint8_t kLumaQuant[64] = {
+    16, 11, 12, 14, 12, 10, 16, 14,
+    13, 14, 18, 17, 16, 19, 24, 40,
+    26, 24, 22, 22, 24, 49, 35, 37,
+    29, 40, 58, 51, 61, 60, 57, 51,
+    56, 55, 64, 72, 92, 78, 64, 68,
+    87, 69, 55, 56, 80, 109, 81, 87,
+    95, 98, 103, 104, 103, 62, 77, 113,
+    121, 112, 100, 120, 92, 101, 103, 99,
+};
+
+const uint8_t kChromaQuant[64] = {
+    17, 18, 18, 24, 21, 24, 47, 26,
+    26, 47, 99, 66, 56, 66, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// Annex K.3 Huffman tables: code counts per length, then the symbols
+const uint8_t kLumaDcCounts[16] = {
+    0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
+};
+const uint8_t kLumaDcValues[12] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+};
+const uint8_t kLumaAcCounts[16] = {
+    0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 125,
+};
+const uint8_t kLumaAcValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+    0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+    0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+    0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+    0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+    0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4,
+    0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+const uint8_t kChromaDcCounts[16] = {
+    0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+};
+const uint8_t kChromaDcValues[12] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+};
+const uint8_t kChromaAcCounts[16] = {
+    0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 119,
+};
+const uint8_t kChromaAcValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
+    0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+    0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+    0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+    0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+    0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+    0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+    0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4,
+    0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+// Natural (row-major) index of each zig-zag position
+const uint8_t kZigzag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Per-row/column output scale of the AAN DCT
+const float kAanScale[8] = {1.0f,         1.387039845f, 1.306562965f, 1.175875602f,
+                            1.0f,         0.785694958f, 0.541196100f, 0.275899379f};
+
+struct HuffmanCode {
+  uint16_t code[256];
+  uint8_t size[256];
+};
+
+void BuildHuffmanCode(const uint8_t counts[16], const uint8_t* values, HuffmanCode& table) {
+  uint16_t code = 0;
+  int k = 0;
+  for (int length = 1; length <= 16; length++) {
+    for (int i = 0; i < counts[length - 1]; i++) {
+      table.code[values[k]] = code++;
+      table.size[values[k]] = static_cast<uint8_t>(length);
+      k++;
+    }
+    code <<= 1;
+  }
+}
+
+struct Tables {
+  HuffmanCode luma_dc;
+  HuffmanCode luma_ac;
+  HuffmanCode chroma_dc;
+  HuffmanCode chroma_ac;
+
+  Tables() {
+    BuildHuffmanCode(kLumaDcCounts, kLumaDcValues, luma_dc);
+    BuildHuffmanCode(kLumaAcCounts, kLumaAcValues, luma_ac);
+    BuildHuffmanCode(kChromaDcCounts, kChromaDcValues, chroma_dc);
+    BuildHuffmanCode(kChromaAcCounts, kChromaAcValues, chroma_ac);
+  }
+};
+
+// Entropy-coded data with 0xFF byte stuffing
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<uint8_t>& out) : out_(out), buffer_(0), bits_(0) {}
+
+  void Write(uint32_t value, int count) {
+    buffer_ |= (value & ((1u << count) - 1)) << (24 - bits_ - count);
+    bits_ += count;
+    while (bits_ >= 8) {
+      uint8_t byte = static_cast<uint8_t>(buffer_ >> 16);
+      out_.push_back(byte);
+      if (byte == 0xFF) {
+        out_.push_back(0);
+      }
+      buffer_ = (buffer_ << 8) & 0xFFFFFF;
+      bits_ -= 8;
+    }
+  }
+
+  // Pad the last byte with one bits
+  void Flush() {
+    if (bits_ > 0) {
+      Write(0x7F, 8 - bits_);
+    }
+  }
+
+ private:
+  std::vector<uint8_t>& out_;
+  uint32_t buffer_;
+  int bits_;
+};
+
+// One pass of the float AAN forward DCT (as in libjpeg's jfdctflt.c) over
+// 8 values |stride| apart
+void ForwardDct8(float* d, int stride) {
+  float tmp0 = d[0] + d[7 * stride];
+  float tmp7 = d[0] - d[7 * stride];
+  float tmp1 = d[stride] + d[6 * stride];
+  float tmp6 = d[stride] - d[6 * stride];
+  float tmp2 = d[2 * stride] + d[5 * stride];
+  float tmp5 = d[2 * stride] - d[5 * stride];
+  float tmp3 = d[3 * stride] + d[4 * stride];
+  float tmp4 = d[3 * stride] - d[4 * stride];
+
+  float tmp10 = tmp0 + tmp3;
+  float tmp13 = tmp0 - tmp3;
+  float tmp11 = tmp1 + tmp2;
+  float tmp12 = tmp1 - tmp2;
+  d[0] = tmp10 + tmp11;
+  d[4 * stride] = tmp10 - tmp11;
+  float z1 = (tmp12 + tmp13) * 0.707106781f;
+  d[2 * stride] = tmp13 + z1;
+  d[6 * stride] = tmp13 - z1;
+
+  tmp10 = tmp4 + tmp5;
+  tmp11 = tmp5 + tmp6;
+  tmp12 = tmp6 + tmp7;
+  float z5 = (tmp10 - tmp12) * 0.382683433f;
+  float z2 = 0.541196100f * tmp10 + z5;
+  float z4 = 1.306562965f * tmp12 + z5;
+  float z3 = tmp11 * 0.707106781f;
+  float z11 = tmp7 + z3;
+  float z13 = tmp7 - z3;
+  d[5 * stride] = z13 + z2;
+  d[3 * stride] = z13 - z2;
+  d[stride] = z11 + z4;
+  d[7 * stride] = z11 - z4;
+}
+
+// Entropy-code one block of quantized coefficients in zig-zag order. Fails
+// for values outside the categories of the Annex K tables, which only
+// quality 100 and above can produce.
+bool EncodeCoefficients(BitWriter& writer, const int16_t coefficients[64], const HuffmanCode& dc,
+                        const HuffmanCode& ac, int& dc_predictor) {
+  // Magnitude category and its extra bits (negative values one's-complemented)
+  auto emit_value = [&writer](const HuffmanCode& table, int symbol_high, int value,
+                              int max_category) {
+    int magnitude = value < 0 ? -value : value;
+    int category = 0;
+    while (magnitude >> category) {
+      category++;
+    }
+    if (category > max_category) {
+      return false;
+    }
+    int symbol = symbol_high | category;
+    writer.Write(table.code[symbol], table.size[symbol]);
+    if (category) {
+      writer.Write(static_cast<uint32_t>(value < 0 ? value - 1 : value), category);
+    }
+    return true;
+  };
+
+  if (!emit_value(dc, 0, coefficients[0] - dc_predictor, 11)) {
+    return false;
+  }
+  dc_predictor = coefficients[0];
+
+  int run = 0;
+  for (int k = 1; k < 64; k++) {
+    if (coefficients[k] == 0) {
+      run++;
+      continue;
+    }
+    while (run >= 16) {
+      writer.Write(ac.code[0xF0], ac.size[0xF0]);
+      run -= 16;
+    }
+    if (!emit_value(ac, run << 4, coefficients[k], 10)) {
+      return false;
+    }
+    run = 0;
+  }
+  if (run > 0) {
+    writer.Write(ac.code[0x00], ac.size[0x00]);
+  }
+  return true;
+}
+
+// Transform, quantize and entropy-code one block of level-shifted samples
+bool EncodeBlock(BitWriter& writer, float block[64], const float divisors[64],
+                 const HuffmanCode& dc, const HuffmanCode& ac, int& dc_predictor) {
+  for (int row = 0; row < 8; row++) {
+    ForwardDct8(block + row * 8, 1);
+  }
+  for (int column = 0; column < 8; column++) {
+    ForwardDct8(block + column, 8);
+  }
+
+  int16_t coefficients[64];
+  for (int k = 0; k < 64; k++) {
+    coefficients[k] = static_cast<int16_t>(std::lround(block[kZigzag[k]] * divisors[k]));
+  }
+  return EncodeCoefficients(writer, coefficients, dc, ac, dc_predictor);
+}
+
+void AppendMarker(std::vector<uint8_t>& out, uint8_t marker, size_t payload_size) {
+  out.push_back(0xFF);
+  out.push_back(marker);
+  if (payload_size > 0) {
+    out.push_back(static_cast<uint8_t>((payload_size + 2) >> 8));
+    out.push_back(static_cast<uint8_t>(payload_size + 2));
+  }
+}
+
+void AppendHuffmanTable(std::vector<uint8_t>& out, uint8_t class_and_id, const uint8_t counts[16],
+                        const uint8_t* values, size_t value_count) {
+  out.push_back(class_and_id);
+  out.insert(out.end(), counts, counts + 16);
+  out.insert(out.end(), values, values + value_count);
+}
+
+}  // namespace
+
+bool EncodeJpeg(const RgbImage& image, int quality, std::vector<uint8_t>& out) {
+  if (image.width <= 0 || image.height <= 0 || image.width > 65535 || image.height > 65535 ||
+      image.pixels.size() < static_cast<size_t>(image.width) * image.height * 3) {
+    return false;
+  }
+  static const Tables tables;
+
+  // libjpeg's quality scaling
+  quality = std::min(100, std::max(1, quality));
+  int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+  uint8_t quant[2][64];
+  float divisors[2][64];
+  for (int k = 0; k < 64; k++) {
+    quant[0][k] = static_cast<uint8_t>(std::min(255, std::max(1, (kLumaQuant[k] * scale + 50) / 100)));
+    quant[1][k] = static_cast<uint8_t>(std::min(255, std::max(1, (kChromaQuant[k] * scale + 50) / 100)));
+    int natural = kZigzag[k];
+    float aan = kAanScale[natural / 8] * kAanScale[natural % 8] * 8.0f;
+    divisors[0][k] = 1.0f / (quant[0][k] * aan);
+    divisors[1][k] = 1.0f / (quant[1][k] * aan);
+  }
+
+  out.clear();
+  out.reserve(static_cast<size_t>(image.width) * image.height / 4 + 1024);
+  AppendMarker(out, 0xD8, 0);  // SOI
+
+  AppendMarker(out, 0xE0, 14);  // JFIF APP0, 1:1 aspect
+  const uint8_t jfif[14] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+  out.insert(out.end(), jfif, jfif + sizeof(jfif));
+
+  AppendMarker(out, 0xDB, 2 * 65);  // DQT
+  for (int t = 0; t < 2; t++) {
+    out.push_back(static_cast<uint8_t>(t));
+    out.insert(out.end(), quant[t], quant[t] + 64);
+  }
+
+  AppendMarker(out, 0xC0, 15);  // SOF0, 4:2:0
+  const uint8_t frame[15] = {8,
+                             static_cast<uint8_t>(image.height >> 8),
+                             static_cast<uint8_t>(image.height),
+                             static_cast<uint8_t>(image.width >> 8),
+                             static_cast<uint8_t>(image.width),
+                             3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1};
+  out.insert(out.end(), frame, frame + sizeof(frame));
+
+  AppendMarker(out, 0xC4, 4 * 17 + 2 * 12 + 2 * 162);  // DHT
+  AppendHuffmanTable(out, 0x00, kLumaDcCounts, kLumaDcValues, 12);
+  AppendHuffmanTable(out, 0x10, kLumaAcCounts, kLumaAcValues, 162);
+  AppendHuffmanTable(out, 0x01, kChromaDcCounts, kChromaDcValues, 12);
+  AppendHuffmanTable(out, 0x11, kChromaAcCounts, kChromaAcValues, 162);
+
+  AppendMarker(out, 0xDA, 10);  // SOS
+  const uint8_t scan[10] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+  out.insert(out.end(), scan, scan + sizeof(scan));
+
+  // 16x16 MCUs: four luma blocks, then one 2x2-averaged block per chroma
+  // component. Edges repeat the last row / column.
+  BitWriter writer(out);
+  int dc_predictors[3] = {0, 0, 0};
+  bool ok = true;
+  float y_plane[16 * 16];
+  float cb_plane[16 * 16];
+  float cr_plane[16 * 16];
+  float block[64];
+  for (int mcu_y = 0; mcu_y < image.height; mcu_y += 16) {
+    for (int mcu_x = 0; mcu_x < image.width; mcu_x += 16) {
+      for (int y = 0; y < 16; y++) {
+        int source_y = std::min(mcu_y + y, image.height - 1);
+        const uint8_t* row = image.pixels.data() + static_cast<size_t>(source_y) * image.width * 3;
+        for (int x = 0; x < 16; x++) {
+          const uint8_t* pixel = row + std::min(mcu_x + x, image.width - 1) * 3;
+          float red = pixel[0];
+          float green = pixel[1];
+          float blue = pixel[2];
+          y_plane[y * 16 + x] = 0.299f * red + 0.587f * green + 0.114f * blue - 128.0f;
+          cb_plane[y * 16 + x] = -0.168736f * red - 0.331264f * green + 0.5f * blue;
+          cr_plane[y * 16 + x] = 0.5f * red - 0.418688f * green - 0.081312f * blue;
+        }
+      }
+
+      for (int b = 0; b < 4; b++) {
+        int origin = (b / 2) * 8 * 16 + (b % 2) * 8;
+        for (int i = 0; i < 64; i++) {
+          block[i] = y_plane[origin + (i / 8) * 16 + i % 8];
+        }
+        ok &= EncodeBlock(writer, block, divisors[0], tables.luma_dc, tables.luma_ac,
+                          dc_predictors[0]);
+      }
+      const float* chroma[2] = {cb_plane, cr_plane};
+      for (int c = 0; c < 2; c++) {
+        for (int i = 0; i < 64; i++) {
+          int origin = (i / 8) * 2 * 16 + (i % 8) * 2;
+          block[i] = 0.25f * (chroma[c][origin] + chroma[c][origin + 1] +
+                              chroma[c][origin + 16] + chroma[c][origin + 17]);
+        }
+        ok &= EncodeBlock(writer, block, divisors[1], tables.chroma_dc, tables.chroma_ac,
+                          dc_predictors[1 + c]);
+      }
+    }
+  }
+  writer.Flush();
+
+  AppendMarker(out, 0xD9, 0);  // EOI
+  return ok;
+}
+
+bool EncodeJpegCoefficients(const JpegCoefficients& image, std::vector<uint8_t>& out) {
+  int count = image.component_count;
+  if ((count != 1 && count != 3) || image.width <= 0 || image.height <= 0 ||
+      image.width > 65535 || image.height > 65535) {
+    return false;
+  }
+  int h_max = 1;
+  int v_max = 1;
+  for (int c = 0; c < count; c++) {
+    const JpegCoefficients::Plane& plane = image.planes[c];
+    h_max = std::max(h_max, plane.h);
+    v_max = std::max(v_max, plane.v);
+  }
+  int mcus_x = (image.width + 8 * h_max - 1) / (8 * h_max);
+  int mcus_y = (image.height + 8 * v_max - 1) / (8 * v_max);
+  bool quant_used[4] = {false, false, false, false};
+  for (int c = 0; c < count; c++) {
+    const JpegCoefficients::Plane& plane = image.planes[c];
+    if (plane.h < 1 || plane.h > 4 || plane.v < 1 || plane.v > 4 ||
+        plane.quant_table < 0 || plane.quant_table > 3 || plane.blocks_x < mcus_x * plane.h ||
+        plane.blocks_y < mcus_y * plane.v ||
+        plane.blocks.size() < static_cast<size_t>(plane.blocks_x) * plane.blocks_y * 64) {
+      return false;
+    }
+    quant_used[plane.quant_table] = true;
+  }
+  static const Tables tables;
+
+  out.clear();
+  out.reserve(static_cast<size_t>(image.width) * image.height / 4 + 1024);
+  AppendMarker(out, 0xD8, 0);  // SOI
+
+  for (int t = 0; t < 4; t++) {
+    if (!quant_used[t]) {
+      continue;
+    }
+    bool wide = *std::max_element(image.quant[t], image.quant[t] + 64) > 255;
+    AppendMarker(out, 0xDB, wide ? 129 : 65);  // DQT
+    out.push_back(static_cast<uint8_t>((wide ? 0x10 : 0x00) | t));
+    for (int k = 0; k < 64; k++) {
+      if (wide) {
+        out.push_back(static_cast<uint8_t>(image.quant[t][k] >> 8));
+      }
+      out.push_back(static_cast<uint8_t>(image.quant[t][k]));
+    }
+  }
+
+  AppendMarker(out, 0xC0, 6 + 3 * count);  // SOF0
+  const uint8_t frame[6] = {8,
+                            static_cast<uint8_t>(image.height >> 8),
+                            static_cast<uint8_t>(image.height),
+                            static_cast<uint8_t>(image.width >> 8),
+                            static_cast<uint8_t>(image.width),
+                            static_cast<uint8_t>(count)};
+  out.insert(out.end(), frame, frame + sizeof(frame));
+  for (int c = 0; c < count; c++) {
+    const JpegCoefficients::Plane& plane = image.planes[c];
+    out.push_back(static_cast<uint8_t>(c + 1));
+    out.push_back(static_cast<uint8_t>((plane.h << 4) | plane.v));
+    out.push_back(static_cast<uint8_t>(plane.quant_table));
+  }
+
+  // Luma tables for the first component, chroma tables for the others
+  AppendMarker(out, 0xC4, (count == 3 ? 2 : 1) * (2 * 17 + 12 + 162));  // DHT
+  AppendHuffmanTable(out, 0x00, kLumaDcCounts, kLumaDcValues, 12);
+  AppendHuffmanTable(out, 0x10, kLumaAcCounts, kLumaAcValues, 162);
+  if (count == 3) {
+    AppendHuffmanTable(out, 0x01, kChromaDcCounts, kChromaDcValues, 12);
+    AppendHuffmanTable(out, 0x11, kChromaAcCounts, kChromaAcValues, 162);
+  }
+
+  AppendMarker(out, 0xDA, 4 + 2 * count);  // SOS
+  out.push_back(static_cast<uint8_t>(count));
+  for (int c = 0; c < count; c++) {
+    out.push_back(static_cast<uint8_t>(c + 1));
+    out.push_back(c == 0 ? 0x00 : 0x11);
+  }
+  const uint8_t spectral[3] = {0, 63, 0};
+  out.insert(out.end(), spectral, spectral + sizeof(spectral));
+
+  BitWriter writer(out);
+  int dc_predictors[3] = {0, 0, 0};
+  for (int mcu_y = 0; mcu_y < mcus_y; mcu_y++) {
+    for (int mcu_x = 0; mcu_x < mcus_x; mcu_x++) {
+      for (int c = 0; c < count; c++) {
+        const JpegCoefficients::Plane& plane = image.planes[c];
+        const HuffmanCode& dc = c == 0 ? tables.luma_dc : tables.chroma_dc;
+        const HuffmanCode& ac = c == 0 ? tables.luma_ac : tables.chroma_ac;
+        for (int by = 0; by < plane.v; by++) {
+          for (int bx = 0; bx < plane.h; bx++) {
+            if (!EncodeCoefficients(writer,
+                                    plane.block(mcu_x * plane.h + bx, mcu_y * plane.v + by), dc,
+                                    ac, dc_predictors[c])) {
+              return false;
+            }
+          }
+        }
+      }
+    }
+  }
+  writer.Flush();
+
+  AppendMarker(out, 0xD9, 0);  // EOI
+  return true;
+}
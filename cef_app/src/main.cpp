@@ -4,6 +4,7 @@
 #include "client_handler.h"
 
 #include "include/cef_app.h"
+#include "include/cef_command_line.h"
 
 #if defined(OS_WIN)
 #include "include/cef_sandbox_win.h"
@@ -59,6 +60,16 @@ int main(int argc, char* argv[]) {
   // Enable remote debugging for OAuth debugging
   settings.remote_debugging_port = 9222;
 
+  // An off-screen meeting view (--meeting-osr) needs windowless rendering,
+  // which costs some rendering performance when it is not used
+  CefRefPtr<CefCommandLine> command_line = CefCommandLine::CreateCommandLine();
+#if defined(OS_WIN)
+  command_line->InitFromString(::GetCommandLineW());
+#else
+  command_line->InitFromArgv(argc, argv);
+#endif
+  settings.windowless_rendering_enabled = ClientHandler::UseOffScreenRendering(command_line);
+
   // SimpleApp implements application-level callbacks for the browser process
   // It will create the first browser instance in OnContextInitialized() after
   // CEF has been initialized
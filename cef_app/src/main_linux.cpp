@@ -4,9 +4,223 @@
 #include "client_handler.h"
 
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
 
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include "include/base/cef_callback.h"
 #include "include/base/cef_logging.h"
 #include "include/cef_browser.h"
+#include "include/wrapper/cef_closure_task.h"
+
+namespace {
+
+// The off-screen content browser's window lives on an X connection of its
+// own, so its input events are not consumed by Chromium's event loop. They
+// are drained from the UI thread every few milliseconds.
+::Display* g_osr_display = nullptr;
+GC g_osr_gc = nullptr;
+int g_osr_pump_generation = 0;  // Stops the pump of a destroyed window
+
+const int64_t kOsrEventIntervalMs = 8;
+const int kWheelDelta = 120;
+const Time kDoubleClickMs = 500;
+const int kDoubleClickDistance = 4;
+
+// Click counting for double and triple clicks
+unsigned int g_last_click_button = 0;
+Time g_last_click_time = 0;
+int g_last_click_x = 0;
+int g_last_click_y = 0;
+int g_click_count = 0;
+
+uint32_t GetEventFlags(unsigned int state) {
+  uint32_t flags = EVENTFLAG_NONE;
+  if (state & ShiftMask) flags |= EVENTFLAG_SHIFT_DOWN;
+  if (state & LockMask) flags |= EVENTFLAG_CAPS_LOCK_ON;
+  if (state & ControlMask) flags |= EVENTFLAG_CONTROL_DOWN;
+  if (state & Mod1Mask) flags |= EVENTFLAG_ALT_DOWN;
+  if (state & Button1Mask) flags |= EVENTFLAG_LEFT_MOUSE_BUTTON;
+  if (state & Button2Mask) flags |= EVENTFLAG_MIDDLE_MOUSE_BUTTON;
+  if (state & Button3Mask) flags |= EVENTFLAG_RIGHT_MOUSE_BUTTON;
+  return flags;
+}
+
+// Windows virtual key code of |keysym|, which Chromium expects in key
+// events on every platform. Keys not listed are sent as text only.
+int GetWindowsKeyCode(KeySym keysym) {
+  if (keysym >= XK_a && keysym <= XK_z) return 'A' + static_cast<int>(keysym - XK_a);
+  if (keysym >= XK_A && keysym <= XK_Z) return 'A' + static_cast<int>(keysym - XK_A);
+  if (keysym >= XK_0 && keysym <= XK_9) return '0' + static_cast<int>(keysym - XK_0);
+  if (keysym >= XK_KP_0 && keysym <= XK_KP_9) return 0x60 + static_cast<int>(keysym - XK_KP_0);
+  if (keysym >= XK_F1 && keysym <= XK_F12) return 0x70 + static_cast<int>(keysym - XK_F1);
+  switch (keysym) {
+    case XK_BackSpace: return 0x08;
+    case XK_Tab:
+    case XK_ISO_Left_Tab: return 0x09;
+    case XK_Return:
+    case XK_KP_Enter: return 0x0D;
+    case XK_Shift_L:
+    case XK_Shift_R: return 0x10;
+    case XK_Control_L:
+    case XK_Control_R: return 0x11;
+    case XK_Alt_L:
+    case XK_Alt_R: return 0x12;
+    case XK_Pause: return 0x13;
+    case XK_Caps_Lock: return 0x14;
+    case XK_Escape: return 0x1B;
+    case XK_space: return 0x20;
+    case XK_Prior: return 0x21;
+    case XK_Next: return 0x22;
+    case XK_End: return 0x23;
+    case XK_Home: return 0x24;
+    case XK_Left: return 0x25;
+    case XK_Up: return 0x26;
+    case XK_Right: return 0x27;
+    case XK_Down: return 0x28;
+    case XK_Insert: return 0x2D;
+    case XK_Delete: return 0x2E;
+    case XK_semicolon:
+    case XK_colon: return 0xBA;
+    case XK_equal:
+    case XK_plus: return 0xBB;
+    case XK_comma:
+    case XK_less: return 0xBC;
+    case XK_minus:
+    case XK_underscore: return 0xBD;
+    case XK_period:
+    case XK_greater: return 0xBE;
+    case XK_slash:
+    case XK_question: return 0xBF;
+    case XK_grave:
+    case XK_asciitilde: return 0xC0;
+    case XK_bracketleft:
+    case XK_braceleft: return 0xDB;
+    case XK_backslash:
+    case XK_bar: return 0xDC;
+    case XK_bracketright:
+    case XK_braceright: return 0xDD;
+    case XK_apostrophe:
+    case XK_quotedbl: return 0xDE;
+    default: return 0;
+  }
+}
+
+void HandleOsrEvent(CefRefPtr<CefBrowserHost> host, XEvent& event) {
+  switch (event.type) {
+    case Expose:
+      if (event.xexpose.count == 0) {
+        host->Invalidate(PET_VIEW);
+      }
+      break;
+
+    case ButtonPress:
+    case ButtonRelease: {
+      const XButtonEvent& button = event.xbutton;
+      bool up = event.type == ButtonRelease;
+      CefMouseEvent mouse;
+      mouse.x = button.x;
+      mouse.y = button.y;
+      mouse.modifiers = GetEventFlags(button.state);
+
+      // Buttons 4-7 are the wheel; X sends a press and a release per notch
+      if (button.button >= 4 && button.button <= 7) {
+        if (!up) {
+          int delta = (button.button == 4 || button.button == 6) ? kWheelDelta : -kWheelDelta;
+          bool horizontal = button.button >= 6;
+          host->SendMouseWheelEvent(mouse, horizontal ? delta : 0, horizontal ? 0 : delta);
+        }
+        break;
+      }
+
+      CefBrowserHost::MouseButtonType type = MBT_LEFT;
+      if (button.button == Button2) {
+        type = MBT_MIDDLE;
+      } else if (button.button == Button3) {
+        type = MBT_RIGHT;
+      } else if (button.button != Button1) {
+        break;
+      }
+      if (!up) {
+        bool repeated = button.button == g_last_click_button &&
+                        button.time - g_last_click_time < kDoubleClickMs &&
+                        std::abs(button.x - g_last_click_x) <= kDoubleClickDistance &&
+                        std::abs(button.y - g_last_click_y) <= kDoubleClickDistance;
+        g_click_count = repeated ? std::min(g_click_count + 1, 3) : 1;
+        g_last_click_button = button.button;
+        g_last_click_time = button.time;
+        g_last_click_x = button.x;
+        g_last_click_y = button.y;
+
+        // Keyboard input goes to whichever window was clicked last
+        XSetInputFocus(g_osr_display, button.window, RevertToParent, CurrentTime);
+      }
+      host->SendMouseClickEvent(mouse, type, up, std::max(1, g_click_count));
+      break;
+    }
+
+    case MotionNotify:
+    case LeaveNotify: {
+      CefMouseEvent mouse;
+      mouse.x = event.type == MotionNotify ? event.xmotion.x : event.xcrossing.x;
+      mouse.y = event.type == MotionNotify ? event.xmotion.y : event.xcrossing.y;
+      mouse.modifiers =
+          GetEventFlags(event.type == MotionNotify ? event.xmotion.state : event.xcrossing.state);
+      host->SendMouseMoveEvent(mouse, event.type == LeaveNotify);
+      break;
+    }
+
+    case KeyPress:
+    case KeyRelease: {
+      char text[8];
+      KeySym keysym = NoSymbol;
+      int length = XLookupString(&event.xkey, text, sizeof(text), &keysym, nullptr);
+
+      CefKeyEvent key;
+      key.windows_key_code = GetWindowsKeyCode(keysym);
+      key.native_key_code = static_cast<int>(event.xkey.keycode);
+      key.modifiers = GetEventFlags(event.xkey.state);
+      key.type = event.type == KeyPress ? KEYEVENT_RAWKEYDOWN : KEYEVENT_KEYUP;
+      host->SendKeyEvent(key);
+
+      // XLookupString yields Latin-1, which maps 1:1 onto UTF-16
+      if (event.type == KeyPress && length == 1) {
+        key.type = KEYEVENT_CHAR;
+        key.character = key.unmodified_character = static_cast<unsigned char>(text[0]);
+        host->SendKeyEvent(key);
+      }
+      break;
+    }
+
+    case FocusIn:
+    case FocusOut:
+      host->SetFocus(event.type == FocusIn);
+      break;
+  }
+}
+
+void PumpOsrEvents(CefRefPtr<ClientHandler> handler, int generation) {
+  if (generation != g_osr_pump_generation) {
+    return;
+  }
+  // Events that arrive before the browser exists are dropped; it paints
+  // the whole view once it is created
+  CefRefPtr<CefBrowser> browser = handler->GetContentBrowser();
+  while (XPending(g_osr_display) > 0) {
+    XEvent event;
+    XNextEvent(g_osr_display, &event);
+    if (browser) {
+      HandleOsrEvent(browser->GetHost(), event);
+    }
+  }
+  CefPostDelayedTask(TID_UI, base::BindOnce(&PumpOsrEvents, handler, generation),
+                     kOsrEventIntervalMs);
+}
+
+}  // namespace
 
 void ClientHandler::PlatformTitleChange(CefRefPtr<CefBrowser> browser,
                                        const CefString& title) {
@@ -16,8 +230,12 @@ void ClientHandler::PlatformTitleChange(CefRefPtr<CefBrowser> browser,
   ::Display* display = cef_get_xdisplay();
   DCHECK(display);
 
-  // Retrieve the X11 window handle for the browser
+  // Retrieve the X11 window handle for the browser; an off-screen browser
+  // is shown in a window of ours
   ::Window window = browser->GetHost()->GetWindowHandle();
+  if (window == kNullWindowHandle) {
+    window = osr_window_;
+  }
   DCHECK(window != kNullWindowHandle);
 
   // Set the window title
@@ -39,7 +257,8 @@ void ClientHandler::PlatformOpenURL(const std::string& url) {
 }
 
 void ClientHandler::PlatformUpdateMeetingBounds(CefRefPtr<CefBrowser> browser, int x, int y, int width, int height) {
-  Window window = browser->GetHost()->GetWindowHandle();
+  Window window = osr_window_ != kNullWindowHandle ? osr_window_
+                                                   : browser->GetHost()->GetWindowHandle();
   Display* display = cef_get_xdisplay();
   
   if (window != kNullWindowHandle && display) {
@@ -50,7 +269,8 @@ void ClientHandler::PlatformUpdateMeetingBounds(CefRefPtr<CefBrowser> browser, i
 }
 
 void ClientHandler::PlatformShowMeetingView(CefRefPtr<CefBrowser> browser) {
-  Window window = browser->GetHost()->GetWindowHandle();
+  Window window = osr_window_ != kNullWindowHandle ? osr_window_
+                                                   : browser->GetHost()->GetWindowHandle();
   Display* display = cef_get_xdisplay();
   if (window != kNullWindowHandle && display) {
     XMapWindow(display, window);
@@ -60,7 +280,8 @@ void ClientHandler::PlatformShowMeetingView(CefRefPtr<CefBrowser> browser) {
 }
 
 void ClientHandler::PlatformHideMeetingView(CefRefPtr<CefBrowser> browser) {
-  Window window = browser->GetHost()->GetWindowHandle();
+  Window window = osr_window_ != kNullWindowHandle ? osr_window_
+                                                   : browser->GetHost()->GetWindowHandle();
   Display* display = cef_get_xdisplay();
   if (window != kNullWindowHandle && display) {
     XUnmapWindow(display, window);
@@ -72,6 +293,102 @@ void ClientHandler::PlatformCloseMeetingView(CefRefPtr<CefBrowser> browser) {
   // No special handling needed on Linux
 }
 
+bool ClientHandler::PlatformCreateOsrWindow(int x, int y, int width, int height) {
+  if (osr_window_ != kNullWindowHandle) {
+    return true;
+  }
+  ::Window parent = browser_list_.empty() ? kNullWindowHandle
+                                          : browser_list_.front()->GetHost()->GetWindowHandle();
+  if (parent == kNullWindowHandle) {
+    return false;
+  }
+  if (!g_osr_display) {
+    g_osr_display = XOpenDisplay(nullptr);
+    if (!g_osr_display) {
+      std::cerr << "[Browser] Off-screen rendering: cannot open the X display" << std::endl;
+      return false;
+    }
+  }
+
+  // BGRA paints are a 24-bit TrueColor image as they are; anything else
+  // would need a conversion per paint
+  int screen = DefaultScreen(g_osr_display);
+  Visual* visual = DefaultVisual(g_osr_display, screen);
+  if (DefaultDepth(g_osr_display, screen) < 24 || visual->red_mask != 0xFF0000 ||
+      visual->green_mask != 0xFF00 || visual->blue_mask != 0xFF) {
+    std::cerr << "[Browser] Off-screen rendering: unsupported X visual" << std::endl;
+    return false;
+  }
+
+  ::Window window = XCreateSimpleWindow(g_osr_display, parent, x, y, std::max(1, width),
+                                        std::max(1, height), 0, 0,
+                                        BlackPixel(g_osr_display, screen));
+  XSelectInput(g_osr_display, window,
+               ExposureMask | ButtonPressMask | ButtonReleaseMask | PointerMotionMask |
+                   LeaveWindowMask | KeyPressMask | KeyReleaseMask | FocusChangeMask);
+  g_osr_gc = XCreateGC(g_osr_display, window, 0, nullptr);
+  XMapRaised(g_osr_display, window);
+  XFlush(g_osr_display);
+  osr_window_ = window;
+
+  CefPostDelayedTask(TID_UI, base::BindOnce(&PumpOsrEvents, CefRefPtr<ClientHandler>(this),
+                                            ++g_osr_pump_generation),
+                     kOsrEventIntervalMs);
+  std::cout << "[Browser] Off-screen content browser window: " << window << std::endl;
+  return true;
+}
+
+void ClientHandler::PlatformPaintOsrWindow(const void* buffer, int width, int height,
+                                           const RectList& dirty_rects, int offset_x,
+                                           int offset_y) {
+  if (osr_window_ == kNullWindowHandle) {
+    return;
+  }
+  int screen = DefaultScreen(g_osr_display);
+  XImage* image = XCreateImage(g_osr_display, DefaultVisual(g_osr_display, screen),
+                               DefaultDepth(g_osr_display, screen), ZPixmap, 0,
+                               static_cast<char*>(const_cast<void*>(buffer)), width, height, 32,
+                               width * 4);
+  if (!image) {
+    return;
+  }
+  image->byte_order = LSBFirst;  // BGRA bytes are 0xAARRGGBB words in little endian
+
+  // Only the damaged parts are sent to the X server
+  for (const CefRect& rect : dirty_rects) {
+    int left = std::max(0, rect.x);
+    int top = std::max(0, rect.y);
+    int right = std::min(width, rect.x + rect.width);
+    int bottom = std::min(height, rect.y + rect.height);
+    if (right > left && bottom > top) {
+      XPutImage(g_osr_display, osr_window_, g_osr_gc, image, left, top, offset_x + left,
+                offset_y + top, right - left, bottom - top);
+    }
+  }
+  image->data = nullptr;  // Owned by CEF
+  XDestroyImage(image);
+  XFlush(g_osr_display);
+}
+
+void ClientHandler::PlatformSetOsrCursor(CefCursorHandle cursor) {
+  if (osr_window_ != kNullWindowHandle) {
+    XDefineCursor(g_osr_display, osr_window_, cursor);
+    XFlush(g_osr_display);
+  }
+}
+
+void ClientHandler::PlatformDestroyOsrWindow() {
+  if (osr_window_ == kNullWindowHandle) {
+    return;
+  }
+  g_osr_pump_generation++;
+  XFreeGC(g_osr_display, g_osr_gc);
+  g_osr_gc = nullptr;
+  XDestroyWindow(g_osr_display, osr_window_);
+  XFlush(g_osr_display);
+  osr_window_ = kNullWindowHandle;
+}
+
 void ClientHandler::PlatformCustomizeWindow(CefRefPtr<CefBrowser> browser) {
   // No window customization needed on Linux
   // Linux window managers handle window decorations
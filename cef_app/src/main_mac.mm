@@ -110,3 +110,16 @@ void ClientHandler::PlatformCloseMeetingView(CefRefPtr<CefBrowser> browser) {
     [view setHidden:YES];
   }
 }
+
+bool ClientHandler::PlatformCreateOsrWindow(int x, int y, int width, int height) {
+  // Off-screen rendering of the meeting view is Linux-only
+  return false;
+}
+
+void ClientHandler::PlatformPaintOsrWindow(const void* buffer, int width, int height,
+                                           const RectList& dirty_rects, int offset_x,
+                                           int offset_y) {}
+
+void ClientHandler::PlatformSetOsrCursor(CefCursorHandle cursor) {}
+
+void ClientHandler::PlatformDestroyOsrWindow() {}
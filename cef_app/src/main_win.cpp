@@ -48,6 +48,19 @@ void ClientHandler::PlatformCloseMeetingView(CefRefPtr<CefBrowser> browser) {
   // No special handling needed on Windows
 }
 
+bool ClientHandler::PlatformCreateOsrWindow(int x, int y, int width, int height) {
+  // Off-screen rendering of the meeting view is Linux-only
+  return false;
+}
+
+void ClientHandler::PlatformPaintOsrWindow(const void* buffer, int width, int height,
+                                           const RectList& dirty_rects, int offset_x,
+                                           int offset_y) {}
+
+void ClientHandler::PlatformSetOsrCursor(CefCursorHandle cursor) {}
+
+void ClientHandler::PlatformDestroyOsrWindow() {}
+
 void ClientHandler::PlatformCustomizeWindow(CefRefPtr<CefBrowser> browser) {
   // No window customization needed on Windows
   // Windows uses standard window decorations
@@ -0,0 +1,271 @@
+#include "matroska_reader.h"
+#include "ebml.h"
+#include "tile_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Largest Info / Tracks / BlockGroup element or frame read into memory
+const uint64_t kMaxElementInMemory = 16 * 1024 * 1024;
+
+// Next element in an in-memory master element payload
+bool NextElement(const uint8_t*& data, const uint8_t* end, uint32_t& id,
+                 const uint8_t*& payload, uint64_t& size) {
+  uint64_t value;
+  int id_length = ebml::ReadVarInt(data, end - data, true, value);
+  if (id_length == 0) {
+    return false;
+  }
+  id = static_cast<uint32_t>(value);
+  int size_length = ebml::ReadVarInt(data + id_length, end - data - id_length, false, size);
+  if (size_length == 0 || size > static_cast<uint64_t>(end - data - id_length - size_length)) {
+    return false;
+  }
+  payload = data + id_length + size_length;
+  data = payload + size;
+  return true;
+}
+
+uint64_t ReadUnsigned(const uint8_t* data, uint64_t size) {
+  uint64_t value = 0;
+  for (uint64_t i = 0; i < size && i < 8; i++) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+double ReadFloat(const uint8_t* data, uint64_t size) {
+  uint64_t bits = ReadUnsigned(data, size);
+  if (size == 4) {
+    uint32_t narrow = static_cast<uint32_t>(bits);
+    float value;
+    memcpy(&value, &narrow, sizeof(value));
+    return value;
+  }
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return size == 8 ? value : 0.0;
+}
+
+}  // namespace
+
+MatroskaReader::MatroskaReader() {}
+
+MatroskaReader::~MatroskaReader() {}
+
+bool MatroskaReader::Read(const std::string& path, const FrameCallback& callback) {
+  file_.open(path, std::ios::in | std::ios::binary);
+  uint32_t id;
+  uint64_t size;
+  bool unknown;
+  if (!ReadHeader(id, size, unknown) || id != ebml::kEbml || unknown ||
+      !file_.seekg(static_cast<std::streamoff>(size), std::ios::cur) ||
+      !ReadHeader(id, size, unknown) || id != ebml::kSegment) {
+    return false;
+  }
+
+  while (next_timestamp_ms_ != std::numeric_limits<int64_t>::max() &&
+         ReadHeader(id, size, unknown)) {
+    if (id == ebml::kCluster) {
+      continue;  // Children are read in the same loop
+    }
+    if (unknown) {
+      break;
+    }
+
+    if (id == ebml::kClusterTimestamp || id == ebml::kInfo || id == ebml::kTracks ||
+        id == ebml::kBlockGroup) {
+      if (size > kMaxElementInMemory || !ReadPayload(size)) {
+        break;
+      }
+      if (id == ebml::kClusterTimestamp) {
+        cluster_timestamp_ = ReadUnsigned(buffer_.data(), size);
+      } else if (id == ebml::kInfo) {
+        ParseInfo();
+      } else if (id == ebml::kTracks) {
+        if (!FindVideoTrack()) {
+          return false;
+        }
+      } else if (track_number_ != 0) {
+        const uint8_t* data = buffer_.data();
+        const uint8_t* payload;
+        uint64_t child_size;
+        uint32_t child_id;
+        while (NextElement(data, buffer_.data() + size, child_id, payload, child_size)) {
+          if (child_id == ebml::kBlock) {
+            HandleBlockInMemory(payload, child_size, callback);
+          }
+        }
+      }
+    } else if (id == ebml::kSimpleBlock && track_number_ != 0) {
+      if (!HandleSimpleBlock(size, callback)) {
+        break;
+      }
+    } else if (!file_.seekg(static_cast<std::streamoff>(size), std::ios::cur)) {
+      break;
+    }
+  }
+  return track_number_ != 0;
+}
+
+bool MatroskaReader::ReadVarInt(bool keep_marker, uint64_t& value, int& length) {
+  uint8_t bytes[8];
+  if (!file_.read(reinterpret_cast<char*>(bytes), 1) || bytes[0] == 0) {
+    return false;
+  }
+  length = 1;
+  while (!(bytes[0] & (0x80 >> (length - 1)))) {
+    length++;
+  }
+  if (length > 1 && !file_.read(reinterpret_cast<char*>(bytes + 1), length - 1)) {
+    return false;
+  }
+  return ebml::ReadVarInt(bytes, length, keep_marker, value) == length;
+}
+
+bool MatroskaReader::ReadHeader(uint32_t& id, uint64_t& size, bool& unknown) {
+  uint64_t value;
+  int length;
+  if (!ReadVarInt(true, value, length) || length > 4) {
+    return false;
+  }
+  id = static_cast<uint32_t>(value);
+  if (!ReadVarInt(false, size, length)) {
+    return false;
+  }
+  unknown = ebml::IsUnknownSize(size, length);
+  return true;
+}
+
+bool MatroskaReader::ReadPayload(uint64_t size) {
+  buffer_.resize(static_cast<size_t>(size));
+  return size == 0 ||
+         static_cast<bool>(file_.read(reinterpret_cast<char*>(buffer_.data()),
+                                      static_cast<std::streamsize>(size)));
+}
+
+void MatroskaReader::ParseInfo() {
+  const uint8_t* data = buffer_.data();
+  const uint8_t* end = data + buffer_.size();
+  const uint8_t* payload;
+  uint64_t size;
+  uint32_t id;
+  double duration = 0.0;
+  while (NextElement(data, end, id, payload, size)) {
+    if (id == ebml::kTimestampScale) {
+      timestamp_scale_ = std::max<uint64_t>(1, ReadUnsigned(payload, size));
+    } else if (id == ebml::kDuration) {
+      duration = ReadFloat(payload, size);
+    }
+  }
+  duration_ms_ = static_cast<int64_t>(duration * timestamp_scale_ / 1000000.0);
+}
+
+bool MatroskaReader::FindVideoTrack() {
+  const uint8_t* data = buffer_.data();
+  const uint8_t* end = data + buffer_.size();
+  const uint8_t* entry;
+  uint64_t entry_size;
+  uint32_t id;
+  while (NextElement(data, end, id, entry, entry_size)) {
+    if (id != ebml::kTrackEntry) {
+      continue;
+    }
+    uint64_t number = 0;
+    std::string codec;
+    const uint8_t* child = entry;
+    const uint8_t* payload;
+    uint64_t size;
+    while (NextElement(child, entry + entry_size, id, payload, size)) {
+      if (id == ebml::kTrackNumber) {
+        number = ReadUnsigned(payload, size);
+      } else if (id == ebml::kCodecId) {
+        codec.assign(reinterpret_cast<const char*>(payload), static_cast<size_t>(size));
+      }
+    }
+    if ((codec == "V_MJPEG" || codec == kTileCodecId) && number != 0) {
+      track_number_ = number;
+      if (codec == kTileCodecId) {
+        tile_decoder_.reset(new TileDecoder());
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+// Block header: track number, 16-bit relative timestamp, flags
+bool MatroskaReader::ParseBlockHeader(const uint8_t* data, size_t size, int64_t& timestamp_ms,
+                                      size_t& header_size) {
+  uint64_t track;
+  int length = ebml::ReadVarInt(data, size, false, track);
+  if (length == 0 || size < static_cast<size_t>(length) + 3 || track != track_number_ ||
+      (data[length + 2] & 0x06) != 0) {  // Laced blocks are not produced for video
+    return false;
+  }
+  int16_t relative = static_cast<int16_t>((data[length] << 8) | data[length + 1]);
+  int64_t ticks = static_cast<int64_t>(cluster_timestamp_) + relative;
+  timestamp_ms = static_cast<int64_t>(ticks * static_cast<double>(timestamp_scale_) / 1000000.0);
+  header_size = length + 3;
+  return true;
+}
+
+void MatroskaReader::HandleBlockInMemory(const uint8_t* data, uint64_t size,
+                                         const FrameCallback& callback) {
+  int64_t timestamp_ms;
+  size_t header_size;
+  if (ParseBlockHeader(data, static_cast<size_t>(size), timestamp_ms, header_size) &&
+      (tile_decoder_ || timestamp_ms >= next_timestamp_ms_)) {
+    HandleFrame(data + header_size, static_cast<size_t>(size) - header_size, timestamp_ms,
+                callback);
+  }
+}
+
+// Reads the block header and, if the frame is wanted, the frame; skips the
+// rest otherwise. Every tile record is wanted, since later frames build on it.
+bool MatroskaReader::HandleSimpleBlock(uint64_t size, const FrameCallback& callback) {
+  uint8_t header[11];
+  size_t peek = static_cast<size_t>(std::min<uint64_t>(size, sizeof(header)));
+  if (!file_.read(reinterpret_cast<char*>(header), peek)) {
+    return false;
+  }
+  int64_t timestamp_ms;
+  size_t header_size;
+  bool wanted = ParseBlockHeader(header, peek, timestamp_ms, header_size) &&
+                (tile_decoder_ || timestamp_ms >= next_timestamp_ms_) &&
+                size <= kMaxElementInMemory;
+  if (!wanted) {
+    return static_cast<bool>(
+        file_.seekg(static_cast<std::streamoff>(size - peek), std::ios::cur));
+  }
+
+  size_t frame_size = static_cast<size_t>(size) - header_size;
+  buffer_.resize(frame_size);
+  size_t copied = peek - header_size;
+  memcpy(buffer_.data(), header + header_size, copied);
+  if (frame_size > copied &&
+      !file_.read(reinterpret_cast<char*>(buffer_.data() + copied),
+                  static_cast<std::streamsize>(frame_size - copied))) {
+    return false;
+  }
+  HandleFrame(buffer_.data(), frame_size, timestamp_ms, callback);
+  return true;
+}
+
+void MatroskaReader::HandleFrame(const uint8_t* data, size_t size, int64_t timestamp_ms,
+                                 const FrameCallback& callback) {
+  if (!tile_decoder_) {
+    next_timestamp_ms_ = callback(data, size, timestamp_ms);
+    return;
+  }
+  // Damaged records make the decoder skip ahead to the next keyframe
+  const uint8_t* jpeg;
+  size_t jpeg_size;
+  if (tile_decoder_->Apply(data, size) && timestamp_ms >= next_timestamp_ms_ &&
+      tile_decoder_->GetFrame(jpeg, jpeg_size)) {
+    next_timestamp_ms_ = callback(jpeg, jpeg_size, timestamp_ms);
+  }
+}
@@ -0,0 +1,276 @@
+#include "matroska_writer.h"
+#include "ebml.h"
+
+#include <iostream>
+
+using namespace ebml;
+
+namespace {
+
+// Space reserved after the Segment header for the SeekHead written on Close()
+const size_t kSeekHeadReserve = 96;
+
+// Clusters are closed after this long so the relative int16 block timestamps
+// never overflow and every few seconds of intra-only video has a cue point.
+const int64_t kMaxClusterDurationMs = 5000;
+
+}  // namespace
+
+MatroskaWriter::MatroskaWriter()
+    : bytes_written_(0),
+      segment_size_position_(0),
+      segment_data_start_(0),
+      seek_head_position_(0),
+      duration_position_(0),
+      info_position_(0),
+      tracks_position_(0),
+      cluster_open_(false),
+      cluster_position_(0),
+      cluster_size_position_(0),
+      cluster_timestamp_ms_(0),
+      cluster_keyframe_(false),
+      last_timestamp_ms_(0),
+      frame_count_(0) {}
+
+MatroskaWriter::~MatroskaWriter() {
+  if (file_.is_open()) {
+    Close();
+  }
+}
+
+bool MatroskaWriter::Open(const std::string& path,
+                          const std::string& doc_type,
+                          const std::string& codec_id,
+                          int width,
+                          int height) {
+  file_.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (!file_.is_open()) {
+    std::cerr << "[Matroska] Failed to open " << path << std::endl;
+    return false;
+  }
+
+  bytes_written_ = 0;
+  cluster_open_ = false;
+  last_timestamp_ms_ = 0;
+  frame_count_ = 0;
+  cues_.clear();
+
+  // EBML header
+  std::string ebml;
+  AppendUInt(ebml, kEbmlVersion, 1);
+  AppendUInt(ebml, kEbmlReadVersion, 1);
+  AppendUInt(ebml, kEbmlMaxIdLength, 4);
+  AppendUInt(ebml, kEbmlMaxSizeLength, 8);
+  AppendString(ebml, kDocType, doc_type);
+  AppendUInt(ebml, kDocTypeVersion, 4);
+  AppendUInt(ebml, kDocTypeReadVersion, 2);
+
+  std::string header;
+  AppendMaster(header, kEbml, ebml);
+
+  // Segment with an unknown size, patched on Close()
+  AppendId(header, kSegment);
+  segment_size_position_ = header.size();
+  AppendFixedSize(header, kUnknownSize);
+  segment_data_start_ = header.size();
+
+  // Reserve room for the SeekHead
+  seek_head_position_ = header.size();
+  AppendVoid(header, kSeekHeadReserve);
+
+  // Info, with a Duration placeholder
+  std::string info;
+  AppendUInt(info, kTimestampScale, 1000000);  // Block timestamps in ms
+  AppendString(info, kMuxingApp, "Rebraze");
+  AppendString(info, kWritingApp, "Rebraze");
+  size_t duration_offset = info.size();
+  AppendFloat(info, kDuration, 0.0);
+
+  info_position_ = header.size();
+  AppendId(header, kInfo);
+  AppendSize(header, info.size());
+  // Duration value is the last 8 bytes of its element
+  duration_position_ = header.size() + duration_offset + 3;
+  header.append(info);
+
+  // Tracks
+  std::string video;
+  AppendUInt(video, kPixelWidth, width > 0 ? width : 1);
+  AppendUInt(video, kPixelHeight, height > 0 ? height : 1);
+
+  std::string track;
+  AppendUInt(track, kTrackNumber, 1);
+  AppendUInt(track, kTrackUid, 1);
+  AppendUInt(track, kTrackType, 1);  // Video
+  AppendUInt(track, kFlagLacing, 0);
+  AppendString(track, kCodecId, codec_id);
+  AppendMaster(track, kVideo, video);
+
+  std::string tracks;
+  AppendMaster(tracks, kTrackEntry, track);
+
+  tracks_position_ = header.size();
+  AppendMaster(header, kTracks, tracks);
+
+  return WriteBytes(header.data(), header.size());
+}
+
+bool MatroskaWriter::WriteFrame(const uint8_t* data,
+                                size_t size,
+                                int64_t timestamp_ms,
+                                bool keyframe) {
+  if (!file_.is_open()) {
+    return false;
+  }
+
+  if (timestamp_ms < last_timestamp_ms_) {
+    timestamp_ms = last_timestamp_ms_;
+  }
+
+  // A keyframe starts a cluster of its own, and with it a cue point, unless
+  // the current cluster already starts with one and is young
+  if (!cluster_open_ ||
+      timestamp_ms - cluster_timestamp_ms_ >= kMaxClusterDurationMs ||
+      (keyframe && (!cluster_keyframe_ || timestamp_ms - cluster_timestamp_ms_ >= 1000))) {
+    if (cluster_open_) {
+      FinishCluster();
+    }
+    StartCluster(timestamp_ms, keyframe);
+  }
+
+  int16_t relative = static_cast<int16_t>(timestamp_ms - cluster_timestamp_ms_);
+
+  std::string block;
+  AppendId(block, kSimpleBlock);
+  AppendSize(block, size + 4);
+  block.push_back(static_cast<char>(0x81));  // Track number 1
+  block.push_back(static_cast<char>((relative >> 8) & 0xFF));
+  block.push_back(static_cast<char>(relative & 0xFF));
+  block.push_back(static_cast<char>(keyframe ? 0x80 : 0x00));
+
+  if (!WriteBytes(block.data(), block.size()) || !WriteBytes(data, size)) {
+    return false;
+  }
+
+  last_timestamp_ms_ = timestamp_ms;
+  frame_count_++;
+  return true;
+}
+
+bool MatroskaWriter::Close() {
+  if (!file_.is_open()) {
+    return false;
+  }
+
+  if (cluster_open_) {
+    FinishCluster();
+  }
+
+  // Cues
+  uint64_t cues_position = bytes_written_;
+  std::string cues;
+  for (const CuePoint& cue : cues_) {
+    std::string positions;
+    AppendUInt(positions, kCueTrack, 1);
+    AppendUInt(positions, kCueClusterPosition, cue.cluster_position);
+
+    std::string point;
+    AppendUInt(point, kCueTime, cue.time_ms);
+    AppendMaster(point, kCueTrackPositions, positions);
+
+    AppendMaster(cues, kCuePoint, point);
+  }
+  if (!cues_.empty()) {
+    std::string element;
+    AppendMaster(element, kCues, cues);
+    WriteBytes(element.data(), element.size());
+  }
+
+  uint64_t end_position = bytes_written_;
+
+  // Duration
+  char duration_bytes[8];
+  EncodeFloat(static_cast<double>(last_timestamp_ms_), duration_bytes);
+  file_.seekp(duration_position_);
+  file_.write(duration_bytes, sizeof(duration_bytes));
+
+  // SeekHead, padded with a Void to fill the reserved space
+  auto seek_entry = [](uint32_t id, uint64_t position) {
+    std::string id_bytes;
+    AppendId(id_bytes, id);
+    std::string seek;
+    AppendString(seek, kSeekId, id_bytes);
+    AppendUInt(seek, kSeekPosition, position);
+    std::string entry;
+    AppendMaster(entry, kSeek, seek);
+    return entry;
+  };
+
+  std::string seeks;
+  seeks += seek_entry(kInfo, info_position_ - segment_data_start_);
+  seeks += seek_entry(kTracks, tracks_position_ - segment_data_start_);
+  if (!cues_.empty()) {
+    seeks += seek_entry(kCues, cues_position - segment_data_start_);
+  }
+
+  std::string seek_head;
+  AppendMaster(seek_head, kSeekHead, seeks);
+  if (seek_head.size() + 2 <= kSeekHeadReserve) {
+    AppendVoid(seek_head, kSeekHeadReserve - seek_head.size());
+    file_.seekp(seek_head_position_);
+    file_.write(seek_head.data(), seek_head.size());
+  }
+
+  PatchSize(segment_size_position_, end_position - segment_data_start_);
+
+  // Errors are sticky, so this covers every write since Open(); closing
+  // flushes the last of them
+  file_.seekp(end_position);
+  bool ok = !file_.fail();
+  file_.close();
+  ok = ok && !file_.fail();
+  if (!ok) {
+    std::cerr << "[Matroska] Failed to write the file" << std::endl;
+  }
+  return ok;
+}
+
+void MatroskaWriter::StartCluster(int64_t timestamp_ms, bool keyframe) {
+  cluster_position_ = bytes_written_;
+  cluster_timestamp_ms_ = timestamp_ms;
+  cluster_keyframe_ = keyframe;
+
+  std::string header;
+  AppendId(header, kCluster);
+  cluster_size_position_ = bytes_written_ + header.size();
+  AppendFixedSize(header, kUnknownSize);
+  AppendUInt(header, kClusterTimestamp, timestamp_ms);
+  WriteBytes(header.data(), header.size());
+
+  // Only a cluster starting with a keyframe can be decoded from its start
+  if (keyframe) {
+    cues_.push_back({timestamp_ms, cluster_position_ - segment_data_start_});
+  }
+  cluster_open_ = true;
+}
+
+void MatroskaWriter::FinishCluster() {
+  // Cluster data starts right after the 8-byte size field
+  uint64_t cluster_data_start = cluster_size_position_ + 8;
+  PatchSize(cluster_size_position_, bytes_written_ - cluster_data_start);
+  cluster_open_ = false;
+}
+
+bool MatroskaWriter::WriteBytes(const void* data, size_t size) {
+  file_.write(static_cast<const char*>(data), size);
+  bytes_written_ += size;
+  return file_.good();
+}
+
+void MatroskaWriter::PatchSize(uint64_t size_position, uint64_t size) {
+  std::string bytes;
+  AppendFixedSize(bytes, size);
+  file_.seekp(size_position);
+  file_.write(bytes.data(), bytes.size());
+  file_.seekp(bytes_written_);
+}
@@ -1,241 +1,853 @@
 #include "message_handler.h"
+#include "message_registry.h"
+#include "recording_transport.h"
+#include "screencast_transport.h"
+#include "include/base/cef_callback.h"
+#include "include/cef_shared_memory_region.h"
+#include "include/cef_shared_process_message_builder.h"
+#include "include/wrapper/cef_closure_task.h"
 #include "include/wrapper/cef_helpers.h"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// JS function registered with setScreencastFrameHandler(), per browser.
+// Only touched on the renderer main thread.
+struct ScreencastFrameHandler {
+  CefRefPtr<CefV8Context> context;
+  CefRefPtr<CefV8Value> function;
+};
+std::map<int, ScreencastFrameHandler> g_screencast_frame_handlers;
+
+// Frees the malloc'd backing store of a frame ArrayBuffer once V8 collects it
+class FreeReleaseCallback : public CefV8ArrayBufferReleaseCallback {
+ public:
+  void ReleaseBuffer(void* buffer) override { free(buffer); }
+
+ private:
+  IMPLEMENT_REFCOUNTING(FreeReleaseCallback);
+};
+
+void SendScreencastFrameConsumed(CefRefPtr<CefFrame> frame) {
+  frame->SendProcessMessage(PID_BROWSER, CefProcessMessage::Create("screencast_frame_consumed"));
+}
 
-// Execute handler for V8 function calls from JavaScript
-bool MessageHandler::Execute(const CefString& name,
-                            CefRefPtr<CefV8Value> object,
-                            const CefV8ValueList& arguments,
-                            CefRefPtr<CefV8Value>& retval,
-                            CefString& exception) {
-  std::cout << "[Renderer] Execute called for function: " << name.ToString() << std::endl;
-
-  if (name == "openSystemBrowser") {
-    // openSystemBrowser(url)
-    if (arguments.size() == 1 && arguments[0]->IsString()) {
-      std::string url = arguments[0]->GetStringValue().ToString();
-      std::cout << "[Renderer] Opening system browser with URL: " << url << std::endl;
-
-      // Send message to browser process to open system browser
-      CefRefPtr<CefProcessMessage> message =
-          CefProcessMessage::Create("open_system_browser");
+// Values cross the bridge as CefValues and are built straight into V8 values
+// (and back), without JSON text in between.
 
-      CefRefPtr<CefListValue> args = message->GetArgumentList();
-      args->SetString(0, arguments[0]->GetStringValue());
+// The V8 equivalent of |value|: dictionaries become objects, lists arrays
+// and binaries ArrayBuffers. Must be called inside a context.
+CefRefPtr<CefV8Value> ToV8Value(CefRefPtr<CefValue> value);
 
-      CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
-      context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+CefRefPtr<CefV8Value> ToV8Object(CefRefPtr<CefDictionaryValue> dict) {
+  CefRefPtr<CefV8Value> object = CefV8Value::CreateObject(nullptr, nullptr);
+  CefDictionaryValue::KeyList keys;
+  dict->GetKeys(keys);
+  for (const CefString& key : keys) {
+    object->SetValue(key, ToV8Value(dict->GetValue(key)), V8_PROPERTY_ATTRIBUTE_NONE);
+  }
+  return object;
+}
 
-      std::cout << "[Renderer] Process message sent to browser" << std::endl;
+CefRefPtr<CefV8Value> ToV8Value(CefRefPtr<CefValue> value) {
+  switch (value->GetType()) {
+    case VTYPE_BOOL:
+      return CefV8Value::CreateBool(value->GetBool());
+    case VTYPE_INT:
+      return CefV8Value::CreateInt(value->GetInt());
+    case VTYPE_DOUBLE:
+      return CefV8Value::CreateDouble(value->GetDouble());
+    case VTYPE_STRING:
+      return CefV8Value::CreateString(value->GetString());
+    case VTYPE_BINARY: {
+      CefRefPtr<CefBinaryValue> binary = value->GetBinary();
+      size_t size = binary->GetSize();
+      void* buffer = malloc(size > 0 ? size : 1);
+      binary->GetData(buffer, size, 0);
+      return CefV8Value::CreateArrayBuffer(buffer, size, new FreeReleaseCallback());
+    }
+    case VTYPE_DICTIONARY:
+      return ToV8Object(value->GetDictionary());
+    case VTYPE_LIST: {
+      CefRefPtr<CefListValue> list = value->GetList();
+      CefRefPtr<CefV8Value> array = CefV8Value::CreateArray(static_cast<int>(list->GetSize()));
+      for (size_t i = 0; i < list->GetSize(); i++) {
+        array->SetValue(static_cast<int>(i), ToV8Value(list->GetValue(i)));
+      }
+      return array;
+    }
+    default:
+      return CefV8Value::CreateNull();
+  }
+}
 
-      retval = CefV8Value::CreateBool(true);
-      return true;
+// The CefValue equivalent of |value|. Functions and undefined become null.
+CefRefPtr<CefValue> ToCefValue(CefRefPtr<CefV8Value> value) {
+  CefRefPtr<CefValue> result = CefValue::Create();
+  if (value->IsBool()) {
+    result->SetBool(value->GetBoolValue());
+  } else if (value->IsInt()) {
+    result->SetInt(value->GetIntValue());
+  } else if (value->IsUInt() || value->IsDouble()) {
+    result->SetDouble(value->GetDoubleValue());
+  } else if (value->IsString()) {
+    result->SetString(value->GetStringValue());
+  } else if (value->IsArrayBuffer()) {
+    result->SetBinary(CefBinaryValue::Create(value->GetArrayBufferData(),
+                                             value->GetArrayBufferByteLength()));
+  } else if (value->IsArray()) {
+    CefRefPtr<CefListValue> list = CefListValue::Create();
+    int length = value->GetArrayLength();
+    for (int i = 0; i < length; i++) {
+      list->SetValue(i, ToCefValue(value->GetValue(i)));
+    }
+    result->SetList(list);
+  } else if (value->IsObject() && !value->IsFunction()) {
+    CefRefPtr<CefDictionaryValue> dict = CefDictionaryValue::Create();
+    std::vector<CefString> keys;
+    value->GetKeys(keys);
+    for (const CefString& key : keys) {
+      dict->SetValue(key, ToCefValue(value->GetValue(key)));
     }
+    result->SetDictionary(dict);
   }
+  return result;
+}
 
-  if (name == "navigateToMeetingUrl") {
-    // navigateToMeetingUrl(url)
-    if (arguments.size() == 1 && arguments[0]->IsString()) {
-      std::string url = arguments[0]->GetStringValue().ToString();
-      std::cout << "[Renderer] Navigating to meeting URL: " << url << std::endl;
+// Requests whose promise waits for a "request_result" from the browser
+// process, by request id. Only touched on the renderer main thread.
+struct PendingRequest {
+  CefRefPtr<CefV8Context> context;
+  CefRefPtr<CefV8Value> promise;
+};
+std::map<int, PendingRequest> g_pending_requests;
+int g_next_request_id = 1;
+
+// How long the browser process gets to answer before the promise is rejected
+const int64_t kRequestTimeoutMs = 5000;
+const int64_t kRecordingRequestTimeoutMs = 60000;  // Reads whole recordings
+
+// Settle request |request_id| and forget it: resolved with |result|, or
+// rejected with |error| if there is no result
+void SettleRequest(int request_id, CefRefPtr<CefValue> result, const std::string& error) {
+  auto it = g_pending_requests.find(request_id);
+  if (it == g_pending_requests.end()) {
+    return;  // Timed out, or its context is gone
+  }
+  PendingRequest request = it->second;
+  g_pending_requests.erase(it);
+  if (!request.context->Enter()) {
+    return;
+  }
 
-      // Send message to browser process to navigate to meeting URL
-      CefRefPtr<CefProcessMessage> message =
-          CefProcessMessage::Create("navigate_to_meeting");
+  if (result) {
+    request.promise->ResolvePromise(ToV8Value(result));
+  } else {
+    request.promise->RejectPromise(error);
+  }
+  request.context->Exit();
+}
 
-      CefRefPtr<CefListValue> args = message->GetArgumentList();
-      args->SetString(0, arguments[0]->GetStringValue());
+void ExpireRequest(int request_id) {
+  SettleRequest(request_id, nullptr, "Request timed out");
+}
 
-      CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
-      context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+// Send |message| with a new request id as its first argument; returns the
+// promise settled by the matching "request_result"
+CefRefPtr<CefV8Value> SendRequest(CefRefPtr<CefProcessMessage> message, int64_t timeout_ms) {
+  CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
+  CefRefPtr<CefV8Value> promise = CefV8Value::CreatePromise();
+  int request_id = g_next_request_id++;
+  g_pending_requests[request_id] = {context, promise};
+
+  message->GetArgumentList()->SetInt(0, request_id);
+  context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  CefPostDelayedTask(TID_RENDERER, base::BindOnce(&ExpireRequest, request_id), timeout_ms);
+  return promise;
+}
 
-      std::cout << "[Renderer] Meeting navigation message sent to browser" << std::endl;
+// Event channel: the handlers subscribed with rebrazeAuth.subscribe(), per
+// browser and keyed by subscription id; a topic may have any number of
+// them. Coalescing subscriptions keep only their latest payload until the
+// next animation frame. Only touched on the renderer main thread.
+struct EventSubscription {
+  std::string topic;
+  CefRefPtr<CefV8Context> context;
+  CefRefPtr<CefV8Value> handler;
+  bool coalesce = false;
+  CefRefPtr<CefDictionaryValue> pending;
+};
+struct EventChannel {
+  std::map<int, EventSubscription> subscriptions;
+  bool flush_scheduled = false;  // requestAnimationFrame() called
+};
+std::map<int, EventChannel> g_event_channels;
+int g_next_subscription_id = 1;
+
+void DeliverEvent(const EventSubscription& subscription, CefRefPtr<CefDictionaryValue> payload) {
+  if (!subscription.context->Enter()) {
+    return;
+  }
+  CefV8ValueList arguments;
+  arguments.push_back(ToV8Object(payload));
+  subscription.handler->ExecuteFunction(nullptr, arguments);
+  subscription.context->Exit();
+}
 
-      retval = CefV8Value::CreateBool(true);
-      return true;
+// Hand each coalescing subscription of a browser its latest payload
+void FlushEvents(int browser_id) {
+  auto channel = g_event_channels.find(browser_id);
+  if (channel == g_event_channels.end()) {
+    return;
+  }
+  channel->second.flush_scheduled = false;
+
+  // Handlers may subscribe or unsubscribe; deliver from a copy
+  std::vector<std::pair<EventSubscription, CefRefPtr<CefDictionaryValue>>> ready;
+  for (auto& entry : channel->second.subscriptions) {
+    EventSubscription& subscription = entry.second;
+    if (subscription.pending) {
+      ready.push_back({subscription, subscription.pending});
+      subscription.pending = nullptr;
     }
   }
+  for (const auto& event : ready) {
+    DeliverEvent(event.first, event.second);
+  }
+}
 
-  if (name == "joinMeeting") {
-    // joinMeeting(url, x, y, width, height)
-    if (arguments.size() == 5 && arguments[0]->IsString() &&
-        arguments[1]->IsInt() && arguments[2]->IsInt() &&
-        arguments[3]->IsInt() && arguments[4]->IsInt()) {
+// Runs FlushEvents() from requestAnimationFrame()
+class EventFlushHandler : public CefV8Handler {
+ public:
+  explicit EventFlushHandler(int browser_id) : browser_id_(browser_id) {}
+
+  bool Execute(const CefString& name,
+               CefRefPtr<CefV8Value> object,
+               const CefV8ValueList& arguments,
+               CefRefPtr<CefV8Value>& retval,
+               CefString& exception) override {
+    FlushEvents(browser_id_);
+    return true;
+  }
 
-      std::string url = arguments[0]->GetStringValue().ToString();
-      int x = arguments[1]->GetIntValue();
-      int y = arguments[2]->GetIntValue();
-      int width = arguments[3]->GetIntValue();
-      int height = arguments[4]->GetIntValue();
+ private:
+  const int browser_id_;
 
-      std::cout << "[Renderer] Join meeting: " << url
-                << " at (" << x << ", " << y << ") size: " << width << "x" << height << std::endl;
+  IMPLEMENT_REFCOUNTING(EventFlushHandler);
+};
 
-      // Send message to browser process to create meeting view
-      CefRefPtr<CefProcessMessage> message =
-          CefProcessMessage::Create("join_meeting");
+// Flush the coalesced events of |browser_id| with the next animation frame,
+// or right away where there is no requestAnimationFrame()
+void ScheduleEventFlush(int browser_id, CefRefPtr<CefV8Context> context) {
+  EventChannel& channel = g_event_channels[browser_id];
+  if (channel.flush_scheduled) {
+    return;
+  }
+  if (!context->Enter()) {
+    return;
+  }
+  CefRefPtr<CefV8Value> request_frame = context->GetGlobal()->GetValue("requestAnimationFrame");
+  if (request_frame && request_frame->IsFunction()) {
+    CefV8ValueList arguments;
+    arguments.push_back(
+        CefV8Value::CreateFunction("flushEvents", new EventFlushHandler(browser_id)));
+    channel.flush_scheduled = request_frame->ExecuteFunction(nullptr, arguments) != nullptr;
+  }
+  context->Exit();
+  if (!channel.flush_scheduled) {
+    FlushEvents(browser_id);
+  }
+}
 
-      CefRefPtr<CefListValue> args = message->GetArgumentList();
-      args->SetString(0, arguments[0]->GetStringValue());
-      args->SetInt(1, x);
-      args->SetInt(2, y);
-      args->SetInt(3, width);
-      args->SetInt(4, height);
+// openSystemBrowser(url)
+bool OpenSystemBrowser(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                       CefString& exception) {
+  std::string url = arguments[0]->GetStringValue().ToString();
+  std::cout << "[Renderer] Opening system browser with URL: " << url << std::endl;
 
-      CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
-      context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  // Send message to browser process to open system browser
+  CefRefPtr<CefProcessMessage> message =
+      CefProcessMessage::Create("open_system_browser");
 
-      std::cout << "[Renderer] Join meeting message sent to browser" << std::endl;
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  args->SetString(0, arguments[0]->GetStringValue());
 
-      retval = CefV8Value::CreateBool(true);
-      return true;
-    }
-  }
+  CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
+  context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
 
-  if (name == "leaveMeeting") {
-    // leaveMeeting()
-    std::cout << "[Renderer] Leave meeting called" << std::endl;
+  std::cout << "[Renderer] Process message sent to browser" << std::endl;
 
-    // Send message to browser process to destroy meeting view
-    CefRefPtr<CefProcessMessage> message =
-        CefProcessMessage::Create("leave_meeting");
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-    CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
-    context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+// navigateToMeetingUrl(url)
+bool NavigateToMeetingUrl(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                          CefString& exception) {
+  std::string url = arguments[0]->GetStringValue().ToString();
+  std::cout << "[Renderer] Navigating to meeting URL: " << url << std::endl;
 
-    std::cout << "[Renderer] Leave meeting message sent to browser" << std::endl;
+  // Send message to browser process to navigate to meeting URL
+  CefRefPtr<CefProcessMessage> message =
+      CefProcessMessage::Create("navigate_to_meeting");
 
-    retval = CefV8Value::CreateBool(true);
-    return true;
-  }
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  args->SetString(0, arguments[0]->GetStringValue());
 
-  if (name == "updateMeetingBounds") {
-    // updateMeetingBounds(x, y, width, height)
-    if (arguments.size() == 4 && arguments[0]->IsInt() && arguments[1]->IsInt() &&
-        arguments[2]->IsInt() && arguments[3]->IsInt()) {
+  CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
+  context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
 
-      int x = arguments[0]->GetIntValue();
-      int y = arguments[1]->GetIntValue();
-      int width = arguments[2]->GetIntValue();
-      int height = arguments[3]->GetIntValue();
+  std::cout << "[Renderer] Meeting navigation message sent to browser" << std::endl;
 
-      std::cout << "[Renderer] Update meeting bounds: (" << x << ", " << y
-                << ") size: " << width << "x" << height << std::endl;
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-      // Send message to browser process to update meeting view bounds
-      CefRefPtr<CefProcessMessage> message =
-          CefProcessMessage::Create("update_meeting_bounds");
+// joinMeeting(url, x, y, width, height)
+bool JoinMeeting(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                 CefString& exception) {
+  std::string url = arguments[0]->GetStringValue().ToString();
+  int x = arguments[1]->GetIntValue();
+  int y = arguments[2]->GetIntValue();
+  int width = arguments[3]->GetIntValue();
+  int height = arguments[4]->GetIntValue();
 
-      CefRefPtr<CefListValue> args = message->GetArgumentList();
-      args->SetInt(0, x);
-      args->SetInt(1, y);
-      args->SetInt(2, width);
-      args->SetInt(3, height);
+  std::cout << "[Renderer] Join meeting: " << url
+            << " at (" << x << ", " << y << ") size: " << width << "x" << height << std::endl;
 
-      CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
-      context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  // Send message to browser process to create meeting view
+  CefRefPtr<CefProcessMessage> message =
+      CefProcessMessage::Create("join_meeting");
 
-      std::cout << "[Renderer] Update meeting bounds message sent to browser" << std::endl;
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  args->SetString(0, arguments[0]->GetStringValue());
+  args->SetInt(1, x);
+  args->SetInt(2, y);
+  args->SetInt(3, width);
+  args->SetInt(4, height);
 
-      retval = CefV8Value::CreateBool(true);
-      return true;
+  CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
+  context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+
+  std::cout << "[Renderer] Join meeting message sent to browser" << std::endl;
+
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
+
+// leaveMeeting()
+bool LeaveMeeting(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                  CefString& exception) {
+  std::cout << "[Renderer] Leave meeting called" << std::endl;
+
+  // Send message to browser process to destroy meeting view
+  CefRefPtr<CefProcessMessage> message =
+      CefProcessMessage::Create("leave_meeting");
+
+  CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
+  context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+
+  std::cout << "[Renderer] Leave meeting message sent to browser" << std::endl;
+
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
+
+// updateMeetingBounds(x, y, width, height)
+bool UpdateMeetingBounds(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                         CefString& exception) {
+  int x = arguments[0]->GetIntValue();
+  int y = arguments[1]->GetIntValue();
+  int width = arguments[2]->GetIntValue();
+  int height = arguments[3]->GetIntValue();
+
+  std::cout << "[Renderer] Update meeting bounds: (" << x << ", " << y
+            << ") size: " << width << "x" << height << std::endl;
+
+  // Send message to browser process to update meeting view bounds
+  CefRefPtr<CefProcessMessage> message =
+      CefProcessMessage::Create("update_meeting_bounds");
+
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  args->SetInt(0, x);
+  args->SetInt(1, y);
+  args->SetInt(2, width);
+  args->SetInt(3, height);
+
+  CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
+  context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+
+  std::cout << "[Renderer] Update meeting bounds message sent to browser" << std::endl;
+
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
+
+// getMeetingPageInfo() - resolves to {url, title} of the meeting page
+bool GetMeetingPageInfo(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                        CefString& exception) {
+  retval = SendRequest(CefProcessMessage::Create("get_meeting_page_info"), kRequestTimeoutMs);
+  return true;
+}
+
+// getMeetingParticipants() - resolves to the current participant roster
+bool GetMeetingParticipants(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                            CefString& exception) {
+  retval = SendRequest(CefProcessMessage::Create("get_meeting_participants"), kRequestTimeoutMs);
+  return true;
+}
+
+// participantsChanged(joined, left) - called from the participant agent in
+// the content browser with the names that joined and left since its last call
+bool ParticipantsChanged(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                         CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("participants_changed");
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  args->SetList(0, ToCefValue(arguments[0])->GetList());
+  args->SetList(1, ToCefValue(arguments[1])->GetList());
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
+
+// reportRecordingCrop(x, y, width, height) - called from the content
+// browser with the recorded element's rect in fractions of the viewport
+bool ReportRecordingCrop(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                         CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("recording_crop_changed");
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  for (size_t i = 0; i < 4; i++) {
+    args->SetDouble(i, arguments[i]->GetDoubleValue());
+  }
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
+
+// startRecording(meetingId, mode?, options?) - mode is "renderer" (default)
+// or "native"; options {codec, bitrateKbps, preset, cropSelector} apply to
+// native mode
+bool StartRecording(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                    CefString& exception) {
+  std::string meeting_id = arguments[0]->GetStringValue().ToString();
+  std::cout << "[Renderer] Start recording called for meeting: " << meeting_id << std::endl;
+
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("start_recording");
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  args->SetString(0, meeting_id);
+  if (arguments.size() >= 2 && arguments[1]->IsString()) {
+    args->SetString(1, arguments[1]->GetStringValue());
+  }
+  if (arguments.size() == 3 && arguments[2]->IsObject()) {
+    CefRefPtr<CefV8Value> options = arguments[2];
+    CefRefPtr<CefDictionaryValue> dict = CefDictionaryValue::Create();
+    CefRefPtr<CefV8Value> codec = options->GetValue("codec");
+    if (codec && codec->IsString()) {
+      dict->SetString("codec", codec->GetStringValue());
     }
+    CefRefPtr<CefV8Value> preset = options->GetValue("preset");
+    if (preset && preset->IsString()) {
+      dict->SetString("preset", preset->GetStringValue());
+    }
+    CefRefPtr<CefV8Value> bitrate = options->GetValue("bitrateKbps");
+    if (bitrate && (bitrate->IsInt() || bitrate->IsDouble())) {
+      dict->SetInt("bitrateKbps", bitrate->GetIntValue());
+    }
+    CefRefPtr<CefV8Value> crop_selector = options->GetValue("cropSelector");
+    if (crop_selector && crop_selector->IsString()) {
+      dict->SetString("cropSelector", crop_selector->GetStringValue());
+    }
+    if (args->GetSize() < 2) {
+      args->SetNull(1);  // Default mode
+    }
+    args->SetDictionary(2, dict);
   }
 
-  if (name == "getMeetingPageInfo") {
-    // getMeetingPageInfo() - requests page info from content browser
-    std::cout << "[Renderer] Get meeting page info called" << std::endl;
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-    // Send message to browser process to get meeting page info
-    CefRefPtr<CefProcessMessage> message =
-        CefProcessMessage::Create("get_meeting_page_info");
+bool StopRecording(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                   CefString& exception) {
+  std::cout << "[Renderer] Stop recording called" << std::endl;
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("stop_recording");
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-    CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
-    context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+// setReplayBufferEnabled(enabled, options?) - options {seconds, maxMegabytes}
+bool SetReplayBufferEnabled(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                            CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("set_replay_buffer");
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  args->SetBool(0, arguments[0]->GetBoolValue());
+  if (arguments.size() == 2 && arguments[1]->IsObject()) {
+    CefRefPtr<CefDictionaryValue> dict = CefDictionaryValue::Create();
+    CefRefPtr<CefV8Value> seconds = arguments[1]->GetValue("seconds");
+    if (seconds && (seconds->IsInt() || seconds->IsDouble())) {
+      dict->SetInt("seconds", seconds->GetIntValue());
+    }
+    CefRefPtr<CefV8Value> megabytes = arguments[1]->GetValue("maxMegabytes");
+    if (megabytes && (megabytes->IsInt() || megabytes->IsDouble())) {
+      dict->SetInt("maxMegabytes", megabytes->GetIntValue());
+    }
+    args->SetDictionary(1, dict);
+  }
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-    std::cout << "[Renderer] Get meeting page info message sent to browser" << std::endl;
+// saveReplay(meetingId) - written in the background, published as "recordingSaved"
+bool SaveReplay(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("save_replay");
+  message->GetArgumentList()->SetString(0, arguments[0]->GetStringValue());
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-    retval = CefV8Value::CreateBool(true);
-    return true;
+// startSlideDetection(meetingId, options?) - options {changeThreshold, intervalMs}
+bool StartSlideDetection(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                         CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("start_slide_detection");
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  args->SetString(0, arguments[0]->GetStringValue());
+  if (arguments.size() == 2 && arguments[1]->IsObject()) {
+    CefRefPtr<CefDictionaryValue> dict = CefDictionaryValue::Create();
+    CefRefPtr<CefV8Value> threshold = arguments[1]->GetValue("changeThreshold");
+    if (threshold && (threshold->IsInt() || threshold->IsDouble())) {
+      dict->SetDouble("changeThreshold", threshold->GetDoubleValue());
+    }
+    CefRefPtr<CefV8Value> interval = arguments[1]->GetValue("intervalMs");
+    if (interval && (interval->IsInt() || interval->IsDouble())) {
+      dict->SetInt("intervalMs", interval->GetIntValue());
+    }
+    args->SetDictionary(1, dict);
   }
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-  if (name == "getMeetingParticipants") {
-    // getMeetingParticipants() - requests participants from content browser
-    std::cout << "[Renderer] Get meeting participants called" << std::endl;
+bool StopSlideDetection(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                        CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("stop_slide_detection");
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-    // Send message to browser process to extract participants
-    CefRefPtr<CefProcessMessage> message =
-        CefProcessMessage::Create("get_meeting_participants");
+// getRecordingPreviews(recordingPath) - resolves to the previews, or null
+bool GetRecordingPreviews(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                          CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("get_recording_previews");
+  message->GetArgumentList()->SetString(1, arguments[0]->GetStringValue());
+  retval = SendRequest(message, kRecordingRequestTimeoutMs);
+  return true;
+}
 
-    CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
-    context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+// searchFrames(jpeg: ArrayBuffer, maxResults?) - resolves to the matches
+bool SearchFrames(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                  CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("search_frames");
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  args->SetBinary(1, CefBinaryValue::Create(arguments[0]->GetArrayBufferData(),
+                                            arguments[0]->GetArrayBufferByteLength()));
+  if (arguments.size() == 2 && arguments[1]->IsInt()) {
+    args->SetInt(2, arguments[1]->GetIntValue());
+  }
+  retval = SendRequest(message, kRecordingRequestTimeoutMs);
+  return true;
+}
 
-    std::cout << "[Renderer] Get meeting participants message sent to browser" << std::endl;
+// setScreencastFrameHandler(fn | null) - fn(jpeg: ArrayBuffer, timestamp: number)
+bool SetScreencastFrameHandler(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                               CefString& exception) {
+  CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
+  int browser_id = context->GetBrowser()->GetIdentifier();
+  if (arguments[0]->IsFunction()) {
+    g_screencast_frame_handlers[browser_id] = {context, arguments[0]};
+  } else {
+    g_screencast_frame_handlers.erase(browser_id);
+  }
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-    retval = CefV8Value::CreateBool(true);
+// subscribe(topic, fn, coalesce?) - fn(payload) for each event of |topic|,
+// or once per animation frame with the latest payload if |coalesce|.
+// Returns the subscription id for unsubscribe().
+bool Subscribe(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+               CefString& exception) {
+  if (!arguments[1]->IsFunction()) {
+    exception = "subscribe() needs a handler function";
     return true;
   }
+  CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
+  EventChannel& channel = g_event_channels[context->GetBrowser()->GetIdentifier()];
+  int id = g_next_subscription_id++;
+  EventSubscription& subscription = channel.subscriptions[id];
+  subscription.topic = arguments[0]->GetStringValue();
+  subscription.context = context;
+  subscription.handler = arguments[1];
+  subscription.coalesce = arguments.size() == 3 && arguments[2]->IsBool() &&
+                          arguments[2]->GetBoolValue();
+  retval = CefV8Value::CreateInt(id);
+  return true;
+}
 
-  if (name == "sendParticipantList") {
-    // sendParticipantList(jsonArray) - called from content browser with extracted participants
-    if (arguments.size() == 1 && arguments[0]->IsString()) {
-      std::string json_list = arguments[0]->GetStringValue().ToString();
-      std::cout << "[Renderer] Sending participant list: " << json_list << std::endl;
-
-      // Send to browser process
-      CefRefPtr<CefProcessMessage> message =
-          CefProcessMessage::Create("participant_list_extracted");
+// unsubscribe(id) - drop a subscription made by subscribe(); its handler
+// receives no further events. Other handlers of the topic are kept.
+bool Unsubscribe(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                 CefString& exception) {
+  CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
+  auto channel = g_event_channels.find(context->GetBrowser()->GetIdentifier());
+  bool removed = channel != g_event_channels.end() &&
+                 channel->second.subscriptions.erase(arguments[0]->GetIntValue()) > 0;
+  retval = CefV8Value::CreateBool(removed);
+  return true;
+}
 
-      CefRefPtr<CefListValue> args = message->GetArgumentList();
-      args->SetString(0, json_list);
+// screencastFrameConsumed() - a forwarded frame has been drawn; releases the
+// next screencast ack in the browser process
+bool ScreencastFrameConsumed(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                             CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("screencast_frame_consumed");
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-      CefRefPtr<CefV8Context> context = CefV8Context::GetCurrentContext();
-      context->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+// openRecordingSession(meetingId) - chunks appended afterwards go to a new file
+bool OpenRecordingSession(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                          CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("open_recording_session");
+  message->GetArgumentList()->SetString(0, arguments[0]->GetStringValue());
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-      retval = CefV8Value::CreateBool(true);
+// appendRecordingChunk(sequence, arrayBuffer) - raw recording bytes, no base64
+bool AppendRecordingChunk(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                          CefString& exception) {
+  uint32_t sequence = arguments[0]->GetUIntValue();
+  const void* data = arguments[1]->GetArrayBufferData();
+  size_t size = arguments[1]->GetArrayBufferByteLength();
+
+  CefRefPtr<CefProcessMessage> message;
+  if (size >= kRecordingSharedMemoryThreshold) {
+    // Copy once into shared memory; the browser writes straight from it
+    CefRefPtr<CefSharedProcessMessageBuilder> builder =
+        CefSharedProcessMessageBuilder::Create("append_recording_chunk",
+                                               sizeof(RecordingChunkHeader) + size);
+    if (!builder || !builder->IsValid()) {
+      exception = "Failed to allocate shared memory for recording chunk";
       return true;
     }
+
+    uint8_t* memory = static_cast<uint8_t*>(builder->Memory());
+    RecordingChunkHeader header = {kRecordingChunkMagic, sequence, size};
+    memcpy(memory, &header, sizeof(header));
+    memcpy(memory + sizeof(header), data, size);
+    message = builder->Build();
+  } else {
+    message = CefProcessMessage::Create("append_recording_chunk");
+    CefRefPtr<CefListValue> args = message->GetArgumentList();
+    args->SetBinary(0, CefBinaryValue::Create(data, size));
+    args->SetInt(1, static_cast<int>(sequence));
   }
 
-  if (name == "startRecording") {
-    if (arguments.size() == 1 && arguments[0]->IsString()) {
-      std::string meeting_id = arguments[0]->GetStringValue().ToString();
-      std::cout << "[Renderer] Start recording called for meeting: " << meeting_id << std::endl;
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-      CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("start_recording");
-      message->GetArgumentList()->SetString(0, meeting_id);
+// finalizeRecordingSession(chunkCount) - close the file once all chunks are written
+bool FinalizeRecordingSession(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                              CefString& exception) {
+  CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("finalize_recording_session");
+  message->GetArgumentList()->SetInt(0, static_cast<int>(arguments[0]->GetUIntValue()));
+  CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
+  retval = CefV8Value::CreateBool(true);
+  return true;
+}
 
-      CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
-      retval = CefV8Value::CreateBool(true);
-      return true;
+// A screencast frame for the setScreencastFrameHandler() function
+void HandleScreencastFrame(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
+                           CefRefPtr<CefProcessMessage> message) {
+  // Locate the JPEG bytes: shared memory for large frames, binary otherwise
+  const void* jpeg = nullptr;
+  size_t size = 0;
+  double timestamp = 0.0;
+  CefRefPtr<CefBinaryValue> binary;
+
+  CefRefPtr<CefSharedMemoryRegion> region = message->GetSharedMemoryRegion();
+  if (region && region->IsValid()) {
+    ScreencastFrameHeader header;
+    if (region->Size() >= sizeof(header)) {
+      memcpy(&header, region->Memory(), sizeof(header));
+      if (header.magic == kScreencastFrameMagic &&
+          header.size <= region->Size() - sizeof(header)) {
+        jpeg = static_cast<const char*>(region->Memory()) + sizeof(header);
+        size = static_cast<size_t>(header.size);
+        timestamp = header.timestamp;
+      }
+    }
+  } else {
+    CefRefPtr<CefListValue> args = message->GetArgumentList();
+    binary = args->GetBinary(0);
+    if (binary) {
+      jpeg = binary->GetRawData();
+      size = binary->GetSize();
     }
+    timestamp = args->GetDouble(1);
   }
 
-  if (name == "stopRecording") {
-    std::cout << "[Renderer] Stop recording called" << std::endl;
-    CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("stop_recording");
-    CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
-    retval = CefV8Value::CreateBool(true);
-    return true;
+  auto it = g_screencast_frame_handlers.find(browser->GetIdentifier());
+  if (!jpeg || it == g_screencast_frame_handlers.end()) {
+    // Nobody will draw this frame; release the next one right away
+    SendScreencastFrameConsumed(frame);
+    return;
   }
 
-  if (name == "saveRecording") {
-    if (arguments.size() == 2 && arguments[0]->IsString() && arguments[1]->IsBool()) {
-      std::string data = arguments[0]->GetStringValue();
-      bool is_last = arguments[1]->GetBoolValue();
-      
-      CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("save_recording_chunk");
-      CefRefPtr<CefListValue> args = message->GetArgumentList();
-      args->SetString(0, data);
-      args->SetBool(1, is_last);
-      
-      CefV8Context::GetCurrentContext()->GetBrowser()->GetMainFrame()->SendProcessMessage(PID_BROWSER, message);
-      retval = CefV8Value::CreateBool(true);
-      return true;
+  ScreencastFrameHandler handler = it->second;
+  if (!handler.context->Enter()) {
+    SendScreencastFrameConsumed(frame);
+    return;
+  }
+
+  // V8 owns a private copy so the message memory can be released now
+  void* buffer = malloc(size > 0 ? size : 1);
+  memcpy(buffer, jpeg, size);
+  CefV8ValueList arguments;
+  arguments.push_back(CefV8Value::CreateArrayBuffer(buffer, size, new FreeReleaseCallback()));
+  arguments.push_back(CefV8Value::CreateDouble(timestamp));
+
+  // The handler reports consumption itself unless it throws
+  CefRefPtr<CefV8Value> result = handler.function->ExecuteFunction(nullptr, arguments);
+  handler.context->Exit();
+  if (!result) {
+    SendScreencastFrameConsumed(frame);
+  }
+}
+
+// [topic, payload] for the handlers subscribed to the topic, if any
+void HandleEvent(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
+                 CefRefPtr<CefProcessMessage> message) {
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  auto channel = g_event_channels.find(browser->GetIdentifier());
+  if (channel == g_event_channels.end()) {
+    return;
+  }
+  std::string topic = args->GetString(0);
+  CefRefPtr<CefDictionaryValue> payload = args->GetDictionary(1);
+
+  // Handlers may subscribe or unsubscribe; deliver from a copy
+  std::vector<EventSubscription> ready;
+  for (auto& entry : channel->second.subscriptions) {
+    EventSubscription& subscription = entry.second;
+    if (subscription.topic != topic) {
+      continue;
     }
+    if (subscription.coalesce) {
+      subscription.pending = payload;
+      ScheduleEventFlush(browser->GetIdentifier(), subscription.context);
+    } else {
+      ready.push_back(subscription);
+    }
+  }
+  for (const EventSubscription& subscription : ready) {
+    DeliverEvent(subscription, payload);
+  }
+}
+
+// [requestId, result] or [requestId, null, error] for a request sent by
+// SendRequest()
+void HandleRequestResult(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
+                         CefRefPtr<CefProcessMessage> message) {
+  CefRefPtr<CefListValue> args = message->GetArgumentList();
+  if (args->GetType(2) == VTYPE_STRING) {
+    SettleRequest(args->GetInt(0), nullptr, args->GetString(2));
+  } else {
+    SettleRequest(args->GetInt(0), args->GetValue(1), std::string());
   }
+}
 
-  return false;
+using V8Function = bool (*)(const CefV8ValueList& arguments, CefRefPtr<CefV8Value>& retval,
+                            CefString& exception);
+using V8FunctionTable = MessageRegistry<V8Function>;
+
+// The functions on window.rebrazeAuth, with their argument schemas
+const V8FunctionTable& GetV8FunctionTable() {
+  static const V8FunctionTable::Entry kEntries[] = {
+      {"openSystemBrowser", "s", OpenSystemBrowser},
+      {"navigateToMeetingUrl", "s", NavigateToMeetingUrl},
+      {"joinMeeting", "siiii", JoinMeeting},
+      {"leaveMeeting", "", LeaveMeeting},
+      {"updateMeetingBounds", "iiii", UpdateMeetingBounds},
+      {"getMeetingPageInfo", "", GetMeetingPageInfo},
+      {"getMeetingParticipants", "", GetMeetingParticipants},
+      {"participantsChanged", "AA", ParticipantsChanged},
+      {"reportRecordingCrop", "nnnn", ReportRecordingCrop},
+      {"startRecording", "s|so", StartRecording},
+      {"stopRecording", "", StopRecording},
+      {"setReplayBufferEnabled", "b|o", SetReplayBufferEnabled},
+      {"saveReplay", "s", SaveReplay},
+      {"startSlideDetection", "s|o", StartSlideDetection},
+      {"stopSlideDetection", "", StopSlideDetection},
+      {"getRecordingPreviews", "s", GetRecordingPreviews},
+      {"searchFrames", "a|i", SearchFrames},
+      {"setScreencastFrameHandler", "f", SetScreencastFrameHandler},
+      {"subscribe", "sf|b", Subscribe},
+      {"unsubscribe", "i", Unsubscribe},
+      {"screencastFrameConsumed", "", ScreencastFrameConsumed},
+      {"openRecordingSession", "s", OpenRecordingSession},
+      {"appendRecordingChunk", "ua", AppendRecordingChunk},
+      {"finalizeRecordingSession", "u", FinalizeRecordingSession},
+  };
+  static const V8FunctionTable table(kEntries, true);
+  return table;
+}
+
+using MessageFunction = void (*)(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
+                                 CefRefPtr<CefProcessMessage> message);
+using MessageTable = MessageRegistry<MessageFunction>;
+
+// Process messages from the browser process, with their argument schemas
+const MessageTable& GetMessageTable() {
+  static const MessageTable::Entry kEntries[] = {
+      {"screencast_frame", "Bd", HandleScreencastFrame},
+      {"event", "sD", HandleEvent},
+      {"request_result", "i|*s", HandleRequestResult},
+  };
+  static const MessageTable table(kEntries, false);
+  return table;
+}
+
+}  // namespace
+
+// Execute handler for V8 function calls from JavaScript
+bool MessageHandler::Execute(const CefString& name,
+                            CefRefPtr<CefV8Value> object,
+                            const CefV8ValueList& arguments,
+                            CefRefPtr<CefV8Value>& retval,
+                            CefString& exception) {
+  const V8FunctionTable::Entry* entry = GetV8FunctionTable().Find(name.ToString());
+  if (!entry || !MatchesSchema(entry->schema, arguments)) {
+    return false;
+  }
+  return entry->handler(arguments, retval, exception);
 }
 
 // Called when the browser context is created in the renderer process
@@ -260,68 +872,12 @@ void RenderProcessHandler::OnContextCreated(CefRefPtr<CefBrowser> browser,
   // Create the rebrazeAuth object
   CefRefPtr<CefV8Value> rebraze_auth = CefV8Value::CreateObject(nullptr, nullptr);
 
-  // Create the handler
+  // One function per entry of the dispatch table, all served by one handler
   CefRefPtr<CefV8Handler> handler = new MessageHandler();
-
-  // Create the openSystemBrowser function
-  CefRefPtr<CefV8Value> open_browser_func =
-      CefV8Value::CreateFunction("openSystemBrowser", handler);
-
-  rebraze_auth->SetValue("openSystemBrowser", open_browser_func,
-                        V8_PROPERTY_ATTRIBUTE_NONE);
-
-  // Create the navigateToMeetingUrl function
-  CefRefPtr<CefV8Value> navigate_meeting_func =
-      CefV8Value::CreateFunction("navigateToMeetingUrl", handler);
-
-  rebraze_auth->SetValue("navigateToMeetingUrl", navigate_meeting_func,
-                        V8_PROPERTY_ATTRIBUTE_NONE);
-
-  // Create the joinMeeting function
-  CefRefPtr<CefV8Value> join_meeting_func =
-      CefV8Value::CreateFunction("joinMeeting", handler);
-
-  rebraze_auth->SetValue("joinMeeting", join_meeting_func,
-                        V8_PROPERTY_ATTRIBUTE_NONE);
-
-  // Create the leaveMeeting function
-  CefRefPtr<CefV8Value> leave_meeting_func =
-      CefV8Value::CreateFunction("leaveMeeting", handler);
-
-  rebraze_auth->SetValue("leaveMeeting", leave_meeting_func,
-                        V8_PROPERTY_ATTRIBUTE_NONE);
-
-  // Create the updateMeetingBounds function
-  CefRefPtr<CefV8Value> update_meeting_bounds_func =
-      CefV8Value::CreateFunction("updateMeetingBounds", handler);
-
-  rebraze_auth->SetValue("updateMeetingBounds", update_meeting_bounds_func,
-                        V8_PROPERTY_ATTRIBUTE_NONE);
-
-  // Create the getMeetingPageInfo function
-  CefRefPtr<CefV8Value> get_meeting_page_info_func =
-      CefV8Value::CreateFunction("getMeetingPageInfo", handler);
-
-  rebraze_auth->SetValue("getMeetingPageInfo", get_meeting_page_info_func,
-                        V8_PROPERTY_ATTRIBUTE_NONE);
-
-  // Create the getMeetingParticipants function
-  CefRefPtr<CefV8Value> get_meeting_participants_func =
-      CefV8Value::CreateFunction("getMeetingParticipants", handler);
-
-  rebraze_auth->SetValue("getMeetingParticipants", get_meeting_participants_func,
-                        V8_PROPERTY_ATTRIBUTE_NONE);
-
-  // Create the sendParticipantList function (used by content browser to send back results)
-  CefRefPtr<CefV8Value> send_participant_list_func =
-      CefV8Value::CreateFunction("sendParticipantList", handler);
-
-  rebraze_auth->SetValue("sendParticipantList", send_participant_list_func,
-                        V8_PROPERTY_ATTRIBUTE_NONE);
-
-  rebraze_auth->SetValue("startRecording", CefV8Value::CreateFunction("startRecording", handler), V8_PROPERTY_ATTRIBUTE_NONE);
-  rebraze_auth->SetValue("stopRecording", CefV8Value::CreateFunction("stopRecording", handler), V8_PROPERTY_ATTRIBUTE_NONE);
-  rebraze_auth->SetValue("saveRecording", CefV8Value::CreateFunction("saveRecording", handler), V8_PROPERTY_ATTRIBUTE_NONE);
+  for (const V8FunctionTable::Entry& entry : GetV8FunctionTable()) {
+    rebraze_auth->SetValue(entry.name, CefV8Value::CreateFunction(entry.name, handler),
+                           V8_PROPERTY_ATTRIBUTE_NONE);
+  }
 
   // Attach to global object
   global->SetValue("rebrazeAuth", rebraze_auth, V8_PROPERTY_ATTRIBUTE_NONE);
@@ -329,123 +885,53 @@ void RenderProcessHandler::OnContextCreated(CefRefPtr<CefBrowser> browser,
   std::cout << "[Renderer] window.rebrazeAuth created successfully with multi-browser meeting support" << std::endl;
 }
 
-// Handle process messages from the browser process
-bool RenderProcessHandler::OnProcessMessageReceived(
-    CefRefPtr<CefBrowser> browser,
-    CefRefPtr<CefFrame> frame,
-    CefProcessId source_process,
-    CefRefPtr<CefProcessMessage> message) {
-
-  const std::string& message_name = message->GetName();
-
-  if (message_name == "screencast_frame") {
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string data = args->GetString(0);
-    std::string js = "if (window.onScreencastFrame) window.onScreencastFrame('" + data + "');";
-    frame->ExecuteJavaScript(js, frame->GetURL(), 0);
-    return true;
+void RenderProcessHandler::OnContextReleased(CefRefPtr<CefBrowser> browser,
+                                            CefRefPtr<CefFrame> frame,
+                                            CefRefPtr<CefV8Context> context) {
+  auto it = g_screencast_frame_handlers.find(browser->GetIdentifier());
+  if (it != g_screencast_frame_handlers.end() && it->second.context->IsSame(context)) {
+    g_screencast_frame_handlers.erase(it);
   }
 
-  if (message_name == "recording_saved") {
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string meeting_id = args->GetString(0);
-    std::string recording_path = args->GetString(1);
-
-    std::cout << "[Renderer] Recording saved - Meeting: " << meeting_id << ", Path: " << recording_path << std::endl;
-
-    // Escape strings for JavaScript
-    auto escapeJS = [](const std::string& str) {
-      std::string result;
-      for (char c : str) {
-        if (c == '\\') result += "\\\\";
-        else if (c == '\'') result += "\\'";
-        else if (c == '\n') result += "\\n";
-        else if (c == '\r') result += "\\r";
-        else result += c;
+  auto channel = g_event_channels.find(browser->GetIdentifier());
+  if (channel != g_event_channels.end()) {
+    std::map<int, EventSubscription>& subscriptions = channel->second.subscriptions;
+    for (auto subscription = subscriptions.begin(); subscription != subscriptions.end();) {
+      if (subscription->second.context->IsSame(context)) {
+        subscription = subscriptions.erase(subscription);
+      } else {
+        ++subscription;
       }
-      return result;
-    };
-
-    std::string js = "if (window.onRecordingSaved) window.onRecordingSaved('" +
-                     escapeJS(meeting_id) + "', '" + escapeJS(recording_path) + "');";
-    frame->ExecuteJavaScript(js, frame->GetURL(), 0);
-    return true;
+    }
+    if (subscriptions.empty()) {
+      g_event_channels.erase(channel);
+    }
   }
 
-  if (message_name == "auth_token_received") {
-    // Token received from OAuth callback
-    std::cout << "[Renderer] ✓ Received auth_token_received message!" << std::endl;
-
-    // Execute JavaScript callback
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string token = args->GetString(0);
-
-    std::cout << "[Renderer] Token: " << token.substr(0, 20) << "..." << std::endl;
-    std::cout << "[Renderer] Frame URL: " << frame->GetURL().ToString() << std::endl;
-
-    // Call JavaScript function if it exists - with console logging
-    std::string js_code =
-        "console.log('[CEF] Received auth token:', '" + token.substr(0, 20) + "...');"
-        "if (window.onAuthTokenReceived) {"
-        "  console.log('[CEF] Calling window.onAuthTokenReceived');"
-        "  window.onAuthTokenReceived('" + token + "');"
-        "  console.log('[CEF] window.onAuthTokenReceived called successfully');"
-        "} else {"
-        "  console.error('[CEF] window.onAuthTokenReceived is not defined!');"
-        "}";
-
-    std::cout << "[Renderer] Executing JavaScript to call window.onAuthTokenReceived" << std::endl;
-
-    frame->ExecuteJavaScript(js_code, frame->GetURL(), 0);
-
-    std::cout << "[Renderer] JavaScript executed" << std::endl;
-
-    return true;
+  // Promises of the context go with it; late results are ignored
+  for (auto request = g_pending_requests.begin(); request != g_pending_requests.end();) {
+    if (request->second.context->IsSame(context)) {
+      request = g_pending_requests.erase(request);
+    } else {
+      ++request;
+    }
   }
+}
 
-  if (message_name == "meeting_page_info_response") {
-    // Meeting page info response from browser process
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string url = args->GetString(0);
-    std::string title = args->GetString(1);
-
-    std::cout << "[Renderer] Meeting page info response - URL: " << url << ", Title: " << title << std::endl;
-
-    // Escape strings for JavaScript
-    auto escapeJS = [](const std::string& str) {
-      std::string result;
-      for (char c : str) {
-        if (c == '\\') result += "\\\\";
-        else if (c == '\'') result += "\\'";
-        else if (c == '\n') result += "\\n";
-        else if (c == '\r') result += "\\r";
-        else result += c;
-      }
-      return result;
-    };
-
-    // Call JavaScript callback if it exists
-    std::string js_code = "if (window.onMeetingPageInfo) { window.onMeetingPageInfo({ url: '" +
-                         escapeJS(url) + "', title: '" + escapeJS(title) + "' }); }";
-
-    frame->ExecuteJavaScript(js_code, frame->GetURL(), 0);
-    return true;
+// Handle process messages from the browser process
+bool RenderProcessHandler::OnProcessMessageReceived(
+    CefRefPtr<CefBrowser> browser,
+    CefRefPtr<CefFrame> frame,
+    CefProcessId source_process,
+    CefRefPtr<CefProcessMessage> message) {
+  const MessageTable::Entry* entry = GetMessageTable().Find(message->GetName().ToString());
+  if (!entry) {
+    return false;
   }
-
-  if (message_name == "meeting_participants_response") {
-    // Meeting participants response from browser process
-    CefRefPtr<CefListValue> args = message->GetArgumentList();
-    std::string json_list = args->GetString(0);
-
-    std::cout << "[Renderer] Meeting participants response: " << json_list << std::endl;
-
-    // Call JavaScript callback if it exists - pass the JSON array directly
-    std::string js_code = "if (window.onMeetingParticipants) { window.onMeetingParticipants(" +
-                         json_list + "); }";
-
-    frame->ExecuteJavaScript(js_code, frame->GetURL(), 0);
+  if (!MatchesSchema(entry->schema, message->GetArgumentList())) {
+    std::cerr << "[Renderer] Malformed process message: " << entry->name << std::endl;
     return true;
   }
-
-  return false;
+  entry->handler(browser, frame, message);
+  return true;
 }
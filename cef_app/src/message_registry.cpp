@@ -0,0 +1,122 @@
+#include "message_registry.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char kListTypes[] = "sidbBDL*";
+const char kV8Types[] = "siunboAaf*";
+
+bool MatchesListType(char type, CefRefPtr<CefListValue> args, size_t index) {
+  switch (type) {
+    case 's':
+      return args->GetType(index) == VTYPE_STRING;
+    case 'i':
+      return args->GetType(index) == VTYPE_INT;
+    case 'd':
+      return args->GetType(index) == VTYPE_DOUBLE || args->GetType(index) == VTYPE_INT;
+    case 'b':
+      return args->GetType(index) == VTYPE_BOOL;
+    case 'B':
+      return args->GetType(index) == VTYPE_BINARY;
+    case 'D':
+      return args->GetType(index) == VTYPE_DICTIONARY;
+    case 'L':
+      return args->GetType(index) == VTYPE_LIST;
+    default:
+      return true;
+  }
+}
+
+bool MatchesV8Type(char type, const CefRefPtr<CefV8Value>& value) {
+  switch (type) {
+    case 's':
+      return value->IsString();
+    case 'i':
+      return value->IsInt();
+    case 'u':
+      return value->IsUInt();
+    case 'n':
+      return value->IsInt() || value->IsUInt() || value->IsDouble();
+    case 'b':
+      return value->IsBool();
+    case 'o':
+      return value->IsObject();
+    case 'A':
+      return value->IsArray();
+    case 'a':
+      return value->IsArrayBuffer();
+    case 'f':
+      return value->IsFunction() || value->IsNull();
+    default:
+      return true;
+  }
+}
+
+}  // namespace
+
+bool MatchesSchema(const char* schema, CefRefPtr<CefListValue> args) {
+  if (!args) {
+    return true;
+  }
+  size_t size = args->GetSize();
+  size_t index = 0;
+  bool optional = false;
+  for (const char* type = schema; *type; type++) {
+    if (*type == '|') {
+      optional = true;
+      continue;
+    }
+    if (index >= size) {
+      return optional;
+    }
+    if (!(optional && args->GetType(index) == VTYPE_NULL) &&
+        !MatchesListType(*type, args, index)) {
+      return false;
+    }
+    index++;
+  }
+  return index == size;
+}
+
+bool MatchesSchema(const char* schema, const CefV8ValueList& args) {
+  size_t index = 0;
+  bool optional = false;
+  for (const char* type = schema; *type; type++) {
+    if (*type == '|') {
+      optional = true;
+      continue;
+    }
+    if (index >= args.size()) {
+      return optional;
+    }
+    const CefRefPtr<CefV8Value>& value = args[index];
+    if (!(optional && (value->IsNull() || value->IsUndefined())) &&
+        !MatchesV8Type(*type, value)) {
+      return false;
+    }
+    index++;
+  }
+  return index == args.size();
+}
+
+bool IsValidSchema(const char* schema, bool v8) {
+  const char* types = v8 ? kV8Types : kListTypes;
+  bool optional = false;
+  for (const char* type = schema; *type; type++) {
+    if (*type == '|' && !optional) {
+      optional = true;
+    } else if (!strchr(types, *type)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ReportBrokenMessageTable(const char* name, const char* reason) {
+  std::cerr << "[Messages] Broken message table at \"" << name << "\": " << reason
+            << std::endl;
+  abort();
+}
@@ -0,0 +1,357 @@
+#include "recording_index.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kIndexExtension[] = ".index";
+
+// Block size used when checksumming a segment during recovery
+const size_t kVerifyBlockSize = 64 * 1024;
+
+struct Crc32Table {
+  uint32_t values[256];
+
+  Crc32Table() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+      }
+      values[i] = crc;
+    }
+  }
+};
+
+uint32_t EntryChecksum(const RecordingSegmentEntry& entry) {
+  return UpdateCrc32(0, &entry, offsetof(RecordingSegmentEntry, entry_crc32));
+}
+
+int OpenFile(const std::string& path, int flags) {
+#if defined(_WIN32)
+  return _open(path.c_str(), flags | _O_BINARY, 0644);
+#else
+  return open(path.c_str(), flags | O_CLOEXEC, 0644);
+#endif
+}
+
+void CloseFile(int fd) {
+#if defined(_WIN32)
+  _close(fd);
+#else
+  close(fd);
+#endif
+}
+
+bool SyncFile(int fd) {
+#if defined(_WIN32)
+  return _commit(fd) == 0;
+#else
+  return fsync(fd) == 0;
+#endif
+}
+
+bool WriteAll(int fd, const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+#if defined(_WIN32)
+    int count = _write(fd, bytes, static_cast<unsigned int>(size));
+#else
+    ssize_t count = write(fd, bytes, size);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+#endif
+    if (count <= 0) {
+      return false;
+    }
+    bytes += count;
+    size -= static_cast<size_t>(count);
+  }
+  return true;
+}
+
+// Sequential read; returns false on error or a short read at end of file
+bool ReadAll(int fd, void* data, size_t size) {
+  char* bytes = static_cast<char*>(data);
+  while (size > 0) {
+#if defined(_WIN32)
+    int count = _read(fd, bytes, static_cast<unsigned int>(size));
+#else
+    ssize_t count = read(fd, bytes, size);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+#endif
+    if (count <= 0) {
+      return false;
+    }
+    bytes += count;
+    size -= static_cast<size_t>(count);
+  }
+  return true;
+}
+
+bool SeekTo(int fd, uint64_t offset) {
+#if defined(_WIN32)
+  return _lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) >= 0;
+#else
+  return lseek(fd, static_cast<off_t>(offset), SEEK_SET) >= 0;
+#endif
+}
+
+uint64_t FileSize(int fd) {
+#if defined(_WIN32)
+  struct _stat64 st;
+  return _fstat64(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+#else
+  struct stat st;
+  return fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+#endif
+}
+
+bool TruncateFile(int fd, uint64_t size) {
+#if defined(_WIN32)
+  return _chsize_s(fd, static_cast<__int64>(size)) == 0;
+#else
+  return ftruncate(fd, static_cast<off_t>(size)) == 0;
+#endif
+}
+
+bool SegmentMatches(int fd, const RecordingSegmentEntry& entry) {
+  if (!SeekTo(fd, entry.offset)) {
+    return false;
+  }
+  std::vector<char> block(kVerifyBlockSize);
+  uint64_t remaining = entry.size;
+  uint32_t crc = 0;
+  while (remaining > 0) {
+    size_t count = static_cast<size_t>(
+        remaining < kVerifyBlockSize ? remaining : kVerifyBlockSize);
+    if (!ReadAll(fd, block.data(), count)) {
+      return false;
+    }
+    crc = UpdateCrc32(crc, block.data(), count);
+    remaining -= count;
+  }
+  return crc == entry.crc32;
+}
+
+enum RecoveryResult { RECOVERED, DISCARDED, SKIPPED };
+
+RecoveryResult RecoverRecording(const std::string& index_path,
+                                std::time_t created_before,
+                                RecoveredRecording& recording) {
+  recording.path = index_path.substr(0, index_path.size() - strlen(kIndexExtension));
+  recording.segments = 0;
+  recording.size = 0;
+  recording.duration_ms = 0;
+
+  int index_fd = OpenFile(index_path, O_RDONLY);
+  if (index_fd < 0) {
+    return SKIPPED;
+  }
+
+  RecordingIndexHeader header;
+  if (!ReadAll(index_fd, &header, sizeof(header)) ||
+      header.magic != kRecordingIndexMagic || header.version != kRecordingIndexVersion) {
+    CloseFile(index_fd);
+    std::cerr << "[RecordingIndex] Ignoring unreadable index: " << index_path << std::endl;
+    return SKIPPED;
+  }
+  if (header.created_at >= static_cast<int64_t>(created_before)) {
+    CloseFile(index_fd);
+    return SKIPPED;  // Belongs to a recording of this run
+  }
+  header.meeting_id[sizeof(header.meeting_id) - 1] = '\0';
+  recording.meeting_id = header.meeting_id;
+
+  // Entries are appended after the data they describe is synced, so the
+  // committed prefix ends at the first torn or out of sequence entry
+  std::vector<RecordingSegmentEntry> segments;
+  RecordingSegmentEntry entry;
+  uint64_t expected_offset = 0;
+  while (ReadAll(index_fd, &entry, sizeof(entry))) {
+    if (entry.entry_crc32 != EntryChecksum(entry) ||
+        entry.segment != segments.size() || entry.offset != expected_offset) {
+      break;
+    }
+    segments.push_back(entry);
+    expected_offset = entry.offset + entry.size;
+  }
+  CloseFile(index_fd);
+
+  int data_fd = OpenFile(recording.path, O_RDWR);
+  if (data_fd >= 0) {
+    uint64_t data_size = FileSize(data_fd);
+    while (!segments.empty() &&
+           (segments.back().offset + segments.back().size > data_size ||
+            !SegmentMatches(data_fd, segments.back()))) {
+      std::cerr << "[RecordingIndex] Dropping damaged segment " << segments.back().segment
+                << " of " << recording.path << std::endl;
+      segments.pop_back();
+    }
+  } else {
+    segments.clear();
+  }
+
+  if (segments.empty()) {
+    if (data_fd >= 0) {
+      CloseFile(data_fd);
+    }
+    std::remove(recording.path.c_str());
+    std::remove(index_path.c_str());
+    return DISCARDED;
+  }
+
+  const RecordingSegmentEntry& last = segments.back();
+  recording.segments = static_cast<uint32_t>(segments.size());
+  recording.size = last.offset + last.size;
+  recording.duration_ms = last.end_ms;
+
+  bool success = TruncateFile(data_fd, recording.size) && SyncFile(data_fd);
+  CloseFile(data_fd);
+  if (!success) {
+    std::cerr << "[RecordingIndex] Failed to truncate " << recording.path << ": "
+              << strerror(errno) << std::endl;
+    return SKIPPED;
+  }
+
+  // Only now is the recording complete on disk
+  std::remove(index_path.c_str());
+  return RECOVERED;
+}
+
+}  // namespace
+
+std::string GetRecordingIndexPath(const std::string& recording_path) {
+  return recording_path + kIndexExtension;
+}
+
+uint32_t UpdateCrc32(uint32_t crc, const void* data, size_t size) {
+  static const Crc32Table table;
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc = table.values[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+RecordingIndex::RecordingIndex() : fd_(-1) {}
+
+RecordingIndex::~RecordingIndex() {
+  Close(false);
+}
+
+bool RecordingIndex::Create(const std::string& recording_path,
+                            const std::string& meeting_id) {
+  Close(false);
+
+  path_ = GetRecordingIndexPath(recording_path);
+  fd_ = OpenFile(path_, O_WRONLY | O_CREAT | O_TRUNC);
+  if (fd_ < 0) {
+    std::cerr << "[RecordingIndex] Failed to create " << path_ << ": " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+
+  RecordingIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kRecordingIndexMagic;
+  header.version = kRecordingIndexVersion;
+  header.created_at = static_cast<int64_t>(std::time(nullptr));
+  strncpy(header.meeting_id, meeting_id.c_str(), sizeof(header.meeting_id) - 1);
+
+  if (!WriteAll(fd_, &header, sizeof(header)) || !SyncFile(fd_)) {
+    std::cerr << "[RecordingIndex] Failed to write " << path_ << ": " << strerror(errno)
+              << std::endl;
+    Close(true);
+    return false;
+  }
+  return true;
+}
+
+bool RecordingIndex::Append(RecordingSegmentEntry entry) {
+  if (fd_ < 0) {
+    return false;
+  }
+  entry.reserved = 0;
+  entry.entry_crc32 = EntryChecksum(entry);
+  if (!WriteAll(fd_, &entry, sizeof(entry)) || !SyncFile(fd_)) {
+    std::cerr << "[RecordingIndex] Failed to append to " << path_ << ": " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void RecordingIndex::Close(bool remove) {
+  if (fd_ >= 0) {
+    CloseFile(fd_);
+    fd_ = -1;
+  }
+  if (remove && !path_.empty()) {
+    std::remove(path_.c_str());
+  }
+  path_.clear();
+}
+
+std::vector<RecoveredRecording> RecoverRecordings(const std::string& directory,
+                                                  std::time_t created_before) {
+  std::vector<RecoveredRecording> recovered;
+
+  std::error_code error;
+  std::filesystem::directory_iterator it(directory, error);
+  if (error) {
+    return recovered;
+  }
+
+  // Collect first; recovery deletes files from the directory
+  std::vector<std::string> index_paths;
+  size_t extension_length = strlen(kIndexExtension);
+  for (; it != std::filesystem::directory_iterator(); it.increment(error)) {
+    if (error) {
+      break;
+    }
+    std::string path = it->path().string();
+    if (path.size() > extension_length &&
+        path.compare(path.size() - extension_length, extension_length,
+                     kIndexExtension) == 0) {
+      index_paths.push_back(path);
+    }
+  }
+
+  for (const std::string& index_path : index_paths) {
+    RecoveredRecording recording;
+    switch (RecoverRecording(index_path, created_before, recording)) {
+      case RECOVERED:
+        std::cout << "[RecordingIndex] Recovered " << recording.path << ": "
+                  << recording.segments << " segments, " << recording.size << " bytes, "
+                  << recording.duration_ms << "ms" << std::endl;
+        recovered.push_back(recording);
+        break;
+      case DISCARDED:
+        std::cout << "[RecordingIndex] Discarded empty recording " << recording.path
+                  << std::endl;
+        break;
+      case SKIPPED:
+        break;
+    }
+  }
+  return recovered;
+}
@@ -0,0 +1,573 @@
+#include "recording_writer.h"
+#include "recording_index.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace {
+
+// Maximum number of operations waiting for the writer thread
+const size_t kQueueCapacity = 1024;
+
+// Writes submitted to io_uring at the same time
+const unsigned kRingEntries = 16;
+
+uint64_t MicrosecondsSince(std::chrono::steady_clock::time_point start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count());
+}
+
+int OpenForWriting(const std::string& path) {
+#if defined(_WIN32)
+  return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+  return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+}
+
+bool SyncData(int fd) {
+#if defined(_WIN32)
+  return _commit(fd) == 0;
+#elif defined(__linux__)
+  return fdatasync(fd) == 0;
+#else
+  return fsync(fd) == 0;
+#endif
+}
+
+void SyncAndClose(int fd) {
+#if defined(_WIN32)
+  _commit(fd);
+  _close(fd);
+#else
+  fsync(fd);
+  close(fd);
+#endif
+}
+
+}  // namespace
+
+struct RecordingWriter::Operation {
+  enum Kind { OPEN, WRITE, COMMIT, CLOSE };
+
+  Kind kind;
+  std::string path;
+  std::string meeting_id;
+  int64_t start_ms = 0;
+  int64_t end_ms = 0;
+  std::unique_ptr<Buffer> buffer;
+  CloseCallback callback;
+  std::chrono::steady_clock::time_point enqueued;
+
+  // WRITE bookkeeping on the writer thread
+  uint64_t offset = 0;
+  size_t written = 0;
+#if defined(__linux__)
+  struct iovec iov;
+#endif
+
+  const char* remaining_data() const {
+    return static_cast<const char*>(buffer->data()) + written;
+  }
+  size_t remaining_size() const { return buffer->size() - written; }
+};
+
+// Writes the remaining part of an operation's buffer at offset + written.
+// Completions are reported as (operation, bytes written or -errno).
+class RecordingWriter::Backend {
+ public:
+  using Completion = std::pair<Operation*, int64_t>;
+
+  virtual ~Backend() {}
+  virtual bool HasCapacity() const = 0;
+  virtual void Submit(int fd, Operation* op) = 0;
+  // Block until a submitted operation has completed, if any is pending
+  virtual void WaitForCompletion() = 0;
+  // Append the completions available now to |completions|; never blocks
+  virtual void Reap(std::vector<Completion>& completions) = 0;
+};
+
+// Synchronous positional writes; completions are available immediately
+class RecordingWriter::PwriteBackend : public RecordingWriter::Backend {
+ public:
+  bool HasCapacity() const override { return true; }
+
+  void Submit(int fd, Operation* op) override {
+    int64_t result;
+#if defined(_WIN32)
+    if (_lseeki64(fd, static_cast<__int64>(op->offset + op->written), SEEK_SET) < 0) {
+      result = -errno;
+    } else {
+      int count = _write(fd, op->remaining_data(),
+                         static_cast<unsigned int>(op->remaining_size()));
+      result = count < 0 ? -errno : count;
+    }
+#else
+    ssize_t count;
+    do {
+      count = pwrite(fd, op->remaining_data(), op->remaining_size(),
+                     static_cast<off_t>(op->offset + op->written));
+    } while (count < 0 && errno == EINTR);
+    result = count < 0 ? -errno : count;
+#endif
+    done_.push_back({op, result});
+  }
+
+  // Submit() has already written; there is never anything to wait for
+  void WaitForCompletion() override {}
+
+  void Reap(std::vector<Completion>& completions) override {
+    completions.insert(completions.end(), done_.begin(), done_.end());
+    done_.clear();
+  }
+
+ private:
+  std::vector<Completion> done_;
+};
+
+#if defined(__linux__)
+// Minimal io_uring driver using the raw system calls (no liburing)
+class RecordingWriter::IoUringBackend : public RecordingWriter::Backend {
+ public:
+  ~IoUringBackend() override {
+    if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_size_);
+    if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+    if (sq_ptr_ != MAP_FAILED) munmap(sq_ptr_, sq_size_);
+    if (ring_fd_ >= 0) close(ring_fd_);
+  }
+
+  bool Init() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, kRingEntries, &params));
+    if (ring_fd_ < 0) {
+      return false;
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+
+    sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) {
+      return false;
+    }
+    cq_ptr_ = single_mmap
+                  ? sq_ptr_
+                  : mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ptr_ == MAP_FAILED) {
+      return false;
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+      return false;
+    }
+
+    char* sq = static_cast<char*>(sq_ptr_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+
+    char* cq = static_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  bool HasCapacity() const override { return in_flight_ < sq_entries_; }
+
+  void Submit(int fd, Operation* op) override {
+    op->iov.iov_base = const_cast<char*>(op->remaining_data());
+    op->iov.iov_len = op->remaining_size();
+
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & sq_mask_;
+    struct io_uring_sqe* sqe = &static_cast<struct io_uring_sqe*>(sqes_)[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&op->iov);
+    sqe->len = 1;
+    sqe->off = op->offset + op->written;
+    sqe->user_data = reinterpret_cast<uint64_t>(op);
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    int ret;
+    do {
+      ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0));
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+      // Not submitted; report the failure as a completion
+      __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+      failed_.push_back({op, -static_cast<int64_t>(errno)});
+      return;
+    }
+    in_flight_++;
+  }
+
+  void WaitForCompletion() override {
+    if (!failed_.empty() || in_flight_ == 0 || HasCompletions()) {
+      return;
+    }
+    int ret;
+    do {
+      ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, 0, 1,
+                                     IORING_ENTER_GETEVENTS, nullptr, 0));
+    } while (ret < 0 && errno == EINTR);
+  }
+
+  void Reap(std::vector<Completion>& completions) override {
+    completions.insert(completions.end(), failed_.begin(), failed_.end());
+    failed_.clear();
+
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+      struct io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+      completions.push_back({reinterpret_cast<Operation*>(cqe->user_data),
+                             static_cast<int64_t>(cqe->res)});
+      in_flight_--;
+      head++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+
+ private:
+  bool HasCompletions() const {
+    return *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  }
+
+  int ring_fd_ = -1;
+  void* sq_ptr_ = MAP_FAILED;
+  void* cq_ptr_ = MAP_FAILED;
+  void* sqes_ = MAP_FAILED;
+  size_t sq_size_ = 0;
+  size_t cq_size_ = 0;
+  size_t sqes_size_ = 0;
+
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned* sq_array_ = nullptr;
+  unsigned sq_entries_ = 0;
+
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  struct io_uring_cqe* cqes_ = nullptr;
+
+  unsigned in_flight_ = 0;
+  std::vector<Completion> failed_;
+};
+#endif  // defined(__linux__)
+
+RecordingWriter::RecordingWriter()
+    : is_open_(false),
+      queue_(kQueueCapacity),
+      writer_waiting_(false),
+      shutdown_(false),
+      in_flight_(0),
+      bytes_written_(0),
+      writes_completed_(0),
+      last_latency_us_(0),
+      max_latency_us_(0),
+      total_latency_us_(0),
+      using_io_uring_(false) {
+  writer_thread_ = std::thread(&RecordingWriter::WriterThread, this);
+}
+
+RecordingWriter::~RecordingWriter() {
+  {
+    std::lock_guard<std::mutex> guard(wake_lock_);
+    shutdown_ = true;
+  }
+  wake_cv_.notify_one();
+  if (writer_thread_.joinable()) {
+    writer_thread_.join();
+  }
+}
+
+void RecordingWriter::Open(const std::string& path, const std::string& meeting_id) {
+  Operation* op = new Operation();
+  op->kind = Operation::OPEN;
+  op->path = path;
+  op->meeting_id = meeting_id;
+  path_ = path;
+  is_open_ = true;
+  Enqueue(op);
+}
+
+void RecordingWriter::Write(std::unique_ptr<Buffer> buffer) {
+  if (!buffer || buffer->size() == 0) {
+    return;
+  }
+  Operation* op = new Operation();
+  op->kind = Operation::WRITE;
+  op->buffer = std::move(buffer);
+  Enqueue(op);
+}
+
+void RecordingWriter::CommitSegment(int64_t start_ms, int64_t end_ms) {
+  Operation* op = new Operation();
+  op->kind = Operation::COMMIT;
+  op->start_ms = start_ms;
+  op->end_ms = end_ms;
+  Enqueue(op);
+}
+
+void RecordingWriter::Close(CloseCallback callback) {
+  Operation* op = new Operation();
+  op->kind = Operation::CLOSE;
+  op->path = path_;
+  op->callback = callback;
+  is_open_ = false;
+  path_.clear();
+  Enqueue(op);
+}
+
+RecordingWriter::Stats RecordingWriter::GetStats() const {
+  Stats stats;
+  stats.queue_depth = queue_.Size() + in_flight_;
+  stats.bytes_written = bytes_written_;
+  stats.writes_completed = writes_completed_;
+  stats.last_latency_us = last_latency_us_;
+  stats.max_latency_us = max_latency_us_;
+  stats.total_latency_us = total_latency_us_;
+  stats.using_io_uring = using_io_uring_;
+  return stats;
+}
+
+void RecordingWriter::Enqueue(Operation* op) {
+  op->enqueued = std::chrono::steady_clock::now();
+
+  // The queue only fills up if the disk is gigabytes behind; wait it out
+  while (!queue_.TryPush(op)) {
+    std::this_thread::yield();
+  }
+
+  if (writer_waiting_) {
+    std::lock_guard<std::mutex> guard(wake_lock_);
+    wake_cv_.notify_one();
+  }
+}
+
+void RecordingWriter::WriterThread() {
+  std::unique_ptr<Backend> backend;
+#if defined(__linux__)
+  std::unique_ptr<IoUringBackend> uring(new IoUringBackend());
+  if (uring->Init()) {
+    backend = std::move(uring);
+    using_io_uring_ = true;
+  }
+#endif
+  if (!backend) {
+    backend.reset(new PwriteBackend());
+  }
+  std::cout << "[RecordingWriter] Using "
+            << (using_io_uring_ ? "io_uring" : "pwrite") << " backend" << std::endl;
+
+  int fd = -1;
+  uint64_t offset = 0;
+  bool failed = false;
+  std::vector<Backend::Completion> completions;
+
+  // Bytes written since the last committed segment
+  RecordingIndex index;
+  uint32_t segment_count = 0;
+  uint64_t segment_offset = 0;
+  uint32_t segment_crc = 0;
+  int64_t segment_end_ms = 0;
+
+  auto process_completions = [&](bool wait) {
+    completions.clear();
+    if (wait) {
+      backend->WaitForCompletion();
+    }
+    backend->Reap(completions);
+    for (const Backend::Completion& completion : completions) {
+      Operation* op = completion.first;
+      int64_t result = completion.second;
+      if (result > 0) {
+        op->written += static_cast<size_t>(result);
+        bytes_written_ += static_cast<uint64_t>(result);
+        if (op->remaining_size() > 0) {
+          backend->Submit(fd, op);  // Short write, continue where it stopped
+          continue;
+        }
+        uint64_t latency = MicrosecondsSince(op->enqueued);
+        last_latency_us_ = latency;
+        total_latency_us_ += latency;
+        if (latency > max_latency_us_) max_latency_us_ = latency;
+        writes_completed_++;
+      } else {
+        std::cerr << "[RecordingWriter] Write failed: " << strerror(static_cast<int>(-result))
+                  << std::endl;
+        failed = true;
+      }
+      in_flight_--;
+      delete op;
+    }
+  };
+
+  auto drain = [&]() {
+    while (in_flight_ > 0) {
+      process_completions(true);
+    }
+  };
+
+  // Data first, then the index entry, so an entry never outlives its bytes
+  auto commit_segment = [&](int64_t start_ms, int64_t end_ms) {
+    drain();
+    if (fd < 0 || failed || !index.IsOpen() || offset == segment_offset) {
+      return;
+    }
+    if (!SyncData(fd)) {
+      std::cerr << "[RecordingWriter] Sync failed: " << strerror(errno) << std::endl;
+      failed = true;
+      return;
+    }
+    RecordingSegmentEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.segment = segment_count;
+    entry.crc32 = segment_crc;
+    entry.start_ms = start_ms;
+    entry.end_ms = end_ms;
+    entry.offset = segment_offset;
+    entry.size = offset - segment_offset;
+    if (index.Append(entry)) {
+      segment_count++;
+      segment_offset = offset;
+      segment_crc = 0;
+      segment_end_ms = end_ms;
+    }
+  };
+
+  while (true) {
+    Operation* op = nullptr;
+    if (!queue_.TryPop(op)) {
+      if (in_flight_ > 0) {
+        process_completions(true);
+        continue;
+      }
+      if (shutdown_) {
+        break;
+      }
+      std::unique_lock<std::mutex> lock(wake_lock_);
+      writer_waiting_ = true;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      wake_cv_.wait_for(lock, std::chrono::milliseconds(100),
+                        [this] { return !queue_.Empty() || shutdown_; });
+      writer_waiting_ = false;
+      continue;
+    }
+
+    switch (op->kind) {
+      case Operation::OPEN:
+        drain();
+        if (fd >= 0) {
+          SyncAndClose(fd);
+          index.Close(!failed);
+        }
+        fd = OpenForWriting(op->path);
+        offset = 0;
+        failed = fd < 0;
+        segment_count = 0;
+        segment_offset = 0;
+        segment_crc = 0;
+        segment_end_ms = 0;
+        if (failed) {
+          std::cerr << "[RecordingWriter] Failed to open " << op->path << ": "
+                    << strerror(errno) << std::endl;
+        } else if (!index.Create(op->path, op->meeting_id)) {
+          // Still record, just without crash recovery
+          std::cerr << "[RecordingWriter] Recording " << op->path
+                    << " is not crash safe" << std::endl;
+        }
+        delete op;
+        break;
+
+      case Operation::WRITE:
+        if (fd < 0) {
+          delete op;
+          break;
+        }
+        while (!backend->HasCapacity()) {
+          process_completions(true);
+        }
+        op->offset = offset;
+        offset += op->buffer->size();
+        segment_crc = UpdateCrc32(segment_crc, op->buffer->data(), op->buffer->size());
+        in_flight_++;
+        backend->Submit(fd, op);
+        process_completions(false);
+        break;
+
+      case Operation::COMMIT:
+        commit_segment(op->start_ms, op->end_ms);
+        delete op;
+        break;
+
+      case Operation::CLOSE: {
+        drain();
+        bool success = fd >= 0 && !failed;
+        if (fd >= 0) {
+          SyncAndClose(fd);
+          fd = -1;
+        }
+        // A complete file needs no recovery; after a failure the index lets
+        // the next launch salvage the committed segments
+        index.Close(success);
+
+        Stats stats = GetStats();
+        std::cout << "[RecordingWriter] Closed " << op->path << ": "
+                  << stats.bytes_written << " bytes total, "
+                  << stats.writes_completed << " writes, max latency "
+                  << stats.max_latency_us << "us" << std::endl;
+
+        if (op->callback) {
+          op->callback(op->path, success);
+        }
+        delete op;
+        break;
+      }
+    }
+  }
+
+  // Shutting down mid-recording: commit what has been written and keep the
+  // index so the next launch reports the recording
+  commit_segment(segment_end_ms, segment_end_ms);
+  if (fd >= 0) {
+    SyncAndClose(fd);
+  }
+  index.Close(false);
+}
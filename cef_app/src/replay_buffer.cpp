@@ -0,0 +1,175 @@
+#include "replay_buffer.h"
+#include "matroska_writer.h"
+#include "video_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// Upper bound on the screencast frame rate; sizes the frame table
+const int64_t kMaxFramesPerSecond = 60;
+
+// The frame table never has more entries than frames of this size would
+// fill the budget with; smaller frames expire by count instead of age
+const size_t kMinFrameBytes = 1024;
+
+// Entries for |max_duration_ms| at the maximum frame rate, each paid for
+// out of |budget_bytes| together with |entry_size| bytes of table
+size_t GetEntryCount(size_t budget_bytes, int64_t max_duration_ms, size_t entry_size) {
+  int64_t frames = std::max<int64_t>(max_duration_ms, 0) / 1000 * kMaxFramesPerSecond + 1;
+  size_t affordable = budget_bytes / (kMinFrameBytes + entry_size);
+  return std::max<size_t>(1, std::min(static_cast<size_t>(frames), affordable));
+}
+
+}  // namespace
+
+ReplayBuffer::ReplayBuffer(size_t budget_bytes, int64_t max_duration_ms)
+    : budget_(budget_bytes),
+      capacity_(budget_bytes -
+                GetEntryCount(budget_bytes, max_duration_ms, sizeof(Entry)) * sizeof(Entry)),
+      max_duration_ms_(max_duration_ms),
+      arena_(new uint8_t[capacity_]),
+      entries_(GetEntryCount(budget_bytes, max_duration_ms, sizeof(Entry))),
+      first_sequence_(0),
+      next_sequence_(0),
+      write_offset_(0),
+      reserved_offset_(0),
+      bytes_(0) {}
+
+uint8_t* ReplayBuffer::BeginFrame(size_t max_size) {
+  if (max_size == 0 || max_size > capacity_ / 4) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+
+  // Frames are contiguous; one that would straddle the end starts over at
+  // the beginning of the arena
+  uint64_t offset = write_offset_;
+  size_t position = static_cast<size_t>(offset % capacity_);
+  if (position + max_size > capacity_) {
+    offset += capacity_ - position;
+  }
+
+  // Everything the new frame may overwrite goes first
+  if (offset + max_size > capacity_) {
+    EvictBefore(offset + max_size - capacity_);
+  }
+  reserved_offset_ = offset;
+  return arena_.get() + offset % capacity_;
+}
+
+void ReplayBuffer::CommitFrame(size_t size, double timestamp) {
+  int64_t timestamp_ms = static_cast<int64_t>(std::llround(timestamp * 1000.0));
+
+  std::lock_guard<std::mutex> guard(lock_);
+
+  if (next_sequence_ - first_sequence_ == entries_.size()) {
+    bytes_ -= EntryAt(first_sequence_).size;
+    first_sequence_++;
+  }
+  EntryAt(next_sequence_) = {reserved_offset_, size, timestamp_ms};
+  next_sequence_++;
+  write_offset_ = reserved_offset_ + size;
+  bytes_ += size;
+
+  while (next_sequence_ - first_sequence_ > 1 &&
+         timestamp_ms - EntryAt(first_sequence_).timestamp_ms > max_duration_ms_) {
+    bytes_ -= EntryAt(first_sequence_).size;
+    first_sequence_++;
+  }
+}
+
+void ReplayBuffer::Clear() {
+  std::lock_guard<std::mutex> guard(lock_);
+  first_sequence_ = next_sequence_;
+  bytes_ = 0;
+}
+
+void ReplayBuffer::EvictBefore(uint64_t offset) {
+  while (first_sequence_ < next_sequence_ && EntryAt(first_sequence_).offset < offset) {
+    bytes_ -= EntryAt(first_sequence_).size;
+    first_sequence_++;
+  }
+}
+
+ReplayBuffer::Stats ReplayBuffer::GetStats() {
+  std::lock_guard<std::mutex> guard(lock_);
+  Stats stats = {next_sequence_ - first_sequence_, bytes_, 0};
+  if (stats.frames > 0) {
+    stats.duration_ms = EntryAt(next_sequence_ - 1).timestamp_ms -
+                        EntryAt(first_sequence_).timestamp_ms;
+  }
+  return stats;
+}
+
+bool ReplayBuffer::Save(const std::string& path, Stats* stats) {
+  // Only frames buffered when the save starts are written; the producer
+  // keeps going meanwhile
+  uint64_t sequence;
+  uint64_t end;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    sequence = first_sequence_;
+    end = next_sequence_;
+  }
+
+  MatroskaWriter writer;
+  std::vector<uint8_t> frame;
+  int64_t first_timestamp_ms = 0;
+  int64_t last_timestamp_ms = 0;
+  uint64_t skipped = 0;
+  bool failed = false;
+
+  while (sequence < end) {
+    int64_t timestamp_ms;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (sequence < first_sequence_) {
+        // Overwritten while the earlier frames were being written
+        skipped += first_sequence_ - sequence;
+        sequence = first_sequence_;
+        continue;
+      }
+      const Entry& entry = EntryAt(sequence);
+      const uint8_t* data = arena_.get() + entry.offset % capacity_;
+      frame.assign(data, data + entry.size);
+      timestamp_ms = entry.timestamp_ms;
+    }
+    sequence++;
+
+    if (!writer.IsOpen()) {
+      int width = 0;
+      int height = 0;
+      GetJpegDimensions(frame.data(), frame.size(), width, height);
+      if (!writer.Open(path, "matroska", "V_MJPEG", width, height)) {
+        std::cerr << "[ReplayBuffer] Failed to open " << path << std::endl;
+        return false;
+      }
+      first_timestamp_ms = timestamp_ms;
+    }
+
+    last_timestamp_ms = std::max(last_timestamp_ms, timestamp_ms - first_timestamp_ms);
+    if (!writer.WriteFrame(frame.data(), frame.size(), last_timestamp_ms, true)) {
+      failed = true;
+      break;
+    }
+  }
+
+  if (!writer.IsOpen()) {
+    std::cerr << "[ReplayBuffer] Nothing to save" << std::endl;
+    return false;
+  }
+
+  if (skipped > 0) {
+    std::cout << "[ReplayBuffer] " << skipped
+              << " frames were overwritten before they could be saved" << std::endl;
+  }
+  bool success = writer.Close() && !failed;
+  if (stats) {
+    *stats = {writer.GetFrameCount(), writer.GetBytesWritten(), writer.GetDurationMs()};
+  }
+  return success;
+}
@@ -0,0 +1,182 @@
+#include "screencast_controller.h"
+#include "utils.h"
+
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Settings from best to cheapest. Level 0 is used when the consumer keeps up
+// and captures at the view's full size, like a plain Page.startScreencast.
+const ScreencastController::Settings kLevels[] = {
+    {80, 0, 0, 1},
+    {70, 1920, 1080, 1},
+    {60, 1600, 900, 1},
+    {60, 1280, 720, 2},
+    {50, 1280, 720, 3},
+    {40, 960, 540, 4},
+};
+const size_t kLevelCount = sizeof(kLevels) / sizeof(kLevels[0]);
+
+// Frames acknowledged before the consumer has finished with them. Keeps the
+// pipeline busy without letting a backlog build up.
+const size_t kMaxFramesInFlight = 2;
+
+// Deferred acks are released if nothing has been consumed for this long
+const int kStallTimeoutMs = 2000;
+
+// Update() windows shorter than this are not evaluated
+const int kMinWindowMs = 500;
+
+// Thresholds for a window to count as pressured
+const double kMaxDeferredRatio = 0.25;  // Share of frames whose ack was held
+const double kMaxDroppedRatio = 0.25;   // Share of frames the consumer skipped
+const double kMaxLatencyMs = 150.0;     // Mean receive-to-consumed latency
+const double kMaxCpuLoad = 0.80;        // Process CPU time / (wall * cores)
+
+// Hysteresis: degrade quickly, recover slowly
+const int kPressuredWindowsToDegrade = 2;
+const int kCalmWindowsToUpgrade = 5;
+
+}  // namespace
+
+ScreencastController::ScreencastController() {
+  Reset();
+}
+
+void ScreencastController::Reset() {
+  in_flight_.clear();
+  deferred_acks_.clear();
+  last_consumed_ = Clock::now();
+  window_start_ = last_consumed_;
+  window_cpu_seconds_ = GetProcessCpuSeconds();
+  window_frames_ = 0;
+  window_deferred_ = 0;
+  window_dropped_ = 0;
+  window_latency_ms_ = 0.0;
+  window_consumed_ = 0;
+  level_ = 0;
+  pressured_windows_ = 0;
+  calm_windows_ = 0;
+}
+
+const ScreencastController::Settings& ScreencastController::GetSettings() const {
+  return kLevels[level_];
+}
+
+bool ScreencastController::OnFrameReceived(int session_id) {
+  if (in_flight_.empty()) {
+    // Nothing was pending, so the stall timer starts now
+    last_consumed_ = Clock::now();
+  }
+  size_t acked_in_flight = in_flight_.size() - deferred_acks_.size();
+  in_flight_.push_back(Clock::now());
+  window_frames_++;
+
+  if (acked_in_flight < kMaxFramesInFlight) {
+    return true;
+  }
+  deferred_acks_.push_back(session_id);
+  window_deferred_++;
+  return false;
+}
+
+int ScreencastController::OnFrameConsumed(bool dropped) {
+  last_consumed_ = Clock::now();
+  if (!in_flight_.empty()) {
+    // Dropped frames free a slot but say nothing about consumer latency
+    if (dropped) {
+      window_dropped_++;
+    } else {
+      window_latency_ms_ += std::chrono::duration<double, std::milli>(
+          last_consumed_ - in_flight_.front()).count();
+      window_consumed_++;
+    }
+    in_flight_.pop_front();
+  }
+
+  // Deferred frames are the newest, so the consumed one was normally acked
+  if (!deferred_acks_.empty() &&
+      in_flight_.size() < deferred_acks_.size() + kMaxFramesInFlight) {
+    int session_id = deferred_acks_.front();
+    deferred_acks_.pop_front();
+    return session_id;
+  }
+  return -1;
+}
+
+bool ScreencastController::Update(std::vector<int>& stalled_acks) {
+  Clock::time_point now = Clock::now();
+
+  if (!deferred_acks_.empty() &&
+      now - last_consumed_ > std::chrono::milliseconds(kStallTimeoutMs)) {
+    std::cerr << "[Screencast] Consumer stalled, releasing "
+              << deferred_acks_.size() << " deferred acks" << std::endl;
+    stalled_acks.insert(stalled_acks.end(), deferred_acks_.begin(), deferred_acks_.end());
+    deferred_acks_.clear();
+    in_flight_.clear();
+    last_consumed_ = now;
+  }
+
+  double wall_seconds = std::chrono::duration<double>(now - window_start_).count();
+  if (wall_seconds * 1000.0 < kMinWindowMs) {
+    return false;
+  }
+
+  double cpu_seconds = GetProcessCpuSeconds();
+  unsigned cores = std::thread::hardware_concurrency();
+  double cpu_load = (cpu_seconds - window_cpu_seconds_) /
+                    (wall_seconds * (cores > 0 ? cores : 1));
+  double deferred_ratio = window_frames_ > 0
+      ? static_cast<double>(window_deferred_) / window_frames_ : 0.0;
+  double dropped_ratio = window_frames_ > 0
+      ? static_cast<double>(window_dropped_) / window_frames_ : 0.0;
+  double mean_latency_ms = window_consumed_ > 0
+      ? window_latency_ms_ / window_consumed_ : 0.0;
+
+  bool pressured = deferred_ratio > kMaxDeferredRatio ||
+                   dropped_ratio > kMaxDroppedRatio ||
+                   mean_latency_ms > kMaxLatencyMs ||
+                   cpu_load > kMaxCpuLoad;
+  // Only count a window as calm if frames actually flowed through it
+  bool calm = !pressured && window_consumed_ > 0;
+
+  window_start_ = now;
+  window_cpu_seconds_ = cpu_seconds;
+  window_frames_ = 0;
+  window_deferred_ = 0;
+  window_dropped_ = 0;
+  window_latency_ms_ = 0.0;
+  window_consumed_ = 0;
+
+  size_t previous_level = level_;
+  if (pressured) {
+    calm_windows_ = 0;
+    if (++pressured_windows_ >= kPressuredWindowsToDegrade && level_ + 1 < kLevelCount) {
+      level_++;
+      pressured_windows_ = 0;
+    }
+  } else if (calm) {
+    pressured_windows_ = 0;
+    if (++calm_windows_ >= kCalmWindowsToUpgrade && level_ > 0) {
+      level_--;
+      calm_windows_ = 0;
+    }
+  }
+
+  if (level_ == previous_level) {
+    return false;
+  }
+
+  const Settings& settings = GetSettings();
+  std::cout << "[Screencast] Level " << previous_level << " -> " << level_
+            << " (deferred " << static_cast<int>(deferred_ratio * 100) << "%, dropped "
+            << static_cast<int>(dropped_ratio * 100) << "%, latency "
+            << static_cast<int>(mean_latency_ms) << " ms, cpu "
+            << static_cast<int>(cpu_load * 100) << "%): quality " << settings.quality
+            << ", max " << (settings.max_width > 0 ? std::to_string(settings.max_width) + "x" +
+                                std::to_string(settings.max_height) : "full size")
+            << ", every " << settings.every_nth_frame << " frame(s)" << std::endl;
+  return true;
+}
@@ -0,0 +1,213 @@
+#include "screencast_frame_parser.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Nesting deeper than this is not expected in screencast events
+const int kMaxDepth = 16;
+
+// Minimal forward-only JSON reader over a byte range
+class JsonScanner {
+ public:
+  JsonScanner(const char* begin, const char* end) : pos_(begin), end_(end) {}
+
+  void SkipWhitespace() {
+    while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\n' || *pos_ == '\r')) {
+      pos_++;
+    }
+  }
+
+  bool Consume(char c) {
+    SkipWhitespace();
+    if (pos_ < end_ && *pos_ == c) {
+      pos_++;
+      return true;
+    }
+    return false;
+  }
+
+  bool Peek(char c) {
+    SkipWhitespace();
+    return pos_ < end_ && *pos_ == c;
+  }
+
+  // Read a string as a span between its quotes. |escaped| is set if the span
+  // contains backslash escapes and therefore is not the literal value.
+  bool ReadString(const char*& begin, size_t& size, bool& escaped) {
+    if (!Consume('"')) {
+      return false;
+    }
+    begin = pos_;
+    escaped = false;
+    while (true) {
+      // memchr is much faster than a byte loop over large base64 payloads
+      const char* quote = static_cast<const char*>(memchr(pos_, '"', end_ - pos_));
+      if (!quote) {
+        return false;
+      }
+      if (memchr(pos_, '\\', quote - pos_)) {
+        escaped = true;
+        // Count the backslashes in front of the quote to see if it is escaped
+        const char* back = quote;
+        while (back > begin && back[-1] == '\\') {
+          back--;
+        }
+        if ((quote - back) % 2 == 1) {
+          pos_ = quote + 1;
+          continue;
+        }
+      }
+      size = static_cast<size_t>(quote - begin);
+      pos_ = quote + 1;
+      return true;
+    }
+  }
+
+  bool ReadNumber(double& value) {
+    SkipWhitespace();
+    char buffer[64];
+    size_t length = 0;
+    while (pos_ < end_ && length < sizeof(buffer) - 1 &&
+           (isdigit(static_cast<unsigned char>(*pos_)) || *pos_ == '-' || *pos_ == '+' ||
+            *pos_ == '.' || *pos_ == 'e' || *pos_ == 'E')) {
+      buffer[length++] = *pos_++;
+    }
+    if (length == 0) {
+      return false;
+    }
+    buffer[length] = '\0';
+    char* parsed_end = nullptr;
+    value = strtod(buffer, &parsed_end);
+    return parsed_end == buffer + length;
+  }
+
+  bool SkipValue(int depth) {
+    if (depth > kMaxDepth) {
+      return false;
+    }
+    SkipWhitespace();
+    if (pos_ >= end_) {
+      return false;
+    }
+
+    const char* begin;
+    size_t size;
+    bool escaped;
+    double number;
+    switch (*pos_) {
+      case '"':
+        return ReadString(begin, size, escaped);
+      case '{':
+        return ForEachMember([this, depth](const char*, size_t, bool) {
+          return SkipValue(depth + 1);
+        });
+      case '[':
+        pos_++;
+        if (Consume(']')) {
+          return true;
+        }
+        do {
+          if (!SkipValue(depth + 1)) {
+            return false;
+          }
+        } while (Consume(','));
+        return Consume(']');
+      case 't':
+        return SkipLiteral("true");
+      case 'f':
+        return SkipLiteral("false");
+      case 'n':
+        return SkipLiteral("null");
+      default:
+        return ReadNumber(number);
+    }
+  }
+
+  // Visit the members of an object. |visit| is called with each key and must
+  // consume the value.
+  template <typename Visitor>
+  bool ForEachMember(Visitor visit) {
+    if (!Consume('{')) {
+      return false;
+    }
+    if (Consume('}')) {
+      return true;
+    }
+    do {
+      const char* key;
+      size_t key_size;
+      bool escaped;
+      if (!ReadString(key, key_size, escaped) || !Consume(':')) {
+        return false;
+      }
+      if (!visit(key, key_size, escaped)) {
+        return false;
+      }
+    } while (Consume(','));
+    return Consume('}');
+  }
+
+ private:
+  bool SkipLiteral(const char* literal) {
+    size_t length = strlen(literal);
+    if (static_cast<size_t>(end_ - pos_) < length || memcmp(pos_, literal, length) != 0) {
+      return false;
+    }
+    pos_ += length;
+    return true;
+  }
+
+  const char* pos_;
+  const char* end_;
+};
+
+bool KeyEquals(const char* key, size_t key_size, const char* name) {
+  return key_size == strlen(name) && memcmp(key, name, key_size) == 0;
+}
+
+}  // namespace
+
+bool ParseScreencastFrame(const void* params, size_t size,
+                          ScreencastFrameView& frame) {
+  const char* begin = static_cast<const char*>(params);
+  JsonScanner scanner(begin, begin + size);
+
+  frame.data = nullptr;
+  frame.data_size = 0;
+  frame.has_session_id = false;
+  frame.has_timestamp = false;
+
+  bool data_escaped = false;
+  bool ok = scanner.ForEachMember([&](const char* key, size_t key_size, bool) {
+    if (KeyEquals(key, key_size, "data") && scanner.Peek('"')) {
+      return scanner.ReadString(frame.data, frame.data_size, data_escaped);
+    }
+    if (KeyEquals(key, key_size, "sessionId") && !scanner.Peek('"')) {
+      double value;
+      if (!scanner.ReadNumber(value)) {
+        return false;
+      }
+      frame.session_id = static_cast<int>(value);
+      frame.has_session_id = true;
+      return true;
+    }
+    if (KeyEquals(key, key_size, "metadata") && scanner.Peek('{')) {
+      return scanner.ForEachMember([&](const char* meta_key, size_t meta_key_size, bool) {
+        if (KeyEquals(meta_key, meta_key_size, "timestamp") && !scanner.Peek('"')) {
+          if (!scanner.ReadNumber(frame.timestamp)) {
+            return false;
+          }
+          frame.has_timestamp = true;
+          return true;
+        }
+        return scanner.SkipValue(1);
+      });
+    }
+    return scanner.SkipValue(0);
+  });
+
+  return ok && frame.data != nullptr && !data_escaped;
+}
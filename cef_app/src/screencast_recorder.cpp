@@ -0,0 +1,386 @@
+#include "screencast_recorder.h"
+#include "matroska_writer.h"
+#include "tile_codec.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace {
+
+// Upper bound on frames waiting for the writer (~4 seconds at 30 fps).
+// Beyond this the oldest frames are dropped to keep memory bounded.
+const size_t kMaxQueuedFrames = 120;
+
+// Raw frame buffers kept for reuse; enough to cover a short writer stall
+const size_t kPooledFrameBuffers = 16;
+
+// Decode pool output kept for reuse: I420 pictures (VP8/VP9) or compressed
+// raw frames (MJPEG, tiles); covers the frames in flight in the pool
+const size_t kPooledImageBuffers = 8;
+
+// JPEG quality of raw frames, about what the screencast itself delivers
+const int kRawFrameQuality = 80;
+
+}  // namespace
+
+ScreencastRecorder::ScreencastRecorder()
+    : recording_(false),
+      stop_requested_(false),
+      frame_pool_(kPooledFrameBuffers),
+      image_pool_(kPooledImageBuffers),
+      frames_written_(0),
+      frames_dropped_(0) {}
+
+ScreencastRecorder::~ScreencastRecorder() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stop_requested_ = true;
+  }
+  cv_.notify_one();
+  if (writer_thread_.joinable()) {
+    writer_thread_.join();
+  }
+}
+
+struct ScreencastRecorder::EncodeJob {
+  Frame frame;
+  I420Image image;
+  ByteBuffer jpeg;  // Raw frames when not encoding, cropped
+  bool decoded = false;
+  bool done = false;  // Guarded by decode_lock_
+};
+
+bool ScreencastRecorder::Start(const std::string& path, const VideoEncoderConfig& config) {
+  if (recording_) {
+    std::cerr << "[Recorder] Recording already in progress: " << path_ << std::endl;
+    return false;
+  }
+
+  // A previous session may still be finalizing
+  if (writer_thread_.joinable()) {
+    writer_thread_.join();
+  }
+
+  path_ = path;
+  config_ = config;
+  if (IsVideoCodecEncoded(config_.codec) && !VideoEncoder::IsAvailable(config_.codec)) {
+    std::cerr << "[Recorder] " << GetVideoCodecName(config_.codec)
+              << " is not available in this build, recording MJPEG" << std::endl;
+    config_.codec = VIDEO_CODEC_MJPEG;
+  }
+  queue_.clear();
+  crop_ = CropRect();
+  stop_requested_ = false;
+  finished_callback_ = nullptr;
+  frames_written_ = 0;
+  frames_dropped_ = 0;
+  recording_ = true;
+
+  writer_thread_ = std::thread(&ScreencastRecorder::WriterThread, this);
+
+  std::cout << "[Recorder] Native screencast recording to: " << path_ << " ("
+            << GetVideoCodecName(config_.codec) << ")" << std::endl;
+  return true;
+}
+
+void ScreencastRecorder::AddFrame(const FrameRef& jpeg) {
+  if (!recording_) {
+    return;
+  }
+  Frame frame;
+  frame.jpeg = jpeg;
+  frame.timestamp = jpeg->GetTimestamp();
+  QueueFrame(std::move(frame));
+}
+
+void ScreencastRecorder::AddRawFrame(const void* bgra, int width, int height, int stride,
+                                     double timestamp) {
+  if (!recording_ || width <= 0 || height <= 0) {
+    return;
+  }
+  Frame frame;
+  size_t row_size = static_cast<size_t>(width) * 4;
+  frame.data = frame_pool_.Acquire(row_size * height);
+  for (int y = 0; y < height; y++) {
+    memcpy(frame.data.data() + row_size * y,
+           static_cast<const uint8_t*>(bgra) + static_cast<size_t>(stride) * y, row_size);
+  }
+  frame.timestamp = timestamp;
+  frame.width = width;
+  frame.height = height;
+  QueueFrame(std::move(frame));
+}
+
+void ScreencastRecorder::QueueFrame(Frame frame) {
+  bool dropped = false;
+  Frame dropped_frame;  // Released outside the lock
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (stop_requested_) {
+      frame_pool_.Release(std::move(frame.data));
+      return;
+    }
+    if (queue_.size() >= kMaxQueuedFrames) {
+      dropped_frame = std::move(queue_.front());
+      queue_.pop_front();
+      frames_dropped_++;
+      dropped = true;
+    }
+    frame.crop = crop_;
+    queue_.push_back(std::move(frame));
+  }
+  cv_.notify_one();
+
+  if (dropped) {
+    if (dropped_frame.jpeg) {
+      dropped_frame.jpeg->MarkDropped();
+    } else {
+      frame_pool_.Release(std::move(dropped_frame.data));
+      if (frame_consumed_callback_) {
+        frame_consumed_callback_(true);
+      }
+    }
+  }
+}
+
+void ScreencastRecorder::SetCrop(const CropRect& rect) {
+  std::lock_guard<std::mutex> guard(lock_);
+  crop_ = rect;
+}
+
+void ScreencastRecorder::Stop(FinishedCallback callback) {
+  if (!recording_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stop_requested_ = true;
+    finished_callback_ = callback;
+  }
+  cv_.notify_one();
+  recording_ = false;
+}
+
+size_t ScreencastRecorder::GetQueueDepth() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return queue_.size();
+}
+
+void ScreencastRecorder::WriterThread() {
+  bool encode = IsVideoCodecEncoded(config_.codec);
+  MatroskaWriter writer;
+  VideoEncoder encoder;
+  std::unique_ptr<TileEncoder> tile_encoder;
+  if (config_.codec == VIDEO_CODEC_TILES) {
+    tile_encoder.reset(new TileEncoder());
+  }
+  std::vector<uint8_t> delta;
+  std::vector<uint8_t> cropped;
+  bool failed = false;
+  double first_timestamp = -1.0;
+
+  // JPEG decoding (or BGRA conversion) is the parallel part of the VP8/VP9
+  // pipeline; encoding stays in order here and libvpx spreads it over its
+  // own threads. MJPEG and tiles only need the pool to compress raw frames.
+  std::unique_ptr<WorkerPool> decode_pool;
+  size_t decoders = static_cast<size_t>(std::max(1, GetVideoEncoderThreads(config_) / 2));
+  size_t pipeline_depth = 1;
+  std::deque<std::shared_ptr<EncodeJob>> pipeline;
+
+  auto write_packet = [&](const uint8_t* data, size_t size, int64_t timestamp_ms,
+                          bool keyframe) {
+    if (!failed && !writer.WriteFrame(data, size, timestamp_ms, keyframe)) {
+      std::cerr << "[Recorder] Write failed, stopping native recording" << std::endl;
+      failed = true;
+    }
+  };
+
+  while (true) {
+    std::vector<std::shared_ptr<EncodeJob>> started;
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      if (pipeline.empty()) {
+        cv_.wait(guard, [this] { return stop_requested_ || !queue_.empty(); });
+        if (queue_.empty()) {
+          break;  // Stop requested and everything has been drained
+        }
+      }
+      while (!queue_.empty() && pipeline.size() < pipeline_depth) {
+        std::shared_ptr<EncodeJob> job = std::make_shared<EncodeJob>();
+        job->frame = std::move(queue_.front());
+        queue_.pop_front();
+        pipeline.push_back(job);
+        started.push_back(job);
+      }
+    }
+
+    for (const std::shared_ptr<EncodeJob>& job : started) {
+      const Frame& frame = job->frame;
+      int width = frame.width;
+      int height = frame.height;
+      bool raw = width > 0;
+      if ((!encode && !raw) ||
+          (!raw && !GetJpegDimensions(frame.jpeg->GetJpeg(), frame.jpeg->GetJpegSize(), width,
+                                      height))) {
+        job->done = true;
+        continue;
+      }
+      if (!decode_pool) {
+        decode_pool.reset(new WorkerPool(decoders, "Screencast decode"));
+        pipeline_depth = decoders * 2;
+      }
+      if (encode) {
+        job->image.Allocate(width, height,
+                            image_pool_.Acquire(I420Image::GetBufferSize(width, height)));
+      } else {
+        job->jpeg = image_pool_.Acquire(0);
+      }
+      decode_pool->Post([this, job, encode, raw] {
+        const Frame& frame = job->frame;
+        bool decoded = false;
+        int left, top, crop_width, crop_height;
+        if (encode && raw) {
+          decoded = ConvertBgraToI420(frame.data.data(), frame.width * 4, job->image);
+        } else if (encode) {
+          decoded = DecodeJpegToI420(frame.jpeg->GetJpeg(), frame.jpeg->GetJpegSize(),
+                                     job->image);
+        } else if (frame.crop.GetBounds(frame.width, frame.height, 1, 1, left, top, crop_width,
+                                        crop_height)) {
+          decoded = EncodeBgraToJpeg(
+              frame.data.data() + (static_cast<size_t>(top) * frame.width + left) * 4,
+              crop_width, crop_height, frame.width * 4, kRawFrameQuality, job->jpeg);
+        } else {
+          decoded = EncodeBgraToJpeg(frame.data.data(), frame.width, frame.height,
+                                     frame.width * 4, kRawFrameQuality, job->jpeg);
+        }
+        {
+          std::lock_guard<std::mutex> guard(decode_lock_);
+          job->decoded = decoded;
+          job->done = true;
+        }
+        decode_cv_.notify_all();
+      });
+    }
+
+    // Oldest frame first; the encoder needs them in order
+    std::shared_ptr<EncodeJob> job = pipeline.front();
+    pipeline.pop_front();
+    {
+      std::unique_lock<std::mutex> guard(decode_lock_);
+      decode_cv_.wait(guard, [&job] { return job->done; });
+    }
+    Frame& frame = job->frame;
+
+    // Region of interest: VP8/VP9 pictures are narrowed in place, JPEGs are
+    // cropped losslessly on the MCU grid; raw frames were cropped before
+    // compression
+    bool raw = frame.width > 0;
+    bool usable = (encode || raw) ? job->decoded : true;
+    const uint8_t* jpeg = raw ? job->jpeg.data() : frame.jpeg->GetJpeg();
+    size_t jpeg_size = raw ? job->jpeg.size() : frame.jpeg->GetJpegSize();
+    int left, top, crop_width, crop_height;
+    if (encode) {
+      if (job->decoded && frame.crop.GetBounds(job->image.width, job->image.height, 2, 2, left,
+                                               top, crop_width, crop_height)) {
+        job->image.Crop(left, top, crop_width, crop_height);
+      }
+    } else if (!raw && !frame.crop.IsFull() && CropJpeg(jpeg, jpeg_size, frame.crop, cropped)) {
+      jpeg = cropped.data();
+      jpeg_size = cropped.size();
+    }
+
+    if (!failed && usable && !writer.IsOpen()) {
+      int width = 0;
+      int height = 0;
+      if (encode) {
+        width = job->image.width;
+        height = job->image.height;
+      } else {
+        GetJpegDimensions(jpeg, jpeg_size, width, height);
+      }
+      bool opened = writer.Open(path_, encode ? "webm" : "matroska",
+                                GetVideoCodecId(config_.codec), width, height);
+      if (opened && encode) {
+        opened = encoder.Open(config_, width, height);
+      }
+      if (opened) {
+        first_timestamp = frame.timestamp;
+      } else {
+        failed = true;
+      }
+    }
+
+    if (!failed && usable) {
+      int64_t timestamp_ms = static_cast<int64_t>(
+          std::llround((frame.timestamp - first_timestamp) * 1000.0));
+      if (tile_encoder) {
+        // Unchanged frames are still written, as empty deltas, so that
+        // every frame keeps its timestamp
+        if (tile_encoder->Encode(jpeg, jpeg_size, timestamp_ms, delta)) {
+          write_packet(jpeg, jpeg_size, timestamp_ms, true);
+        } else {
+          write_packet(delta.data(), delta.size(), timestamp_ms, false);
+        }
+        if (!failed) {
+          frames_written_++;
+        }
+      } else if (!encode) {
+        write_packet(jpeg, jpeg_size, timestamp_ms, true);
+        if (!failed) {
+          frames_written_++;
+        }
+      } else if (encoder.Encode(job->image, timestamp_ms, write_packet)) {
+        frames_written_++;
+      } else {
+        failed = true;
+      }
+    }
+
+    if (encode) {
+      image_pool_.Release(std::move(job->image.data));
+    } else if (raw) {
+      image_pool_.Release(std::move(job->jpeg));
+    }
+    if (raw) {
+      frame_pool_.Release(std::move(frame.data));
+      if (frame_consumed_callback_) {
+        frame_consumed_callback_(false);
+      }
+    } else {
+      frame.jpeg = nullptr;
+    }
+  }
+
+  if (encoder.IsOpen()) {
+    encoder.Flush(write_packet);
+    encoder.Close();
+  }
+
+  bool success = false;
+  if (writer.IsOpen()) {
+    success = writer.Close() && !failed;
+  }
+
+  std::cout << "[Recorder] Finished " << path_ << ": " << frames_written_
+            << " frames written, " << frames_dropped_ << " dropped" << std::endl;
+  if (tile_encoder) {
+    std::cout << "[Recorder] " << tile_encoder->GetKeyframes() << " keyframes, "
+              << tile_encoder->GetDeltas() << " deltas with "
+              << tile_encoder->GetChangedTiles() << " changed tiles" << std::endl;
+  }
+
+  FinishedCallback callback;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    callback = finished_callback_;
+    finished_callback_ = nullptr;
+  }
+  if (callback) {
+    callback(path_, success);
+  }
+}
@@ -0,0 +1,270 @@
+#include "slide_detector.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SLIDE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SLIDE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Tiles are kTileBlocks x kTileBlocks pixels of the DC image
+const int kTileBlocks = 8;
+
+// A tile has settled once it showed no motion for this many analyzed frames
+const uint8_t kSettleFrames = 3;
+
+// Sum of absolute differences of each 8x8 tile of |a| and |b|, which have
+// the same size. |sums| gets stride / 8 entries per tile row.
+void ComputeTileSad(const LumaImage& a, const LumaImage& b, std::vector<uint32_t>& sums) {
+  int tiles_x = a.stride / kTileBlocks;
+  int tiles_y = (a.height + kTileBlocks - 1) / kTileBlocks;
+  sums.assign(static_cast<size_t>(tiles_x) * tiles_y, 0);
+
+  for (int ty = 0; ty < tiles_y; ty++) {
+    const uint8_t* row_a = a.pixels.data() + static_cast<size_t>(ty) * kTileBlocks * a.stride;
+    const uint8_t* row_b = b.pixels.data() + static_cast<size_t>(ty) * kTileBlocks * b.stride;
+    uint32_t* row_sums = sums.data() + static_cast<size_t>(ty) * tiles_x;
+
+    // Two tiles per 16-byte column; the buffers are padded to whole columns
+    for (int x = 0; x < a.stride; x += 16) {
+#if defined(SLIDE_SSE2)
+      __m128i acc = _mm_setzero_si128();
+      for (int y = 0; y < kTileBlocks; y++) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row_a + y * a.stride + x));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row_b + y * b.stride + x));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+      }
+      row_sums[x / 8] = static_cast<uint32_t>(_mm_cvtsi128_si32(acc));
+      row_sums[x / 8 + 1] = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#elif defined(SLIDE_NEON)
+      uint16x8_t acc = vdupq_n_u16(0);
+      for (int y = 0; y < kTileBlocks; y++) {
+        uint8x16_t va = vld1q_u8(row_a + y * a.stride + x);
+        uint8x16_t vb = vld1q_u8(row_b + y * b.stride + x);
+        acc = vpadalq_u8(acc, vabdq_u8(va, vb));
+      }
+      uint64x2_t halves = vpaddlq_u32(vpaddlq_u16(acc));
+      row_sums[x / 8] = static_cast<uint32_t>(vgetq_lane_u64(halves, 0));
+      row_sums[x / 8 + 1] = static_cast<uint32_t>(vgetq_lane_u64(halves, 1));
+#else
+      for (int y = 0; y < kTileBlocks; y++) {
+        const uint8_t* pa = row_a + y * a.stride + x;
+        const uint8_t* pb = row_b + y * b.stride + x;
+        for (int i = 0; i < 16; i++) {
+          row_sums[x / 8 + i / 8] += pa[i] > pb[i] ? pa[i] - pb[i] : pb[i] - pa[i];
+        }
+      }
+#endif
+    }
+  }
+}
+
+}  // namespace
+
+SlideDetector::SlideDetector()
+    : running_(false),
+      stop_requested_(false),
+      has_keyframe_(false),
+      settled_(false),
+      first_timestamp_(-1.0),
+      keyframe_count_(0) {}
+
+SlideDetector::~SlideDetector() {
+  Stop();
+}
+
+bool SlideDetector::Start(const std::string& directory, const Options& options) {
+  if (running_) {
+    return false;
+  }
+  if (!MakeDirectory(directory)) {
+    return false;
+  }
+  sidecar_.open(directory + "/slides.jsonl", std::ios::out | std::ios::app);
+  if (!sidecar_.is_open()) {
+    std::cerr << "[SlideDetector] Failed to open sidecar in " << directory << std::endl;
+    return false;
+  }
+
+  directory_ = directory;
+  options_ = options;
+  pending_frame_ = nullptr;
+  stop_requested_ = false;
+  has_keyframe_ = false;
+  settled_ = false;
+  previous_ = LumaImage();
+  first_timestamp_ = -1.0;
+  keyframe_count_ = 0;
+  running_ = true;
+  analyzer_thread_ = std::thread(&SlideDetector::AnalyzerThread, this);
+  std::cout << "[SlideDetector] Writing slides to " << directory << std::endl;
+  return true;
+}
+
+void SlideDetector::Stop() {
+  if (!running_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stop_requested_ = true;
+  }
+  cv_.notify_one();
+  analyzer_thread_.join();
+  pending_frame_ = nullptr;
+  sidecar_.close();
+  running_ = false;
+  std::cout << "[SlideDetector] " << keyframe_count_ << " slides in " << directory_
+            << std::endl;
+}
+
+void SlideDetector::AddFrame(const FrameRef& frame) {
+  FrameRef replaced;  // Released outside the lock
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    replaced = std::move(pending_frame_);
+    pending_frame_ = frame;
+  }
+  cv_.notify_one();
+}
+
+void SlideDetector::AnalyzerThread() {
+  // The last frame is kept: the screencast only sends frames when the page
+  // changes, so a slide that stays up has to be re-examined without one.
+  // Its JPEG is copied so that the shared frame, which holds back the
+  // screencast ack, is let go right away.
+  std::vector<uint8_t> jpeg;
+  double timestamp = 0.0;
+  bool decoded = false;
+
+  while (true) {
+    FrameRef frame;
+    bool repeat = false;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      cv_.wait_for(lock, std::chrono::milliseconds(options_.interval_ms),
+                   [this] { return pending_frame_ || stop_requested_; });
+      if (pending_frame_) {
+        frame = std::move(pending_frame_);
+        pending_frame_ = nullptr;
+        timestamp = frame->GetTimestamp();
+      } else if (stop_requested_) {
+        break;
+      } else if (decoded && !settled_) {
+        repeat = true;
+      } else {
+        continue;
+      }
+    }
+
+    if (first_timestamp_ < 0.0) {
+      first_timestamp_ = timestamp;
+    }
+    if (repeat) {
+      current_ = previous_;
+    } else {
+      // Shared with any other consumer of the 1/8-scale picture
+      const LumaImage* luma = frame->GetDcLuma();
+      decoded = luma != nullptr;
+      if (!decoded) {
+        continue;
+      }
+      current_ = *luma;
+      jpeg.assign(frame->GetJpeg(), frame->GetJpeg() + frame->GetJpegSize());
+      frame = nullptr;
+    }
+
+    double score = Analyze();
+    if (score >= options_.change_threshold) {
+      SaveKeyframe(jpeg, timestamp, score);
+      keyframe_ = current_;
+      has_keyframe_ = true;
+    }
+    std::swap(previous_, current_);
+  }
+}
+
+double SlideDetector::Analyze() {
+  const LumaImage& image = current_;
+  bool same_size = previous_.width == image.width && previous_.height == image.height;
+  if (!same_size) {
+    // First frame or the window was resized: everything starts out moving
+    // and the next keyframe is picked once the picture settles
+    has_keyframe_ = false;
+    settled_ = false;
+    motion_sad_.clear();
+    quiet_frames_.assign(static_cast<size_t>(image.stride / kTileBlocks) *
+                             ((image.height + kTileBlocks - 1) / kTileBlocks),
+                         0);
+    return -1.0;
+  }
+
+  ComputeTileSad(image, previous_, motion_sad_);
+  if (has_keyframe_) {
+    ComputeTileSad(image, keyframe_, keyframe_sad_);
+  }
+
+  int tiles_x = image.stride / kTileBlocks;
+  int tiles_y = (image.height + kTileBlocks - 1) / kTileBlocks;
+  int total = 0;
+  int changed = 0;
+  settled_ = true;
+  for (int ty = 0; ty < tiles_y; ty++) {
+    int rows = std::min(kTileBlocks, image.height - ty * kTileBlocks);
+    for (int tx = 0; tx < tiles_x; tx++) {
+      int columns = std::min(kTileBlocks, image.width - tx * kTileBlocks);
+      if (columns <= 0) {
+        continue;  // Padding
+      }
+      size_t index = static_cast<size_t>(ty) * tiles_x + tx;
+      uint32_t limit = static_cast<uint32_t>(options_.tile_threshold * rows * columns);
+      total++;
+
+      uint8_t& quiet = quiet_frames_[index];
+      if (motion_sad_[index] >= limit) {
+        quiet = 0;
+      } else if (quiet < kSettleFrames) {
+        quiet++;
+      }
+      if (quiet < kSettleFrames) {
+        settled_ = false;
+      }
+      if (quiet >= kSettleFrames && (!has_keyframe_ || keyframe_sad_[index] >= limit)) {
+        changed++;
+      }
+    }
+  }
+
+  return total > 0 ? static_cast<double>(changed) / total : 0.0;
+}
+
+void SlideDetector::SaveKeyframe(const std::vector<uint8_t>& jpeg, double timestamp,
+                                 double score) {
+  uint64_t index = ++keyframe_count_;
+  char name[32];
+  snprintf(name, sizeof(name), "slide_%04llu.jpg", static_cast<unsigned long long>(index));
+
+  std::ofstream file(directory_ + "/" + name, std::ios::out | std::ios::binary);
+  file.write(reinterpret_cast<const char*>(jpeg.data()), jpeg.size());
+  if (!file) {
+    std::cerr << "[SlideDetector] Failed to write " << name << std::endl;
+    return;
+  }
+
+  // One JSON object per line; each line is complete once flushed
+  int64_t offset_ms = static_cast<int64_t>((timestamp - first_timestamp_) * 1000.0);
+  sidecar_ << "{\"index\":" << index << ",\"file\":\"" << name << "\",\"timestamp\":"
+           << std::fixed << std::setprecision(3) << timestamp << ",\"offsetMs\":" << offset_ms
+           << ",\"score\":" << std::setprecision(2) << score << "}\n";
+  sidecar_.flush();
+}
@@ -0,0 +1,288 @@
+#include "thumbnail_service.h"
+#include "jpeg_dc_decoder.h"
+#include "jpeg_encoder.h"
+#include "matroska_reader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+const size_t kMaxTiles = 100;
+const int kSpriteColumns = 10;
+const int kTileWidth = 160;
+const int64_t kMinTileIntervalMs = 1000;
+const int64_t kUnknownDurationIntervalMs = 5000;  // Until tiles are thinned out
+
+// The poster is the first frame at least this far in, past join screens
+const int64_t kPosterOffsetMs = 5000;
+
+const int kPosterQuality = 85;
+const int kSpriteQuality = 75;
+
+struct Tile {
+  int64_t timestamp_ms;
+  RgbImage image;
+};
+
+// Identifies the recording a set of previews was made from
+struct SourceStamp {
+  uint64_t size = 0;
+  int64_t modified = 0;
+};
+
+bool StatRecording(const std::string& path, SourceStamp& stamp) {
+  std::error_code error;
+  stamp.size = std::filesystem::file_size(path, error);
+  if (error) {
+    return false;
+  }
+  stamp.modified = static_cast<int64_t>(
+      std::filesystem::last_write_time(path, error).time_since_epoch().count());
+  return !error;
+}
+
+std::string StampNote(const SourceStamp& stamp) {
+  return "NOTE source " + std::to_string(stamp.size) + " " + std::to_string(stamp.modified);
+}
+
+// True if |index_path| is a complete VTT made from the recording as it is
+// now; |tile_count| gets its number of cues
+bool LoadCached(const std::string& index_path, const SourceStamp& stamp, int& tile_count) {
+  std::ifstream file(index_path);
+  std::string line;
+  if (!std::getline(file, line) || line != "WEBVTT") {
+    return false;
+  }
+  std::string note = StampNote(stamp);
+  bool current = false;
+  tile_count = 0;
+  while (std::getline(file, line)) {
+    if (line == note) {
+      current = true;
+    } else if (line.find(" --> ") != std::string::npos) {
+      tile_count++;
+    }
+  }
+  return current && tile_count > 0;
+}
+
+// Bilinear resampling; the DC images are at most a few times the tile size
+void ResizeRgb(const RgbImage& source, int width, int height, RgbImage& out) {
+  out.width = width;
+  out.height = height;
+  out.pixels.resize(static_cast<size_t>(width) * height * 3);
+  uint8_t* pixel = out.pixels.data();
+  for (int y = 0; y < height; y++) {
+    float sy = std::max(0.0f, (y + 0.5f) * source.height / height - 0.5f);
+    int y0 = std::min(static_cast<int>(sy), source.height - 1);
+    int y1 = std::min(y0 + 1, source.height - 1);
+    float fy = sy - y0;
+    const uint8_t* row0 = source.pixels.data() + static_cast<size_t>(y0) * source.width * 3;
+    const uint8_t* row1 = source.pixels.data() + static_cast<size_t>(y1) * source.width * 3;
+    for (int x = 0; x < width; x++) {
+      float sx = std::max(0.0f, (x + 0.5f) * source.width / width - 0.5f);
+      int x0 = std::min(static_cast<int>(sx), source.width - 1);
+      int x1 = std::min(x0 + 1, source.width - 1);
+      float fx = sx - x0;
+      for (int c = 0; c < 3; c++) {
+        float top = row0[x0 * 3 + c] + (row0[x1 * 3 + c] - row0[x0 * 3 + c]) * fx;
+        float bottom = row1[x0 * 3 + c] + (row1[x1 * 3 + c] - row1[x0 * 3 + c]) * fx;
+        *pixel++ = static_cast<uint8_t>(top + (bottom - top) * fy + 0.5f);
+      }
+    }
+  }
+}
+
+std::string FormatVttTime(int64_t ms) {
+  char text[32];
+  snprintf(text, sizeof(text), "%02lld:%02lld:%02lld.%03lld",
+           static_cast<long long>(ms / 3600000), static_cast<long long>(ms / 60000 % 60),
+           static_cast<long long>(ms / 1000 % 60), static_cast<long long>(ms % 1000));
+  return text;
+}
+
+bool WriteFile(const std::string& path, const void* data, size_t size) {
+  std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+  return static_cast<bool>(file.flush());
+}
+
+ThumbnailService::Previews MakePreviews(const std::string& recording_path,
+                                        const std::atomic<bool>& abort) {
+  ThumbnailService::Previews previews;
+  SourceStamp stamp;
+  if (!StatRecording(recording_path, stamp)) {
+    return previews;
+  }
+
+  size_t slash = recording_path.find_last_of("/\\");
+  size_t dot = recording_path.find_last_of('.');
+  std::string stem = dot != std::string::npos && (slash == std::string::npos || dot > slash)
+                         ? recording_path.substr(0, dot)
+                         : recording_path;
+  std::string poster_path = stem + ".poster.jpg";
+  std::string sprite_path = stem + ".sprite.jpg";
+  std::string index_path = stem + ".sprite.vtt";
+
+  int cached_tiles = 0;
+  if (LoadCached(index_path, stamp, cached_tiles)) {
+    previews.poster_path = poster_path;
+    previews.sprite_path = sprite_path;
+    previews.index_path = index_path;
+    previews.tile_count = cached_tiles;
+    return previews;
+  }
+
+  // Sample at the tile spacing; if the duration is unknown or wrong, every
+  // other tile is dropped and the spacing doubled whenever there are too many
+  MatroskaReader reader;
+  std::vector<Tile> tiles;
+  RgbImage frame;
+  RgbImage poster;
+  int64_t poster_timestamp = 0;
+  int64_t interval_ms = 0;
+  int tile_width = 0;
+  int tile_height = 0;
+  reader.Read(recording_path, [&](const uint8_t* jpeg, size_t size, int64_t timestamp_ms) {
+    if (abort) {
+      return std::numeric_limits<int64_t>::max();
+    }
+    if (interval_ms == 0) {
+      int64_t duration_ms = reader.GetDurationMs();
+      interval_ms = duration_ms > 0
+                        ? std::max<int64_t>(kMinTileIntervalMs,
+                                            duration_ms / static_cast<int64_t>(kMaxTiles))
+                        : kUnknownDurationIntervalMs;
+    }
+
+    if (DecodeJpegDcColor(jpeg, size, frame)) {
+      if (tile_width == 0) {
+        tile_width = std::min(kTileWidth, frame.width);
+        tile_height = std::max(1, (tile_width * frame.height + frame.width / 2) / frame.width);
+      }
+      tiles.push_back(Tile{timestamp_ms, RgbImage()});
+      ResizeRgb(frame, tile_width, tile_height, tiles.back().image);
+      if (poster.width == 0 || poster_timestamp < kPosterOffsetMs) {
+        poster = frame;
+        poster_timestamp = timestamp_ms;
+      }
+    }
+
+    if (tiles.size() > kMaxTiles) {
+      size_t kept = 0;
+      for (size_t i = 0; i < tiles.size(); i += 2) {
+        tiles[kept++] = std::move(tiles[i]);
+      }
+      tiles.resize(kept);
+      interval_ms *= 2;
+    }
+    return timestamp_ms + interval_ms;
+  });
+  if (abort || tiles.empty()) {
+    return previews;  // Not MJPEG, or unreadable
+  }
+
+  int columns = static_cast<int>(std::min<size_t>(kSpriteColumns, tiles.size()));
+  int rows = static_cast<int>((tiles.size() + columns - 1) / columns);
+  RgbImage sprite;
+  sprite.width = columns * tile_width;
+  sprite.height = rows * tile_height;
+  sprite.pixels.assign(static_cast<size_t>(sprite.width) * sprite.height * 3, 0);
+  for (size_t i = 0; i < tiles.size(); i++) {
+    int x = static_cast<int>(i % columns) * tile_width;
+    int y = static_cast<int>(i / columns) * tile_height;
+    for (int row = 0; row < tile_height; row++) {
+      std::copy_n(tiles[i].image.pixels.data() + static_cast<size_t>(row) * tile_width * 3,
+                  tile_width * 3,
+                  sprite.pixels.data() + (static_cast<size_t>(y + row) * sprite.width + x) * 3);
+    }
+  }
+
+  std::vector<uint8_t> encoded;
+  if (!EncodeJpeg(poster, kPosterQuality, encoded) ||
+      !WriteFile(poster_path, encoded.data(), encoded.size()) ||
+      !EncodeJpeg(sprite, kSpriteQuality, encoded) ||
+      !WriteFile(sprite_path, encoded.data(), encoded.size())) {
+    std::cerr << "[Thumbnails] Failed to write previews of " << recording_path << std::endl;
+    return previews;
+  }
+
+  std::string sprite_name = sprite_path.substr(slash == std::string::npos ? 0 : slash + 1);
+  std::string vtt = "WEBVTT\n\n" + StampNote(stamp) + "\n\n";
+  int64_t duration_ms = reader.GetDurationMs();
+  for (size_t i = 0; i < tiles.size(); i++) {
+    int64_t start = tiles[i].timestamp_ms;
+    int64_t end = i + 1 < tiles.size() ? tiles[i + 1].timestamp_ms
+                                       : std::max(start + interval_ms, duration_ms);
+    vtt += FormatVttTime(start) + " --> " + FormatVttTime(end) + "\n" + sprite_name +
+           "#xywh=" + std::to_string((i % columns) * tile_width) + "," +
+           std::to_string((i / columns) * tile_height) + "," + std::to_string(tile_width) +
+           "," + std::to_string(tile_height) + "\n\n";
+  }
+
+  // The VTT marks the set complete, so it goes last and in one piece
+  std::string temp_path = index_path + ".tmp";
+  std::error_code error;
+  if (!WriteFile(temp_path, vtt.data(), vtt.size()) ||
+      (std::filesystem::rename(temp_path, index_path, error), error)) {
+    std::remove(temp_path.c_str());
+    std::cerr << "[Thumbnails] Failed to write " << index_path << std::endl;
+    return previews;
+  }
+
+  std::cout << "[Thumbnails] " << tiles.size() << " tiles for " << recording_path << std::endl;
+  previews.poster_path = poster_path;
+  previews.sprite_path = sprite_path;
+  previews.index_path = index_path;
+  previews.tile_count = static_cast<int>(tiles.size());
+  return previews;
+}
+
+}  // namespace
+
+ThumbnailService::ThumbnailService(size_t threads)
+    : shutting_down_(false),
+      pool_(threads, "Thumbnails", WorkerPool::Priority::kBackground) {}
+
+ThumbnailService::~ThumbnailService() {
+  // The pool's destructor still runs what is queued; make that a no-op
+  shutting_down_ = true;
+}
+
+void ThumbnailService::Generate(const std::string& recording_path, Callback callback) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    std::vector<Callback>& callbacks = pending_[recording_path];
+    callbacks.push_back(std::move(callback));
+    if (callbacks.size() > 1) {
+      return;  // Already queued
+    }
+  }
+  pool_.Post([this, recording_path] { Run(recording_path); });
+}
+
+void ThumbnailService::Run(const std::string& recording_path) {
+  Previews previews;
+  if (!shutting_down_) {
+    previews = MakePreviews(recording_path, shutting_down_);
+  }
+
+  std::vector<Callback> callbacks;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    callbacks.swap(pending_[recording_path]);
+    pending_.erase(recording_path);
+  }
+  if (shutting_down_) {
+    return;
+  }
+  for (const Callback& callback : callbacks) {
+    callback(recording_path, previews);
+  }
+}
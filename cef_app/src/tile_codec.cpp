@@ -0,0 +1,352 @@
+#include "tile_codec.h"
+#include "jpeg_encoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TILE_CODEC_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define TILE_CODEC_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+const int kTileSize = 64;
+const int64_t kKeyframeIntervalMs = 10000;
+const int kMaxAtlasColumns = 32;
+const size_t kDeltaHeaderSize = 6;
+const uint8_t kDeltaMagic[4] = {'R', 'B', 'T', '1'};
+
+// Largest coefficient the Annex K tables of EncodeJpegCoefficients can code,
+// DC differences included
+const int kMaxCoefficient = 1023;
+
+// Blocks per tile, per plane
+struct TileGrid {
+  int tiles_x = 0;
+  int tiles_y = 0;
+  int blocks_x[3] = {0, 0, 0};
+  int blocks_y[3] = {0, 0, 0};
+};
+
+// Fails if a tile would not be a whole number of MCUs
+bool GetTileGrid(const JpegCoefficients& image, TileGrid& grid) {
+  int h_max = 1;
+  int v_max = 1;
+  for (int c = 0; c < image.component_count; c++) {
+    h_max = std::max(h_max, image.planes[c].h);
+    v_max = std::max(v_max, image.planes[c].v);
+  }
+  if (kTileSize % (8 * h_max) != 0 || kTileSize % (8 * v_max) != 0) {
+    return false;
+  }
+  grid.tiles_x = (image.width + kTileSize - 1) / kTileSize;
+  grid.tiles_y = (image.height + kTileSize - 1) / kTileSize;
+  for (int c = 0; c < image.component_count; c++) {
+    grid.blocks_x[c] = kTileSize / 8 * image.planes[c].h / h_max;
+    grid.blocks_y[c] = kTileSize / 8 * image.planes[c].v / v_max;
+  }
+  return true;
+}
+
+// Same size, sampling and quantization, i.e. coefficients are comparable
+bool SameGeometry(const JpegCoefficients& a, const JpegCoefficients& b) {
+  if (a.width != b.width || a.height != b.height || a.component_count != b.component_count) {
+    return false;
+  }
+  for (int c = 0; c < a.component_count; c++) {
+    const JpegCoefficients::Plane& plane_a = a.planes[c];
+    const JpegCoefficients::Plane& plane_b = b.planes[c];
+    if (plane_a.h != plane_b.h || plane_a.v != plane_b.v ||
+        memcmp(a.quant[plane_a.quant_table], b.quant[plane_b.quant_table],
+               sizeof(a.quant[0])) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// |count| coefficients, a multiple of 8
+bool CoefficientsEqual(const int16_t* a, const int16_t* b, size_t count) {
+#if defined(TILE_CODEC_SSE2)
+  __m128i difference = _mm_setzero_si128();
+  for (size_t i = 0; i < count; i += 8) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    difference = _mm_or_si128(difference, _mm_xor_si128(va, vb));
+  }
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(difference, _mm_setzero_si128())) == 0xFFFF;
+#elif defined(TILE_CODEC_NEON)
+  uint16x8_t difference = vdupq_n_u16(0);
+  for (size_t i = 0; i < count; i += 8) {
+    uint16x8_t va = vreinterpretq_u16_s16(vld1q_s16(a + i));
+    uint16x8_t vb = vreinterpretq_u16_s16(vld1q_s16(b + i));
+    difference = vorrq_u16(difference, veorq_u16(va, vb));
+  }
+  return vmaxvq_u16(difference) == 0;
+#else
+  return memcmp(a, b, count * sizeof(int16_t)) == 0;
+#endif
+}
+
+bool CoefficientsInRange(const int16_t* coefficients, size_t count) {
+  int16_t low = 0;
+  int16_t high = 0;
+  for (size_t i = 0; i < count; i++) {
+    low = std::min(low, coefficients[i]);
+    high = std::max(high, coefficients[i]);
+  }
+  return low >= -kMaxCoefficient && high <= kMaxCoefficient;
+}
+
+// Calls |row(plane, x, y, count)| for each run of blocks of tile
+// (tile_x, tile_y) that lies inside |image|
+template <typename Row>
+void ForEachTileRow(const JpegCoefficients& image, const TileGrid& grid, int tile_x, int tile_y,
+                    Row row) {
+  for (int c = 0; c < image.component_count; c++) {
+    const JpegCoefficients::Plane& plane = image.planes[c];
+    int x = tile_x * grid.blocks_x[c];
+    int y = tile_y * grid.blocks_y[c];
+    int count = std::min(grid.blocks_x[c], plane.blocks_x - x);
+    int bottom = std::min(y + grid.blocks_y[c], plane.blocks_y);
+    for (; y < bottom; y++) {
+      row(c, x, y, count);
+    }
+  }
+}
+
+bool TileChanged(const JpegCoefficients& previous, const JpegCoefficients& current,
+                 const TileGrid& grid, int tile_x, int tile_y) {
+  bool changed = false;
+  ForEachTileRow(current, grid, tile_x, tile_y, [&](int c, int x, int y, int count) {
+    changed = changed ||
+              !CoefficientsEqual(previous.planes[c].block(x, y), current.planes[c].block(x, y),
+                                 static_cast<size_t>(count) * 64);
+  });
+  return changed;
+}
+
+// Tile (tile_x, tile_y) of |image| to tile (atlas_x, atlas_y) of |atlas|
+void CopyTileToAtlas(const JpegCoefficients& image, const TileGrid& grid, int tile_x,
+                     int tile_y, JpegCoefficients& atlas, int atlas_x, int atlas_y) {
+  ForEachTileRow(image, grid, tile_x, tile_y, [&](int c, int x, int y, int count) {
+    int row = y - tile_y * grid.blocks_y[c];
+    memcpy(atlas.planes[c].block(atlas_x * grid.blocks_x[c], atlas_y * grid.blocks_y[c] + row),
+           image.planes[c].block(x, y), static_cast<size_t>(count) * 64 * sizeof(int16_t));
+  });
+}
+
+// And back
+void CopyTileFromAtlas(const JpegCoefficients& atlas, int atlas_x, int atlas_y,
+                       JpegCoefficients& image, const TileGrid& grid, int tile_x, int tile_y) {
+  ForEachTileRow(image, grid, tile_x, tile_y, [&](int c, int x, int y, int count) {
+    int row = y - tile_y * grid.blocks_y[c];
+    memcpy(image.planes[c].block(x, y),
+           atlas.planes[c].block(atlas_x * grid.blocks_x[c], atlas_y * grid.blocks_y[c] + row),
+           static_cast<size_t>(count) * 64 * sizeof(int16_t));
+  });
+}
+
+void WriteUint16(uint8_t* data, uint16_t value) {
+  data[0] = static_cast<uint8_t>(value >> 8);
+  data[1] = static_cast<uint8_t>(value);
+}
+
+uint16_t ReadUint16(const uint8_t* data) {
+  return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+}  // namespace
+
+const char kTileCodecId[] = "V_REBRAZE/TILES";
+
+bool TileEncoder::Encode(const uint8_t* jpeg, size_t size, int64_t timestamp_ms,
+                         std::vector<uint8_t>& delta) {
+  // Frames the coefficient decoder or the tile grid cannot handle are all
+  // keyframes, as are the frames after them
+  TileGrid grid;
+  if (!DecodeJpegCoefficients(jpeg, size, current_) || !GetTileGrid(current_, grid) ||
+      grid.tiles_x * grid.tiles_y > 0xFFFF) {
+    has_reference_ = false;
+    keyframes_++;
+    return true;
+  }
+
+  bool keyframe = !has_reference_ || !SameGeometry(previous_, current_) ||
+                  timestamp_ms - keyframe_timestamp_ms_ >= kKeyframeIntervalMs;
+  if (!keyframe) {
+    changed_.clear();
+    for (int y = 0; y < grid.tiles_y; y++) {
+      for (int x = 0; x < grid.tiles_x; x++) {
+        if (TileChanged(previous_, current_, grid, x, y)) {
+          changed_.push_back(static_cast<uint16_t>(y * grid.tiles_x + x));
+        }
+      }
+    }
+    keyframe = changed_.size() * 2 > static_cast<size_t>(grid.tiles_x) * grid.tiles_y ||
+               !EncodeDelta(delta);
+  }
+
+  if (keyframe) {
+    // Deltas on top of this frame must be re-encodable as a whole
+    has_reference_ = true;
+    for (int c = 0; c < current_.component_count && has_reference_; c++) {
+      has_reference_ = CoefficientsInRange(current_.planes[c].blocks.data(),
+                                           current_.planes[c].blocks.size());
+    }
+    keyframe_timestamp_ms_ = timestamp_ms;
+    keyframes_++;
+  } else {
+    deltas_++;
+    changed_tiles_ += changed_.size();
+  }
+  std::swap(previous_, current_);
+  return keyframe;
+}
+
+bool TileEncoder::EncodeDelta(std::vector<uint8_t>& delta) {
+  size_t count = changed_.size();
+  delta.resize(kDeltaHeaderSize + 2 * count);
+  memcpy(delta.data(), kDeltaMagic, sizeof(kDeltaMagic));
+  WriteUint16(delta.data() + 4, static_cast<uint16_t>(count));
+  for (size_t i = 0; i < count; i++) {
+    WriteUint16(delta.data() + kDeltaHeaderSize + 2 * i, changed_[i]);
+  }
+  if (count == 0) {
+    return true;
+  }
+
+  TileGrid grid;
+  GetTileGrid(current_, grid);
+  int columns = static_cast<int>(std::min<size_t>(count, kMaxAtlasColumns));
+  int rows = static_cast<int>((count + columns - 1) / columns);
+  atlas_.width = columns * kTileSize;
+  atlas_.height = rows * kTileSize;
+  atlas_.component_count = current_.component_count;
+  memcpy(atlas_.quant, current_.quant, sizeof(atlas_.quant));
+  for (int c = 0; c < current_.component_count; c++) {
+    JpegCoefficients::Plane& plane = atlas_.planes[c];
+    plane.h = current_.planes[c].h;
+    plane.v = current_.planes[c].v;
+    plane.quant_table = current_.planes[c].quant_table;
+    plane.blocks_x = columns * grid.blocks_x[c];
+    plane.blocks_y = rows * grid.blocks_y[c];
+    plane.blocks.assign(static_cast<size_t>(plane.blocks_x) * plane.blocks_y * 64, 0);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    int tile_x = changed_[i] % grid.tiles_x;
+    int tile_y = changed_[i] / grid.tiles_x;
+    CopyTileToAtlas(current_, grid, tile_x, tile_y, atlas_, static_cast<int>(i) % columns,
+                    static_cast<int>(i) / columns);
+  }
+  for (int c = 0; c < atlas_.component_count; c++) {
+    if (!CoefficientsInRange(atlas_.planes[c].blocks.data(), atlas_.planes[c].blocks.size())) {
+      return false;
+    }
+  }
+
+  thread_local std::vector<uint8_t> encoded;
+  if (!EncodeJpegCoefficients(atlas_, encoded)) {
+    return false;
+  }
+  delta.insert(delta.end(), encoded.begin(), encoded.end());
+  return true;
+}
+
+bool TileDecoder::IsKeyframe(const uint8_t* record, size_t size) {
+  return size >= 2 && record[0] == 0xFF && record[1] == 0xD8;
+}
+
+bool TileDecoder::Apply(const uint8_t* record, size_t size) {
+  if (IsKeyframe(record, size)) {
+    keyframe_.assign(record, record + size);
+    has_keyframe_ = true;
+    decoded_ = false;
+    modified_ = false;
+    return true;
+  }
+
+  // After a bad delta the picture is unknown until the next keyframe
+  if (!has_keyframe_ || !ApplyDelta(record, size)) {
+    has_keyframe_ = false;
+    return false;
+  }
+  return true;
+}
+
+bool TileDecoder::ApplyDelta(const uint8_t* record, size_t size) {
+  if (size < kDeltaHeaderSize || memcmp(record, kDeltaMagic, sizeof(kDeltaMagic)) != 0) {
+    return false;
+  }
+  size_t count = ReadUint16(record + 4);
+  size_t atlas_offset = kDeltaHeaderSize + 2 * count;
+  if (count == 0) {
+    return true;  // Same picture as before
+  }
+  if (size <= atlas_offset) {
+    return false;
+  }
+
+  TileGrid grid;
+  if (!decoded_) {
+    if (!DecodeJpegCoefficients(keyframe_.data(), keyframe_.size(), image_)) {
+      return false;
+    }
+    decoded_ = true;
+  }
+  if (!GetTileGrid(image_, grid) ||
+      !DecodeJpegCoefficients(record + atlas_offset, size - atlas_offset, atlas_)) {
+    return false;
+  }
+
+  // The atlas must be laid out as the encoder does it, with the same tables
+  int columns = static_cast<int>(std::min<size_t>(count, kMaxAtlasColumns));
+  int rows = static_cast<int>((count + columns - 1) / columns);
+  if (atlas_.width != columns * kTileSize || atlas_.height != rows * kTileSize ||
+      atlas_.component_count != image_.component_count) {
+    return false;
+  }
+  for (int c = 0; c < image_.component_count; c++) {
+    const JpegCoefficients::Plane& plane = image_.planes[c];
+    const JpegCoefficients::Plane& tiles = atlas_.planes[c];
+    if (tiles.h != plane.h || tiles.v != plane.v ||
+        memcmp(atlas_.quant[tiles.quant_table], image_.quant[plane.quant_table],
+               sizeof(image_.quant[0])) != 0) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    int index = ReadUint16(record + kDeltaHeaderSize + 2 * i);
+    if (index >= grid.tiles_x * grid.tiles_y) {
+      return false;
+    }
+    CopyTileFromAtlas(atlas_, static_cast<int>(i) % columns, static_cast<int>(i) / columns,
+                      image_, grid, index % grid.tiles_x, index / grid.tiles_x);
+  }
+  modified_ = true;
+  frame_.clear();
+  return true;
+}
+
+bool TileDecoder::GetFrame(const uint8_t*& jpeg, size_t& size) {
+  if (!has_keyframe_) {
+    return false;
+  }
+  if (!modified_) {
+    jpeg = keyframe_.data();
+    size = keyframe_.size();
+    return true;
+  }
+  if (frame_.empty() && !EncodeJpegCoefficients(image_, frame_)) {
+    return false;
+  }
+  jpeg = frame_.data();
+  size = frame_.size();
+  return true;
+}
@@ -1,13 +1,22 @@
 #include "utils.h"
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
 
 #if defined(__linux__)
 #include <unistd.h>
 #include <linux/limits.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #elif defined(_WIN32)
 #include <windows.h>
+#include <direct.h>
 #elif defined(__APPLE__)
 #include <mach-o/dyld.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #endif
 
 std::string GetExecutableDirectory() {
@@ -55,3 +64,76 @@ std::string GetDocumentsDirectory() {
   return "/tmp";
 #endif
 }
+
+std::string GetRecordingsDirectory() {
+  std::string docs_dir = GetDocumentsDirectory();
+
+#ifdef _WIN32
+  std::string app_dir = docs_dir + "\\Rebraze";
+  std::string recordings_dir = app_dir + "\\Recordings";
+  if (_mkdir(app_dir.c_str()) != 0 && errno != EEXIST) {
+    std::cerr << "[Utils] Failed to create app dir: " << app_dir << " Error: " << strerror(errno) << std::endl;
+  }
+  if (_mkdir(recordings_dir.c_str()) != 0 && errno != EEXIST) {
+    std::cerr << "[Utils] Failed to create recordings dir: " << recordings_dir << " Error: " << strerror(errno) << std::endl;
+  }
+#else
+  std::string app_dir = docs_dir + "/Rebraze";
+  std::string recordings_dir = app_dir + "/Recordings";
+  if (mkdir(app_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cerr << "[Utils] Failed to create app dir: " << app_dir << " Error: " << strerror(errno) << std::endl;
+  }
+  if (mkdir(recordings_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cerr << "[Utils] Failed to create recordings dir: " << recordings_dir << " Error: " << strerror(errno) << std::endl;
+  }
+#endif
+
+  return recordings_dir;
+}
+
+bool MakeDirectory(const std::string& path) {
+#ifdef _WIN32
+  int result = _mkdir(path.c_str());
+#else
+  int result = mkdir(path.c_str(), 0755);
+#endif
+  if (result != 0 && errno != EEXIST) {
+    std::cerr << "[Utils] Failed to create dir: " << path << " Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+std::string MakeRecordingPath(const std::string& meeting_id,
+                              const std::string& extension) {
+  // Generate filename with meeting ID and timestamp
+  std::time_t t = std::time(nullptr);
+  char timestamp[50];
+  std::strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", std::localtime(&t));
+
+  return GetRecordingsDirectory() + "/meeting_" + meeting_id + "_" + timestamp +
+         "." + extension;
+}
+
+double GetProcessCpuSeconds() {
+#if defined(_WIN32)
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time,
+                       &kernel_time, &user_time)) {
+    return 0.0;
+  }
+  ULARGE_INTEGER kernel, user;
+  kernel.LowPart = kernel_time.dwLowDateTime;
+  kernel.HighPart = kernel_time.dwHighDateTime;
+  user.LowPart = user_time.dwLowDateTime;
+  user.HighPart = user_time.dwHighDateTime;
+  return (kernel.QuadPart + user.QuadPart) / 1e7;  // 100ns units
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0.0;
+  }
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
@@ -0,0 +1,480 @@
+#include "video_encoder.h"
+#include "jpeg_encoder.h"
+#include "tile_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#if defined(REBRAZE_HAVE_VPX)
+#include <turbojpeg.h>
+#include <vpx/vp8cx.h>
+#include <vpx/vpx_encoder.h>
+#endif
+
+namespace {
+
+// Keyframe at least this often (frames), so seeking never decodes far
+const unsigned kMaxKeyframeDistance = 300;
+
+// Frame duration assumed for the first frame, in ms
+const unsigned long kDefaultFrameDurationMs = 33;
+
+#if defined(REBRAZE_HAVE_VPX)
+// Per-thread TurboJPEG handles; decoding runs on several pool threads
+struct JpegCodecs {
+  tjhandle decompressor = nullptr;
+  tjhandle compressor = nullptr;
+  std::vector<unsigned char> rgb;
+
+  ~JpegCodecs() {
+    if (decompressor) tjDestroy(decompressor);
+    if (compressor) tjDestroy(compressor);
+  }
+};
+
+JpegCodecs& GetJpegCodecs() {
+  thread_local JpegCodecs codecs;
+  if (!codecs.decompressor) {
+    codecs.decompressor = tjInitDecompress();
+  }
+  return codecs;
+}
+
+bool InitJpegCompressor(JpegCodecs& codecs) {
+  if (!codecs.compressor) {
+    codecs.compressor = tjInitCompress();
+  }
+  return codecs.compressor != nullptr;
+}
+#endif  // defined(REBRAZE_HAVE_VPX)
+
+}  // namespace
+
+bool ParseVideoCodec(const std::string& name, VideoCodec& codec) {
+  if (name == "mjpeg") {
+    codec = VIDEO_CODEC_MJPEG;
+  } else if (name == "vp8") {
+    codec = VIDEO_CODEC_VP8;
+  } else if (name == "vp9") {
+    codec = VIDEO_CODEC_VP9;
+  } else if (name == "tiles") {
+    codec = VIDEO_CODEC_TILES;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool ParseVideoEncoderPreset(const std::string& name, VideoEncoderPreset& preset) {
+  if (name == "realtime") {
+    preset = VIDEO_PRESET_REALTIME;
+  } else if (name == "balanced") {
+    preset = VIDEO_PRESET_BALANCED;
+  } else if (name == "quality") {
+    preset = VIDEO_PRESET_QUALITY;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* GetVideoCodecName(VideoCodec codec) {
+  switch (codec) {
+    case VIDEO_CODEC_VP8: return "vp8";
+    case VIDEO_CODEC_VP9: return "vp9";
+    case VIDEO_CODEC_TILES: return "tiles";
+    default: return "mjpeg";
+  }
+}
+
+const char* GetVideoCodecId(VideoCodec codec) {
+  switch (codec) {
+    case VIDEO_CODEC_VP8: return "V_VP8";
+    case VIDEO_CODEC_VP9: return "V_VP9";
+    case VIDEO_CODEC_TILES: return kTileCodecId;
+    default: return "V_MJPEG";
+  }
+}
+
+bool IsVideoCodecEncoded(VideoCodec codec) {
+  return codec == VIDEO_CODEC_VP8 || codec == VIDEO_CODEC_VP9;
+}
+
+int GetVideoEncoderThreads(const VideoEncoderConfig& config) {
+  if (config.threads > 0) {
+    return config.threads;
+  }
+  // Half the cores, at most 4: libvpx gains little beyond that at 1080p
+  // and it leaves room for the meeting itself and other recordings
+  int cores = static_cast<int>(std::thread::hardware_concurrency());
+  return std::max(1, std::min(4, cores / 2));
+}
+
+void I420Image::Allocate(int image_width, int image_height, ByteBuffer buffer) {
+  width = image_width;
+  height = image_height;
+  int luma_stride = (width + 1) & ~1;
+  int luma_rows = (height + 1) & ~1;
+  strides[0] = luma_stride;
+  strides[1] = strides[2] = luma_stride / 2;
+  offsets[0] = 0;
+  offsets[1] = static_cast<size_t>(luma_stride) * luma_rows;
+  offsets[2] = offsets[1] + static_cast<size_t>(strides[1]) * (luma_rows / 2);
+  data = std::move(buffer);
+  data.resize(GetBufferSize(width, height));
+}
+
+void I420Image::Crop(int left, int top, int crop_width, int crop_height) {
+  offsets[0] += static_cast<size_t>(top) * strides[0] + left;
+  for (int i = 1; i < 3; i++) {
+    offsets[i] += static_cast<size_t>(top / 2) * strides[i] + left / 2;
+  }
+  width = crop_width;
+  height = crop_height;
+}
+
+size_t I420Image::GetBufferSize(int width, int height) {
+  size_t luma_stride = static_cast<size_t>((width + 1) & ~1);
+  size_t luma_rows = static_cast<size_t>((height + 1) & ~1);
+  return luma_stride * luma_rows + 2 * (luma_stride / 2) * (luma_rows / 2);
+}
+
+bool GetJpegDimensions(const uint8_t* jpeg, size_t size, int& width, int& height) {
+  // Walk the markers up to the first SOFn
+  size_t pos = 2;  // Skip SOI
+  while (pos + 9 < size) {
+    if (jpeg[pos] != 0xFF) {
+      return false;
+    }
+    uint8_t marker = jpeg[pos + 1];
+    if (marker == 0xFF) {
+      pos++;
+      continue;
+    }
+    size_t length = (jpeg[pos + 2] << 8) | jpeg[pos + 3];
+    bool is_sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 &&
+                  marker != 0xC8 && marker != 0xCC;
+    if (is_sof) {
+      height = (jpeg[pos + 5] << 8) | jpeg[pos + 6];
+      width = (jpeg[pos + 7] << 8) | jpeg[pos + 8];
+      return true;
+    }
+    pos += 2 + length;
+  }
+  return false;
+}
+
+bool DecodeJpegToI420(const uint8_t* jpeg, size_t size, I420Image& image) {
+#if defined(REBRAZE_HAVE_VPX)
+  JpegCodecs& codecs = GetJpegCodecs();
+  if (!codecs.decompressor) {
+    return false;
+  }
+
+  int width, height, subsampling, colorspace;
+  if (tjDecompressHeader3(codecs.decompressor, jpeg, static_cast<unsigned long>(size),
+                          &width, &height, &subsampling, &colorspace) != 0 ||
+      width != image.width || height != image.height) {
+    return false;
+  }
+
+  unsigned char* planes[3] = {image.plane(0), image.plane(1), image.plane(2)};
+  if (subsampling == TJSAMP_420 || subsampling == TJSAMP_GRAY) {
+    // Chromium encodes screencast frames as 4:2:0, which decodes straight
+    // into the encoder's format without a color conversion
+    if (tjDecompressToYUVPlanes(codecs.decompressor, jpeg, static_cast<unsigned long>(size),
+                                planes, width, image.strides, height, TJFLAG_FASTDCT) != 0) {
+      return false;
+    }
+    if (subsampling == TJSAMP_GRAY) {
+      memset(image.plane(1), 128, image.data.size() - image.offsets[1]);
+    }
+    return true;
+  }
+
+  // Other subsamplings go through RGB
+  if (!InitJpegCompressor(codecs)) {
+    return false;
+  }
+  codecs.rgb.resize(static_cast<size_t>(width) * height * 3);
+  return tjDecompress2(codecs.decompressor, jpeg, static_cast<unsigned long>(size),
+                       codecs.rgb.data(), width, 0, height, TJPF_RGB, TJFLAG_FASTDCT) == 0 &&
+         tjEncodeYUVPlanes(codecs.compressor, codecs.rgb.data(), width, 0, height, TJPF_RGB,
+                           planes, image.strides, TJSAMP_420, 0) == 0;
+#else
+  (void)jpeg;
+  (void)size;
+  (void)image;
+  return false;
+#endif
+}
+
+bool ConvertBgraToI420(const uint8_t* bgra, int stride, I420Image& image) {
+#if defined(REBRAZE_HAVE_VPX)
+  JpegCodecs& codecs = GetJpegCodecs();
+  if (!InitJpegCompressor(codecs)) {
+    return false;
+  }
+  unsigned char* planes[3] = {image.plane(0), image.plane(1), image.plane(2)};
+  return tjEncodeYUVPlanes(codecs.compressor, bgra, image.width, stride, image.height,
+                           TJPF_BGRA, planes, image.strides, TJSAMP_420, 0) == 0;
+#else
+  (void)bgra;
+  (void)stride;
+  (void)image;
+  return false;
+#endif
+}
+
+bool EncodeBgraToJpeg(const uint8_t* bgra, int width, int height, int stride,
+                      int quality, ByteBuffer& out) {
+#if defined(REBRAZE_HAVE_VPX)
+  JpegCodecs& codecs = GetJpegCodecs();
+  if (!InitJpegCompressor(codecs)) {
+    return false;
+  }
+  // Compress into |out| directly; it is grown to the worst case up front
+  out.resize(tjBufSize(width, height, TJSAMP_420));
+  unsigned char* data = out.data();
+  unsigned long size = static_cast<unsigned long>(out.size());
+  if (tjCompress2(codecs.compressor, bgra, width, stride, height, TJPF_BGRA, &data, &size,
+                  TJSAMP_420, quality, TJFLAG_FASTDCT | TJFLAG_NOREALLOC) != 0) {
+    return false;
+  }
+  out.resize(size);
+  return true;
+#else
+  thread_local RgbImage rgb;
+  rgb.width = width;
+  rgb.height = height;
+  rgb.pixels.resize(static_cast<size_t>(width) * height * 3);
+  uint8_t* pixel = rgb.pixels.data();
+  for (int y = 0; y < height; y++) {
+    const uint8_t* row = bgra + static_cast<size_t>(y) * stride;
+    for (int x = 0; x < width; x++, row += 4) {
+      *pixel++ = row[2];
+      *pixel++ = row[1];
+      *pixel++ = row[0];
+    }
+  }
+  thread_local std::vector<uint8_t> encoded;
+  if (!EncodeJpeg(rgb, quality, encoded)) {
+    return false;
+  }
+  out.assign(encoded.begin(), encoded.end());
+  return true;
+#endif
+}
+
+struct VideoEncoder::State {
+  VideoEncoderConfig settings;  // As passed to Open(), for re-opening
+#if defined(REBRAZE_HAVE_VPX)
+  vpx_codec_ctx_t codec;
+  vpx_codec_enc_cfg_t config;
+  unsigned long deadline = VPX_DL_REALTIME;
+#endif
+  int64_t last_timestamp_ms = -1;
+  unsigned long last_duration_ms = kDefaultFrameDurationMs;
+};
+
+// static
+bool VideoEncoder::IsAvailable(VideoCodec codec) {
+#if defined(REBRAZE_HAVE_VPX)
+  return codec == VIDEO_CODEC_VP8 || codec == VIDEO_CODEC_VP9;
+#else
+  (void)codec;
+  return false;
+#endif
+}
+
+VideoEncoder::VideoEncoder() {}
+
+VideoEncoder::~VideoEncoder() {
+  Close();
+}
+
+bool VideoEncoder::Open(const VideoEncoderConfig& config, int width, int height) {
+  Close();
+  if (!IsAvailable(config.codec) || width <= 0 || height <= 0) {
+    return false;
+  }
+
+#if defined(REBRAZE_HAVE_VPX)
+  bool vp9 = config.codec == VIDEO_CODEC_VP9;
+  vpx_codec_iface_t* iface = vp9 ? vpx_codec_vp9_cx() : vpx_codec_vp8_cx();
+
+  std::unique_ptr<State> state(new State());
+  state->settings = config;
+  if (vpx_codec_enc_config_default(iface, &state->config, 0) != VPX_CODEC_OK) {
+    return false;
+  }
+
+  int threads = GetVideoEncoderThreads(config);
+  vpx_codec_enc_cfg_t& cfg = state->config;
+  cfg.g_w = width;
+  cfg.g_h = height;
+  cfg.g_timebase.num = 1;  // Timestamps in ms
+  cfg.g_timebase.den = 1000;
+  cfg.g_threads = threads;
+  cfg.g_pass = VPX_RC_ONE_PASS;
+  cfg.g_lag_in_frames = 0;  // One packet per frame, and allows size changes
+  cfg.rc_target_bitrate = config.bitrate_kbps > 0 ? config.bitrate_kbps : 2000;
+  cfg.rc_end_usage = config.preset == VIDEO_PRESET_QUALITY ? VPX_VBR : VPX_CBR;
+  cfg.kf_mode = VPX_KF_AUTO;
+  cfg.kf_max_dist = kMaxKeyframeDistance;
+
+  if (vpx_codec_enc_init(&state->codec, iface, &cfg, 0) != VPX_CODEC_OK) {
+    std::cerr << "[VideoEncoder] Failed to initialize " << GetVideoCodecName(config.codec)
+              << std::endl;
+    return false;
+  }
+
+  // cpu-used: higher is faster. VP8 accepts up to 16, VP9 up to 9.
+  int cpu_used;
+  switch (config.preset) {
+    case VIDEO_PRESET_REALTIME:
+      cpu_used = vp9 ? 8 : 12;
+      state->deadline = VPX_DL_REALTIME;
+      break;
+    case VIDEO_PRESET_QUALITY:
+      cpu_used = vp9 ? 4 : 2;
+      state->deadline = VPX_DL_GOOD_QUALITY;
+      break;
+    default:
+      cpu_used = vp9 ? 6 : 8;
+      state->deadline = VPX_DL_REALTIME;
+      break;
+  }
+  vpx_codec_control(&state->codec, VP8E_SET_CPUUSED, cpu_used);
+  if (vp9) {
+    // Row-based multithreading plus one tile column per thread (log2)
+    int tile_columns = 0;
+    while ((2 << tile_columns) <= threads && tile_columns < 2) {
+      tile_columns++;
+    }
+    vpx_codec_control(&state->codec, VP9E_SET_ROW_MT, 1);
+    vpx_codec_control(&state->codec, VP9E_SET_TILE_COLUMNS, tile_columns);
+    vpx_codec_control(&state->codec, VP9E_SET_TUNE_CONTENT, VP9E_CONTENT_SCREEN);
+  } else {
+    vpx_codec_control(&state->codec, VP8E_SET_SCREEN_CONTENT_MODE, 1);
+  }
+
+  std::cout << "[VideoEncoder] " << GetVideoCodecName(config.codec) << " " << width << "x"
+            << height << " at " << cfg.rc_target_bitrate << " kbps, " << threads
+            << " threads, cpu-used " << cpu_used << std::endl;
+
+  state_ = std::move(state);
+  return true;
+#else
+  return false;
+#endif
+}
+
+#if defined(REBRAZE_HAVE_VPX)
+namespace {
+
+bool DrainPackets(vpx_codec_ctx_t* codec, const VideoEncoder::PacketCallback& callback) {
+  vpx_codec_iter_t iter = nullptr;
+  const vpx_codec_cx_pkt_t* packet;
+  while ((packet = vpx_codec_get_cx_data(codec, &iter)) != nullptr) {
+    if (packet->kind == VPX_CODEC_CX_FRAME_PKT) {
+      callback(static_cast<const uint8_t*>(packet->data.frame.buf), packet->data.frame.sz,
+               static_cast<int64_t>(packet->data.frame.pts),
+               (packet->data.frame.flags & VPX_FRAME_IS_KEY) != 0);
+    }
+  }
+  return true;
+}
+
+}  // namespace
+#endif  // defined(REBRAZE_HAVE_VPX)
+
+bool VideoEncoder::Encode(const I420Image& image, int64_t timestamp_ms,
+                          const PacketCallback& callback) {
+  if (!state_) {
+    return false;
+  }
+
+#if defined(REBRAZE_HAVE_VPX)
+  vpx_enc_frame_flags_t flags = 0;
+  if (static_cast<int>(state_->config.g_w) != image.width ||
+      static_cast<int>(state_->config.g_h) != image.height) {
+    // The adaptive screencast changes resolution under load
+    // VP8 cannot grow past the size it was opened with; the encoder is
+    // opened again at the new size, continuing the timestamps
+    state_->config.g_w = image.width;
+    state_->config.g_h = image.height;
+    if (vpx_codec_enc_config_set(&state_->codec, &state_->config) != VPX_CODEC_OK) {
+      VideoEncoderConfig settings = state_->settings;
+      int64_t last_timestamp_ms = state_->last_timestamp_ms;
+      unsigned long last_duration_ms = state_->last_duration_ms;
+      Flush(callback);
+      if (!Open(settings, image.width, image.height)) {
+        std::cerr << "[VideoEncoder] Cannot switch to " << image.width << "x" << image.height
+                  << std::endl;
+        return false;
+      }
+      state_->last_timestamp_ms = last_timestamp_ms;
+      state_->last_duration_ms = last_duration_ms;
+    }
+    flags |= VPX_EFLAG_FORCE_KF;
+  }
+
+  if (timestamp_ms <= state_->last_timestamp_ms) {
+    timestamp_ms = state_->last_timestamp_ms + 1;
+  }
+  if (state_->last_timestamp_ms >= 0) {
+    state_->last_duration_ms =
+        static_cast<unsigned long>(timestamp_ms - state_->last_timestamp_ms);
+  }
+  state_->last_timestamp_ms = timestamp_ms;
+
+  vpx_image_t picture;
+  vpx_img_wrap(&picture, VPX_IMG_FMT_I420, image.width, image.height, 1,
+               const_cast<uint8_t*>(image.plane(0)));
+  for (int i = 0; i < 3; i++) {
+    picture.planes[i] = const_cast<uint8_t*>(image.plane(i));
+    picture.stride[i] = image.strides[i];
+  }
+
+  if (vpx_codec_encode(&state_->codec, &picture, timestamp_ms, state_->last_duration_ms,
+                       flags, state_->deadline) != VPX_CODEC_OK) {
+    std::cerr << "[VideoEncoder] Encode failed: " << vpx_codec_error(&state_->codec)
+              << std::endl;
+    return false;
+  }
+  return DrainPackets(&state_->codec, callback);
+#else
+  (void)image;
+  (void)timestamp_ms;
+  (void)callback;
+  return false;
+#endif
+}
+
+bool VideoEncoder::Flush(const PacketCallback& callback) {
+  if (!state_) {
+    return false;
+  }
+#if defined(REBRAZE_HAVE_VPX)
+  if (vpx_codec_encode(&state_->codec, nullptr, 0, 0, 0, state_->deadline) != VPX_CODEC_OK) {
+    return false;
+  }
+  return DrainPackets(&state_->codec, callback);
+#else
+  (void)callback;
+  return false;
+#endif
+}
+
+void VideoEncoder::Close() {
+  if (!state_) {
+    return;
+  }
+#if defined(REBRAZE_HAVE_VPX)
+  vpx_codec_destroy(&state_->codec);
+#endif
+  state_.reset();
+}
@@ -0,0 +1,679 @@
+#include "webm_remuxer.h"
+#include "ebml.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace ebml;
+
+namespace {
+
+// Space reserved after the Segment header for the SeekHead
+const size_t kSeekHeadReserve = 96;
+
+// Info, Tracks and BlockGroups are parsed in memory; anything larger than
+// this is not something MediaRecorder produced
+const uint64_t kMaxParsedElementSize = 16 * 1024 * 1024;
+
+const size_t kCopyBufferSize = 256 * 1024;
+
+struct ElementHeader {
+  uint32_t id;
+  uint64_t size;
+  bool unknown_size;
+  uint64_t start;       // Position of the ID
+  uint64_t data_start;  // Position of the payload
+};
+
+bool IsTopLevel(uint32_t id) {
+  return id == kCluster || id == kCues || id == kInfo || id == kTracks ||
+         id == kSeekHead || id == kTags || id == kChapters || id == kAttachments ||
+         id == kEbml || id == kSegment;
+}
+
+uint64_t ReadUInt(const uint8_t* data, size_t size) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size && i < 8; ++i) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+// Iterates over the children of an element already held in memory
+class ChildIterator {
+ public:
+  ChildIterator(const std::string& payload)
+      : data_(reinterpret_cast<const uint8_t*>(payload.data())),
+        size_(payload.size()),
+        position_(0) {}
+
+  // Returns false at the end of the payload or on malformed data
+  bool Next(uint32_t& id, size_t& start, size_t& data_start, size_t& data_size) {
+    if (position_ >= size_) {
+      return false;
+    }
+    uint64_t value;
+    int id_length = ReadVarInt(data_ + position_, size_ - position_, true, value);
+    if (id_length == 0 || id_length > 4) {
+      return false;
+    }
+    id = static_cast<uint32_t>(value);
+    int size_length = ReadVarInt(data_ + position_ + id_length,
+                                 size_ - position_ - id_length, false, value);
+    if (size_length == 0 || IsUnknownSize(value, size_length)) {
+      return false;
+    }
+    start = position_;
+    data_start = position_ + id_length + size_length;
+    if (value > size_ - data_start) {
+      return false;
+    }
+    data_size = static_cast<size_t>(value);
+    position_ = data_start + data_size;
+    return true;
+  }
+
+  const uint8_t* data() const { return data_; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t position_;
+};
+
+// Block header: track number, signed 16-bit relative timestamp and flags
+bool ParseBlockHeader(const uint8_t* data, size_t size, uint64_t& track,
+                      int16_t& relative, uint8_t& flags) {
+  int length = ReadVarInt(data, size, false, track);
+  if (length == 0 || size < static_cast<size_t>(length) + 3) {
+    return false;
+  }
+  relative = static_cast<int16_t>((data[length] << 8) | data[length + 1]);
+  flags = data[length + 2];
+  return true;
+}
+
+bool SyncFileAtPath(const std::string& path) {
+#if defined(_WIN32)
+  int fd = _open(path.c_str(), _O_WRONLY | _O_BINARY);
+  if (fd < 0) return false;
+  bool success = _commit(fd) == 0;
+  _close(fd);
+#else
+  int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  bool success = fsync(fd) == 0;
+  close(fd);
+#endif
+  return success;
+}
+
+class Remuxer {
+ public:
+  Remuxer()
+      : input_size_(0),
+        input_position_(0),
+        output_position_(0),
+        segment_size_position_(0),
+        segment_data_start_(0),
+        seek_head_position_(0),
+        info_position_(0),
+        tracks_position_(0),
+        duration_position_(0),
+        timestamp_scale_(1000000),
+        cue_track_(0),
+        max_timestamp_(0),
+        clusters_(0),
+        copy_buffer_(kCopyBufferSize) {}
+
+  bool Run(const std::string& input_path, const std::string& output_path,
+           WebmRemuxStats& stats);
+
+ private:
+  struct CuePoint {
+    int64_t time;               // In TimestampScale units
+    uint64_t cluster_position;  // Relative to the Segment data start
+  };
+
+  // Input
+  bool ReadHeader(ElementHeader& header);
+  bool Read(void* data, size_t size);
+  bool ReadPayload(const ElementHeader& header, std::string& payload);
+  bool SeekInput(uint64_t position);
+  bool CopyPayload(uint64_t size);
+
+  // Output
+  void Write(const void* data, size_t size);
+  void Write(const std::string& data) { Write(data.data(), data.size()); }
+  void WriteHeader(uint32_t id, uint64_t size);
+  void Patch(uint64_t position, const std::string& bytes);
+
+  bool CopyInfo(const ElementHeader& header);
+  bool CopyTracks(const ElementHeader& header);
+  // Returns false if the input ended inside the cluster
+  bool CopyCluster(const ElementHeader& header, uint64_t segment_end);
+  void OnBlock(uint64_t track, int64_t timestamp, bool keyframe,
+               uint64_t cluster_position, bool& has_cue);
+  void Finish();
+
+  std::ifstream input_;
+  uint64_t input_size_;
+  uint64_t input_position_;
+
+  std::ofstream output_;
+  uint64_t output_position_;
+
+  uint64_t segment_size_position_;
+  uint64_t segment_data_start_;
+  uint64_t seek_head_position_;
+  uint64_t info_position_;
+  uint64_t tracks_position_;
+  uint64_t duration_position_;
+
+  uint64_t timestamp_scale_;
+  uint64_t cue_track_;
+  int64_t max_timestamp_;
+  uint64_t clusters_;
+  std::vector<CuePoint> cues_;
+  std::vector<char> copy_buffer_;
+};
+
+bool Remuxer::Run(const std::string& input_path, const std::string& output_path,
+                  WebmRemuxStats& stats) {
+  input_.open(input_path, std::ios::binary | std::ios::in | std::ios::ate);
+  if (!input_.is_open()) {
+    return false;
+  }
+  input_size_ = static_cast<uint64_t>(input_.tellg());
+  if (!SeekInput(0)) {
+    return false;
+  }
+
+  // EBML header, copied as is
+  ElementHeader header;
+  std::string payload;
+  if (!ReadHeader(header) || header.id != kEbml || !ReadPayload(header, payload)) {
+    return false;
+  }
+
+  output_.open(output_path, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (!output_.is_open()) {
+    std::cerr << "[Remuxer] Failed to create " << output_path << std::endl;
+    return false;
+  }
+  WriteHeader(kEbml, payload.size());
+  Write(payload);
+
+  // Segment, sized once everything has been copied
+  if (!ReadHeader(header) || header.id != kSegment) {
+    return false;
+  }
+  uint64_t segment_end = input_size_;
+  if (!header.unknown_size) {
+    segment_end = std::min(segment_end, header.data_start + header.size);
+  }
+
+  std::string segment_header;
+  AppendId(segment_header, kSegment);
+  segment_size_position_ = output_position_ + segment_header.size();
+  AppendFixedSize(segment_header, kUnknownSize);
+  Write(segment_header);
+  segment_data_start_ = output_position_;
+
+  std::string seek_head_space;
+  AppendVoid(seek_head_space, kSeekHeadReserve);
+  seek_head_position_ = output_position_;
+  Write(seek_head_space);
+
+  bool has_info = false;
+  bool has_tracks = false;
+  while (input_position_ < segment_end) {
+    if (!ReadHeader(header)) {
+      break;  // Cut off inside an element header
+    }
+    if (header.id == kCluster) {
+      if (!CopyCluster(header, segment_end)) {
+        break;
+      }
+      continue;
+    }
+
+    // Only Clusters may have an unknown size
+    if (header.unknown_size) {
+      std::cerr << "[Remuxer] Unsupported unknown-size element " << std::hex << header.id
+                << std::dec << std::endl;
+      return false;
+    }
+    if (header.data_start + header.size > segment_end) {
+      break;
+    }
+
+    switch (header.id) {
+      case kInfo:
+        if (has_info || !CopyInfo(header)) {
+          return false;
+        }
+        has_info = true;
+        break;
+      case kTracks:
+        if (has_tracks || !CopyTracks(header)) {
+          return false;
+        }
+        has_tracks = true;
+        break;
+      case kSeekHead:
+      case kCues:
+      case kVoid:
+        // Rebuilt below
+        if (!SeekInput(header.data_start + header.size)) {
+          return false;
+        }
+        break;
+      default:
+        WriteHeader(header.id, header.size);
+        if (!CopyPayload(header.size)) {
+          return false;
+        }
+        break;
+    }
+  }
+
+  if (!has_info || !has_tracks || clusters_ == 0) {
+    return false;
+  }
+
+  Finish();
+  output_.close();
+  if (output_.fail()) {
+    return false;
+  }
+
+  // Anything past the end is what remains of a dropped partial block
+  std::error_code error;
+  std::filesystem::resize_file(output_path, output_position_, error);
+  if (error) {
+    return false;
+  }
+
+  stats.clusters = clusters_;
+  stats.cue_points = cues_.size();
+  stats.duration_ms = static_cast<int64_t>(
+      static_cast<double>(max_timestamp_) * timestamp_scale_ / 1000000.0);
+  stats.input_bytes = input_size_;
+  stats.output_bytes = output_position_;
+  return true;
+}
+
+bool Remuxer::ReadHeader(ElementHeader& header) {
+  uint8_t bytes[12];
+  size_t available = static_cast<size_t>(
+      std::min<uint64_t>(sizeof(bytes), input_size_ - input_position_));
+  uint64_t start = input_position_;
+  if (available == 0 || !Read(bytes, available)) {
+    return false;
+  }
+
+  uint64_t value;
+  int id_length = ReadVarInt(bytes, available, true, value);
+  if (id_length == 0 || id_length > 4) {
+    return false;
+  }
+  header.id = static_cast<uint32_t>(value);
+  int size_length = ReadVarInt(bytes + id_length, available - id_length, false, value);
+  if (size_length == 0) {
+    return false;
+  }
+  header.unknown_size = IsUnknownSize(value, size_length);
+  header.size = header.unknown_size ? 0 : value;
+  header.start = start;
+  header.data_start = start + id_length + size_length;
+  return SeekInput(header.data_start);
+}
+
+bool Remuxer::Read(void* data, size_t size) {
+  input_.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+  if (static_cast<size_t>(input_.gcount()) != size) {
+    return false;
+  }
+  input_position_ += size;
+  return true;
+}
+
+bool Remuxer::ReadPayload(const ElementHeader& header, std::string& payload) {
+  if (header.unknown_size || header.size > kMaxParsedElementSize ||
+      header.size > input_size_ - input_position_) {
+    return false;
+  }
+  payload.resize(static_cast<size_t>(header.size));
+  return payload.empty() || Read(&payload[0], payload.size());
+}
+
+bool Remuxer::SeekInput(uint64_t position) {
+  input_.clear();
+  input_.seekg(static_cast<std::streamoff>(position));
+  input_position_ = position;
+  return input_.good();
+}
+
+bool Remuxer::CopyPayload(uint64_t size) {
+  while (size > 0) {
+    size_t count = static_cast<size_t>(std::min<uint64_t>(size, copy_buffer_.size()));
+    if (!Read(copy_buffer_.data(), count)) {
+      return false;
+    }
+    Write(copy_buffer_.data(), count);
+    size -= count;
+  }
+  return true;
+}
+
+void Remuxer::Write(const void* data, size_t size) {
+  output_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+  output_position_ += size;
+}
+
+void Remuxer::WriteHeader(uint32_t id, uint64_t size) {
+  std::string header;
+  AppendId(header, id);
+  AppendSize(header, size);
+  Write(header);
+}
+
+void Remuxer::Patch(uint64_t position, const std::string& bytes) {
+  output_.seekp(static_cast<std::streamoff>(position));
+  output_.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  output_.seekp(static_cast<std::streamoff>(output_position_));
+}
+
+bool Remuxer::CopyInfo(const ElementHeader& header) {
+  std::string payload;
+  if (!ReadPayload(header, payload)) {
+    return false;
+  }
+
+  // Keep everything but a Duration, which is appended with the real value
+  std::string info;
+  ChildIterator children(payload);
+  uint32_t id;
+  size_t start, data_start, data_size;
+  while (children.Next(id, start, data_start, data_size)) {
+    if (id == kDuration) {
+      continue;
+    }
+    if (id == kTimestampScale) {
+      timestamp_scale_ = ReadUInt(children.data() + data_start, data_size);
+      if (timestamp_scale_ == 0) {
+        timestamp_scale_ = 1000000;
+      }
+    }
+    info.append(payload, start, data_start + data_size - start);
+  }
+  size_t duration_offset = info.size() + 3;  // After the 2-byte ID and size
+  AppendFloat(info, kDuration, 0.0);
+
+  info_position_ = output_position_;
+  std::string info_header;
+  AppendId(info_header, kInfo);
+  AppendSize(info_header, info.size());
+  duration_position_ = output_position_ + info_header.size() + duration_offset;
+  Write(info_header);
+  Write(info);
+  return true;
+}
+
+bool Remuxer::CopyTracks(const ElementHeader& header) {
+  std::string payload;
+  if (!ReadPayload(header, payload)) {
+    return false;
+  }
+
+  // Cue on the video track; an audio-only recording cues its first track
+  uint32_t id;
+  size_t start, data_start, data_size;
+  ChildIterator tracks(payload);
+  while (tracks.Next(id, start, data_start, data_size)) {
+    if (id != kTrackEntry) {
+      continue;
+    }
+    std::string entry = payload.substr(data_start, data_size);
+    uint64_t number = 0;
+    uint64_t type = 0;
+    ChildIterator fields(entry);
+    size_t field_start, field_data_start, field_size;
+    while (fields.Next(id, field_start, field_data_start, field_size)) {
+      if (id == kTrackNumber) {
+        number = ReadUInt(fields.data() + field_data_start, field_size);
+      } else if (id == kTrackType) {
+        type = ReadUInt(fields.data() + field_data_start, field_size);
+      }
+    }
+    if (type == 1) {
+      cue_track_ = number;
+      break;
+    }
+    if (cue_track_ == 0) {
+      cue_track_ = number;
+    }
+  }
+
+  tracks_position_ = output_position_;
+  WriteHeader(kTracks, payload.size());
+  Write(payload);
+  return true;
+}
+
+bool Remuxer::CopyCluster(const ElementHeader& header, uint64_t segment_end) {
+  uint64_t cluster_end = segment_end;
+  if (!header.unknown_size) {
+    cluster_end = std::min(cluster_end, header.data_start + header.size);
+  }
+
+  uint64_t cluster_position = output_position_;
+  std::string cluster_header;
+  AppendId(cluster_header, kCluster);
+  uint64_t size_position = output_position_ + cluster_header.size();
+  AppendFixedSize(cluster_header, kUnknownSize);
+  Write(cluster_header);
+  uint64_t data_start = output_position_;
+  clusters_++;
+
+  bool complete = true;
+  bool has_cue = false;
+  int64_t cluster_timestamp = 0;
+  uint64_t child_position = output_position_;
+  while (input_position_ < cluster_end) {
+    child_position = output_position_;
+    ElementHeader child;
+    if (!ReadHeader(child)) {
+      complete = false;
+      break;
+    }
+    if (header.unknown_size && IsTopLevel(child.id)) {
+      // An unknown-size cluster ends where the next top-level element starts
+      SeekInput(child.start);
+      break;
+    }
+    if (child.unknown_size || child.data_start + child.size > cluster_end) {
+      complete = false;
+      break;
+    }
+
+    WriteHeader(child.id, child.size);
+    if (child.id == kClusterTimestamp) {
+      std::string payload;
+      if (!ReadPayload(child, payload)) {
+        complete = false;
+        break;
+      }
+      cluster_timestamp = static_cast<int64_t>(
+          ReadUInt(reinterpret_cast<const uint8_t*>(payload.data()), payload.size()));
+      Write(payload);
+    } else if (child.id == kSimpleBlock) {
+      // Only the block header is inspected; the frame is streamed through
+      uint8_t prefix[12];
+      size_t prefix_size = static_cast<size_t>(std::min<uint64_t>(sizeof(prefix), child.size));
+      if (!Read(prefix, prefix_size)) {
+        complete = false;
+        break;
+      }
+      Write(prefix, prefix_size);
+      uint64_t track;
+      int16_t relative;
+      uint8_t flags;
+      if (ParseBlockHeader(prefix, prefix_size, track, relative, flags)) {
+        OnBlock(track, cluster_timestamp + relative, (flags & 0x80) != 0,
+                cluster_position, has_cue);
+      }
+      if (!CopyPayload(child.size - prefix_size)) {
+        complete = false;
+        break;
+      }
+    } else if (child.id == kBlockGroup) {
+      std::string payload;
+      if (!ReadPayload(child, payload)) {
+        complete = false;
+        break;
+      }
+      // A Block without a ReferenceBlock is a keyframe
+      bool have_block = false;
+      bool keyframe = true;
+      uint64_t track = 0;
+      int16_t relative = 0;
+      uint8_t flags = 0;
+      ChildIterator children(payload);
+      uint32_t id;
+      size_t start, block_start, block_size;
+      while (children.Next(id, start, block_start, block_size)) {
+        if (id == kBlock) {
+          have_block = ParseBlockHeader(children.data() + block_start, block_size, track,
+                                        relative, flags);
+        } else if (id == kReferenceBlock) {
+          keyframe = false;
+        }
+      }
+      if (have_block) {
+        OnBlock(track, cluster_timestamp + relative, keyframe, cluster_position, has_cue);
+      }
+      Write(payload);
+    } else if (!CopyPayload(child.size)) {
+      complete = false;
+      break;
+    }
+  }
+
+  if (!complete) {
+    // Drop the partial element; the cluster ends after the last whole block
+    output_position_ = child_position;
+    output_.seekp(static_cast<std::streamoff>(output_position_));
+  }
+  std::string size_bytes;
+  AppendFixedSize(size_bytes, output_position_ - data_start);
+  Patch(size_position, size_bytes);
+  return complete;
+}
+
+void Remuxer::OnBlock(uint64_t track, int64_t timestamp, bool keyframe,
+                      uint64_t cluster_position, bool& has_cue) {
+  max_timestamp_ = std::max(max_timestamp_, timestamp);
+  if (track == cue_track_ && keyframe && !has_cue) {
+    cues_.push_back({timestamp, cluster_position - segment_data_start_});
+    has_cue = true;
+  }
+}
+
+void Remuxer::Finish() {
+  uint64_t cues_position = output_position_;
+  if (!cues_.empty()) {
+    std::string cues;
+    for (const CuePoint& cue : cues_) {
+      std::string positions;
+      AppendUInt(positions, kCueTrack, cue_track_);
+      AppendUInt(positions, kCueClusterPosition, cue.cluster_position);
+
+      std::string point;
+      AppendUInt(point, kCueTime, static_cast<uint64_t>(std::max<int64_t>(cue.time, 0)));
+      AppendMaster(point, kCueTrackPositions, positions);
+
+      AppendMaster(cues, kCuePoint, point);
+    }
+    std::string element;
+    AppendMaster(element, kCues, cues);
+    Write(element);
+  }
+
+  char duration_bytes[8];
+  EncodeFloat(static_cast<double>(max_timestamp_), duration_bytes);
+  Patch(duration_position_, std::string(duration_bytes, sizeof(duration_bytes)));
+
+  auto seek_entry = [](uint32_t id, uint64_t position) {
+    std::string id_bytes;
+    AppendId(id_bytes, id);
+    std::string seek;
+    AppendString(seek, kSeekId, id_bytes);
+    AppendUInt(seek, kSeekPosition, position);
+    std::string entry;
+    AppendMaster(entry, kSeek, seek);
+    return entry;
+  };
+
+  std::string seeks;
+  seeks += seek_entry(kInfo, info_position_ - segment_data_start_);
+  seeks += seek_entry(kTracks, tracks_position_ - segment_data_start_);
+  if (!cues_.empty()) {
+    seeks += seek_entry(kCues, cues_position - segment_data_start_);
+  }
+  std::string seek_head;
+  AppendMaster(seek_head, kSeekHead, seeks);
+  if (seek_head.size() + 2 <= kSeekHeadReserve) {
+    AppendVoid(seek_head, kSeekHeadReserve - seek_head.size());
+    Patch(seek_head_position_, seek_head);
+  }
+
+  std::string segment_size;
+  AppendFixedSize(segment_size, output_position_ - segment_data_start_);
+  Patch(segment_size_position_, segment_size);
+}
+
+}  // namespace
+
+bool RemuxWebmForSeeking(const std::string& path, WebmRemuxStats* stats) {
+  std::string temp_path = path + ".remux";
+  WebmRemuxStats result = {};
+  bool success;
+  {
+    Remuxer remuxer;
+    success = remuxer.Run(path, temp_path, result);
+  }
+
+  std::error_code error;
+  if (success && SyncFileAtPath(temp_path)) {
+    std::filesystem::rename(temp_path, path, error);
+    success = !error;
+  } else {
+    success = false;
+  }
+  if (!success) {
+    std::remove(temp_path.c_str());
+    std::cerr << "[Remuxer] Could not make " << path << " seekable" << std::endl;
+    return false;
+  }
+
+  std::cout << "[Remuxer] " << path << ": " << result.clusters << " clusters, "
+            << result.cue_points << " cue points, " << result.duration_ms << "ms" << std::endl;
+  if (stats) {
+    *stats = result;
+  }
+  return true;
+}
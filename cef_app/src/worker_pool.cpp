@@ -0,0 +1,79 @@
+#include "worker_pool.h"
+
+#include <iostream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void LowerCurrentThreadPriority() {
+#if defined(_WIN32)
+  // Also lowers the thread's I/O and memory priority
+  SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__APPLE__)
+  pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0);
+#elif defined(__linux__)
+  // Linux applies nice values per thread
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+}
+
+}  // namespace
+
+WorkerPool::WorkerPool(size_t threads, const std::string& name, Priority priority)
+    : name_(name), priority_(priority), shutdown_(false) {
+  if (threads == 0) {
+    threads = 1;
+  }
+  for (size_t i = 0; i < threads; i++) {
+    threads_.emplace_back(&WorkerPool::WorkerThread, this);
+  }
+  std::cout << "[WorkerPool] " << name_ << ": " << threads << " threads" << std::endl;
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    shutdown_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::Post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    tasks_.push_back(std::move(task));
+  }
+  cv_.notify_one();
+}
+
+void WorkerPool::WorkerThread() {
+  if (priority_ == Priority::kBackground) {
+    LowerCurrentThreadPriority();
+  }
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      cv_.wait(guard, [this] { return shutdown_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        break;  // Shutting down and nothing left to run
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
@@ -1,18 +1,18 @@
 import React, { useState, useEffect } from 'react';
 import { Sparkles, Chrome } from 'lucide-react';
 import { authService } from '../services/authService';
-import { isCEF, openSystemBrowser, setAuthTokenCallback } from '../utils/cefBridge';
+import { isCEF, openSystemBrowser, subscribe } from '../utils/cefBridge';
 
 const Login: React.FC = () => {
   const [isLoading, setIsLoading] = useState(false);
   const [error, setError] = useState<string | null>(null);
 
   useEffect(() => {
-    // Set up callback for CEF to send us the auth token
+    // Subscribe to the auth token pushed by CEF
     if (isCEF()) {
       console.log('✓ Running in CEF mode - system browser OAuth enabled');
       console.log('✓ rebrazeAuth object available:', window.rebrazeAuth);
-      setAuthTokenCallback((token: string) => {
+      return subscribe('authToken', ({ token }) => {
         console.log('✓ Auth token received from CEF:', token.substring(0, 20) + '...');
         authService.setToken(token);
         // The AuthContext will detect the token and update isAuthenticated
@@ -20,17 +20,9 @@ const Login: React.FC = () => {
         setIsLoading(false);
         window.location.reload(); // Force a reload to trigger auth check
       });
-    } else {
-      console.log('✗ Running in web browser mode - normal OAuth redirect');
-      console.log('✗ rebrazeAuth object:', window.rebrazeAuth);
     }
-
-    // Cleanup
-    return () => {
-      if (typeof window !== 'undefined') {
-        window.onAuthTokenReceived = undefined;
-      }
-    };
+    console.log('✗ Running in web browser mode - normal OAuth redirect');
+    console.log('✗ rebrazeAuth object:', window.rebrazeAuth);
   }, []);
 
   const handleGoogleLogin = async () => {
@@ -2,7 +2,7 @@ import React, { useState, useEffect, useRef } from 'react';
 import { LogOut, Video, Clock, Sparkles, Send, Mic, MicOff, VideoOff, Pause, Play, Circle, Square, X } from 'lucide-react';
 import { Meeting as MeetingType, ChatMessage } from '../types';
 import { meetingService } from '../services/meetingService';
-import { joinMeeting, leaveMeeting, updateMeetingBounds, isCEF, getMeetingPageInfo, setMeetingPageInfoCallback, MeetingPageInfo, getMeetingParticipants, setMeetingParticipantsCallback, startRecording, stopRecording, saveRecording, setScreencastFrameCallback, setRecordingSavedCallback } from '../utils/cefBridge';
+import { joinMeeting, leaveMeeting, updateMeetingBounds, isCEF, getMeetingPageInfo, MeetingPageInfo, getMeetingParticipants, startRecording, stopRecording, openRecordingSession, screencastFrameConsumed, setScreencastFrameCallback, subscribe } from '../utils/cefBridge';
 import { generateChatResponse } from '../services/geminiService';
 
 interface MeetingProps {
@@ -48,7 +48,6 @@ const Meeting: React.FC<MeetingProps> = ({ meeting, onLeaveMeeting }) => {
   // Recording refs
   const canvasRef = useRef<HTMLCanvasElement>(null);
   const mediaRecorderRef = useRef<MediaRecorder | null>(null);
-  const recordedChunksRef = useRef<Blob[]>([]);
 
   const updateBoundsIfNeeded = () => {
     if (meetingLeftRef.current) return;
@@ -99,37 +98,68 @@ const Meeting: React.FC<MeetingProps> = ({ meeting, onLeaveMeeting }) => {
     messagesEndRef.current?.scrollIntoView({ behavior: 'smooth' });
   }, [messages]);
 
-  // Set up meeting page info and participants callbacks
+  // Keep the participant roster live from the join/leave events
   useEffect(() => {
     if (!isCEF()) return;
 
-    setMeetingPageInfoCallback((info) => {
-      console.log('[Meeting] Received page info:', info);
-      setMeetingPageInfo(info);
+    // Events are delivered in order with the snapshot reply, so the
+    // snapshot already contains any event that arrived before it
+    let active = true;
+    const unsubscribe = subscribe('participants', ({ joined, left }) => {
+      setMeetingParticipants((current) => {
+        const next = [...current];
+        left.forEach((name) => {
+          const index = next.indexOf(name);
+          if (index !== -1) next.splice(index, 1);
+        });
+        return next.concat(joined);
+      });
     });
+    getMeetingParticipants()
+      .then((participants) => {
+        if (active) setMeetingParticipants(participants);
+      })
+      .catch((error) => console.warn('[Meeting] Participants unavailable:', error));
 
-    setMeetingParticipantsCallback((participants) => {
-      console.log('[Meeting] Received participants:', participants);
-      setMeetingParticipants(participants);
-    });
+    return () => {
+      active = false;
+      unsubscribe();
+    };
+  }, []);
+
+  // Set up screencast and recording callbacks, and keep the page info fresh
+  useEffect(() => {
+    if (!isCEF()) return;
 
-    setScreencastFrameCallback((data) => {
-      if (!canvasRef.current) return;
+    // Page info is pushed on title changes; bursts arrive once per frame
+    let active = true;
+    const unsubscribePageInfo = subscribe('meetingPageInfo', setMeetingPageInfo, true);
 
-      const img = new Image();
-      img.onload = () => {
-        if (!canvasRef.current) return;
+    setScreencastFrameCallback((jpeg) => {
+      // Every frame must be reported once so the next capture is released
+      if (!canvasRef.current) {
+        screencastFrameConsumed();
+        return;
+      }
+
+      createImageBitmap(new Blob([jpeg], { type: 'image/jpeg' })).then((bitmap) => {
+        screencastFrameConsumed();
+        if (!canvasRef.current) {
+          bitmap.close();
+          return;
+        }
 
         // Set canvas dimensions to match image (first frame only effectively)
-        if (canvasRef.current.width !== img.width || canvasRef.current.height !== img.height) {
-            canvasRef.current.width = img.width;
-            canvasRef.current.height = img.height;
+        if (canvasRef.current.width !== bitmap.width || canvasRef.current.height !== bitmap.height) {
+            canvasRef.current.width = bitmap.width;
+            canvasRef.current.height = bitmap.height;
         }
 
         const ctx = canvasRef.current.getContext('2d');
         if (ctx) {
-          ctx.drawImage(img, 0, 0);
+          ctx.drawImage(bitmap, 0, 0);
         }
+        bitmap.close();
 
         // Start recording on first frame if enabled
         if (isRecording && !mediaRecorderRef.current) {
@@ -143,26 +173,26 @@ const Meeting: React.FC<MeetingProps> = ({ meeting, onLeaveMeeting }) => {
              mediaRecorderRef.current = new MediaRecorder(stream);
            }
 
+           // Each chunk is streamed to disk as soon as it is produced
+           const session = openRecordingSession(currentMeeting.id);
+
            mediaRecorderRef.current.ondataavailable = (event) => {
              if (event.data && event.data.size > 0) {
-               recordedChunksRef.current.push(event.data);
+               session.append(event.data);
              }
            };
 
            mediaRecorderRef.current.onstop = () => {
-             const blob = new Blob(recordedChunksRef.current, { type: 'video/webm' });
-             saveRecording(blob);
-             recordedChunksRef.current = [];
+             session.finalize();
              mediaRecorderRef.current = null;
            };
 
            mediaRecorderRef.current.start(1000); // Collect chunks every second
         }
-      };
-      img.src = 'data:image/jpeg;base64,' + data;
+      }, () => screencastFrameConsumed());
     });
 
-    setRecordingSavedCallback((meetingId, recordingPath) => {
+    const unsubscribeRecordingSaved = subscribe('recordingSaved', ({ meetingId, recordingPath }) => {
       console.log('[Meeting] Recording saved:', meetingId, recordingPath);
       meetingService.saveRecordingUrl(meetingId, recordingPath);
 
@@ -175,25 +205,28 @@ const Meeting: React.FC<MeetingProps> = ({ meeting, onLeaveMeeting }) => {
       }
     });
 
-    // Request page info and sync bounds periodically to keep it updated/visible
+    // Sync bounds periodically to keep the view visible
     const interval = setInterval(() => {
       if (meetingLeftRef.current) return;
-      getMeetingPageInfo();
       updateBoundsIfNeeded();
     }, 3000);
 
-    // Initial request
+    // Initial request; later changes are pushed
     setTimeout(() => {
-      getMeetingPageInfo();
+      getMeetingPageInfo()
+        .then((info) => {
+          if (active) setMeetingPageInfo(info);
+        })
+        .catch((error) => console.warn('[Meeting] Page info unavailable:', error));
       updateBoundsIfNeeded();
     }, 1000);
 
     return () => {
+      active = false;
       clearInterval(interval);
-      setMeetingPageInfoCallback(() => {});
-      setMeetingParticipantsCallback(() => {});
-      setScreencastFrameCallback(() => {});
-      setRecordingSavedCallback(() => {});
+      unsubscribePageInfo();
+      unsubscribeRecordingSaved();
+      setScreencastFrameCallback(null);
     };
   }, [isRecording, currentMeeting.id]);
 
@@ -318,18 +351,8 @@ const Meeting: React.FC<MeetingProps> = ({ meeting, onLeaveMeeting }) => {
     let response: string;
 
     if (isParticipantQuery && isCEF()) {
-      // Request participants from the content browser and wait for response
-      const participants = await new Promise<string[]>((resolve) => {
-        const timeout = setTimeout(() => resolve([]), 2000); // Timeout after 2s
-
-        setMeetingParticipantsCallback((result) => {
-          clearTimeout(timeout);
-          setMeetingParticipants(result);
-          resolve(result);
-        });
-
-        getMeetingParticipants();
-      });
+      // The roster is pushed by the participant agent in the meeting page
+      const participants = meetingParticipants;
 
       if (participants.length > 0) {
         const participantList = participants
@@ -339,9 +362,8 @@ const Meeting: React.FC<MeetingProps> = ({ meeting, onLeaveMeeting }) => {
         response = `**Participants in this meeting (${participants.length}):**\n\n${participantList}`;
       } else {
         response = "I couldn't find any participants. This could mean:\n\n" +
-                   "• The participant list isn't currently visible\n" +
-                   "• The meeting platform's HTML structure has changed\n" +
-                   "• You might need to open the participants panel first\n\n" +
+                   "• You haven't joined the meeting yet\n" +
+                   "• The meeting platform's HTML structure has changed\n\n" +
                    "Try opening the participants list in your meeting and ask again.";
       }
     } else if (isMeetingQuery && meetingPageInfo) {
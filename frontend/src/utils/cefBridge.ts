@@ -5,6 +5,76 @@ export interface MeetingPageInfo {
   title: string;
 }
 
+// 'renderer': frames are drawn to a canvas and encoded by MediaRecorder (WebM).
+// 'native': the browser process writes the screencast JPEGs straight to an
+// MJPEG .mkv file without sending them to the UI renderer.
+export type RecordingMode = 'renderer' | 'native';
+
+// Native mode only. 'vp8'/'vp9' encode in the browser process (WebM) when the
+// app is built with libvpx; otherwise the recording falls back to MJPEG.
+// 'tiles' stores only the 64x64 tiles that changed between frames, which
+// makes slide-heavy meetings a fraction of the MJPEG size; such .mkv files
+// are only readable by the app itself.
+export interface RecordingOptions {
+  codec?: 'mjpeg' | 'vp8' | 'vp9' | 'tiles';
+  bitrateKbps?: number;
+  preset?: 'realtime' | 'balanced' | 'quality';
+  // CSS selector of the element to record in the meeting page, e.g. the
+  // shared screen; the rest of the page is cropped away. Followed as it
+  // moves or resizes.
+  cropSelector?: string;
+}
+
+// Instant replay: the browser process keeps the last |seconds| of the
+// meeting (bounded by |maxMegabytes|) so it can be saved after the fact
+export interface ReplayOptions {
+  seconds?: number;
+  maxMegabytes?: number;
+}
+
+// Slide detection: distinct slides of the meeting are saved as JPEGs with a
+// slides.jsonl sidecar next to the recordings
+export interface SlideDetectionOptions {
+  changeThreshold?: number;  // Share of the screen that must change, 0..1
+  intervalMs?: number;
+}
+
+// Visual search: a recording (or slides directory) showing a frame like the
+// query, with the position of the closest sampled frame
+export interface FrameMatch {
+  path: string;
+  offsetMs: number;
+  distance: number;  // Differing bits of the 64-bit frame hashes
+}
+
+// Preview images generated next to a recording: a poster frame and a scrub
+// sprite sheet whose tiles are mapped to time ranges by a WebVTT file
+// ("sprite.jpg#xywh=x,y,w,h" cues)
+export interface RecordingPreviews {
+  poster: string;
+  sprite: string;
+  index: string;
+  tileCount: number;
+}
+
+// Receives each screencast frame as JPEG bytes; |timestamp| is in seconds
+export type ScreencastFrameHandler = (jpeg: ArrayBuffer, timestamp: number) => void;
+
+// Events pushed by the native side, by topic
+export interface EventPayloads {
+  authToken: { token: string };
+  recordingSaved: { meetingId: string; recordingPath: string };
+  // Made in the background once a recording is saved
+  recordingPreviews: { recordingPath: string; previews: RecordingPreviews | null };
+  // Whenever the meeting page's title changes
+  meetingPageInfo: MeetingPageInfo;
+  // Names that joined and left the meeting since the last event; a name
+  // appears once per person with that name
+  participants: { joined: string[]; left: string[] };
+}
+
+export type EventTopic = keyof EventPayloads;
+
 declare global {
   interface Window {
     rebrazeAuth?: {
@@ -13,18 +83,26 @@ declare global {
       joinMeeting: (url: string, x: number, y: number, width: number, height: number) => boolean;
       leaveMeeting: () => boolean;
       updateMeetingBounds: (x: number, y: number, width: number, height: number) => boolean;
-      getMeetingPageInfo: () => boolean;
-      getMeetingParticipants: () => boolean;
-      sendParticipantList: (jsonList: string) => boolean;
-      startRecording: (meetingId: string) => boolean;
+      getMeetingPageInfo: () => Promise<MeetingPageInfo>;
+      getMeetingParticipants: () => Promise<string[]>;
+      participantsChanged: (joined: string[], left: string[]) => boolean;
+      reportRecordingCrop: (x: number, y: number, width: number, height: number) => boolean;
+      startRecording: (meetingId: string, mode?: RecordingMode, options?: RecordingOptions) => boolean;
       stopRecording: () => boolean;
-      saveRecording: (data: string, isLast: boolean) => boolean;
+      setScreencastFrameHandler: (handler: ScreencastFrameHandler | null) => boolean;
+      screencastFrameConsumed: () => boolean;
+      openRecordingSession: (meetingId: string) => boolean;
+      appendRecordingChunk: (sequence: number, data: ArrayBuffer) => boolean;
+      finalizeRecordingSession: (chunkCount: number) => boolean;
+      setReplayBufferEnabled: (enabled: boolean, options?: ReplayOptions) => boolean;
+      saveReplay: (meetingId: string) => boolean;
+      startSlideDetection: (meetingId: string, options?: SlideDetectionOptions) => boolean;
+      stopSlideDetection: () => boolean;
+      searchFrames: (jpeg: ArrayBuffer, maxResults?: number) => Promise<FrameMatch[]>;
+      getRecordingPreviews: (recordingPath: string) => Promise<RecordingPreviews | null>;
+      subscribe: (topic: string, handler: (payload: any) => void, coalesce?: boolean) => number;
+      unsubscribe: (id: number) => boolean;
     };
-    onAuthTokenReceived?: (token: string) => void;
-    onMeetingPageInfo?: (info: MeetingPageInfo) => void;
-    onMeetingParticipants?: (participants: string[]) => void;
-    onScreencastFrame?: (data: string) => void;
-    onRecordingSaved?: (meetingId: string, recordingPath: string) => void;
   }
 }
 
@@ -39,12 +117,6 @@ export const openSystemBrowser = (url: string): boolean => {
   return false;
 };
 
-export const setAuthTokenCallback = (callback: (token: string) => void): void => {
-  if (typeof window !== 'undefined') {
-    window.onAuthTokenReceived = callback;
-  }
-};
-
 export const navigateToMeetingUrl = (url: string): boolean => {
   if (isCEF() && window.rebrazeAuth) {
     return window.rebrazeAuth.navigateToMeetingUrl(url);
@@ -81,91 +153,193 @@ export const updateMeetingBounds = (x: number, y: number, width: number, height:
   return false;
 };
 
-export const getMeetingPageInfo = (): boolean => {
+// Request/response calls return promises. Every call has its own request
+// id on the native side, so concurrent calls never clobber each other; the
+// promise is rejected if the native side does not answer in time.
+const notInCEF = (): Promise<never> => Promise.reject(new Error('Not in CEF environment'));
+
+export const getMeetingPageInfo = (): Promise<MeetingPageInfo> => {
   if (isCEF() && window.rebrazeAuth) {
-    console.log('[CEF Bridge] Requesting meeting page info');
     return window.rebrazeAuth.getMeetingPageInfo();
   }
-  console.warn('[CEF Bridge] Not in CEF environment, cannot get meeting page info');
+  return notInCEF();
+};
+
+export const getMeetingParticipants = (): Promise<string[]> => {
+  if (isCEF() && window.rebrazeAuth) {
+    console.log('[CEF Bridge] Requesting meeting participants');
+    return window.rebrazeAuth.getMeetingParticipants();
+  }
+  return notInCEF();
+};
+
+export const startRecording = (
+  meetingId: string,
+  mode: RecordingMode = 'renderer',
+  options?: RecordingOptions
+): boolean => {
+  if (isCEF() && window.rebrazeAuth) {
+    console.log('[CEF Bridge] Starting recording for meeting:', meetingId, 'mode:', mode);
+    return options
+      ? window.rebrazeAuth.startRecording(meetingId, mode, options)
+      : window.rebrazeAuth.startRecording(meetingId, mode);
+  }
+  console.warn('[CEF Bridge] Not in CEF environment, cannot start recording');
   return false;
 };
 
-export const setMeetingPageInfoCallback = (callback: (info: MeetingPageInfo) => void): void => {
-  if (typeof window !== 'undefined') {
-    window.onMeetingPageInfo = callback;
+export const stopRecording = (): boolean => {
+  if (isCEF() && window.rebrazeAuth) {
+    console.log('[CEF Bridge] Stopping recording');
+    return window.rebrazeAuth.stopRecording();
   }
+  console.warn('[CEF Bridge] Not in CEF environment, cannot stop recording');
+  return false;
 };
 
-export const getMeetingParticipants = (): boolean => {
+export const setReplayBufferEnabled = (enabled: boolean, options?: ReplayOptions): boolean => {
   if (isCEF() && window.rebrazeAuth) {
-    console.log('[CEF Bridge] Requesting meeting participants');
-    return window.rebrazeAuth.getMeetingParticipants();
+    console.log('[CEF Bridge] Instant replay', enabled ? 'enabled' : 'disabled');
+    return options
+      ? window.rebrazeAuth.setReplayBufferEnabled(enabled, options)
+      : window.rebrazeAuth.setReplayBufferEnabled(enabled);
   }
-  console.warn('[CEF Bridge] Not in CEF environment, cannot get meeting participants');
   return false;
 };
 
-export const setMeetingParticipantsCallback = (callback: (participants: string[]) => void): void => {
-  if (typeof window !== 'undefined') {
-    window.onMeetingParticipants = callback;
+// Save the replay buffer; the file is published as a "recordingSaved" event
+export const saveReplay = (meetingId: string): boolean => {
+  if (isCEF() && window.rebrazeAuth) {
+    console.log('[CEF Bridge] Saving replay for meeting:', meetingId);
+    return window.rebrazeAuth.saveReplay(meetingId);
   }
+  console.warn('[CEF Bridge] Not in CEF environment, cannot save replay');
+  return false;
 };
 
-export const startRecording = (meetingId: string): boolean => {
+export const startSlideDetection = (meetingId: string, options?: SlideDetectionOptions): boolean => {
   if (isCEF() && window.rebrazeAuth) {
-    console.log('[CEF Bridge] Starting recording for meeting:', meetingId);
-    return window.rebrazeAuth.startRecording(meetingId);
+    console.log('[CEF Bridge] Starting slide detection for meeting:', meetingId);
+    return options
+      ? window.rebrazeAuth.startSlideDetection(meetingId, options)
+      : window.rebrazeAuth.startSlideDetection(meetingId);
   }
-  console.warn('[CEF Bridge] Not in CEF environment, cannot start recording');
   return false;
 };
 
-export const stopRecording = (): boolean => {
+export const stopSlideDetection = (): boolean => {
   if (isCEF() && window.rebrazeAuth) {
-    console.log('[CEF Bridge] Stopping recording');
-    return window.rebrazeAuth.stopRecording();
+    console.log('[CEF Bridge] Stopping slide detection');
+    return window.rebrazeAuth.stopSlideDetection();
   }
-  console.warn('[CEF Bridge] Not in CEF environment, cannot stop recording');
   return false;
 };
 
-export const saveRecording = (blob: Blob): void => {
-  if (isCEF() && window.rebrazeAuth) {
-    console.log('[CEF Bridge] Saving recording, size:', blob.size);
-    const reader = new FileReader();
-    reader.onload = () => {
-      const base64 = (reader.result as string).split(',')[1];
-      const chunkSize = 1024 * 512; // 512KB chunks
-      const totalChunks = Math.ceil(base64.length / chunkSize);
-      
-      for (let i = 0; i < totalChunks; i++) {
-        const chunk = base64.slice(i * chunkSize, (i + 1) * chunkSize);
-        const isLast = i === totalChunks - 1;
-        window.rebrazeAuth!.saveRecording(chunk, isLast);
-      }
+// Find recordings showing a frame like |jpeg| (a baseline JPEG, e.g. a
+// screenshot)
+export const searchFrames = (jpeg: ArrayBuffer, maxResults?: number): Promise<FrameMatch[]> => {
+  if (isCEF() && window.rebrazeAuth) {
+    return maxResults !== undefined
+      ? window.rebrazeAuth.searchFrames(jpeg, maxResults)
+      : window.rebrazeAuth.searchFrames(jpeg);
+  }
+  return notInCEF();
+};
+
+// The previews of a saved recording, or null for recordings that cannot be
+// previewed. They are made in the background (and cached) when a recording
+// is saved, and also published as "recordingPreviews" events then.
+export const getRecordingPreviews = (recordingPath: string): Promise<RecordingPreviews | null> => {
+  if (isCEF() && window.rebrazeAuth) {
+    return window.rebrazeAuth.getRecordingPreviews(recordingPath);
+  }
+  return notInCEF();
+};
+
+// A renderer-mode recording streamed to disk as MediaRecorder produces it,
+// so the renderer never holds more than the chunk being sent.
+export interface RecordingSession {
+  append: (chunk: Blob) => void;
+  finalize: () => void;
+}
+
+export const openRecordingSession = (meetingId: string): RecordingSession => {
+  if (isCEF() && window.rebrazeAuth) {
+    console.log('[CEF Bridge] Opening recording session for meeting:', meetingId);
+    window.rebrazeAuth.openRecordingSession(meetingId);
+
+    // Blob reads are async; chain them so chunks are sent in sequence order
+    let pending: Promise<void> = Promise.resolve();
+    let sequence = 0;
+
+    return {
+      append: (chunk: Blob) => {
+        const chunkSequence = sequence++;
+        pending = pending
+          .then(async () => {
+            const data = await chunk.arrayBuffer();
+            window.rebrazeAuth!.appendRecordingChunk(chunkSequence, data);
+          })
+          .catch((error) => {
+            console.error('[CEF Bridge] Failed to send recording chunk:', chunkSequence, error);
+          });
+      },
+      finalize: () => {
+        const chunkCount = sequence;
+        pending = pending.then(() => {
+          console.log('[CEF Bridge] Finalizing recording session, chunks:', chunkCount);
+          window.rebrazeAuth!.finalizeRecordingSession(chunkCount);
+        });
+      },
     };
-    reader.readAsDataURL(blob);
-    return;
   }
-  console.warn('[CEF Bridge] Not in CEF environment, cannot save recording');
-  
-  // Fallback for web dev: download the file
-  const url = URL.createObjectURL(blob);
-  const a = document.createElement('a');
-  a.href = url;
-  a.download = 'recording.webm';
-  a.click();
-  URL.revokeObjectURL(url);
+  console.warn('[CEF Bridge] Not in CEF environment, recording will be downloaded');
+
+  // Fallback for web dev: keep the chunks and download the file at the end
+  const chunks: Blob[] = [];
+  return {
+    append: (chunk: Blob) => {
+      chunks.push(chunk);
+    },
+    finalize: () => {
+      const url = URL.createObjectURL(new Blob(chunks, { type: 'video/webm' }));
+      const a = document.createElement('a');
+      a.href = url;
+      a.download = 'recording.webm';
+      a.click();
+      URL.revokeObjectURL(url);
+    },
+  };
+};
+
+export const setScreencastFrameCallback = (callback: ScreencastFrameHandler | null): void => {
+  if (isCEF() && window.rebrazeAuth) {
+    window.rebrazeAuth.setScreencastFrameHandler(callback);
+  }
 };
 
-export const setScreencastFrameCallback = (callback: (data: string) => void): void => {
-  if (typeof window !== 'undefined') {
-    window.onScreencastFrame = callback;
+// Tell the native side a screencast frame has been drawn. Frames are only
+// acknowledged to Chromium as they are consumed, so this paces the capture.
+export const screencastFrameConsumed = (): void => {
+  if (isCEF() && window.rebrazeAuth) {
+    window.rebrazeAuth.screencastFrameConsumed();
   }
 };
 
-export const setRecordingSavedCallback = (callback: (meetingId: string, recordingPath: string) => void): void => {
-  if (typeof window !== 'undefined') {
-    window.onRecordingSaved = callback;
+// Receive the events of |topic| until the returned function is called. With
+// |coalesce|, a burst of events is delivered once per animation frame with
+// the latest payload. Each call adds a handler; unsubscribing removes only
+// that one.
+export const subscribe = <T extends EventTopic>(
+  topic: T,
+  handler: (payload: EventPayloads[T]) => void,
+  coalesce = false
+): (() => void) => {
+  if (!isCEF() || !window.rebrazeAuth) {
+    return () => {};
   }
+  const id = window.rebrazeAuth.subscribe(topic, handler, coalesce);
+  return () => {
+    window.rebrazeAuth?.unsubscribe(id);
+  };
 };